@@ -8,7 +8,23 @@
 #include "complex.hpp"
 #include "matrix.hpp"
 #include "quantum_gates.hpp"
+#include "state_vector.hpp"
+#include "random_source.hpp"
+#include "circuit.hpp"
+#include "simd_kernels.hpp"
+#include "kernels.hpp"
 #include "qubits.hpp"
+#include "stabiliser.hpp"
+#include "amplitude_map.hpp"
+#include "sparse_qubits.hpp"
+#include "factorised_qubits.hpp"
+#include "density_matrix.hpp"
+#include "trajectories.hpp"
+#include "svd.hpp"
+#include "matrix_product_state.hpp"
+#include "decision_diagram.hpp"
+#include "tensor_network.hpp"
+#include "schrodinger_feynman.hpp"
 #include "qmulator_graphics.hpp"
 
 #endif
\ No newline at end of file
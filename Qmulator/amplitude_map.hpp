@@ -0,0 +1,166 @@
+#ifndef QMULATOR_AMPLITUDE_MAP_HPP
+#define QMULATOR_AMPLITUDE_MAP_HPP
+
+#include <vector>
+#include <stdint.h>
+#include "complex.hpp"
+
+/*
+	Open-addressing hash map from basis index to amplitude, for states with
+	few nonzero coefficients. Keys and values sit in two flat arrays probed
+	linearly from a mixed hash of the key, and the table doubles before it
+	is half full. EMPTY marks a free slot, so keys must stay below 2^64 - 1.
+	Entries are never removed one by one; a map is rebuilt instead.
+*/
+
+template<class T>
+class AmplitudeMap
+{
+private:
+	vector<uint64_t> keys;
+	vector<Complex<T> > values;
+	uint64_t numEntries;
+	uint64_t mask;
+
+	uint64_t find(uint64_t);
+	void grow();
+
+	static uint64_t hash(uint64_t);
+
+public:
+	static const uint64_t EMPTY = ~0ULL;
+	static const uint64_t MIN_CAPACITY = 16;
+
+	AmplitudeMap();
+
+	void reset(uint64_t);
+	void add(uint64_t, Complex<T>);
+	Complex<T> get(uint64_t);
+
+	uint64_t size() { return numEntries; }
+	uint64_t capacity() { return keys.size(); }
+	uint64_t bytes() { return keys.size() * (sizeof(uint64_t) + sizeof(Complex<T>)); }
+
+	bool occupied(uint64_t slot) { return keys[slot] != EMPTY; }
+	uint64_t key(uint64_t slot) { return keys[slot]; }
+	Complex<T>& value(uint64_t slot) { return values[slot]; }
+
+	void swap(AmplitudeMap<T> &);
+};
+
+template<class T>
+const uint64_t AmplitudeMap<T>::EMPTY;
+
+template<class T>
+const uint64_t AmplitudeMap<T>::MIN_CAPACITY;
+
+template<class T>
+AmplitudeMap<T>::AmplitudeMap()
+{
+	reset(0);
+}
+
+template<class T>
+uint64_t AmplitudeMap<T>::hash(uint64_t key)
+{
+	// splitmix64 finaliser; basis indices differ in few bits, so they are
+	// mixed before the low bits pick a slot
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+
+	return key;
+}
+
+template<class T>
+void AmplitudeMap<T>::reset(uint64_t entries)
+{
+	// Empties the map, sized to hold the given number of entries without
+	// growing.
+	uint64_t slots = MIN_CAPACITY;
+
+	while(slots < 2 * entries)
+		slots <<= 1;
+
+	keys.assign(slots, EMPTY);
+	values.assign(slots, Complex<T>(0, 0));
+	numEntries = 0;
+	mask = slots - 1;
+}
+
+template<class T>
+uint64_t AmplitudeMap<T>::find(uint64_t key)
+{
+	// Slot holding the key, or the empty slot where it would go.
+	uint64_t slot = hash(key) & mask;
+
+	while(keys[slot] != EMPTY && keys[slot] != key)
+		slot = (slot + 1) & mask;
+
+	return slot;
+}
+
+template<class T>
+void AmplitudeMap<T>::grow()
+{
+	vector<uint64_t> oldKeys;
+	vector<Complex<T> > oldValues;
+
+	oldKeys.swap(keys);
+	oldValues.swap(values);
+
+	keys.assign(2 * oldKeys.size(), EMPTY);
+	values.assign(2 * oldKeys.size(), Complex<T>(0, 0));
+	mask = keys.size() - 1;
+
+	for(uint64_t i=0; i<oldKeys.size(); ++i)
+	{
+		if(oldKeys[i] == EMPTY)
+			continue;
+
+		uint64_t slot = find(oldKeys[i]);
+		keys[slot] = oldKeys[i];
+		values[slot] = oldValues[i];
+	}
+}
+
+template<class T>
+void AmplitudeMap<T>::add(uint64_t key, Complex<T> value)
+{
+	// Adds value to the amplitude of key, inserting it if absent.
+	if(2 * (numEntries + 1) > keys.size())
+		grow();
+
+	uint64_t slot = find(key);
+
+	if(keys[slot] == EMPTY)
+	{
+		keys[slot] = key;
+		values[slot] = value;
+		++numEntries;
+		return;
+	}
+
+	values[slot] += value;
+}
+
+template<class T>
+Complex<T> AmplitudeMap<T>::get(uint64_t key)
+{
+	uint64_t slot = find(key);
+
+	return (keys[slot] == EMPTY)? Complex<T>(0, 0) : values[slot];
+}
+
+template<class T>
+void AmplitudeMap<T>::swap(AmplitudeMap<T> &other)
+{
+	keys.swap(other.keys);
+	values.swap(other.values);
+	std::swap(numEntries, other.numEntries);
+	std::swap(mask, other.mask);
+}
+
+#endif
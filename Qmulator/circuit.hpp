@@ -0,0 +1,162 @@
+#ifndef QMULATOR_CIRCUIT_HPP
+#define QMULATOR_CIRCUIT_HPP
+
+#include <vector>
+#include <stdint.h>
+#include "complex.hpp"
+#include "matrix.hpp"
+
+/*
+	Typed record of the operations applied to a register. Qubits of a
+	controlled operation are listed controls first, then open controls,
+	then the target. Matrices are kept by the circuit and referred to by
+	index, so an Operation does not depend on the precision type.
+*/
+
+struct Operation
+{
+	enum opType: int
+	{
+		H = 0,
+		X = 1,
+		Y = 2,
+		Z = 3,
+		T = 4,
+		S = 5,
+		U = 6,
+		PHASE = 7, // diag(1, e^(i params[0]))
+		CNOT = 10,
+		CY = 11,
+		CZ = 12,
+		TOFFOLI = 13,
+		MCU = 14,
+		UNITARY = 15,
+		SWAP = 20,
+		MEASURE = 30,
+		MEASURE_ALL = 31,
+		RESET = 32,
+		DISCARD = 33,
+		MARGIN = 40,
+		BARRIER = 41,
+	};
+
+	int type;
+	vector<int> qubits;
+	int numControls;
+	int numOpenControls;
+	vector<double> params;
+	int matrix;
+	bool drawn;
+
+	Operation();
+	Operation(int, vector<int>);
+	Operation(int, int);
+	Operation(int, int, int);
+	Operation(int, int, int, int);
+	void initialise(int, vector<int>);
+
+	int target() { return qubits.back(); }
+	bool isUnitary() { return type < MEASURE; }
+	bool hasMatrix() { return matrix >= 0; }
+};
+
+inline Operation::Operation()
+{
+	initialise(BARRIER, vector<int>());
+}
+
+inline Operation::Operation(int type, vector<int> qubits)
+{
+	initialise(type, qubits);
+}
+
+inline Operation::Operation(int type, int qubit)
+{
+	initialise(type, vector<int>(1, qubit));
+}
+
+inline Operation::Operation(int type, int qubit1, int qubit2)
+{
+	vector<int> qubits;
+	qubits.push_back(qubit1);
+	qubits.push_back(qubit2);
+
+	initialise(type, qubits);
+}
+
+inline Operation::Operation(int type, int qubit1, int qubit2, int qubit3)
+{
+	vector<int> qubits;
+	qubits.push_back(qubit1);
+	qubits.push_back(qubit2);
+	qubits.push_back(qubit3);
+
+	initialise(type, qubits);
+}
+
+inline void Operation::initialise(int typeIn, vector<int> qubitsIn)
+{
+	type = typeIn;
+	qubits = qubitsIn;
+	numOpenControls = 0;
+	matrix = -1;
+	drawn = true;
+
+	switch(type)
+	{
+		case CNOT: case CY: case CZ: numControls = 1; break;
+		case TOFFOLI: numControls = 2; break;
+		default: numControls = 0; break;
+	}
+}
+
+template<class T>
+class Circuit
+{
+private:
+	vector<Matrix<T> > matrices;
+
+public:
+	vector<Operation> operations;
+
+	void add(Operation);
+	void add(Operation, Matrix<T>);
+	int addMatrix(Matrix<T>);
+	void clear();
+
+	uint64_t size() { return operations.size(); }
+	Operation& at(uint64_t i) { return operations.at(i); }
+	Matrix<T>& matrix(Operation &op) { return matrices.at(op.matrix); }
+};
+
+template<class T>
+void Circuit<T>::add(Operation op)
+{
+	operations.push_back(op);
+}
+
+template<class T>
+void Circuit<T>::add(Operation op, Matrix<T> m)
+{
+	op.matrix = matrices.size();
+	matrices.push_back(m);
+	operations.push_back(op);
+}
+
+template<class T>
+int Circuit<T>::addMatrix(Matrix<T> m)
+{
+	// Stores a matrix without an operation; returns its handle.
+	matrices.push_back(m);
+
+	return matrices.size() - 1;
+}
+
+template<class T>
+void Circuit<T>::clear()
+{
+	operations.clear();
+	matrices.clear();
+}
+
+#endif
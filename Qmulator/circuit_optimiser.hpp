@@ -0,0 +1,470 @@
+#ifndef QMULATOR_CIRCUIT_OPTIMISER_HPP
+#define QMULATOR_CIRCUIT_OPTIMISER_HPP
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <stdint.h>
+#include <math.h>
+#include "complex.hpp"
+#include "matrix.hpp"
+#include "circuit.hpp"
+
+/*
+	Peephole optimiser over a recorded circuit. Each gate is compared with
+	the closest earlier gate on the same qubits: inverse pairs are removed
+	and single-qubit phases are multiplied together. The search carries on
+	past gates that commute with it, so diagonal gates can slide through
+	the controls of controlled gates to meet their partner. Barriers and
+	measurements are never crossed.
+*/
+
+template<class T>
+class CircuitOptimiser
+{
+private:
+	Circuit<T> work;
+	vector<bool> alive;
+
+	uint64_t numGatesRemoved;
+	uint64_t numSweepsRemoved;
+	T tolerance;
+
+	static const int LOOKBACK = 256;
+
+	bool cancels(Operation &, Operation &);
+	bool mergePhases(uint64_t, uint64_t);
+	bool commutes(Operation &, Operation &);
+
+	bool isDiagonal(Operation &);
+	bool isDiagonal(Circuit<T> &, Operation &);
+	bool isControlled(Operation &);
+	bool isControl(Operation &, int);
+	bool phasesOf(Operation &, Complex<T> *, Complex<T> *);
+	bool isInverse(Matrix<T>, Matrix<T>);
+	bool isNear(Complex<T>, Complex<T>);
+	bool shareQubits(Operation &, Operation &);
+	bool sameSet(vector<int>, vector<int>);
+
+	uint64_t countGates(Circuit<T> &);
+	uint64_t countSweeps(Circuit<T> &);
+
+public:
+	CircuitOptimiser();
+
+	Circuit<T> optimise(Circuit<T> &, uint64_t);
+
+	uint64_t gatesRemoved() { return numGatesRemoved; }
+	uint64_t sweepsRemoved() { return numSweepsRemoved; }
+	void resetCounts();
+};
+
+template<class T>
+CircuitOptimiser<T>::CircuitOptimiser()
+{
+	tolerance = 64 * numeric_limits<T>::epsilon();
+	resetCounts();
+}
+
+template<class T>
+void CircuitOptimiser<T>::resetCounts()
+{
+	numGatesRemoved = 0;
+	numSweepsRemoved = 0;
+}
+
+template<class T>
+Circuit<T> CircuitOptimiser<T>::optimise(Circuit<T> &circuit, uint64_t begin)
+{
+	// Returns the optimised copy of the operations from begin onwards; the
+	// circuit itself is left as recorded.
+	work.clear();
+
+	for(uint64_t i=begin; i<circuit.size(); ++i)
+	{
+		Operation &op = circuit.at(i);
+
+		if(op.hasMatrix())
+			work.add(op, circuit.matrix(op));
+		else
+			work.add(op);
+	}
+
+	alive.assign(work.size(), true);
+
+	uint64_t gatesBefore = countGates(work);
+	uint64_t sweepsBefore = countSweeps(work);
+
+	for(uint64_t i=0; i<work.size(); ++i)
+	{
+		Operation &op = work.at(i);
+
+		if(!op.isUnitary())
+			continue;
+
+		uint64_t stop = (i > LOOKBACK)? i - LOOKBACK : 0;
+
+		for(uint64_t j=i; j-- > stop; )
+		{
+			if(!alive[j])
+				continue;
+
+			Operation &prev = work.at(j);
+
+			if(prev.type == Operation::BARRIER)
+				break;
+
+			if(!shareQubits(prev, op))
+				continue;
+
+			if(!prev.isUnitary())
+				break;
+
+			if(cancels(prev, op))
+			{
+				alive[j] = false;
+				alive[i] = false;
+				break;
+			}
+
+			if(mergePhases(j, i) || !commutes(prev, op))
+				break;
+		}
+	}
+
+	Circuit<T> result;
+
+	for(uint64_t i=0; i<work.size(); ++i)
+	{
+		if(!alive[i])
+			continue;
+
+		Operation &op = work.at(i);
+
+		if(op.hasMatrix())
+			result.add(op, work.matrix(op));
+		else
+			result.add(op);
+	}
+
+	numGatesRemoved += gatesBefore - countGates(result);
+	numSweepsRemoved += sweepsBefore - countSweeps(result);
+
+	return result;
+}
+
+/* Rewrites */
+
+template<class T>
+bool CircuitOptimiser<T>::cancels(Operation &a, Operation &b)
+{
+	// True if b undoes a.
+	if(a.type != b.type)
+		return false;
+
+	switch(a.type)
+	{
+		case Operation::H:
+		case Operation::X:
+		case Operation::Y:
+		case Operation::Z:
+		case Operation::CNOT:
+		case Operation::CY:
+			return a.qubits == b.qubits;
+
+		case Operation::CZ:
+		case Operation::SWAP:
+			return sameSet(a.qubits, b.qubits);
+
+		case Operation::TOFFOLI:
+			return a.target() == b.target() && sameSet(a.qubits, b.qubits);
+
+		case Operation::U:
+		case Operation::UNITARY:
+			return a.qubits == b.qubits && isInverse(work.matrix(a), work.matrix(b));
+
+		case Operation::MCU:
+		{
+			if(a.target() != b.target() || a.numControls != b.numControls || a.numOpenControls != b.numOpenControls)
+				return false;
+
+			vector<int> closedA(a.qubits.begin(), a.qubits.begin() + a.numControls);
+			vector<int> closedB(b.qubits.begin(), b.qubits.begin() + b.numControls);
+
+			return sameSet(closedA, closedB) && sameSet(a.qubits, b.qubits) && isInverse(work.matrix(a), work.matrix(b));
+		}
+
+		default:
+			return false;
+	}
+}
+
+template<class T>
+bool CircuitOptimiser<T>::mergePhases(uint64_t j, uint64_t i)
+{
+	// Folds the single-qubit phase at i into the one at j, naming the
+	// product Z, S or T where it matches one and dropping it if it is 1.
+	Operation &a = work.at(j), &b = work.at(i);
+	Complex<T> a0, a1, b0, b1;
+
+	if(a.qubits != b.qubits || !phasesOf(a, &a0, &a1) || !phasesOf(b, &b0, &b1))
+		return false;
+
+	Complex<T> d0 = a0 * b0, d1 = a1 * b1;
+	Complex<T> one(1, 0);
+
+	alive[i] = false;
+
+	if(isNear(d0, one) && isNear(d1, one))
+	{
+		alive[j] = false;
+		return true;
+	}
+
+	Operation merged(Operation::U, a.target());
+
+	if(isNear(d0, one))
+	{
+		if(isNear(d1, Complex<T>(-1, 0)))
+			merged.type = Operation::Z;
+		else if(isNear(d1, Complex<T>(0, 1)))
+			merged.type = Operation::S;
+		else if(isNear(d1, Complex<T>(cos(M_PI / 4), sin(M_PI / 4))))
+			merged.type = Operation::T;
+		else
+		{
+			merged.type = Operation::PHASE;
+			merged.params.push_back(atan2(d1.getIm(), d1.getRe()));
+		}
+	}
+	else
+	{
+		Matrix<T> m(2, 2);
+
+		m.set(0, 0, d0);
+		m.set(1, 1, d1);
+
+		merged.matrix = work.addMatrix(m);
+	}
+
+	merged.drawn = a.drawn;
+	a = merged;
+
+	return true;
+}
+
+template<class T>
+bool CircuitOptimiser<T>::commutes(Operation &a, Operation &b)
+{
+	// Only rules that hold for every gate of the kind are used.
+	if(isDiagonal(a) && isDiagonal(b))
+		return true;
+
+	// a diagonal single-qubit gate passes through a control
+	if(a.qubits.size() == 1 && isDiagonal(a) && isControl(b, a.target()))
+		return true;
+
+	if(b.qubits.size() == 1 && isDiagonal(b) && isControl(a, b.target()))
+		return true;
+
+	// X passes through the target of a controlled NOT
+	bool aIsNot = a.type == Operation::CNOT || a.type == Operation::TOFFOLI;
+	bool bIsNot = b.type == Operation::CNOT || b.type == Operation::TOFFOLI;
+
+	if(a.type == Operation::X && bIsNot && b.target() == a.target())
+		return true;
+
+	if(b.type == Operation::X && aIsNot && a.target() == b.target())
+		return true;
+
+	// controlled gates that only share controls
+	if(isControlled(a) && isControlled(b))
+	{
+		bool targetA = find(b.qubits.begin(), b.qubits.end(), a.target()) != b.qubits.end();
+		bool targetB = find(a.qubits.begin(), a.qubits.end(), b.target()) != a.qubits.end();
+
+		return !targetA && !targetB;
+	}
+
+	return false;
+}
+
+/* Gate Properties */
+
+template<class T>
+bool CircuitOptimiser<T>::isDiagonal(Operation &op)
+{
+	return isDiagonal(work, op);
+}
+
+template<class T>
+bool CircuitOptimiser<T>::isDiagonal(Circuit<T> &circuit, Operation &op)
+{
+	switch(op.type)
+	{
+		case Operation::Z:
+		case Operation::T:
+		case Operation::S:
+		case Operation::PHASE:
+		case Operation::CZ:
+			return true;
+
+		case Operation::U:
+		case Operation::MCU:
+		case Operation::UNITARY:
+		{
+			Matrix<T> &u = circuit.matrix(op);
+
+			for(int r=0; r<u.rows(); ++r)
+			{
+				for(int c=0; c<u.cols(); ++c)
+				{
+					if(r != c && u.get(r, c).normSq() != 0)
+						return false;
+				}
+			}
+
+			return true;
+		}
+
+		default:
+			return false;
+	}
+}
+
+template<class T>
+bool CircuitOptimiser<T>::isControlled(Operation &op)
+{
+	return op.type == Operation::CNOT || op.type == Operation::CY || op.type == Operation::TOFFOLI || op.type == Operation::MCU;
+}
+
+template<class T>
+bool CircuitOptimiser<T>::isControl(Operation &op, int qubit)
+{
+	if(!isControlled(op))
+		return false;
+
+	for(int i=0; i<op.numControls + op.numOpenControls; ++i)
+	{
+		if(op.qubits.at(i) == qubit)
+			return true;
+	}
+
+	return false;
+}
+
+template<class T>
+bool CircuitOptimiser<T>::phasesOf(Operation &op, Complex<T> *d0, Complex<T> *d1)
+{
+	// Diagonal of a single-qubit diagonal gate.
+	*d0 = Complex<T>(1, 0);
+
+	switch(op.type)
+	{
+		case Operation::Z: *d1 = Complex<T>(-1, 0); return true;
+		case Operation::S: *d1 = Complex<T>(0, 1); return true;
+		case Operation::T: *d1 = Complex<T>(cos(M_PI / 4), sin(M_PI / 4)); return true;
+		case Operation::PHASE: *d1 = Complex<T>(cos(op.params.at(0)), sin(op.params.at(0))); return true;
+
+		case Operation::U:
+			if(!isDiagonal(op))
+				return false;
+
+			*d0 = work.matrix(op).get(0, 0);
+			*d1 = work.matrix(op).get(1, 1);
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+template<class T>
+bool CircuitOptimiser<T>::isInverse(Matrix<T> a, Matrix<T> b)
+{
+	Matrix<T> product = b * a;
+
+	for(int r=0; r<product.rows(); ++r)
+	{
+		for(int c=0; c<product.cols(); ++c)
+		{
+			if(!isNear(product.get(r, c), Complex<T>((r == c)? 1 : 0, 0)))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+template<class T>
+bool CircuitOptimiser<T>::isNear(Complex<T> a, Complex<T> b)
+{
+	return (a - b).normSq() <= tolerance * tolerance;
+}
+
+template<class T>
+bool CircuitOptimiser<T>::shareQubits(Operation &a, Operation &b)
+{
+	for(int i=0; i<b.qubits.size(); ++i)
+	{
+		if(find(a.qubits.begin(), a.qubits.end(), b.qubits.at(i)) != a.qubits.end())
+			return true;
+	}
+
+	return false;
+}
+
+template<class T>
+bool CircuitOptimiser<T>::sameSet(vector<int> a, vector<int> b)
+{
+	sort(a.begin(), a.end());
+	sort(b.begin(), b.end());
+
+	return a == b;
+}
+
+/* Statistics */
+
+template<class T>
+uint64_t CircuitOptimiser<T>::countGates(Circuit<T> &circuit)
+{
+	uint64_t gates = 0;
+
+	for(uint64_t i=0; i<circuit.size(); ++i)
+		gates += circuit.at(i).isUnitary();
+
+	return gates;
+}
+
+template<class T>
+uint64_t CircuitOptimiser<T>::countSweeps(Circuit<T> &circuit)
+{
+	// Passes over the state vector before fusion: one per non-diagonal gate
+	// (three for a swap) and one per run of diagonal gates between them.
+	uint64_t sweeps = 0;
+	bool pendingPhases = false;
+
+	for(uint64_t i=0; i<circuit.size(); ++i)
+	{
+		Operation &op = circuit.at(i);
+
+		if(op.type == Operation::MARGIN || op.type == Operation::BARRIER)
+			continue;
+
+		if(op.isUnitary() && isDiagonal(circuit, op))
+		{
+			pendingPhases = true;
+			continue;
+		}
+
+		sweeps += pendingPhases;
+		pendingPhases = false;
+
+		if(op.isUnitary())
+			sweeps += (op.type == Operation::SWAP)? 3 : 1;
+	}
+
+	return sweeps + pendingPhases;
+}
+
+#endif
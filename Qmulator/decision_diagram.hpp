@@ -0,0 +1,1145 @@
+#ifndef QMULATOR_DECISION_DIAGRAM_HPP
+#define QMULATOR_DECISION_DIAGRAM_HPP
+
+#include <stdio.h>
+#include <map>
+#include <limits>
+#include <vector>
+#include <stdint.h>
+#include <math.h>
+#include "complex.hpp"
+#include "random_source.hpp"
+#include "matrix.hpp"
+#include "quantum_gates.hpp"
+
+/*
+	Decision diagram (QMDD) backend for structured circuits. The state is a
+	graph with one level per qubit, highest qubit at the root: a node at
+	level v splits its vector by the value of qubit v into two children on
+	level v - 1, each reached through an edge carrying a complex weight,
+	and the terminal at level -1 stands for the scalar 1. Equal subvectors
+	are stored once, so states such as arithmetic registers or oracle
+	outputs take a few nodes per level instead of 2^n amplitudes.
+
+	Every node is a unit vector: its two weights satisfy
+	|w0|^2 + |w1|^2 = 1 with the first nonzero one real and positive, the
+	norm and phase being pushed onto the incoming edge. Nodes are shared
+	through the unique table, which compares weights to within TOLERANCE.
+	The compute table caches additions of subdiagrams across gates and the
+	recursion of the current gate, and is a direct-mapped cache that simply
+	overwrites on collision. Nodes no longer reachable from the root are
+	reclaimed once the pool doubles since the last collection.
+*/
+
+template<class Type>
+class DecisionDiagram
+{
+private:
+	struct Edge
+	{
+		int node;
+		Complex<Type> weight;
+
+		Edge() : node(0), weight(0, 0) {}
+		Edge(int n, Complex<Type> w) : node(n), weight(w) {}
+	};
+
+	struct Node
+	{
+		int level;
+		int children[2];
+		Complex<Type> weights[2];
+	};
+
+	struct Entry
+	{
+		int operation;
+		int a, b;
+		int64_t key[4];
+		uint64_t generation;
+		Edge result;
+	};
+
+	enum computation: int {ADD = 1, APPLY, MIX, PROJECT};
+
+	unsigned int numQubits;
+	Edge root;
+
+	vector<Node> nodes;
+	vector<int> uniqueTable;
+	uint64_t uniqueMask;
+	vector<Entry> computeTable;
+	uint64_t generation;
+
+	// the gate being applied: u on target when controls (mask) read value
+	Complex<Type> gateMatrix[4];
+	int gateTarget;
+	uint64_t gateMask;
+	uint64_t gateValue;
+	int gateLowest;
+
+	uint64_t collectAt;
+	uint64_t numCollections;
+	uint64_t peak;
+	uint64_t lookups;
+	uint64_t hits;
+
+	vector<int> measurement;
+	RandomSource<Type> generator;
+
+	QuantumGates<Type> gate;
+
+	/* Diagram Operations */
+	Edge makeNode(int, Edge, Edge);
+	Edge child(Edge, int);
+	Edge add(Edge, Edge);
+	Edge apply(Edge);
+	Edge mix(Edge, Edge, int);
+	Edge project(Edge, int, int);
+	Type probabilityOne(int, int, vector<Type> &);
+
+	uint64_t hashNode(Node &);
+	bool sameNode(Node &, Node &);
+	void growUniqueTable();
+	void insertUnique(int);
+
+	Entry* lookup(int, int, int, Complex<Type>, Complex<Type>, uint64_t);
+	void remember(int, int, int, Complex<Type>, Complex<Type>, uint64_t, Edge);
+	uint64_t computeSlot(int, int, int, int64_t *);
+	int64_t quantise(Type);
+	bool isZero(Complex<Type>);
+
+	void applyControlled(uint64_t, uint64_t, int, Matrix<Type> &);
+	void collectGarbage();
+	void maybeCollect();
+
+	void barf(string, string);
+
+public:
+	static const int MAX_QUBITS = 63;
+	static const uint64_t COMPUTE_TABLE_SIZE = 1ULL << 16;
+	static const Type TOLERANCE;
+
+	/* Constructor */
+	DecisionDiagram(int);
+
+	/* Quantum Logic Gates */
+	void H(int);
+	void X(int);
+	void Y(int);
+	void Z(int);
+	void T(int);
+	void S(int);
+	void U(Matrix<Type>, int);
+	void U(Matrix<Type>, vector<int>);
+
+	unsigned int Measure(int);
+	uint64_t MeasureAll();
+	map<uint64_t, unsigned int> Sample(unsigned int);
+
+	void MCU(vector<int>, int, Matrix<Type>);
+	void MCU(vector<int>, vector<int>, int, Matrix<Type>);
+	void CNOT(int, int);
+	void CY(int, int);
+	void CZ(int, int);
+	void Toffoli(int, int, int);
+
+	void Swap(int, int);
+
+	/* Statistics */
+	uint64_t nodeCount();
+	uint64_t peakNodes();
+	uint64_t bytes();
+	double denseBytes();
+	uint64_t garbageCollections();
+	double computeHitRate();
+	void printStatistics();
+
+	/* Utilities */
+	Complex<Type> amplitude(uint64_t);
+	int getMeasurement(int);
+	vector<int> getMeasurements();
+	unsigned int size();
+	void setRandomSeed(uint64_t);
+	void print();
+};
+
+template<class Type>
+const int DecisionDiagram<Type>::MAX_QUBITS;
+
+template<class Type>
+const uint64_t DecisionDiagram<Type>::COMPUTE_TABLE_SIZE;
+
+template<class Type>
+const Type DecisionDiagram<Type>::TOLERANCE = numeric_limits<Type>::epsilon() * 1024;
+
+/* Constructor */
+
+template<class Type>
+DecisionDiagram<Type>::DecisionDiagram(int qubits)
+{
+	if(qubits < 1 || qubits > MAX_QUBITS)
+		barf("DecisionDiagram", "number of qubits must be between 1 and 63");
+
+	numQubits = qubits;
+
+	// the terminal is node 0; zero edges point at it with weight 0
+	Node terminal;
+	terminal.level = -1;
+	terminal.children[0] = terminal.children[1] = 0;
+	nodes.push_back(terminal);
+
+	uniqueTable.assign(1024, -1);
+	uniqueMask = uniqueTable.size() - 1;
+
+	Entry empty;
+	empty.generation = ~0ULL;
+	computeTable.assign(COMPUTE_TABLE_SIZE, empty);
+	generation = 0;
+
+	collectAt = 1 << 16;
+	numCollections = 0;
+	lookups = 0;
+	hits = 0;
+
+	// |0...0⟩ is a chain of nodes taking the 0 branch
+	root = Edge(0, Complex<Type>(1, 0));
+
+	for(int v=0; v<numQubits; ++v)
+		root = makeNode(v, root, Edge());
+
+	peak = nodes.size();
+
+	measurement.assign(numQubits, -1);
+}
+
+template<class Type>
+void DecisionDiagram<Type>::barf(string function, string message)
+{
+	cout << "[error] " << "<" << function << ">";
+	cout << " " << message << endl;
+	exit(1);
+}
+
+/* Tables */
+
+template<class Type>
+bool DecisionDiagram<Type>::isZero(Complex<Type> w)
+{
+	return w.normSq() < TOLERANCE * TOLERANCE;
+}
+
+template<class Type>
+int64_t DecisionDiagram<Type>::quantise(Type x)
+{
+	// Weights within TOLERANCE of each other usually share a key; those
+	// straddling a grid line do not, which only costs a duplicate node.
+	return (int64_t)llround(x / TOLERANCE);
+}
+
+template<class Type>
+uint64_t DecisionDiagram<Type>::hashNode(Node &node)
+{
+	uint64_t h = (uint64_t)node.level * 0x9e3779b97f4a7c15ULL;
+
+	h ^= (uint64_t)node.children[0] + 0xbf58476d1ce4e5b9ULL * (uint64_t)node.children[1];
+
+	for(int i=0; i<2; ++i)
+	{
+		h = (h ^ (uint64_t)quantise(node.weights[i].getRe())) * 0x94d049bb133111ebULL;
+		h = (h ^ (uint64_t)quantise(node.weights[i].getIm())) * 0xbf58476d1ce4e5b9ULL;
+	}
+
+	return h ^ (h >> 31);
+}
+
+template<class Type>
+bool DecisionDiagram<Type>::sameNode(Node &a, Node &b)
+{
+	return a.level == b.level && a.children[0] == b.children[0] && a.children[1] == b.children[1]
+		&& isZero(a.weights[0] - b.weights[0]) && isZero(a.weights[1] - b.weights[1]);
+}
+
+template<class Type>
+void DecisionDiagram<Type>::insertUnique(int index)
+{
+	uint64_t slot = hashNode(nodes[index]) & uniqueMask;
+
+	while(uniqueTable[slot] >= 0)
+		slot = (slot + 1) & uniqueMask;
+
+	uniqueTable[slot] = index;
+}
+
+template<class Type>
+void DecisionDiagram<Type>::growUniqueTable()
+{
+	uniqueTable.assign(2 * uniqueTable.size(), -1);
+	uniqueMask = uniqueTable.size() - 1;
+
+	for(int i=1; i<nodes.size(); ++i)
+		insertUnique(i);
+}
+
+template<class Type>
+uint64_t DecisionDiagram<Type>::computeSlot(int operation, int a, int b, int64_t *key)
+{
+	uint64_t h = (uint64_t)operation * 0x9e3779b97f4a7c15ULL ^ (uint64_t)a * 0xbf58476d1ce4e5b9ULL ^ (uint64_t)b;
+
+	for(int i=0; i<4; ++i)
+		h = (h ^ (uint64_t)key[i]) * 0x94d049bb133111ebULL;
+
+	return (h ^ (h >> 29)) & (COMPUTE_TABLE_SIZE - 1);
+}
+
+template<class Type>
+typename DecisionDiagram<Type>::Entry* DecisionDiagram<Type>::lookup(int operation, int a, int b,
+	Complex<Type> x, Complex<Type> y, uint64_t stamp)
+{
+	// Cached result for the key, or NULL. Weights are part of the key up to
+	// TOLERANCE, and stamp tells apart results that only hold for one gate.
+	int64_t key[4] = {quantise(x.getRe()), quantise(x.getIm()), quantise(y.getRe()), quantise(y.getIm())};
+	Entry *entry = &computeTable[computeSlot(operation, a, b, key)];
+
+	++lookups;
+
+	if(entry->generation != stamp || entry->operation != operation || entry->a != a || entry->b != b)
+		return NULL;
+
+	for(int i=0; i<4; ++i)
+	{
+		if(entry->key[i] != key[i])
+			return NULL;
+	}
+
+	++hits;
+
+	return entry;
+}
+
+template<class Type>
+void DecisionDiagram<Type>::remember(int operation, int a, int b, Complex<Type> x, Complex<Type> y, uint64_t stamp, Edge result)
+{
+	int64_t key[4] = {quantise(x.getRe()), quantise(x.getIm()), quantise(y.getRe()), quantise(y.getIm())};
+	Entry *entry = &computeTable[computeSlot(operation, a, b, key)];
+
+	entry->operation = operation;
+	entry->a = a;
+	entry->b = b;
+	entry->generation = stamp;
+	entry->result = result;
+
+	for(int i=0; i<4; ++i)
+		entry->key[i] = key[i];
+}
+
+/* Diagram Operations */
+
+template<class Type>
+typename DecisionDiagram<Type>::Edge DecisionDiagram<Type>::makeNode(int level, Edge e0, Edge e1)
+{
+	// Normalises the two weights into a unit vector with the first nonzero
+	// weight real and positive, finds or adds the node in the unique table,
+	// and returns it behind an edge carrying the norm and phase taken out.
+	if(isZero(e0.weight))
+		e0 = Edge();
+
+	if(isZero(e1.weight))
+		e1 = Edge();
+
+	if(e0.weight.normSq() == 0 && e1.weight.normSq() == 0)
+		return Edge();
+
+	Type norm = sqrt(e0.weight.normSq() + e1.weight.normSq());
+	Complex<Type> lead = (e0.weight.normSq() != 0)? e0.weight : e1.weight;
+	Complex<Type> phase = lead * (1 / sqrt(lead.normSq()));
+	Complex<Type> factor = phase * norm;
+	Complex<Type> inverse(phase.getRe() / norm, -phase.getIm() / norm);
+
+	Node node;
+	node.level = level;
+	node.children[0] = e0.node;
+	node.children[1] = e1.node;
+	node.weights[0] = e0.weight * inverse;
+	node.weights[1] = e1.weight * inverse;
+
+	uint64_t slot = hashNode(node) & uniqueMask;
+
+	while(uniqueTable[slot] >= 0)
+	{
+		if(sameNode(nodes[uniqueTable[slot]], node))
+			return Edge(uniqueTable[slot], factor);
+
+		slot = (slot + 1) & uniqueMask;
+	}
+
+	uniqueTable[slot] = nodes.size();
+	nodes.push_back(node);
+
+	if(2 * nodes.size() > uniqueTable.size())
+		growUniqueTable();
+
+	return Edge(nodes.size() - 1, factor);
+}
+
+template<class Type>
+typename DecisionDiagram<Type>::Edge DecisionDiagram<Type>::child(Edge e, int bit)
+{
+	// The half of e's vector where its top qubit reads bit.
+	if(e.weight.normSq() == 0)
+		return Edge();
+
+	Node &node = nodes[e.node];
+
+	return Edge(node.children[bit], e.weight * node.weights[bit]);
+}
+
+template<class Type>
+typename DecisionDiagram<Type>::Edge DecisionDiagram<Type>::add(Edge a, Edge b)
+{
+	// a + b for edges on the same level. The larger weight is factored out
+	// so the cached sum serves every multiple of the same pair.
+	if(a.weight.normSq() == 0)
+		return b;
+
+	if(b.weight.normSq() == 0)
+		return a;
+
+	if(a.node == b.node)
+	{
+		Complex<Type> sum = a.weight + b.weight;
+		return (isZero(sum))? Edge() : Edge(a.node, sum);
+	}
+
+	Complex<Type> scale = (a.weight.normSq() >= b.weight.normSq())? a.weight : b.weight;
+	Complex<Type> x = a.weight / scale, y = b.weight / scale;
+
+	Entry *entry = lookup(ADD, a.node, b.node, x, y, 0);
+	Edge result;
+
+	if(entry != NULL)
+		result = entry->result;
+	else
+	{
+		int level = nodes[a.node].level;
+		Edge ua(a.node, x), ub(b.node, y);
+		Edge e0 = add(child(ua, 0), child(ub, 0));
+		Edge e1 = add(child(ua, 1), child(ub, 1));
+
+		result = makeNode(level, e0, e1);
+		remember(ADD, a.node, b.node, x, y, 0, result);
+	}
+
+	result.weight = result.weight * scale;
+
+	return (isZero(result.weight))? Edge() : result;
+}
+
+template<class Type>
+typename DecisionDiagram<Type>::Edge DecisionDiagram<Type>::apply(Edge e)
+{
+	// The current gate applied to the subvector under e. Levels below every
+	// qubit the gate touches are left alone; above the target, a control
+	// only descends into the branch with its required value.
+	if(e.weight.normSq() == 0)
+		return Edge();
+
+	Node &node = nodes[e.node];
+	int level = node.level;
+
+	if(level < gateLowest)
+		return e;
+
+	Entry *entry = lookup(APPLY, e.node, 0, Complex<Type>(0, 0), Complex<Type>(0, 0), generation);
+	Edge result;
+
+	if(entry != NULL)
+		result = entry->result;
+	else
+	{
+		Edge unit(e.node, Complex<Type>(1, 0));
+		Edge children[2] = {child(unit, 0), child(unit, 1)};
+
+		if(level == gateTarget)
+		{
+			Edge e0 = mix(children[0], children[1], 0);
+			Edge e1 = mix(children[0], children[1], 1);
+			result = makeNode(level, e0, e1);
+		}
+		else
+		{
+			for(int bit=0; bit<2; ++bit)
+			{
+				bool control = (gateMask >> level) & 1;
+
+				if(!control || bit == ((gateValue >> level) & 1))
+					children[bit] = apply(children[bit]);
+			}
+
+			result = makeNode(level, children[0], children[1]);
+		}
+
+		remember(APPLY, e.node, 0, Complex<Type>(0, 0), Complex<Type>(0, 0), generation, result);
+	}
+
+	result.weight = result.weight * e.weight;
+
+	return result;
+}
+
+template<class Type>
+typename DecisionDiagram<Type>::Edge DecisionDiagram<Type>::mix(Edge a, Edge b, int row)
+{
+	// Row of the gate's matrix applied under the target: a and b are the
+	// target's 0 and 1 halves, and the result is u[row][0] a + u[row][1] b
+	// where the controls below the target hold, and the half the row keeps
+	// (a for row 0, b for row 1) elsewhere.
+	if(a.weight.normSq() == 0 && b.weight.normSq() == 0)
+		return Edge();
+
+	Complex<Type> x = gateMatrix[2 * row], y = gateMatrix[2 * row + 1];
+	int level = nodes[(a.weight.normSq() != 0)? a.node : b.node].level;
+
+	if(level < 0 || (gateMask & ((2ULL << level) - 1)) == 0)
+	{
+		Edge scaledA(a.node, a.weight * x), scaledB(b.node, b.weight * y);
+		return add((isZero(scaledA.weight))? Edge() : scaledA, (isZero(scaledB.weight))? Edge() : scaledB);
+	}
+
+	Complex<Type> scale = (a.weight.normSq() >= b.weight.normSq())? a.weight : b.weight;
+	Complex<Type> ra = a.weight / scale, rb = b.weight / scale;
+
+	Entry *entry = lookup(MIX + 16 * row, a.node, b.node, ra, rb, generation);
+	Edge result;
+
+	if(entry != NULL)
+		result = entry->result;
+	else
+	{
+		Edge ua(a.node, ra), ub(b.node, rb);
+		Edge children[2];
+
+		for(int bit=0; bit<2; ++bit)
+		{
+			bool control = (gateMask >> level) & 1;
+
+			if(control && bit != ((gateValue >> level) & 1))
+				children[bit] = (row == 0)? child(ua, bit) : child(ub, bit);
+			else
+				children[bit] = mix(child(ua, bit), child(ub, bit), row);
+		}
+
+		result = makeNode(level, children[0], children[1]);
+		remember(MIX + 16 * row, a.node, b.node, ra, rb, generation, result);
+	}
+
+	result.weight = result.weight * scale;
+
+	return result;
+}
+
+template<class Type>
+typename DecisionDiagram<Type>::Edge DecisionDiagram<Type>::project(Edge e, int qubit, int value)
+{
+	// e with every amplitude where qubit differs from value set to zero.
+	if(e.weight.normSq() == 0)
+		return Edge();
+
+	Node &node = nodes[e.node];
+	int level = node.level;
+
+	if(level == qubit)
+		return (value == 0)? makeNode(level, child(e, 0), Edge()) : makeNode(level, Edge(), child(e, 1));
+
+	Entry *entry = lookup(PROJECT, e.node, value, Complex<Type>(0, 0), Complex<Type>(0, 0), generation);
+	Edge result;
+
+	if(entry != NULL)
+		result = entry->result;
+	else
+	{
+		Edge unit(e.node, Complex<Type>(1, 0));
+		Edge e0 = project(child(unit, 0), qubit, value);
+		Edge e1 = project(child(unit, 1), qubit, value);
+
+		result = makeNode(level, e0, e1);
+		remember(PROJECT, e.node, value, Complex<Type>(0, 0), Complex<Type>(0, 0), generation, result);
+	}
+
+	result.weight = result.weight * e.weight;
+
+	return result;
+}
+
+template<class Type>
+Type DecisionDiagram<Type>::probabilityOne(int index, int qubit, vector<Type> &memo)
+{
+	// Probability that qubit reads 1 in the unit vector of node index.
+	Node &node = nodes[index];
+
+	if(node.level == qubit)
+		return node.weights[1].normSq();
+
+	if(memo[index] >= 0)
+		return memo[index];
+
+	Type p = 0;
+
+	for(int bit=0; bit<2; ++bit)
+	{
+		if(node.weights[bit].normSq() != 0)
+			p += node.weights[bit].normSq() * probabilityOne(node.children[bit], qubit, memo);
+	}
+
+	memo[index] = p;
+
+	return p;
+}
+
+template<class Type>
+void DecisionDiagram<Type>::applyControlled(uint64_t mask, uint64_t value, int target, Matrix<Type> &u)
+{
+	// Runs the recursion for one controlled 2 x 2 gate. Entries of the
+	// compute table from earlier gates are told apart by the generation.
+	// Garbage is left for the caller, which may still hold other edges.
+	if(target < 0 || target >= numQubits)
+		barf("U", "qubit out of range");
+
+	if(u.rows() != 2 || u.cols() != 2)
+		barf("U", "2 x 2 matrix expected");
+
+	for(int i=0; i<4; ++i)
+		gateMatrix[i] = u.get(i / 2, i % 2);
+
+	gateTarget = target;
+	gateMask = mask;
+	gateValue = value;
+	gateLowest = target;
+
+	for(int q=0; q<target; ++q)
+	{
+		if((mask >> q) & 1)
+		{
+			gateLowest = q;
+			break;
+		}
+	}
+
+	++generation;
+	root = apply(root);
+}
+
+template<class Type>
+void DecisionDiagram<Type>::maybeCollect()
+{
+	if(nodes.size() > peak)
+		peak = nodes.size();
+
+	if(nodes.size() >= collectAt)
+		collectGarbage();
+}
+
+template<class Type>
+void DecisionDiagram<Type>::collectGarbage()
+{
+	// Marks the nodes reachable from the root and compacts them to the
+	// front of the pool. A node is always created after its children, so
+	// keeping pool order keeps every child before its parent. The unique
+	// table is then rebuilt and the compute table cleared, its entries
+	// referring to old indices.
+	vector<int> renamed(nodes.size(), -1);
+	vector<int> stack;
+
+	if(root.weight.normSq() != 0)
+		stack.push_back(root.node);
+
+	while(!stack.empty())
+	{
+		int index = stack.back();
+		stack.pop_back();
+
+		if(index == 0 || renamed[index] >= 0)
+			continue;
+
+		renamed[index] = 0;
+		stack.push_back(nodes[index].children[0]);
+		stack.push_back(nodes[index].children[1]);
+	}
+
+	int live = 1;
+	renamed[0] = 0;
+
+	for(int i=1; i<nodes.size(); ++i)
+	{
+		if(renamed[i] < 0)
+			continue;
+
+		renamed[i] = live++;
+
+		Node node = nodes[i];
+		node.children[0] = renamed[node.children[0]];
+		node.children[1] = renamed[node.children[1]];
+		nodes[renamed[i]] = node;
+	}
+
+	nodes.resize(live);
+	root.node = renamed[root.node];
+
+	uint64_t slots = 1024;
+
+	while(slots < 2 * nodes.size())
+		slots <<= 1;
+
+	uniqueTable.assign(slots, -1);
+	uniqueMask = slots - 1;
+
+	for(int i=1; i<nodes.size(); ++i)
+		insertUnique(i);
+
+	for(uint64_t i=0; i<computeTable.size(); ++i)
+		computeTable[i].generation = ~0ULL;
+
+	collectAt = max((uint64_t)1 << 16, 2 * nodes.size());
+	++numCollections;
+}
+
+/* Quantum Logic Gates */
+
+template<class Type>
+void DecisionDiagram<Type>::H(int qubit)
+{
+	U(gate.Hadamard(), qubit);
+}
+
+template<class Type>
+void DecisionDiagram<Type>::X(int qubit)
+{
+	U(gate.Pauli_X(), qubit);
+}
+
+template<class Type>
+void DecisionDiagram<Type>::Y(int qubit)
+{
+	U(gate.Pauli_Y(), qubit);
+}
+
+template<class Type>
+void DecisionDiagram<Type>::Z(int qubit)
+{
+	U(gate.Pauli_Z(), qubit);
+}
+
+template<class Type>
+void DecisionDiagram<Type>::T(int qubit)
+{
+	U(gate.PhaseShift(M_PI / 4), qubit);
+}
+
+template<class Type>
+void DecisionDiagram<Type>::S(int qubit)
+{
+	U(gate.PhaseShift(M_PI / 2), qubit);
+}
+
+template<class Type>
+void DecisionDiagram<Type>::U(Matrix<Type> u, int qubit)
+{
+	applyControlled(0, 0, qubit, u);
+	maybeCollect();
+}
+
+template<class Type>
+void DecisionDiagram<Type>::U(Matrix<Type> u, vector<int> qubits)
+{
+	// Bit j of the matrix index is qubits[j]. The gate is expanded as
+	// Σ u[r][c] |r⟩⟨c|, each term a product of single-qubit transitions
+	// |r_j⟩⟨c_j|, and the terms are summed; fine for the few-qubit dense
+	// matrices this is meant for.
+	int k = qubits.size();
+
+	if(k == 0 || u.rows() != (1ULL << k) || u.cols() != u.rows())
+		barf("U", "2^k x 2^k matrix expected for k qubits");
+
+	for(int j=0; j<k; ++j)
+	{
+		if(qubits.at(j) < 0 || qubits.at(j) >= numQubits)
+			barf("U", "qubit out of range");
+
+		for(int i=0; i<j; ++i)
+		{
+			if(qubits.at(i) == qubits.at(j))
+				barf("U", "qubits must be distinct");
+		}
+	}
+
+	Edge start = root, sum;
+
+	for(uint64_t c=0; c<u.cols(); ++c)
+	{
+		// ⟨c| on the gate's qubits, leaving the state with those qubits at 0
+		root = start;
+
+		for(int j=0; j<k && root.weight.normSq() != 0; ++j)
+		{
+			Matrix<Type> transition(2, 2);
+			transition.set(0, (c >> j) & 1, 1, 0);
+			applyControlled(0, 0, qubits.at(j), transition);
+		}
+
+		Edge selected = root;
+
+		for(uint64_t r=0; r<u.rows() && selected.weight.normSq() != 0; ++r)
+		{
+			Complex<Type> entry = u.get(r, c);
+
+			if(isZero(entry))
+				continue;
+
+			// |r⟩ from |0...0⟩ on the gate's qubits, scaled by the entry
+			root = selected;
+
+			for(int j=0; j<k; ++j)
+			{
+				if((r >> j) & 1)
+				{
+					Matrix<Type> raise(2, 2);
+					raise.set(1, 0, 1, 0);
+					applyControlled(0, 0, qubits.at(j), raise);
+				}
+			}
+
+			root.weight = root.weight * entry;
+			sum = add(sum, root);
+		}
+	}
+
+	root = sum;
+	maybeCollect();
+}
+
+template<class Type>
+void DecisionDiagram<Type>::MCU(vector<int> controls, int target, Matrix<Type> u)
+{
+	MCU(controls, vector<int>(), target, u);
+}
+
+template<class Type>
+void DecisionDiagram<Type>::MCU(vector<int> controls, vector<int> openControls, int target, Matrix<Type> u)
+{
+	// Controls must read 1 and open controls 0 for u to act on the target.
+	uint64_t mask = 0, value = 0;
+
+	for(int i=0; i<controls.size(); ++i)
+	{
+		if(controls.at(i) < 0 || controls.at(i) >= numQubits || controls.at(i) == target)
+			barf("MCU", "invalid control qubit");
+
+		mask |= 1ULL << controls.at(i);
+		value |= 1ULL << controls.at(i);
+	}
+
+	for(int i=0; i<openControls.size(); ++i)
+	{
+		if(openControls.at(i) < 0 || openControls.at(i) >= numQubits || openControls.at(i) == target)
+			barf("MCU", "invalid control qubit");
+
+		mask |= 1ULL << openControls.at(i);
+	}
+
+	applyControlled(mask, value, target, u);
+	maybeCollect();
+}
+
+template<class Type>
+void DecisionDiagram<Type>::CNOT(int control, int target)
+{
+	MCU(vector<int>(1, control), target, gate.Pauli_X());
+}
+
+template<class Type>
+void DecisionDiagram<Type>::CY(int control, int target)
+{
+	MCU(vector<int>(1, control), target, gate.Pauli_Y());
+}
+
+template<class Type>
+void DecisionDiagram<Type>::CZ(int control, int target)
+{
+	MCU(vector<int>(1, control), target, gate.Pauli_Z());
+}
+
+template<class Type>
+void DecisionDiagram<Type>::Toffoli(int control1, int control2, int target)
+{
+	vector<int> controls;
+	controls.push_back(control1);
+	controls.push_back(control2);
+
+	MCU(controls, target, gate.Pauli_X());
+}
+
+template<class Type>
+void DecisionDiagram<Type>::Swap(int qubit1, int qubit2)
+{
+	CNOT(qubit1, qubit2);
+	CNOT(qubit2, qubit1);
+	CNOT(qubit1, qubit2);
+}
+
+/* Measurement */
+
+template<class Type>
+unsigned int DecisionDiagram<Type>::Measure(int qubit)
+{
+	if(qubit < 0 || qubit >= numQubits)
+		barf("Measure", "qubit out of range");
+
+	vector<Type> memo(nodes.size(), -1);
+	Type one = probabilityOne(root.node, qubit, memo);
+	unsigned int result = (generator.uniform() < one)? 1 : 0;
+
+	++generation;
+	Edge before = root;
+	root = project(before, qubit, result);
+
+	// rounding in the probability can pick an outcome that cannot occur
+	if(root.weight.normSq() <= 0)
+	{
+		result ^= 1;
+		root = project(before, qubit, result);
+	}
+
+	// back to unit norm, keeping the global phase
+	root.weight = root.weight * (1 / sqrt(root.weight.normSq()));
+	measurement.at(qubit) = result;
+
+	maybeCollect();
+
+	return result;
+}
+
+template<class Type>
+map<uint64_t, unsigned int> DecisionDiagram<Type>::Sample(unsigned int shots)
+{
+	// Draws outcomes without collapsing: since every node is a unit vector,
+	// each level is a coin with the squared weights as probabilities.
+	map<uint64_t, unsigned int> counts;
+
+	for(unsigned int shot=0; shot<shots; ++shot)
+	{
+		uint64_t outcome = 0;
+		int index = root.node;
+
+		for(int v=numQubits-1; v>=0; --v)
+		{
+			Node &node = nodes[index];
+			int bit = (generator.uniform() < node.weights[0].normSq())? 0 : 1;
+
+			if(node.weights[bit].normSq() <= 0)
+				bit ^= 1;
+
+			outcome |= (uint64_t)bit << v;
+			index = node.children[bit];
+		}
+
+		++counts[outcome];
+	}
+
+	return counts;
+}
+
+template<class Type>
+uint64_t DecisionDiagram<Type>::MeasureAll()
+{
+	// One sample, after which the state is that basis state.
+	uint64_t outcome = Sample(1).begin()->first;
+
+	root = Edge(0, Complex<Type>(1, 0));
+
+	for(int v=0; v<numQubits; ++v)
+	{
+		int bit = (outcome >> v) & 1;
+		root = (bit == 0)? makeNode(v, root, Edge()) : makeNode(v, Edge(), root);
+		measurement.at(v) = bit;
+	}
+
+	maybeCollect();
+
+	return outcome;
+}
+
+/* Statistics */
+
+template<class Type>
+uint64_t DecisionDiagram<Type>::nodeCount()
+{
+	// Nodes reachable from the root, the terminal excluded.
+	vector<bool> seen(nodes.size(), false);
+	vector<int> stack;
+	uint64_t count = 0;
+
+	if(root.weight.normSq() != 0)
+		stack.push_back(root.node);
+
+	while(!stack.empty())
+	{
+		int index = stack.back();
+		stack.pop_back();
+
+		if(index == 0 || seen[index])
+			continue;
+
+		seen[index] = true;
+		++count;
+
+		stack.push_back(nodes[index].children[0]);
+		stack.push_back(nodes[index].children[1]);
+	}
+
+	return count;
+}
+
+template<class Type>
+uint64_t DecisionDiagram<Type>::peakNodes()
+{
+	// Largest pool size so far, garbage included.
+	return peak;
+}
+
+template<class Type>
+uint64_t DecisionDiagram<Type>::bytes()
+{
+	// Memory held by the node pool and both tables.
+	return nodes.capacity() * sizeof(Node) + uniqueTable.size() * sizeof(int) + computeTable.size() * sizeof(Entry);
+}
+
+template<class Type>
+double DecisionDiagram<Type>::denseBytes()
+{
+	// What Qubits would need for the same state, past 2^64 for many qubits.
+	return ldexp((double)sizeof(Complex<Type>), numQubits);
+}
+
+template<class Type>
+uint64_t DecisionDiagram<Type>::garbageCollections()
+{
+	return numCollections;
+}
+
+template<class Type>
+double DecisionDiagram<Type>::computeHitRate()
+{
+	return (lookups == 0)? 0 : (double)hits / lookups;
+}
+
+template<class Type>
+void DecisionDiagram<Type>::printStatistics()
+{
+	uint64_t live = nodeCount();
+
+	printf("%u qubits: %llu live nodes (peak %llu), %llu bytes of nodes against %.3g dense\n", numQubits,
+		(unsigned long long)live, (unsigned long long)peak,
+		(unsigned long long)(live * sizeof(Node)), denseBytes());
+
+	printf("Node pool and tables %llu bytes, ", (unsigned long long)bytes());
+
+	printf("compute table hit rate %.1f%% over %llu lookups, %llu garbage collections\n",
+		100 * computeHitRate(), (unsigned long long)lookups, (unsigned long long)numCollections);
+}
+
+/* Utilities */
+
+template<class Type>
+Complex<Type> DecisionDiagram<Type>::amplitude(uint64_t index)
+{
+	// Product of the weights along the path picked by the bits of index.
+	Complex<Type> product = root.weight;
+	int node = root.node;
+
+	for(int v=numQubits-1; v>=0 && product.normSq() != 0; --v)
+	{
+		int bit = (index >> v) & 1;
+		product = product * nodes[node].weights[bit];
+		node = nodes[node].children[bit];
+	}
+
+	return product;
+}
+
+template<class Type>
+int DecisionDiagram<Type>::getMeasurement(int qubit)
+{
+	return measurement.at(qubit);
+}
+
+template<class Type>
+vector<int> DecisionDiagram<Type>::getMeasurements()
+{
+	return measurement;
+}
+
+template<class Type>
+unsigned int DecisionDiagram<Type>::size()
+{
+	return numQubits;
+}
+
+template<class Type>
+void DecisionDiagram<Type>::setRandomSeed(uint64_t seed)
+{
+	generator.seed(seed);
+}
+
+template<class Type>
+void DecisionDiagram<Type>::print()
+{
+	// Nonzero amplitudes in increasing order of basis state, found by
+	// walking the diagram, so only practical for few of them.
+	vector<pair<int, pair<uint64_t, Complex<Type> > > > stack;
+	map<uint64_t, Complex<Type> > amplitudes;
+
+	if(root.weight.normSq() != 0)
+		stack.push_back(make_pair(numQubits - 1, make_pair(0ULL, root.weight)));
+
+	vector<int> at(1, root.node);
+
+	while(!stack.empty())
+	{
+		int level = stack.back().first;
+		uint64_t prefix = stack.back().second.first;
+		Complex<Type> weight = stack.back().second.second;
+		int index = at.back();
+
+		stack.pop_back();
+		at.pop_back();
+
+		if(level < 0)
+		{
+			amplitudes[prefix] = weight;
+			continue;
+		}
+
+		for(int bit=0; bit<2; ++bit)
+		{
+			Complex<Type> w = weight * nodes[index].weights[bit];
+
+			if(w.normSq() == 0)
+				continue;
+
+			stack.push_back(make_pair(level - 1, make_pair(prefix | (uint64_t)bit << level, w)));
+			at.push_back(nodes[index].children[bit]);
+		}
+	}
+
+	for(typename map<uint64_t, Complex<Type> >::iterator it=amplitudes.begin(); it!=amplitudes.end(); ++it)
+	{
+		string decToBin;
+
+		for(int j=0; j<numQubits; ++j)
+			decToBin.insert(decToBin.begin(), (it->first >> j & 1) + '0');
+
+		printf("%+.4f%+.4fi |%s⟩\n", it->second.getRe(), it->second.getIm(), decToBin.c_str());
+	}
+}
+
+#endif
@@ -0,0 +1,754 @@
+#ifndef QMULATOR_DENSITY_MATRIX_HPP
+#define QMULATOR_DENSITY_MATRIX_HPP
+
+#include <stdio.h>
+#include <limits>
+#include <vector>
+#include <stdint.h>
+#include "complex.hpp"
+#include "matrix.hpp"
+#include "quantum_gates.hpp"
+#include "state_vector.hpp"
+#include "random_source.hpp"
+#include "kernels.hpp"
+#include "qubits.hpp"
+
+/*
+	Mixed states of n qubits as a 2^n x 2^n density matrix, stored as a
+	vector of 4^n entries: ρ[r][c] sits at index r | c << n, so the row
+	index takes bits 0 to n-1 and the column index bits n to 2n-1. U ρ U†
+	is then U applied to bit q and conj(U) to bit q + n with the state
+	vector kernels. A channel with Kraus operators K on k qubits is one
+	4^k x 4^k matrix, the sum of K ⊗ conj(K), applied to bits q and q + n
+	of each qubit in a single sweep.
+*/
+
+template<class Type>
+class DensityMatrix
+{
+private:
+	unsigned int numQubits;
+	uint64_t dimension;
+	uint64_t numEntries;
+
+	vector<int> measurement;
+	vector<Type> readoutFlip01;
+	vector<Type> readoutFlip10;
+	RandomSource<Type> generator;
+
+	QuantumGates<Type> gate;
+	GateKernels<Type> kernel;
+
+	void applySingle(int, Matrix<Type>);
+	void applyControlled(vector<int>, vector<int>, int, Matrix<Type>);
+	void applyDiagonal(int, Complex<Type>, Complex<Type>);
+	void applySuperoperator(vector<Matrix<Type> > &, vector<int>);
+	unsigned int readout(int, unsigned int);
+	void checkQubits(string, vector<int>);
+
+	void initialise(int, unsigned int);
+	void barf(string, string);
+
+public:
+	StateVector<Type> *entries;
+
+	/* Constructor and Deconstructor */
+	DensityMatrix(int);
+	DensityMatrix(int, unsigned int);
+	~DensityMatrix();
+
+	/* Quantum Logic Gates */
+	void H(int);
+	void X(int);
+	void Y(int);
+	void Z(int);
+	void T(int);
+	void S(int);
+	void U(Matrix<Type>, int);
+	void U(Matrix<Type>, vector<int>);
+	unsigned int Measure(int);
+	uint64_t MeasureAll();
+
+	void MCU(vector<int>, int, Matrix<Type>);
+	void MCU(vector<int>, vector<int>, int, Matrix<Type>);
+	void CNOT(int, int);
+	void CY(int, int);
+	void CZ(int, int);
+	void Toffoli(int, int, int);
+
+	void Swap(int, int);
+
+	/* Noise Channels */
+	void Kraus(vector<Matrix<Type> >, int);
+	void Kraus(vector<Matrix<Type> >, vector<int>);
+	void Depolarise(int, Type);
+	void AmplitudeDamping(int, Type);
+	void PhaseDamping(int, Type);
+	void setReadoutError(int, Type, Type);
+	void setReadoutError(Type, Type);
+
+	/* Utilities */
+	unsigned int size();
+	Complex<Type> element(uint64_t, uint64_t);
+	Type probability(uint64_t);
+	Type trace();
+	Type purity();
+
+	static uint64_t bytesRequired(int);
+
+	void setRandomSeed(uint64_t);
+	int getMeasurement(int);
+	vector<int> getMeasurements();
+	void setNumThreads(int);
+	void setParallelThreshold(uint64_t);
+
+	void print();
+};
+
+/* Constructor and Deconstructor */
+
+template<class Type>
+DensityMatrix<Type>::DensityMatrix(int qubits)
+{
+	initialise(qubits, Qubits<Type>::STRICT_MEMORY);
+}
+
+template<class Type>
+DensityMatrix<Type>::DensityMatrix(int qubits, unsigned int policy)
+{
+	initialise(qubits, policy);
+}
+
+template<class Type>
+void DensityMatrix<Type>::initialise(int qubits, unsigned int policy)
+{
+	// Starts in |0...0⟩⟨0...0|. The memory policies are those of Qubits.
+	if(qubits < 1 || 2 * qubits > Qubits<Type>::MAX_QUBITS)
+		barf("DensityMatrix", "number of qubits must be between 1 and 31");
+
+	numQubits = qubits;
+	dimension = 1ULL << numQubits;
+	numEntries = dimension * dimension;
+
+	uint64_t required = bytesRequired(numQubits);
+	uint64_t available = StateVector<Type>::availableMemory();
+
+	// zero means the size overflows, which no policy can allocate
+	if(required == 0)
+		barf("DensityMatrix", "density matrix too large to address");
+
+	if(policy != Qubits<Type>::IGNORE_MEMORY && available != 0 && required > available)
+	{
+		printf("Density matrix of %d qubits needs %llu bytes, %llu available\n", numQubits,
+			(unsigned long long)required, (unsigned long long)available);
+
+		if(policy == Qubits<Type>::STRICT_MEMORY)
+			barf("DensityMatrix", "density matrix exceeds available memory");
+
+		printf("[warning] <DensityMatrix> density matrix exceeds available memory\n");
+	}
+
+	entries = new StateVector<Type>(numEntries);
+	entries->set(0, 1, 0);
+
+	measurement.assign(numQubits, -1);
+	readoutFlip01.assign(numQubits, 0);
+	readoutFlip10.assign(numQubits, 0);
+}
+
+template<class Type>
+DensityMatrix<Type>::~DensityMatrix()
+{
+	delete entries;
+}
+
+template<class Type>
+void DensityMatrix<Type>::barf(string function, string message)
+{
+	cout << "[error] " << "<" << function << ">";
+	cout << " " << message << endl;
+	exit(1);
+}
+
+template<class Type>
+void DensityMatrix<Type>::checkQubits(string function, vector<int> qubits)
+{
+	// Every qubit must exist and appear once, before any bit mask is built.
+	for(int j=0; j<qubits.size(); ++j)
+	{
+		if(qubits.at(j) < 0 || qubits.at(j) >= numQubits)
+			barf(function, "qubit out of range");
+
+		for(int i=0; i<j; ++i)
+		{
+			if(qubits.at(i) == qubits.at(j))
+				barf(function, "qubits must be distinct");
+		}
+	}
+}
+
+/* Conjugation Kernels */
+
+template<class Type>
+void DensityMatrix<Type>::applySingle(int qubit, Matrix<Type> u)
+{
+	checkQubits("U", vector<int>(1, qubit));
+
+	Complex<Type> coeffs[4] = {u.get(0, 0), u.get(0, 1), u.get(1, 0), u.get(1, 1)};
+	Complex<Type> conjugates[4];
+
+	for(int i=0; i<4; ++i)
+		conjugates[i] = Complex<Type>(coeffs[i].getRe(), -coeffs[i].getIm());
+
+	kernel.applySingle(entries->data(), numEntries, qubit, coeffs);
+	kernel.applySingle(entries->data(), numEntries, qubit + numQubits, conjugates);
+}
+
+template<class Type>
+void DensityMatrix<Type>::applyControlled(vector<int> controls, vector<int> openControls, int target, Matrix<Type> u)
+{
+	// The controls select the same rows and columns, so the column pass uses
+	// the masks shifted up by n.
+	vector<int> qubits = controls;
+	qubits.insert(qubits.end(), openControls.begin(), openControls.end());
+	qubits.push_back(target);
+
+	checkQubits("MCU", qubits);
+
+	uint64_t controlMask = 0, controlValue = 0;
+
+	for(int i=0; i<controls.size(); ++i)
+	{
+		controlMask |= 1ULL << controls.at(i);
+		controlValue |= 1ULL << controls.at(i);
+	}
+
+	for(int i=0; i<openControls.size(); ++i)
+		controlMask |= 1ULL << openControls.at(i);
+
+	Complex<Type> coeffs[4] = {u.get(0, 0), u.get(0, 1), u.get(1, 0), u.get(1, 1)};
+	Complex<Type> conjugates[4];
+
+	for(int i=0; i<4; ++i)
+		conjugates[i] = Complex<Type>(coeffs[i].getRe(), -coeffs[i].getIm());
+
+	kernel.applyControlled(entries->data(), numEntries, controlMask, controlValue, target, coeffs);
+	kernel.applyControlled(entries->data(), numEntries, controlMask << numQubits, controlValue << numQubits,
+		target + numQubits, conjugates);
+}
+
+template<class Type>
+void DensityMatrix<Type>::applyDiagonal(int qubit, Complex<Type> d0, Complex<Type> d1)
+{
+	// diag(d) ρ diag(d)† scales ρ[r][c] by d[r] conj(d[c]), a phase table
+	// over bits q and q + n applied in one sweep
+	checkQubits("U", vector<int>(1, qubit));
+
+	Complex<Type> d[2] = {d0, d1};
+	Complex<Type> phases[4];
+
+	for(int t=0; t<4; ++t)
+	{
+		Complex<Type> column = d[t >> 1];
+		phases[t] = d[t & 1] * Complex<Type>(column.getRe(), -column.getIm());
+	}
+
+	int bits[2] = {qubit, qubit + (int)numQubits};
+
+	kernel.applyPhases(entries->data(), numEntries, bits, 2, phases);
+}
+
+template<class Type>
+void DensityMatrix<Type>::applySuperoperator(vector<Matrix<Type> > &operators, vector<int> qubits)
+{
+	// Builds S = Σ K ⊗ conj(K) over the 2k bits qubits and qubits + n, with
+	// bit j < k of its index the row bit of qubits[j] and bit k + j the
+	// column bit, and applies it as one dense matrix.
+	checkQubits("Kraus", qubits);
+
+	int k = qubits.size();
+	uint64_t dim = 1ULL << k;
+	uint64_t superDim = dim * dim;
+
+	vector<Complex<Type> > superoperator(superDim * superDim, Complex<Type>(0, 0));
+
+	for(int o=0; o<operators.size(); ++o)
+	{
+		Matrix<Type> &kraus = operators.at(o);
+
+		for(uint64_t r=0; r<dim; ++r)
+		for(uint64_t c=0; c<dim; ++c)
+		for(uint64_t rIn=0; rIn<dim; ++rIn)
+		for(uint64_t cIn=0; cIn<dim; ++cIn)
+		{
+			Complex<Type> column = kraus.get(c, cIn);
+			Complex<Type> term = kraus.get(r, rIn) * Complex<Type>(column.getRe(), -column.getIm());
+
+			superoperator.at((r | c << k) * superDim + (rIn | cIn << k)) += term;
+		}
+	}
+
+	vector<int> bits(qubits);
+
+	for(int j=0; j<k; ++j)
+		bits.push_back(qubits.at(j) + numQubits);
+
+	kernel.applyMatrix(entries->data(), numEntries, &bits.at(0), 2 * k, &superoperator.at(0));
+}
+
+/* Quantum Logic Gates */
+
+template<class Type>
+void DensityMatrix<Type>::H(int qubit)
+{
+	applySingle(qubit, gate.Hadamard());
+}
+
+template<class Type>
+void DensityMatrix<Type>::X(int qubit)
+{
+	applySingle(qubit, gate.Pauli_X());
+}
+
+template<class Type>
+void DensityMatrix<Type>::Y(int qubit)
+{
+	applySingle(qubit, gate.Pauli_Y());
+}
+
+template<class Type>
+void DensityMatrix<Type>::Z(int qubit)
+{
+	applyDiagonal(qubit, Complex<Type>(1, 0), Complex<Type>(-1, 0));
+}
+
+template<class Type>
+void DensityMatrix<Type>::T(int qubit)
+{
+	applyDiagonal(qubit, Complex<Type>(1, 0), Complex<Type>(cos(M_PI / 4), sin(M_PI / 4)));
+}
+
+template<class Type>
+void DensityMatrix<Type>::S(int qubit)
+{
+	applyDiagonal(qubit, Complex<Type>(1, 0), Complex<Type>(0, 1));
+}
+
+template<class Type>
+void DensityMatrix<Type>::U(Matrix<Type> u, int qubit)
+{
+	applySingle(qubit, u);
+}
+
+template<class Type>
+void DensityMatrix<Type>::U(Matrix<Type> u, vector<int> qubits)
+{
+	// Bit j of the row and column index of u is the j-th qubit listed.
+	if(u.rows() != (1 << qubits.size()) || u.cols() != u.rows())
+		barf("U", "matrix must be 2^k x 2^k for k qubits");
+
+	checkQubits("U", qubits);
+
+	uint64_t dim = u.rows();
+	vector<Complex<Type> > matrix(dim * dim), conjugate(dim * dim);
+
+	for(uint64_t r=0; r<dim; ++r)
+	{
+		for(uint64_t c=0; c<dim; ++c)
+		{
+			matrix.at(r * dim + c) = u.get(r, c);
+			conjugate.at(r * dim + c) = Complex<Type>(u.get(r, c).getRe(), -u.get(r, c).getIm());
+		}
+	}
+
+	vector<int> columns(qubits);
+
+	for(int j=0; j<columns.size(); ++j)
+		columns.at(j) += numQubits;
+
+	kernel.applyMatrix(entries->data(), numEntries, &qubits.at(0), qubits.size(), &matrix.at(0));
+	kernel.applyMatrix(entries->data(), numEntries, &columns.at(0), columns.size(), &conjugate.at(0));
+}
+
+template<class Type>
+void DensityMatrix<Type>::MCU(vector<int> controls, int target, Matrix<Type> u)
+{
+	applyControlled(controls, vector<int>(), target, u);
+}
+
+template<class Type>
+void DensityMatrix<Type>::MCU(vector<int> controls, vector<int> openControls, int target, Matrix<Type> u)
+{
+	applyControlled(controls, openControls, target, u);
+}
+
+template<class Type>
+void DensityMatrix<Type>::CNOT(int control, int target)
+{
+	applyControlled(vector<int>(1, control), vector<int>(), target, gate.Pauli_X());
+}
+
+template<class Type>
+void DensityMatrix<Type>::CY(int control, int target)
+{
+	applyControlled(vector<int>(1, control), vector<int>(), target, gate.Pauli_Y());
+}
+
+template<class Type>
+void DensityMatrix<Type>::CZ(int control, int target)
+{
+	applyControlled(vector<int>(1, control), vector<int>(), target, gate.Pauli_Z());
+}
+
+template<class Type>
+void DensityMatrix<Type>::Toffoli(int control1, int control2, int target)
+{
+	vector<int> controls;
+	controls.push_back(control1);
+	controls.push_back(control2);
+
+	applyControlled(controls, vector<int>(), target, gate.Pauli_X());
+}
+
+template<class Type>
+void DensityMatrix<Type>::Swap(int qubit1, int qubit2)
+{
+	vector<int> qubits;
+	qubits.push_back(qubit1);
+	qubits.push_back(qubit2);
+
+	checkQubits("Swap", qubits);
+
+	kernel.applySwap(entries->data(), numEntries, qubit1, qubit2);
+	kernel.applySwap(entries->data(), numEntries, qubit1 + numQubits, qubit2 + numQubits);
+}
+
+template<class Type>
+unsigned int DensityMatrix<Type>::Measure(int qubit)
+{
+	// The outcome is drawn from the diagonal, and rows and columns that
+	// disagree with it are zeroed. The value reported may then be flipped
+	// by the readout error of the qubit; the state keeps the true outcome.
+	checkQubits("Measure", vector<int>(1, qubit));
+
+	Complex<Type> *rho = entries->data();
+	Type probOfZero = 0, probOfOne = 0;
+
+	#pragma omp parallel for reduction(+:probOfZero, probOfOne) if(kernel.isParallel(numEntries)) num_threads(kernel.threads())
+	for(uint64_t i=0; i<dimension; ++i)
+	{
+		Type population = rho[i * (dimension + 1)].getRe();
+
+		if((i >> qubit) & 1)
+			probOfOne += population;
+		else
+			probOfZero += population;
+	}
+
+	unsigned int result = (generator.uniform() * (probOfZero + probOfOne) < probOfZero)? 0 : 1;
+
+	if(((result)? probOfOne : probOfZero) <= 0)
+		result ^= 1;
+
+	Type probability = (result)? probOfOne : probOfZero;
+
+	// one pass over the 2 x 2 blocks of row and column bit q
+	int low = qubit, high = qubit + numQubits;
+	uint64_t rowBit = 1ULL << low, columnBit = 1ULL << high;
+	uint64_t keep = (result)? rowBit | columnBit : 0;
+	Type factor = 1 / probability;
+
+	#pragma omp parallel for if(kernel.isParallel(numEntries)) num_threads(kernel.threads())
+	for(uint64_t k=0; k<numEntries/4; ++k)
+	{
+		uint64_t i = GateKernels<Type>::insertZero(GateKernels<Type>::insertZero(k, low), high);
+
+		rho[i | keep] *= factor;
+		rho[i | (keep ^ rowBit)].set(0, 0);
+		rho[i | (keep ^ columnBit)].set(0, 0);
+		rho[i | (keep ^ rowBit ^ columnBit)].set(0, 0);
+	}
+
+	measurement.at(qubit) = readout(qubit, result);
+
+	return measurement.at(qubit);
+}
+
+template<class Type>
+uint64_t DensityMatrix<Type>::MeasureAll()
+{
+	// Measures every qubit with a single draw from the diagonal, leaving the
+	// state |x⟩⟨x|. The returned index carries the readout errors.
+	Complex<Type> *rho = entries->data();
+	Type total = trace();
+	Type draw = generator.uniform() * total;
+	uint64_t outcome = 0;
+
+	// if rounding runs the draw past the end, the last population that is
+	// not zero is taken
+	for(uint64_t i=0; i<dimension; ++i)
+	{
+		Type population = rho[i * (dimension + 1)].getRe();
+
+		if(population <= 0)
+			continue;
+
+		outcome = i;
+		draw -= population;
+
+		if(draw < 0)
+			break;
+	}
+
+	#pragma omp parallel for if(kernel.isParallel(numEntries)) num_threads(kernel.threads())
+	for(uint64_t i=0; i<numEntries; ++i)
+		rho[i].set(0, 0);
+
+	rho[outcome * (dimension + 1)].set(1, 0);
+
+	uint64_t result = 0;
+
+	for(int i=0; i<numQubits; ++i)
+	{
+		measurement.at(i) = readout(i, (outcome >> i) & 1);
+		result |= (uint64_t)measurement.at(i) << i;
+	}
+
+	return result;
+}
+
+template<class Type>
+unsigned int DensityMatrix<Type>::readout(int qubit, unsigned int outcome)
+{
+	Type flip = (outcome)? readoutFlip10.at(qubit) : readoutFlip01.at(qubit);
+
+	return (flip > 0 && generator.uniform() < flip)? outcome ^ 1 : outcome;
+}
+
+/* Noise Channels */
+
+template<class Type>
+void DensityMatrix<Type>::Kraus(vector<Matrix<Type> > operators, int qubit)
+{
+	Kraus(operators, vector<int>(1, qubit));
+}
+
+template<class Type>
+void DensityMatrix<Type>::Kraus(vector<Matrix<Type> > operators, vector<int> qubits)
+{
+	// Applies ρ -> Σ K ρ K† for 2^k x 2^k operators on k qubits, bit j of
+	// their index being the j-th qubit listed. The operators must satisfy
+	// Σ K† K = I, so the trace is kept.
+	uint64_t dim = 1ULL << qubits.size();
+	Type tolerance = sqrt(numeric_limits<Type>::epsilon());
+
+	if(operators.empty())
+		barf("Kraus", "no operators given");
+
+	for(int o=0; o<operators.size(); ++o)
+	{
+		if(operators.at(o).rows() != dim || operators.at(o).cols() != dim)
+			barf("Kraus", "operators must be 2^k x 2^k for k qubits");
+	}
+
+	for(uint64_t r=0; r<dim; ++r)
+	{
+		for(uint64_t c=0; c<dim; ++c)
+		{
+			Complex<Type> sum(0, 0);
+
+			for(int o=0; o<operators.size(); ++o)
+			{
+				for(uint64_t i=0; i<dim; ++i)
+				{
+					Complex<Type> left = operators.at(o).get(i, r);
+					sum += Complex<Type>(left.getRe(), -left.getIm()) * operators.at(o).get(i, c);
+				}
+			}
+
+			Complex<Type> expected((r == c)? 1 : 0, 0);
+
+			if((sum - expected).normSq() > tolerance * tolerance)
+				barf("Kraus", "operators are not trace preserving");
+		}
+	}
+
+	applySuperoperator(operators, qubits);
+}
+
+template<class Type>
+void DensityMatrix<Type>::Depolarise(int qubit, Type p)
+{
+	// With probability p, one of X, Y or Z chosen uniformly.
+	vector<Matrix<Type> > operators;
+
+	operators.push_back(gate.Identity() * Complex<Type>(sqrt(1 - p), 0));
+	operators.push_back(gate.Pauli_X() * Complex<Type>(sqrt(p / 3), 0));
+	operators.push_back(gate.Pauli_Y() * Complex<Type>(sqrt(p / 3), 0));
+	operators.push_back(gate.Pauli_Z() * Complex<Type>(sqrt(p / 3), 0));
+
+	applySuperoperator(operators, vector<int>(1, qubit));
+}
+
+template<class Type>
+void DensityMatrix<Type>::AmplitudeDamping(int qubit, Type gamma)
+{
+	// |1⟩ decays to |0⟩ with probability gamma.
+	Matrix<Type> k0(2, 2), k1(2, 2);
+	k0.set(0, 0, 1, 0);
+	k0.set(1, 1, sqrt(1 - gamma), 0);
+	k1.set(0, 1, sqrt(gamma), 0);
+
+	vector<Matrix<Type> > operators;
+	operators.push_back(k0);
+	operators.push_back(k1);
+
+	applySuperoperator(operators, vector<int>(1, qubit));
+}
+
+template<class Type>
+void DensityMatrix<Type>::PhaseDamping(int qubit, Type lambda)
+{
+	// Coherences between |0⟩ and |1⟩ shrink by sqrt(1 - lambda); populations
+	// are untouched.
+	Matrix<Type> k0(2, 2), k1(2, 2);
+	k0.set(0, 0, 1, 0);
+	k0.set(1, 1, sqrt(1 - lambda), 0);
+	k1.set(1, 1, sqrt(lambda), 0);
+
+	vector<Matrix<Type> > operators;
+	operators.push_back(k0);
+	operators.push_back(k1);
+
+	applySuperoperator(operators, vector<int>(1, qubit));
+}
+
+template<class Type>
+void DensityMatrix<Type>::setReadoutError(int qubit, Type flip01, Type flip10)
+{
+	// Probabilities that a measured 0 is reported as 1, and a 1 as 0.
+	checkQubits("setReadoutError", vector<int>(1, qubit));
+
+	readoutFlip01.at(qubit) = flip01;
+	readoutFlip10.at(qubit) = flip10;
+}
+
+template<class Type>
+void DensityMatrix<Type>::setReadoutError(Type flip01, Type flip10)
+{
+	readoutFlip01.assign(numQubits, flip01);
+	readoutFlip10.assign(numQubits, flip10);
+}
+
+/* Utilities */
+
+template<class Type>
+unsigned int DensityMatrix<Type>::size()
+{
+	return numQubits;
+}
+
+template<class Type>
+Complex<Type> DensityMatrix<Type>::element(uint64_t row, uint64_t col)
+{
+	// Returns ρ[row][col] = ⟨row|ρ|col⟩.
+	return (*entries)[row | col << numQubits];
+}
+
+template<class Type>
+Type DensityMatrix<Type>::probability(uint64_t index)
+{
+	// Population of the basis state |index⟩.
+	return (*entries)[index * (dimension + 1)].getRe();
+}
+
+template<class Type>
+Type DensityMatrix<Type>::trace()
+{
+	Complex<Type> *rho = entries->data();
+	Type sum = 0;
+
+	for(uint64_t i=0; i<dimension; ++i)
+		sum += rho[i * (dimension + 1)].getRe();
+
+	return sum;
+}
+
+template<class Type>
+Type DensityMatrix<Type>::purity()
+{
+	// Tr(ρ^2), the sum of |ρ[r][c]|^2 as ρ is Hermitian: 1 for a pure state
+	// and 1 / 2^n for the maximally mixed one.
+	Complex<Type> *rho = entries->data();
+	Type sum = 0;
+
+	#pragma omp parallel for reduction(+:sum) if(kernel.isParallel(numEntries)) num_threads(kernel.threads())
+	for(uint64_t i=0; i<numEntries; ++i)
+		sum += rho[i].normSq();
+
+	return sum;
+}
+
+template<class Type>
+uint64_t DensityMatrix<Type>::bytesRequired(int qubits)
+{
+	// A density matrix of n qubits is as large as a state vector of 2n.
+	return Qubits<Type>::bytesRequired(2 * qubits);
+}
+
+template<class Type>
+void DensityMatrix<Type>::setRandomSeed(uint64_t seed)
+{
+	generator.seed(seed);
+}
+
+template<class Type>
+int DensityMatrix<Type>::getMeasurement(int qubit)
+{
+	// Returns the last reported outcome for the qubit, or -1 if it has not
+	// been measured.
+	return measurement.at(qubit);
+}
+
+template<class Type>
+vector<int> DensityMatrix<Type>::getMeasurements()
+{
+	return measurement;
+}
+
+template<class Type>
+void DensityMatrix<Type>::setNumThreads(int threads)
+{
+	kernel.setNumThreads(threads);
+}
+
+template<class Type>
+void DensityMatrix<Type>::setParallelThreshold(uint64_t length)
+{
+	kernel.setParallelThreshold(length);
+}
+
+template<class Type>
+void DensityMatrix<Type>::print()
+{
+	// Prints the population of each basis state, then the purity.
+	for(uint64_t i=0; i<dimension; ++i)
+	{
+		string decToBin;
+
+		for(int j=0; j<numQubits; ++j)
+			decToBin.insert(decToBin.begin(), (i >> j & 1) + '0');
+
+		printf("|%s⟩  (%.3f)\n", decToBin.c_str(), probability(i));
+	}
+
+	printf("\npurity %.3f\n", purity());
+
+	for(int i=0; i<numQubits; ++i)
+	{
+		if(measurement.at(i) >= 0)
+			printf("Qubit%2d: %d\n", i, measurement.at(i));
+	}
+}
+
+#endif
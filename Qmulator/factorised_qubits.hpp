@@ -0,0 +1,715 @@
+#ifndef QMULATOR_FACTORISED_QUBITS_HPP
+#define QMULATOR_FACTORISED_QUBITS_HPP
+
+#include <stdio.h>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <math.h>
+#include "complex.hpp"
+#include "matrix.hpp"
+#include "quantum_gates.hpp"
+#include "random_source.hpp"
+#include "qubits.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+	State held as a product of independent registers, each a Qubits over
+	the qubits entangled with one another. A qubit no gate has touched yet
+	has no register at all and is simply |0⟩. A gate on qubits of several
+	registers first merges them into one by a tensor product, so memory
+	grows with the largest group of entangled qubits rather than with all
+	of them; a swap only exchanges the labels of two qubits.
+
+	After a measurement the register is checked qubit by qubit: a qubit is
+	separable when the amplitudes with it at 0 and at 1 are parallel, and
+	such qubits are split off into registers of their own. The measured
+	qubit always is, and in a GHZ state every other qubit follows it.
+*/
+
+template<class Type>
+class FactorisedQubits
+{
+private:
+	struct Register
+	{
+		Qubits<Type> *state;
+		vector<int> qubits;
+	};
+
+	unsigned int numQubits;
+
+	// owner[q] is the register holding qubit q (-1 while still |0⟩ and
+	// untouched) and position[q] its bit within that register
+	vector<Register> registers;
+	vector<int> owner;
+	vector<int> position;
+
+	vector<int> measurement;
+	RandomSource<Type> generator;
+	int numThreads;
+	uint64_t peak;
+
+	QuantumGates<Type> gate;
+
+	Qubits<Type>* newState(int);
+	int touch(int);
+	int join(vector<int>);
+	int join(int, int);
+	int join(int, int, int);
+	int merge(int, int);
+	void remove(int);
+	bool peel(int, int);
+	void splitSeparable(int);
+	vector<int> local(vector<int>);
+
+	void initialise(int);
+	void barf(string, string);
+
+public:
+	/* Constructor and Deconstructor */
+	FactorisedQubits(int);
+	~FactorisedQubits();
+
+	/* Quantum Logic Gates */
+	void H(int);
+	void X(int);
+	void Y(int);
+	void Z(int);
+	void T(int);
+	void S(int);
+	void U(Matrix<Type>, int);
+	void U(Matrix<Type>, vector<int>);
+	unsigned int Measure(int);
+	uint64_t MeasureAll();
+
+	void MCU(vector<int>, int, Matrix<Type>);
+	void MCU(vector<int>, vector<int>, int, Matrix<Type>);
+	void CNOT(int, int);
+	void CY(int, int);
+	void CZ(int, int);
+	void Toffoli(int, int, int);
+
+	void Swap(int, int);
+
+	/* Representation */
+	int numRegisters();
+	int largestRegister();
+	vector<int> registerOf(int);
+	uint64_t bytes();
+	uint64_t peakBytes();
+
+	/* Utilities */
+	unsigned int size();
+	Complex<Type> amplitude(uint64_t);
+
+	void setRandomSeed(uint64_t);
+	void setNumThreads(int);
+	int getMeasurement(int);
+	vector<int> getMeasurements();
+
+	void print();
+};
+
+/* Constructor and Deconstructor */
+
+template<class Type>
+FactorisedQubits<Type>::FactorisedQubits(int qubits)
+{
+	initialise(qubits);
+}
+
+template<class Type>
+void FactorisedQubits<Type>::initialise(int qubits)
+{
+	// Any number of qubits, as long as no register outgrows Qubits.
+	if(qubits < 1)
+		barf("FactorisedQubits", "at least one qubit required");
+
+	numQubits = qubits;
+	numThreads = 0;
+	peak = 0;
+
+	owner.assign(numQubits, -1);
+	position.assign(numQubits, 0);
+	measurement.assign(numQubits, -1);
+}
+
+template<class Type>
+FactorisedQubits<Type>::~FactorisedQubits()
+{
+	for(int r=0; r<registers.size(); ++r)
+		delete registers.at(r).state;
+}
+
+template<class Type>
+void FactorisedQubits<Type>::barf(string function, string message)
+{
+	cout << "[error] " << "<" << function << ">";
+	cout << " " << message << endl;
+	exit(1);
+}
+
+/* Registers */
+
+template<class Type>
+Qubits<Type>* FactorisedQubits<Type>::newState(int qubits)
+{
+	// A register in |0...0⟩, seeded from this generator so that a seeded
+	// run measures the same way every time.
+	Qubits<Type> *state = new Qubits<Type>(qubits);
+	state->enableGraphics = false;
+	state->setRandomSeed(generator.next());
+
+	if(numThreads > 0)
+		state->setNumThreads(numThreads);
+
+	return state;
+}
+
+template<class Type>
+int FactorisedQubits<Type>::touch(int qubit)
+{
+	// The register of a qubit, giving an untouched one its own.
+	if(qubit < 0 || qubit >= numQubits)
+		barf("FactorisedQubits", "qubit out of range");
+
+	if(owner.at(qubit) < 0)
+	{
+		Register added;
+		added.state = newState(1);
+		added.qubits.push_back(qubit);
+
+		owner.at(qubit) = registers.size();
+		position.at(qubit) = 0;
+		registers.push_back(added);
+
+		peak = max(peak, bytes());
+	}
+
+	return owner.at(qubit);
+}
+
+template<class Type>
+int FactorisedQubits<Type>::merge(int a, int b)
+{
+	// Tensors register b onto register a: bit j of a stays bit j and bit j
+	// of b becomes bit ka + j. The result keeps the lower of the two slots.
+	if(a > b)
+		swap(a, b);
+
+	Register &first = registers.at(a), &second = registers.at(b);
+	int ka = first.qubits.size(), kb = second.qubits.size();
+
+	if(ka + kb > Qubits<Type>::MAX_QUBITS)
+		barf("FactorisedQubits", "entangled register exceeds the largest state vector");
+
+	first.state->flush();
+	second.state->flush();
+
+	Qubits<Type> *joined = newState(ka + kb);
+	joined->flush();
+
+	Complex<Type> *x = first.state->states->data(), *y = second.state->states->data();
+	Complex<Type> *out = joined->states->data();
+	int64_t lengthA = first.state->length(), lengthB = second.state->length();
+
+	#pragma omp parallel for if(lengthA * lengthB >= (1 << 16)) num_threads((numThreads > 0)? numThreads : omp_get_max_threads())
+	for(int64_t j=0; j<lengthB; ++j)
+	{
+		for(int64_t i=0; i<lengthA; ++i)
+			out[i + (j << ka)] = x[i] * y[j];
+	}
+
+	for(int j=0; j<kb; ++j)
+	{
+		int q = second.qubits.at(j);
+		first.qubits.push_back(q);
+		owner.at(q) = a;
+		position.at(q) = ka + j;
+	}
+
+	delete first.state;
+	first.state = joined;
+
+	remove(b);
+	peak = max(peak, bytes());
+
+	return a;
+}
+
+template<class Type>
+void FactorisedQubits<Type>::remove(int r)
+{
+	// Frees register r, moving the last register into its slot.
+	delete registers.at(r).state;
+
+	int last = registers.size() - 1;
+
+	if(r != last)
+	{
+		registers.at(r) = registers.at(last);
+
+		for(int j=0; j<registers.at(r).qubits.size(); ++j)
+			owner.at(registers.at(r).qubits.at(j)) = r;
+	}
+
+	registers.pop_back();
+}
+
+template<class Type>
+int FactorisedQubits<Type>::join(vector<int> qubits)
+{
+	// One register holding all the qubits given.
+	for(int j=0; j<qubits.size(); ++j)
+	{
+		for(int k=0; k<j; ++k)
+		{
+			if(qubits.at(k) == qubits.at(j))
+				barf("FactorisedQubits", "qubits must be distinct");
+		}
+	}
+
+	int r = touch(qubits.at(0));
+
+	for(int j=1; j<qubits.size(); ++j)
+	{
+		int other = touch(qubits.at(j));
+
+		// touching may not move r, but merging can
+		r = owner.at(qubits.at(0));
+
+		if(other != r)
+			r = merge(r, other);
+	}
+
+	return r;
+}
+
+template<class Type>
+int FactorisedQubits<Type>::join(int qubit1, int qubit2)
+{
+	vector<int> qubits;
+	qubits.push_back(qubit1);
+	qubits.push_back(qubit2);
+
+	return join(qubits);
+}
+
+template<class Type>
+int FactorisedQubits<Type>::join(int qubit1, int qubit2, int qubit3)
+{
+	vector<int> qubits;
+	qubits.push_back(qubit1);
+	qubits.push_back(qubit2);
+	qubits.push_back(qubit3);
+
+	return join(qubits);
+}
+
+template<class Type>
+vector<int> FactorisedQubits<Type>::local(vector<int> qubits)
+{
+	for(int j=0; j<qubits.size(); ++j)
+		qubits.at(j) = position.at(qubits.at(j));
+
+	return qubits;
+}
+
+template<class Type>
+bool FactorisedQubits<Type>::peel(int r, int j)
+{
+	// Splits bit j off register r if the register is a product with it:
+	// writing v0, v1 for the halves with bit j at 0 and 1, that holds when
+	// |⟨v0|v1⟩|² = |v0|²|v1|². The rest keeps the larger half, normalised
+	// as w, and the qubit gets (⟨w|v0⟩, ⟨w|v1⟩).
+	Register &reg = registers.at(r);
+	int k = reg.qubits.size();
+
+	if(k < 2)
+		return false;
+
+	reg.state->flush();
+	Complex<Type> *v = reg.state->states->data();
+
+	uint64_t half = reg.state->length() / 2;
+	uint64_t bit = 1ULL << j, low = bit - 1;
+
+	Type norm0 = 0, norm1 = 0, overlapRe = 0, overlapIm = 0;
+
+	for(uint64_t i=0; i<half; ++i)
+	{
+		uint64_t index = (i & low) | ((i & ~low) << 1);
+		Complex<Type> a = v[index], b = v[index | bit];
+
+		norm0 += a.normSq();
+		norm1 += b.normSq();
+		overlapRe += a.getRe() * b.getRe() + a.getIm() * b.getIm();
+		overlapIm += a.getRe() * b.getIm() - a.getIm() * b.getRe();
+	}
+
+	Type tolerance = 64 * numeric_limits<Type>::epsilon();
+
+	if(overlapRe * overlapRe + overlapIm * overlapIm < norm0 * norm1 * (1 - tolerance))
+		return false;
+
+	// either half is w up to a factor, so project both onto the larger one
+	uint64_t keep = (norm1 > norm0)? bit : 0;
+	Type scale = 1 / sqrt(max(norm0, norm1));
+
+	Qubits<Type> *rest = newState(k - 1);
+	rest->flush();
+	Complex<Type> *w = rest->states->data();
+
+	Complex<Type> alpha(0, 0), beta(0, 0);
+
+	for(uint64_t i=0; i<half; ++i)
+	{
+		uint64_t index = (i & low) | ((i & ~low) << 1);
+		w[i] = v[index | keep] * Complex<Type>(scale, 0);
+
+		Complex<Type> conjugate(w[i].getRe(), -w[i].getIm());
+		alpha += conjugate * v[index];
+		beta += conjugate * v[index | bit];
+	}
+
+	Register single;
+	single.state = newState(1);
+	single.state->flush();
+	single.state->states->set(0, alpha.getRe(), alpha.getIm());
+	single.state->states->set(1, beta.getRe(), beta.getIm());
+
+	int qubit = reg.qubits.at(j);
+	single.qubits.push_back(qubit);
+
+	delete reg.state;
+	reg.state = rest;
+	reg.qubits.erase(reg.qubits.begin() + j);
+
+	for(int p=0; p<reg.qubits.size(); ++p)
+		position.at(reg.qubits.at(p)) = p;
+
+	owner.at(qubit) = registers.size();
+	position.at(qubit) = 0;
+	registers.push_back(single);
+
+	return true;
+}
+
+template<class Type>
+void FactorisedQubits<Type>::splitSeparable(int r)
+{
+	// Peels every separable qubit off register r after a measurement.
+	int j = 0;
+
+	while(j < registers.at(r).qubits.size() && registers.at(r).qubits.size() > 1)
+	{
+		if(!peel(r, j))
+			++j;
+	}
+}
+
+/* Quantum Logic Gates */
+
+template<class Type>
+void FactorisedQubits<Type>::H(int qubit)
+{
+	registers.at(touch(qubit)).state->H(position.at(qubit));
+}
+
+template<class Type>
+void FactorisedQubits<Type>::X(int qubit)
+{
+	registers.at(touch(qubit)).state->X(position.at(qubit));
+}
+
+template<class Type>
+void FactorisedQubits<Type>::Y(int qubit)
+{
+	registers.at(touch(qubit)).state->Y(position.at(qubit));
+}
+
+template<class Type>
+void FactorisedQubits<Type>::Z(int qubit)
+{
+	registers.at(touch(qubit)).state->Z(position.at(qubit));
+}
+
+template<class Type>
+void FactorisedQubits<Type>::T(int qubit)
+{
+	registers.at(touch(qubit)).state->T(position.at(qubit));
+}
+
+template<class Type>
+void FactorisedQubits<Type>::S(int qubit)
+{
+	registers.at(touch(qubit)).state->S(position.at(qubit));
+}
+
+template<class Type>
+void FactorisedQubits<Type>::U(Matrix<Type> u, int qubit)
+{
+	registers.at(touch(qubit)).state->U(u, position.at(qubit));
+}
+
+template<class Type>
+void FactorisedQubits<Type>::U(Matrix<Type> u, vector<int> qubits)
+{
+	int r = join(qubits);
+	registers.at(r).state->U(u, local(qubits));
+}
+
+template<class Type>
+unsigned int FactorisedQubits<Type>::Measure(int qubit)
+{
+	// An untouched qubit is |0⟩ and needs no register.
+	if(qubit < 0 || qubit >= numQubits)
+		barf("Measure", "qubit out of range");
+
+	if(owner.at(qubit) < 0)
+		return measurement.at(qubit) = 0;
+
+	int r = owner.at(qubit);
+	measurement.at(qubit) = registers.at(r).state->Measure(position.at(qubit));
+
+	splitSeparable(r);
+
+	return measurement.at(qubit);
+}
+
+template<class Type>
+uint64_t FactorisedQubits<Type>::MeasureAll()
+{
+	// Measures each register as a whole; afterwards every qubit is on its own.
+	if(numQubits > 64)
+		barf("MeasureAll", "outcome limited to 64 qubits, use Measure");
+
+	uint64_t result = 0;
+	int count = registers.size();
+
+	for(int r=0; r<count; ++r)
+	{
+		uint64_t outcome = registers.at(r).state->MeasureAll();
+
+		for(int j=0; j<registers.at(r).qubits.size(); ++j)
+		{
+			int q = registers.at(r).qubits.at(j);
+			result |= ((outcome >> j) & 1ULL) << q;
+		}
+	}
+
+	for(int q=0; q<numQubits; ++q)
+		measurement.at(q) = (result >> q) & 1;
+
+	for(int r=0; r<count; ++r)
+		splitSeparable(r);
+
+	return result;
+}
+
+template<class Type>
+void FactorisedQubits<Type>::MCU(vector<int> controls, int target, Matrix<Type> u)
+{
+	MCU(controls, vector<int>(), target, u);
+}
+
+template<class Type>
+void FactorisedQubits<Type>::MCU(vector<int> controls, vector<int> openControls, int target, Matrix<Type> u)
+{
+	vector<int> qubits = controls;
+	qubits.insert(qubits.end(), openControls.begin(), openControls.end());
+	qubits.push_back(target);
+
+	int r = join(qubits);
+	registers.at(r).state->MCU(local(controls), local(openControls), position.at(target), u);
+}
+
+template<class Type>
+void FactorisedQubits<Type>::CNOT(int control, int target)
+{
+	int r = join(control, target);
+	registers.at(r).state->CNOT(position.at(control), position.at(target));
+}
+
+template<class Type>
+void FactorisedQubits<Type>::CY(int control, int target)
+{
+	int r = join(control, target);
+	registers.at(r).state->CY(position.at(control), position.at(target));
+}
+
+template<class Type>
+void FactorisedQubits<Type>::CZ(int control, int target)
+{
+	int r = join(control, target);
+	registers.at(r).state->CZ(position.at(control), position.at(target));
+}
+
+template<class Type>
+void FactorisedQubits<Type>::Toffoli(int control1, int control2, int target)
+{
+	int r = join(control1, control2, target);
+	registers.at(r).state->Toffoli(position.at(control1), position.at(control2), position.at(target));
+}
+
+template<class Type>
+void FactorisedQubits<Type>::Swap(int qubit1, int qubit2)
+{
+	// Only the labels move: each qubit takes over the other's place.
+	if(qubit1 < 0 || qubit1 >= numQubits || qubit2 < 0 || qubit2 >= numQubits)
+		barf("Swap", "qubit out of range");
+
+	int r1 = owner.at(qubit1), r2 = owner.at(qubit2);
+
+	if(r1 >= 0)
+		registers.at(r1).qubits.at(position.at(qubit1)) = qubit2;
+
+	if(r2 >= 0)
+		registers.at(r2).qubits.at(position.at(qubit2)) = qubit1;
+
+	swap(owner.at(qubit1), owner.at(qubit2));
+	swap(position.at(qubit1), position.at(qubit2));
+}
+
+/* Representation */
+
+template<class Type>
+int FactorisedQubits<Type>::numRegisters()
+{
+	return registers.size();
+}
+
+template<class Type>
+int FactorisedQubits<Type>::largestRegister()
+{
+	// Qubits in the largest register.
+	int largest = 0;
+
+	for(int r=0; r<registers.size(); ++r)
+		largest = max(largest, (int)registers.at(r).qubits.size());
+
+	return largest;
+}
+
+template<class Type>
+vector<int> FactorisedQubits<Type>::registerOf(int qubit)
+{
+	// The qubits sharing a register with the one given, itself included.
+	if(qubit < 0 || qubit >= numQubits)
+		barf("registerOf", "qubit out of range");
+
+	if(owner.at(qubit) < 0)
+		return vector<int>(1, qubit);
+
+	return registers.at(owner.at(qubit)).qubits;
+}
+
+template<class Type>
+uint64_t FactorisedQubits<Type>::bytes()
+{
+	// Amplitude storage of all registers.
+	uint64_t total = 0;
+
+	for(int r=0; r<registers.size(); ++r)
+		total += registers.at(r).state->length() * sizeof(Complex<Type>);
+
+	return total;
+}
+
+template<class Type>
+uint64_t FactorisedQubits<Type>::peakBytes()
+{
+	return peak;
+}
+
+/* Utilities */
+
+template<class Type>
+unsigned int FactorisedQubits<Type>::size()
+{
+	return numQubits;
+}
+
+template<class Type>
+Complex<Type> FactorisedQubits<Type>::amplitude(uint64_t index)
+{
+	// The product of each register's amplitude at its bits of the index.
+	if(numQubits > 64)
+		barf("amplitude", "index form limited to 64 qubits");
+
+	Complex<Type> result(1, 0);
+
+	for(int q=0; q<numQubits; ++q)
+	{
+		if(owner.at(q) < 0 && ((index >> q) & 1))
+			return Complex<Type>(0, 0);
+	}
+
+	for(int r=0; r<registers.size(); ++r)
+	{
+		uint64_t localIndex = 0;
+
+		for(int j=0; j<registers.at(r).qubits.size(); ++j)
+			localIndex |= ((index >> registers.at(r).qubits.at(j)) & 1ULL) << j;
+
+		result = result * registers.at(r).state->amplitude(localIndex);
+	}
+
+	return result;
+}
+
+template<class Type>
+void FactorisedQubits<Type>::setRandomSeed(uint64_t seed)
+{
+	generator.seed(seed);
+
+	for(int r=0; r<registers.size(); ++r)
+		registers.at(r).state->setRandomSeed(generator.next());
+}
+
+template<class Type>
+void FactorisedQubits<Type>::setNumThreads(int threads)
+{
+	numThreads = (threads > 0)? threads : 0;
+
+	for(int r=0; r<registers.size(); ++r)
+		registers.at(r).state->setNumThreads(threads);
+}
+
+template<class Type>
+int FactorisedQubits<Type>::getMeasurement(int qubit)
+{
+	return measurement.at(qubit);
+}
+
+template<class Type>
+vector<int> FactorisedQubits<Type>::getMeasurements()
+{
+	return measurement;
+}
+
+template<class Type>
+void FactorisedQubits<Type>::print()
+{
+	// One line per register: its qubits and its size.
+	int untouched = count(owner.begin(), owner.end(), -1);
+
+	printf("%d registers, %d untouched qubits, %llu bytes\n", (int)registers.size(), untouched, (unsigned long long)bytes());
+
+	for(int r=0; r<registers.size(); ++r)
+	{
+		printf("[");
+
+		for(int j=0; j<registers.at(r).qubits.size(); ++j)
+			printf((j == 0)? "%d" : " %d", registers.at(r).qubits.at(j));
+
+		printf("] %llu amplitudes\n", (unsigned long long)registers.at(r).state->length());
+	}
+}
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef QMULATOR_GATE_FUSION_HPP
+#define QMULATOR_GATE_FUSION_HPP
+
+#include <vector>
+#include <stdint.h>
+#include "circuit.hpp"
+
+/*
+	Groups consecutive gates of a recorded circuit whose qubits together fit
+	in maxWidth qubits. The product of a group is a single 2^k x 2^k unitary,
+	so the whole group costs one sweep of the state vector instead of one
+	per gate. Qubit j of the group is qubits[j].
+*/
+
+class GateFusion
+{
+private:
+	vector<int> qubits;
+	vector<uint64_t> members;
+	int maxWidth;
+	int numDense;
+
+public:
+	static const int DEFAULT_WIDTH = 3;
+
+	GateFusion();
+
+	bool add(uint64_t, Operation &, bool);
+	void clear();
+	Operation local(Operation &);
+	int position(int);
+
+	bool isEmpty() { return members.empty(); }
+	bool isWorthwhile();
+	int gates() { return members.size(); }
+	int width() { return qubits.size(); }
+	int getMaxWidth() { return maxWidth; }
+	void setMaxWidth(int width) { maxWidth = width; }
+
+	int* qubitList() { return &qubits.at(0); }
+	vector<uint64_t>& operations() { return members; }
+};
+
+inline GateFusion::GateFusion()
+{
+	maxWidth = DEFAULT_WIDTH;
+	clear();
+}
+
+inline int GateFusion::position(int qubit)
+{
+	for(int i=0; i<qubits.size(); ++i)
+	{
+		if(qubits.at(i) == qubit)
+			return i;
+	}
+
+	return -1;
+}
+
+inline bool GateFusion::add(uint64_t index, Operation &op, bool diagonal)
+{
+	// Adds the operation at index of the circuit. Returns false if the group
+	// would span more than maxWidth qubits, leaving the group unchanged.
+	int numNew = 0;
+
+	for(int j=0; j<op.qubits.size(); ++j)
+	{
+		if(position(op.qubits.at(j)) < 0)
+			++numNew;
+	}
+
+	if(qubits.size() + numNew > maxWidth)
+		return false;
+
+	for(int j=0; j<op.qubits.size(); ++j)
+	{
+		if(position(op.qubits.at(j)) < 0)
+			qubits.push_back(op.qubits.at(j));
+	}
+
+	members.push_back(index);
+
+	if(!diagonal)
+		++numDense;
+
+	return true;
+}
+
+inline bool GateFusion::isWorthwhile()
+{
+	// A dense k-qubit matrix costs about as much as 2^k / 4 single-qubit
+	// sweeps, so the gates it replaces must outnumber that. Diagonal gates
+	// are not counted, as they are fused into one phase sweep anyway.
+	return numDense > 1 && numDense > (1 << qubits.size()) / 4;
+}
+
+inline void GateFusion::clear()
+{
+	qubits.clear();
+	members.clear();
+	numDense = 0;
+}
+
+inline Operation GateFusion::local(Operation &op)
+{
+	// Copy of the operation acting on positions within the group.
+	Operation mapped = op;
+
+	for(int j=0; j<mapped.qubits.size(); ++j)
+		mapped.qubits.at(j) = position(op.qubits.at(j));
+
+	return mapped;
+}
+
+#endif
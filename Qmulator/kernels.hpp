@@ -0,0 +1,676 @@
+#ifndef QMULATOR_KERNELS_HPP
+#define QMULATOR_KERNELS_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include "complex.hpp"
+#include "matrix.hpp"
+#include "simd_kernels.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+	Gate kernels apply small unitaries directly to the amplitudes of a state
+	vector in place, rather than building a 2^n x 2^n operator. Qubit i
+	corresponds to bit i of the basis index.
+
+	When compiled with OpenMP, every kernel splits its index space across
+	threads once the state vector reaches parallelThreshold amplitudes.
+	Kernels on float and double use the SIMD level detected at runtime
+	whenever the target stride spans at least one vector register.
+*/
+
+template<class T>
+class GateKernels
+{
+private:
+	int numThreads;
+	uint64_t parallelThreshold;
+	int simd;
+
+	static const uint64_t BLOCK_SIZE = 1ULL << 12;
+
+	template<int LANES>
+	void applyMatrixLanes(Complex<T> *, uint64_t, vector<int> &, vector<uint64_t> &, Complex<T> *, int);
+
+public:
+	GateKernels();
+
+	/* Parallel Execution */
+	void setNumThreads(int);
+	void setParallelThreshold(uint64_t);
+	int threads();
+	bool isParallel(uint64_t);
+
+	/* Vectorisation */
+	void setSimdLevel(int);
+	int simdLevel();
+
+	/* Single-Qubit Kernels */
+	void applySingle(Complex<T> *, uint64_t, int, Matrix<T>);
+	void applySingle(Complex<T> *, uint64_t, int, Complex<T> *);
+	void applyDiagonal(Complex<T> *, uint64_t, int, Complex<T>, Complex<T>);
+	void applyPhases(Complex<T> *, uint64_t, int *, int, Complex<T> *);
+
+	/* Controlled Kernels */
+	void applyControlled(Complex<T> *, uint64_t, uint64_t, uint64_t, int, Matrix<T>);
+	void applyControlled(Complex<T> *, uint64_t, uint64_t, uint64_t, int, Complex<T> *);
+
+	/* Multi-Qubit Kernels */
+	void applyMatrix(Complex<T> *, uint64_t, int *, int, Complex<T> *);
+	void applySwap(Complex<T> *, uint64_t, int, int);
+
+	/* Measurement Kernels */
+	void probabilities(Complex<T> *, uint64_t, int, T *, T *);
+	void collapse(Complex<T> *, uint64_t, int, unsigned int, T);
+	void collapseTo(Complex<T> *, uint64_t, uint64_t);
+
+	/* Sampling Kernels */
+	T blockSums(Complex<T> *, uint64_t, vector<T> &);
+	uint64_t sampleIndex(Complex<T> *, uint64_t, T);
+	void cumulative(Complex<T> *, uint64_t, T *);
+
+	/* Utilities */
+	static uint64_t insertZero(uint64_t, int);
+};
+
+template<class T>
+GateKernels<T>::GateKernels()
+{
+	numThreads = 0;
+	parallelThreshold = 1ULL << 14;
+	simd = SimdKernels::detect();
+}
+
+/* Parallel Execution */
+
+template<class T>
+void GateKernels<T>::setNumThreads(int threads)
+{
+	// Zero uses the OpenMP default.
+	numThreads = (threads > 0)? threads : 0;
+}
+
+template<class T>
+void GateKernels<T>::setParallelThreshold(uint64_t length)
+{
+	parallelThreshold = length;
+}
+
+template<class T>
+int GateKernels<T>::threads()
+{
+#ifdef _OPENMP
+	return (numThreads > 0)? numThreads : omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+template<class T>
+bool GateKernels<T>::isParallel(uint64_t length)
+{
+	return length >= parallelThreshold && threads() > 1;
+}
+
+/* Vectorisation */
+
+template<class T>
+void GateKernels<T>::setSimdLevel(int level)
+{
+	// Levels above what the CPU supports are clamped to the detected level.
+	int detected = SimdKernels::detect();
+
+	simd = (level < detected)? level : detected;
+}
+
+template<class T>
+int GateKernels<T>::simdLevel()
+{
+	return simd;
+}
+
+/* Single-Qubit Kernels */
+
+template<class T>
+void GateKernels<T>::applySingle(Complex<T> *states, uint64_t length, int qubit, Matrix<T> u)
+{
+	Complex<T> coeffs[4] = {u.get(0, 0), u.get(0, 1), u.get(1, 0), u.get(1, 1)};
+
+	applySingle(states, length, qubit, coeffs);
+}
+
+template<class T>
+void GateKernels<T>::applySingle(Complex<T> *states, uint64_t length, int qubit, Complex<T> *matrix)
+{
+	// Every amplitude pair (i, i | 1 << qubit) is mixed by the 2 x 2 matrix,
+	// given row by row.
+	Complex<T> u00 = matrix[0], u01 = matrix[1];
+	Complex<T> u10 = matrix[2], u11 = matrix[3];
+
+	uint64_t stride = 1ULL << qubit;
+	uint64_t numPairs = length >> 1;
+	uint64_t width = SimdKernels::width(simd, sizeof(T));
+
+	if(width > 0 && stride >= width)
+	{
+		Complex<T> coeffs[4] = {u00, u01, u10, u11};
+		uint64_t numBlocks = (numPairs + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+		#pragma omp parallel for if(isParallel(length)) num_threads(threads())
+		for(uint64_t b=0; b<numBlocks; ++b)
+		{
+			uint64_t end = (b + 1 < numBlocks)? (b + 1) * BLOCK_SIZE : numPairs;
+			SimdKernels::applySingle(simd, states, b * BLOCK_SIZE, end, qubit, coeffs);
+		}
+
+		return;
+	}
+
+	#pragma omp parallel for if(isParallel(length)) num_threads(threads())
+	for(uint64_t k=0; k<numPairs; ++k)
+	{
+		uint64_t i = insertZero(k, qubit);
+
+		Complex<T> a0 = states[i];
+		Complex<T> a1 = states[i + stride];
+
+		states[i] = u00 * a0 + u01 * a1;
+		states[i + stride] = u10 * a0 + u11 * a1;
+	}
+}
+
+template<class T>
+void GateKernels<T>::applyDiagonal(Complex<T> *states, uint64_t length, int qubit, Complex<T> d0, Complex<T> d1)
+{
+	// A diagonal matrix only rescales each amplitude by the entry its bit selects.
+	uint64_t stride = 1ULL << qubit;
+	uint64_t numPairs = length >> 1;
+	uint64_t width = SimdKernels::width(simd, sizeof(T));
+
+	if(width > 0 && stride >= width)
+	{
+		Complex<T> coeffs[2] = {d0, d1};
+		uint64_t numBlocks = (numPairs + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+		#pragma omp parallel for if(isParallel(length)) num_threads(threads())
+		for(uint64_t b=0; b<numBlocks; ++b)
+		{
+			uint64_t end = (b + 1 < numBlocks)? (b + 1) * BLOCK_SIZE : numPairs;
+			SimdKernels::applyDiagonal(simd, states, b * BLOCK_SIZE, end, qubit, coeffs);
+		}
+
+		return;
+	}
+
+	#pragma omp parallel for if(isParallel(length)) num_threads(threads())
+	for(uint64_t k=0; k<numPairs; ++k)
+	{
+		uint64_t i = insertZero(k, qubit);
+
+		states[i] *= d0;
+		states[i + stride] *= d1;
+	}
+}
+
+template<class T>
+void GateKernels<T>::applyPhases(Complex<T> *states, uint64_t length, int *qubits, int numQubits, Complex<T> *phases)
+{
+	// Multiplies each amplitude by phases[t], where bit j of t is the bit of
+	// the amplitude's index at qubits[j]. The phase is constant over runs of
+	// 2^lowest consecutive amplitudes, and runs whose phase is 1 are skipped.
+	if(numQubits == 1)
+	{
+		applyDiagonal(states, length, qubits[0], phases[0], phases[1]);
+		return;
+	}
+
+	int lowest = qubits[0];
+
+	for(int j=1; j<numQubits; ++j)
+		lowest = (qubits[j] < lowest)? qubits[j] : lowest;
+
+	uint64_t runLength = 1ULL << lowest;
+	uint64_t numRuns = length >> lowest;
+
+	#pragma omp parallel for if(isParallel(length)) num_threads(threads())
+	for(uint64_t r=0; r<numRuns; ++r)
+	{
+		uint64_t start = r << lowest;
+		uint64_t t = 0;
+
+		for(int j=0; j<numQubits; ++j)
+			t |= ((start >> qubits[j]) & 1) << j;
+
+		Complex<T> phase = phases[t];
+
+		if(phase.getRe() == 1 && phase.getIm() == 0)
+			continue;
+
+		for(uint64_t i=start; i<start+runLength; ++i)
+			states[i] *= phase;
+	}
+}
+
+/* Controlled Kernels */
+
+template<class T>
+void GateKernels<T>::applyControlled(Complex<T> *states, uint64_t length,
+	uint64_t controlMask, uint64_t controlValue, int target, Matrix<T> u)
+{
+	Complex<T> coeffs[4] = {u.get(0, 0), u.get(0, 1), u.get(1, 0), u.get(1, 1)};
+
+	applyControlled(states, length, controlMask, controlValue, target, coeffs);
+}
+
+template<class T>
+void GateKernels<T>::applyControlled(Complex<T> *states, uint64_t length,
+	uint64_t controlMask, uint64_t controlValue, int target, Complex<T> *matrix)
+{
+	// Only the pairs whose control bits (controlMask) read controlValue are
+	// touched, enumerated by inserting the fixed bits into a compact counter.
+	Complex<T> u00 = matrix[0], u01 = matrix[1];
+	Complex<T> u10 = matrix[2], u11 = matrix[3];
+
+	uint64_t stride = 1ULL << target;
+	uint64_t fixedMask = controlMask | stride;
+
+	int fixedBits[64];
+	int numFixed = 0;
+	uint64_t numFree = length;
+
+	for(int bit=0; (1ULL << bit) < length; ++bit)
+	{
+		if((fixedMask >> bit) & 1)
+		{
+			fixedBits[numFixed++] = bit;
+			numFree >>= 1;
+		}
+	}
+
+	uint64_t width = SimdKernels::width(simd, sizeof(T));
+
+	if(width > 0 && (fixedMask & (width - 1)) == 0)
+	{
+		Complex<T> coeffs[4] = {u00, u01, u10, u11};
+		uint64_t setBits = controlValue & controlMask;
+		uint64_t numBlocks = (numFree + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+		#pragma omp parallel for if(isParallel(length)) num_threads(threads())
+		for(uint64_t b=0; b<numBlocks; ++b)
+		{
+			uint64_t end = (b + 1 < numBlocks)? (b + 1) * BLOCK_SIZE : numFree;
+			SimdKernels::applyControlled(simd, states, b * BLOCK_SIZE, end, fixedBits, numFixed, setBits, stride, coeffs);
+		}
+
+		return;
+	}
+
+	#pragma omp parallel for if(isParallel(length)) num_threads(threads())
+	for(uint64_t k=0; k<numFree; ++k)
+	{
+		uint64_t i = k;
+
+		for(int j=0; j<numFixed; ++j)
+			i = insertZero(i, fixedBits[j]);
+
+		i |= controlValue & controlMask;
+
+		Complex<T> a0 = states[i];
+		Complex<T> a1 = states[i | stride];
+
+		states[i] = u00 * a0 + u01 * a1;
+		states[i | stride] = u10 * a0 + u11 * a1;
+	}
+}
+
+/* Multi-Qubit Kernels */
+
+template<class T>
+void GateKernels<T>::applyMatrix(Complex<T> *states, uint64_t length, int *qubits, int numQubits, Complex<T> *matrix)
+{
+	// Applies a dense 2^k x 2^k matrix, stored row by row, to k qubits. Bit j
+	// of a row or column index is the bit at qubits[j]. Each group of 2^k
+	// amplitudes the matrix mixes is gathered, multiplied and scattered back.
+	uint64_t dim = 1ULL << numQubits;
+
+	vector<int> sorted(qubits, qubits + numQubits);
+	sort(sorted.begin(), sorted.end());
+
+	vector<uint64_t> offsets(dim, 0);
+
+	for(uint64_t t=0; t<dim; ++t)
+	{
+		for(int j=0; j<numQubits; ++j)
+			offsets[t] |= ((t >> j) & 1) << qubits[j];
+	}
+
+	// Groups that differ only below the lowest qubit sit next to each other,
+	// so up to 16 of them are handled at once with unit stride. With qubit 0
+	// in the set the products are accumulated a column at a time instead.
+	switch(sorted[0])
+	{
+		case 0: break;
+		case 1: applyMatrixLanes<2>(states, length, sorted, offsets, matrix, numQubits); return;
+		case 2: applyMatrixLanes<4>(states, length, sorted, offsets, matrix, numQubits); return;
+		case 3: applyMatrixLanes<8>(states, length, sorted, offsets, matrix, numQubits); return;
+		default: applyMatrixLanes<16>(states, length, sorted, offsets, matrix, numQubits); return;
+	}
+
+	vector<T> colRe(dim * dim), colIm(dim * dim);
+
+	for(uint64_t r=0; r<dim; ++r)
+	{
+		for(uint64_t c=0; c<dim; ++c)
+		{
+			colRe[c * dim + r] = matrix[r * dim + c].getRe();
+			colIm[c * dim + r] = matrix[r * dim + c].getIm();
+		}
+	}
+
+	uint64_t numGroups = length >> numQubits;
+	T *amplitudes = (T *)states;
+
+	#pragma omp parallel if(isParallel(length)) num_threads(threads())
+	{
+		vector<T> outRe(dim), outIm(dim);
+		T *accRe = &outRe[0], *accIm = &outIm[0];
+
+		#pragma omp for
+		for(uint64_t g=0; g<numGroups; ++g)
+		{
+			uint64_t base = g;
+
+			for(int j=0; j<numQubits; ++j)
+				base = insertZero(base, sorted[j]);
+
+			for(uint64_t r=0; r<dim; ++r)
+			{
+				accRe[r] = 0;
+				accIm[r] = 0;
+			}
+
+			for(uint64_t c=0; c<dim; ++c)
+			{
+				T xRe = amplitudes[2 * (base + offsets[c])];
+				T xIm = amplitudes[2 * (base + offsets[c]) + 1];
+				const T *mRe = &colRe[c * dim], *mIm = &colIm[c * dim];
+
+				for(uint64_t r=0; r<dim; ++r)
+				{
+					accRe[r] += mRe[r] * xRe - mIm[r] * xIm;
+					accIm[r] += mRe[r] * xIm + mIm[r] * xRe;
+				}
+			}
+
+			for(uint64_t r=0; r<dim; ++r)
+			{
+				amplitudes[2 * (base + offsets[r])] = accRe[r];
+				amplitudes[2 * (base + offsets[r]) + 1] = accIm[r];
+			}
+		}
+	}
+}
+
+template<class T>
+template<int LANES>
+void GateKernels<T>::applyMatrixLanes(Complex<T> *states, uint64_t length,
+	vector<int> &sorted, vector<uint64_t> &offsets, Complex<T> *matrix, int numQubits)
+{
+	// LANES neighbouring groups at once; needs 2^lowest qubit >= LANES.
+	uint64_t dim = 1ULL << numQubits;
+	uint64_t numChunks = (length >> numQubits) / LANES;
+	T *amplitudes = (T *)states;
+
+	#pragma omp parallel if(isParallel(length)) num_threads(threads())
+	{
+		vector<T> gathered(2 * dim * LANES);
+
+		#pragma omp for
+		for(uint64_t b=0; b<numChunks; ++b)
+		{
+			uint64_t base = b * LANES;
+
+			for(int j=0; j<numQubits; ++j)
+				base = insertZero(base, sorted[j]);
+
+			for(uint64_t c=0; c<dim; ++c)
+			{
+				T *in = amplitudes + 2 * (base + offsets[c]);
+				T *xRe = &gathered[2 * c * LANES], *xIm = xRe + LANES;
+
+				for(int l=0; l<LANES; ++l)
+				{
+					xRe[l] = in[2 * l];
+					xIm[l] = in[2 * l + 1];
+				}
+			}
+
+			for(uint64_t r=0; r<dim; ++r)
+			{
+				T accRe[LANES], accIm[LANES];
+
+				for(int l=0; l<LANES; ++l)
+				{
+					accRe[l] = 0;
+					accIm[l] = 0;
+				}
+
+				for(uint64_t c=0; c<dim; ++c)
+				{
+					T a = matrix[r * dim + c].getRe(), d = matrix[r * dim + c].getIm();
+					const T *xRe = &gathered[2 * c * LANES], *xIm = xRe + LANES;
+
+					for(int l=0; l<LANES; ++l)
+					{
+						accRe[l] += a * xRe[l] - d * xIm[l];
+						accIm[l] += a * xIm[l] + d * xRe[l];
+					}
+				}
+
+				T *out = amplitudes + 2 * (base + offsets[r]);
+
+				for(int l=0; l<LANES; ++l)
+				{
+					out[2 * l] = accRe[l];
+					out[2 * l + 1] = accIm[l];
+				}
+			}
+		}
+	}
+}
+
+template<class T>
+void GateKernels<T>::applySwap(Complex<T> *states, uint64_t length, int qubit1, int qubit2)
+{
+	// Exchanges the amplitudes whose bits at the two qubits read 10 and 01;
+	// a single pass over a quarter of the index space.
+	int low = (qubit1 < qubit2)? qubit1 : qubit2;
+	int high = (qubit1 < qubit2)? qubit2 : qubit1;
+
+	uint64_t bit1 = 1ULL << qubit1, bit2 = 1ULL << qubit2;
+	uint64_t numPairs = length >> 2;
+
+	#pragma omp parallel for if(isParallel(length)) num_threads(threads())
+	for(uint64_t k=0; k<numPairs; ++k)
+	{
+		uint64_t i = insertZero(insertZero(k, low), high);
+
+		Complex<T> a = states[i | bit1];
+		states[i | bit1] = states[i | bit2];
+		states[i | bit2] = a;
+	}
+}
+
+/* Measurement Kernels */
+
+template<class T>
+void GateKernels<T>::probabilities(Complex<T> *states, uint64_t length, int qubit, T *probOfZero, T *probOfOne)
+{
+	// Sums the squared norms on either side of the qubit in one reduction.
+	uint64_t stride = 1ULL << qubit;
+	uint64_t numPairs = length >> 1;
+	T zero = 0, one = 0;
+
+	#pragma omp parallel for reduction(+:zero, one) if(isParallel(length)) num_threads(threads())
+	for(uint64_t k=0; k<numPairs; ++k)
+	{
+		uint64_t i = insertZero(k, qubit);
+
+		zero += states[i].normSq();
+		one += states[i + stride].normSq();
+	}
+
+	*probOfZero = zero;
+	*probOfOne = one;
+}
+
+template<class T>
+void GateKernels<T>::collapse(Complex<T> *states, uint64_t length, int qubit, unsigned int result, T factor)
+{
+	// Zeroes the amplitudes that disagree with the result and rescales the
+	// rest by factor, in one pass over the pairs.
+	uint64_t stride = 1ULL << qubit;
+	uint64_t numPairs = length >> 1;
+	uint64_t keep = (result)? stride : 0;
+	uint64_t drop = stride - keep;
+
+	#pragma omp parallel for if(isParallel(length)) num_threads(threads())
+	for(uint64_t k=0; k<numPairs; ++k)
+	{
+		uint64_t i = insertZero(k, qubit);
+
+		states[i + keep] *= factor;
+		states[i + drop].set(0, 0);
+	}
+}
+
+template<class T>
+void GateKernels<T>::collapseTo(Complex<T> *states, uint64_t length, uint64_t index)
+{
+	// Leaves only the basis state |index⟩, keeping its phase.
+	T norm = states[index].norm();
+	Complex<T> kept = (norm > 0)? states[index] / Complex<T>(norm, 0) : Complex<T>(1, 0);
+
+	#pragma omp parallel for if(isParallel(length)) num_threads(threads())
+	for(uint64_t i=0; i<length; ++i)
+		states[i].set(0, 0);
+
+	states[index] = kept;
+}
+
+/* Sampling Kernels */
+
+template<class T>
+T GateKernels<T>::blockSums(Complex<T> *states, uint64_t length, vector<T> &sums)
+{
+	// Squared norms summed over blocks of BLOCK_SIZE amplitudes; returns the total.
+	uint64_t numBlocks = (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	sums.assign(numBlocks, 0);
+
+	#pragma omp parallel for if(isParallel(length)) num_threads(threads())
+	for(uint64_t b=0; b<numBlocks; ++b)
+	{
+		uint64_t end = (b + 1 < numBlocks)? (b + 1) * BLOCK_SIZE : length;
+		T sum = 0;
+
+		for(uint64_t i=b*BLOCK_SIZE; i<end; ++i)
+			sum += states[i].normSq();
+
+		sums[b] = sum;
+	}
+
+	T total = 0;
+
+	for(uint64_t b=0; b<numBlocks; ++b)
+		total += sums[b];
+
+	return total;
+}
+
+template<class T>
+uint64_t GateKernels<T>::sampleIndex(Complex<T> *states, uint64_t length, T fraction)
+{
+	// Returns the basis state at which the cumulative probability first
+	// exceeds fraction (in [0, 1)) of the total, skipping whole blocks first.
+	vector<T> sums;
+	T target = fraction * blockSums(states, length, sums);
+	uint64_t last = 0;
+
+	for(uint64_t b=0; b<sums.size(); ++b)
+	{
+		uint64_t end = (b + 1 < sums.size())? (b + 1) * BLOCK_SIZE : length;
+
+		if(target >= sums[b])
+		{
+			target -= sums[b];
+			continue;
+		}
+
+		for(uint64_t i=b*BLOCK_SIZE; i<end; ++i)
+		{
+			T p = states[i].normSq();
+
+			if(p == 0)
+				continue;
+
+			if(target < p)
+				return i;
+
+			target -= p;
+			last = i;
+		}
+	}
+
+	// rounding left target just past the end: fall back to the last candidate
+	for(uint64_t i=length; i>0; --i)
+	{
+		if(states[i - 1].normSq() > 0)
+			return i - 1;
+	}
+
+	return last;
+}
+
+template<class T>
+void GateKernels<T>::cumulative(Complex<T> *states, uint64_t length, T *cdf)
+{
+	// Inclusive prefix sum of the squared norms, computed blockwise in parallel.
+	vector<T> sums;
+	blockSums(states, length, sums);
+
+	uint64_t numBlocks = sums.size();
+	vector<T> offsets(numBlocks, 0);
+
+	for(uint64_t b=1; b<numBlocks; ++b)
+		offsets[b] = offsets[b - 1] + sums[b - 1];
+
+	#pragma omp parallel for if(isParallel(length)) num_threads(threads())
+	for(uint64_t b=0; b<numBlocks; ++b)
+	{
+		uint64_t end = (b + 1 < numBlocks)? (b + 1) * BLOCK_SIZE : length;
+		T sum = offsets[b];
+
+		for(uint64_t i=b*BLOCK_SIZE; i<end; ++i)
+		{
+			sum += states[i].normSq();
+			cdf[i] = sum;
+		}
+	}
+}
+
+/* Utilities */
+
+template<class T>
+uint64_t GateKernels<T>::insertZero(uint64_t index, int bit)
+{
+	// Shifts the bits at and above the position up by one, leaving a zero.
+	uint64_t low = index & ((1ULL << bit) - 1);
+
+	return ((index >> bit) << (bit + 1)) | low;
+}
+
+#endif
@@ -0,0 +1,976 @@
+#ifndef QMULATOR_MATRIX_PRODUCT_STATE_HPP
+#define QMULATOR_MATRIX_PRODUCT_STATE_HPP
+
+#include <stdio.h>
+#include <map>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "complex.hpp"
+#include "random_source.hpp"
+#include "matrix.hpp"
+#include "quantum_gates.hpp"
+#include "svd.hpp"
+
+/*
+	Matrix product state for shallow, weakly entangled circuits on many
+	qubits. Each site holds a tensor A[l][s][r] of its left bond, physical
+	index and right bond, and the state is the product of the matrices
+	A[s] picked by the bits of a basis state. Memory grows with the bond
+	dimensions instead of 2^n.
+
+	The tensors are kept in mixed canonical form around one site, the
+	centre, so that a split by SVD at the centre discards exactly the
+	weight of the dropped singular values. A gate on several qubits moves
+	them onto neighbouring sites with swaps (the qubits stay there, so the
+	site of a qubit changes over time), contracts those sites, applies the
+	gate and splits them again, keeping at most maxBond singular values and
+	dropping those whose total weight is below the cutoff. The discarded
+	weight is accumulated so that results can be trusted or not.
+
+	Bitstrings are written qubit n-1 first, as in the state printouts.
+*/
+
+template<class Type>
+class MatrixProductState
+{
+private:
+	unsigned int numQubits;
+
+	// tensors[i] is bonds[i] x 2 x bonds[i + 1], index (l * 2 + s) * right + r
+	vector<vector<Complex<Type> > > tensors;
+	vector<int> bonds;
+	vector<int> siteOf;
+	vector<int> qubitAt;
+	int centre;
+
+	int maxBond;
+	Type cutoff;
+	Type discarded;
+	Type fidelityEstimate;
+
+	vector<int> measurement;
+	RandomSource<Type> generator;
+
+	QuantumGates<Type> gate;
+
+	void applySingle(Matrix<Type> &, int);
+	void applyGate(Matrix<Type> &, vector<int>);
+	void applyWindow(Matrix<Type> &, vector<int> &, int);
+	void swapSites(int);
+	void moveCentre(int);
+	void split(vector<Complex<Type> > &, int, int, int);
+	int keep(vector<Type> &);
+
+	Matrix<Type> controlled(int, int, Matrix<Type> &);
+	string bitstring(vector<int> &);
+
+	void barf(string, string);
+
+public:
+	static const int DEFAULT_MAX_BOND = 64;
+
+	/* Constructor */
+	MatrixProductState(int);
+
+	/* Quantum Logic Gates */
+	void H(int);
+	void X(int);
+	void Y(int);
+	void Z(int);
+	void T(int);
+	void S(int);
+	void U(Matrix<Type>, int);
+	void U(Matrix<Type>, vector<int>);
+
+	unsigned int Measure(int);
+	string MeasureAll();
+	map<string, unsigned int> Sample(unsigned int);
+
+	void MCU(vector<int>, int, Matrix<Type>);
+	void MCU(vector<int>, vector<int>, int, Matrix<Type>);
+	void CNOT(int, int);
+	void CY(int, int);
+	void CZ(int, int);
+	void Toffoli(int, int, int);
+
+	void Swap(int, int);
+
+	/* Truncation */
+	void setMaxBond(int);
+	void setCutoff(Type);
+	Type truncationError();
+	Type fidelity();
+	int bondDimension();
+	vector<int> bondDimensions();
+
+	/* Utilities */
+	Complex<Type> amplitude(string);
+	Complex<Type> amplitude(uint64_t);
+	int getMeasurement(int);
+	vector<int> getMeasurements();
+	unsigned int size();
+	uint64_t bytes();
+	void setRandomSeed(uint64_t);
+	void print();
+};
+
+template<class Type>
+const int MatrixProductState<Type>::DEFAULT_MAX_BOND;
+
+/* Constructor */
+
+template<class Type>
+MatrixProductState<Type>::MatrixProductState(int qubits)
+{
+	if(qubits < 1)
+		barf("MatrixProductState", "at least one qubit required");
+
+	numQubits = qubits;
+
+	// |0...0⟩ is a product state, every bond of dimension one
+	tensors.assign(numQubits, vector<Complex<Type> >(2, Complex<Type>(0, 0)));
+	bonds.assign(numQubits + 1, 1);
+
+	for(int i=0; i<numQubits; ++i)
+	{
+		tensors.at(i).at(0) = Complex<Type>(1, 0);
+		siteOf.push_back(i);
+		qubitAt.push_back(i);
+	}
+
+	centre = 0;
+	maxBond = DEFAULT_MAX_BOND;
+	cutoff = numeric_limits<Type>::epsilon();
+	discarded = 0;
+	fidelityEstimate = 1;
+
+	measurement.assign(numQubits, -1);
+}
+
+template<class Type>
+void MatrixProductState<Type>::barf(string function, string message)
+{
+	cout << "[error] " << "<" << function << ">";
+	cout << " " << message << endl;
+	exit(1);
+}
+
+/* Tensor Updates */
+
+template<class Type>
+void MatrixProductState<Type>::applySingle(Matrix<Type> &u, int qubit)
+{
+	// A[l][s'][r] = Σ_s u[s'][s] A[l][s][r]; a unitary on the physical index
+	// leaves the canonical form intact, so no SVD is needed.
+	vector<Complex<Type> > &a = tensors.at(siteOf.at(qubit));
+	int right = bonds.at(siteOf.at(qubit) + 1);
+
+	Complex<Type> u00 = u.get(0, 0), u01 = u.get(0, 1);
+	Complex<Type> u10 = u.get(1, 0), u11 = u.get(1, 1);
+
+	for(int l=0; l<bonds.at(siteOf.at(qubit)); ++l)
+	{
+		Complex<Type> *zero = &a[(uint64_t)(2 * l) * right];
+		Complex<Type> *one = zero + right;
+
+		for(int r=0; r<right; ++r)
+		{
+			Complex<Type> a0 = zero[r], a1 = one[r];
+			zero[r] = u00 * a0 + u01 * a1;
+			one[r] = u10 * a0 + u11 * a1;
+		}
+	}
+}
+
+template<class Type>
+void MatrixProductState<Type>::applyGate(Matrix<Type> &u, vector<int> qubits)
+{
+	// Gathers the qubits onto neighbouring sites around their median, then
+	// applies u to that window. Bit j of u's index is qubits[j].
+	int k = qubits.size();
+
+	if(k == 1)
+	{
+		applySingle(u, qubits.at(0));
+		return;
+	}
+
+	vector<int> sites;
+
+	for(int j=0; j<k; ++j)
+		sites.push_back(siteOf.at(qubits.at(j)));
+
+	sort(sites.begin(), sites.end());
+
+	// the window start minimising the swaps is the median of sites[j] - j
+	vector<int> offsets;
+
+	for(int j=0; j<k; ++j)
+		offsets.push_back(sites.at(j) - j);
+
+	nth_element(offsets.begin(), offsets.begin() + k / 2, offsets.end());
+	int window = offsets.at(k / 2);
+
+	// qubits right of their place move left in increasing order and those
+	// left of it move right in decreasing order, so none cross each other
+	for(int j=0; j<k; ++j)
+	{
+		for(int s=sites.at(j); s>window+j; --s)
+			swapSites(s - 1);
+	}
+
+	for(int j=k-1; j>=0; --j)
+	{
+		for(int s=sites.at(j); s<window+j; ++s)
+			swapSites(s);
+	}
+
+	applyWindow(u, qubits, window);
+}
+
+template<class Type>
+void MatrixProductState<Type>::swapSites(int site)
+{
+	// Exchanges the qubits on site and site + 1 with a two-site SWAP.
+	Matrix<Type> swap(4, 4);
+	swap.set(0, 0, 1, 0);
+	swap.set(1, 2, 1, 0);
+	swap.set(2, 1, 1, 0);
+	swap.set(3, 3, 1, 0);
+
+	vector<int> pair;
+	pair.push_back(qubitAt.at(site));
+	pair.push_back(qubitAt.at(site + 1));
+
+	applyWindow(swap, pair, site);
+
+	std::swap(qubitAt.at(site), qubitAt.at(site + 1));
+	siteOf.at(qubitAt.at(site)) = site;
+	siteOf.at(qubitAt.at(site + 1)) = site + 1;
+}
+
+template<class Type>
+void MatrixProductState<Type>::applyWindow(Matrix<Type> &u, vector<int> &qubits, int window)
+{
+	// Contracts the k sites from window on into theta[l][s_0 ... s_k-1][r],
+	// s_0 being the most significant, applies u and splits theta back into
+	// k tensors. The centre ends on the last site of the window.
+	int k = qubits.size();
+	uint64_t dim = 1ULL << k;
+
+	moveCentre(window);
+
+	int left = bonds.at(window);
+	int right = bonds.at(window + k);
+
+	// theta as left x (2 x rest) x right, grown one site at a time
+	vector<Complex<Type> > theta = tensors.at(window);
+	int inner = 2;
+
+	for(int i=1; i<k; ++i)
+	{
+		vector<Complex<Type> > &a = tensors.at(window + i);
+		int middle = bonds.at(window + i);
+		int next = bonds.at(window + i + 1);
+
+		vector<Complex<Type> > grown((uint64_t)left * inner * 2 * next, Complex<Type>(0, 0));
+
+		for(uint64_t row=0; row<(uint64_t)left * inner; ++row)
+		{
+			for(int m=0; m<middle; ++m)
+			{
+				Complex<Type> x = theta[row * middle + m];
+
+				if(x.getRe() == 0 && x.getIm() == 0)
+					continue;
+
+				Complex<Type> *from = &a[(uint64_t)m * 2 * next];
+				Complex<Type> *to = &grown[row * 2 * next];
+
+				for(int c=0; c<2*next; ++c)
+					to[c] += x * from[c];
+			}
+		}
+
+		theta.swap(grown);
+		inner *= 2;
+	}
+
+	// physical digit of gate bit j: the site of qubits[j] counted from the
+	// left of the window, window site i being bit k - 1 - i of the index
+	vector<int> shift(k);
+
+	for(int j=0; j<k; ++j)
+		shift.at(j) = k - 1 - (siteOf.at(qubits.at(j)) - window);
+
+	vector<uint64_t> physical(dim);
+
+	for(uint64_t g=0; g<dim; ++g)
+	{
+		physical.at(g) = 0;
+
+		for(int j=0; j<k; ++j)
+			physical.at(g) |= ((g >> j) & 1) << shift.at(j);
+	}
+
+	vector<Complex<Type> > result(theta.size(), Complex<Type>(0, 0));
+
+	for(int l=0; l<left; ++l)
+	{
+		for(uint64_t row=0; row<dim; ++row)
+		{
+			Complex<Type> *to = &result[((uint64_t)l * dim + physical.at(row)) * right];
+
+			for(uint64_t col=0; col<dim; ++col)
+			{
+				Complex<Type> entry = u.get(row, col);
+
+				if(entry.getRe() == 0 && entry.getIm() == 0)
+					continue;
+
+				Complex<Type> *from = &theta[((uint64_t)l * dim + physical.at(col)) * right];
+
+				for(int r=0; r<right; ++r)
+					to[r] += entry * from[r];
+			}
+		}
+	}
+
+	split(result, window, k, left);
+}
+
+template<class Type>
+void MatrixProductState<Type>::split(vector<Complex<Type> > &theta, int window, int k, int left)
+{
+	// Peels one site off the left of theta at a time: theta as
+	// (left x 2) x (rest x right) = U S V†, the site keeps U and the rest
+	// carries on as S V†, so every site but the last is left-canonical.
+	vector<Complex<Type> > u, v;
+	vector<Type> s;
+
+	for(int i=0; i<k-1; ++i)
+	{
+		int rows = left * 2;
+		int cols = (int)(theta.size() / rows);
+
+		SVD<Type>::compute(rows, cols, theta.data(), u, s, v);
+
+		int full = s.size();
+		int kept = keep(s);
+
+		vector<Complex<Type> > &a = tensors.at(window + i);
+		a.resize((uint64_t)rows * kept);
+
+		for(int r=0; r<rows; ++r)
+		{
+			for(int j=0; j<kept; ++j)
+				a[(uint64_t)r * kept + j] = u[(uint64_t)r * full + j];
+		}
+
+		theta.assign((uint64_t)kept * cols, Complex<Type>(0, 0));
+
+		for(int j=0; j<kept; ++j)
+		{
+			for(int c=0; c<cols; ++c)
+			{
+				Complex<Type> x = v[(uint64_t)c * full + j];
+				theta[(uint64_t)j * cols + c] = Complex<Type>(x.getRe(), -x.getIm()) * s.at(j);
+			}
+		}
+
+		bonds.at(window + i + 1) = kept;
+		left = kept;
+	}
+
+	tensors.at(window + k - 1) = theta;
+	centre = window + k - 1;
+}
+
+template<class Type>
+int MatrixProductState<Type>::keep(vector<Type> &s)
+{
+	// Number of singular values kept: at most maxBond, dropping from the
+	// smallest while their weight stays within the cutoff. The kept values
+	// are rescaled to the original norm and the dropped weight recorded.
+	Type total = 0;
+
+	for(int j=0; j<s.size(); ++j)
+		total += s.at(j) * s.at(j);
+
+	if(total == 0)
+		return 1;
+
+	int kept = s.size();
+	Type dropped = 0;
+
+	while(kept > 1)
+	{
+		Type weight = s.at(kept - 1) * s.at(kept - 1);
+
+		if(kept <= maxBond && dropped + weight > cutoff * total)
+			break;
+
+		dropped += weight;
+		--kept;
+	}
+
+	if(dropped > 0)
+	{
+		Type scale = sqrt(total / (total - dropped));
+
+		for(int j=0; j<kept; ++j)
+			s.at(j) *= scale;
+
+		discarded += dropped / total;
+		fidelityEstimate *= 1 - dropped / total;
+	}
+
+	return kept;
+}
+
+template<class Type>
+void MatrixProductState<Type>::moveCentre(int site)
+{
+	// Shifts the orthogonality centre one bond at a time by SVD without
+	// truncation beyond the cutoff: moving right the site keeps U and its
+	// neighbour absorbs S V†, moving left the site keeps V† and its
+	// neighbour absorbs U S.
+	vector<Complex<Type> > u, v;
+	vector<Type> s;
+
+	while(centre < site)
+	{
+		vector<Complex<Type> > &a = tensors.at(centre);
+		vector<Complex<Type> > &b = tensors.at(centre + 1);
+		int rows = bonds.at(centre) * 2;
+		int cols = bonds.at(centre + 1);
+		int next = bonds.at(centre + 2);
+
+		SVD<Type>::compute(rows, cols, a.data(), u, s, v);
+
+		int full = s.size();
+		int kept = keep(s);
+
+		a.resize((uint64_t)rows * kept);
+
+		for(int r=0; r<rows; ++r)
+		{
+			for(int j=0; j<kept; ++j)
+				a[(uint64_t)r * kept + j] = u[(uint64_t)r * full + j];
+		}
+
+		// b' [j][t] = Σ_c s_j conj(v[c][j]) b[c][t]
+		vector<Complex<Type> > absorbed((uint64_t)kept * 2 * next, Complex<Type>(0, 0));
+
+		for(int j=0; j<kept; ++j)
+		{
+			for(int c=0; c<cols; ++c)
+			{
+				Complex<Type> x = v[(uint64_t)c * full + j];
+				Complex<Type> factor = Complex<Type>(x.getRe(), -x.getIm()) * s.at(j);
+
+				for(int t=0; t<2*next; ++t)
+					absorbed[(uint64_t)j * 2 * next + t] += factor * b[(uint64_t)c * 2 * next + t];
+			}
+		}
+
+		b.swap(absorbed);
+		bonds.at(centre + 1) = kept;
+		++centre;
+	}
+
+	while(centre > site)
+	{
+		vector<Complex<Type> > &a = tensors.at(centre);
+		vector<Complex<Type> > &b = tensors.at(centre - 1);
+		int rows = bonds.at(centre);
+		int cols = 2 * bonds.at(centre + 1);
+		int previous = bonds.at(centre - 1);
+
+		SVD<Type>::compute(rows, cols, a.data(), u, s, v);
+
+		int full = s.size();
+		int kept = keep(s);
+
+		a.assign((uint64_t)kept * cols, Complex<Type>(0, 0));
+
+		for(int j=0; j<kept; ++j)
+		{
+			for(int c=0; c<cols; ++c)
+			{
+				Complex<Type> x = v[(uint64_t)c * full + j];
+				a[(uint64_t)j * cols + c] = Complex<Type>(x.getRe(), -x.getIm());
+			}
+		}
+
+		// b'[p][j] = Σ_r b[p][r] u[r][j] s_j
+		vector<Complex<Type> > absorbed((uint64_t)previous * 2 * kept, Complex<Type>(0, 0));
+
+		for(uint64_t p=0; p<(uint64_t)previous * 2; ++p)
+		{
+			for(int r=0; r<rows; ++r)
+			{
+				Complex<Type> x = b[p * rows + r];
+
+				for(int j=0; j<kept; ++j)
+					absorbed[p * kept + j] += x * u[(uint64_t)r * full + j] * s.at(j);
+			}
+		}
+
+		b.swap(absorbed);
+		bonds.at(centre) = kept;
+		--centre;
+	}
+}
+
+template<class Type>
+Matrix<Type> MatrixProductState<Type>::controlled(int numControls, int numOpenControls, Matrix<Type> &u)
+{
+	// Full matrix of u on the last bit, applied when the first numControls
+	// bits are 1 and the next numOpenControls bits are 0.
+	int k = numControls + numOpenControls + 1;
+	uint64_t dim = 1ULL << k;
+	uint64_t half = dim / 2;
+	uint64_t value = (1ULL << numControls) - 1;
+
+	Matrix<Type> full(dim, dim);
+
+	for(uint64_t i=0; i<dim; ++i)
+		full.set(i, i, 1, 0);
+
+	for(int r=0; r<2; ++r)
+	{
+		for(int c=0; c<2; ++c)
+		{
+			Complex<Type> entry = u.get(r, c);
+			full.set(value | r * half, value | c * half, entry.getRe(), entry.getIm());
+		}
+	}
+
+	return full;
+}
+
+/* Quantum Logic Gates */
+
+template<class Type>
+void MatrixProductState<Type>::H(int qubit)
+{
+	Matrix<Type> u = gate.Hadamard();
+	U(u, qubit);
+}
+
+template<class Type>
+void MatrixProductState<Type>::X(int qubit)
+{
+	Matrix<Type> u = gate.Pauli_X();
+	U(u, qubit);
+}
+
+template<class Type>
+void MatrixProductState<Type>::Y(int qubit)
+{
+	Matrix<Type> u = gate.Pauli_Y();
+	U(u, qubit);
+}
+
+template<class Type>
+void MatrixProductState<Type>::Z(int qubit)
+{
+	Matrix<Type> u = gate.Pauli_Z();
+	U(u, qubit);
+}
+
+template<class Type>
+void MatrixProductState<Type>::T(int qubit)
+{
+	Matrix<Type> u = gate.PhaseShift(M_PI / 4);
+	U(u, qubit);
+}
+
+template<class Type>
+void MatrixProductState<Type>::S(int qubit)
+{
+	Matrix<Type> u = gate.PhaseShift(M_PI / 2);
+	U(u, qubit);
+}
+
+template<class Type>
+void MatrixProductState<Type>::U(Matrix<Type> u, int qubit)
+{
+	if(qubit < 0 || qubit >= numQubits)
+		barf("U", "qubit out of range");
+
+	if(u.rows() != 2 || u.cols() != 2)
+		barf("U", "2 x 2 matrix expected");
+
+	applySingle(u, qubit);
+}
+
+template<class Type>
+void MatrixProductState<Type>::U(Matrix<Type> u, vector<int> qubits)
+{
+	// Bit j of the matrix index is qubits[j], as for Qubits.
+	if(qubits.empty() || u.rows() != (1ULL << qubits.size()) || u.cols() != u.rows())
+		barf("U", "2^k x 2^k matrix expected for k qubits");
+
+	for(int j=0; j<qubits.size(); ++j)
+	{
+		if(qubits.at(j) < 0 || qubits.at(j) >= numQubits)
+			barf("U", "qubit out of range");
+
+		for(int i=0; i<j; ++i)
+		{
+			if(qubits.at(i) == qubits.at(j))
+				barf("U", "qubits must be distinct");
+		}
+	}
+
+	applyGate(u, qubits);
+}
+
+template<class Type>
+void MatrixProductState<Type>::MCU(vector<int> controls, int target, Matrix<Type> u)
+{
+	MCU(controls, vector<int>(), target, u);
+}
+
+template<class Type>
+void MatrixProductState<Type>::MCU(vector<int> controls, vector<int> openControls, int target, Matrix<Type> u)
+{
+	vector<int> qubits = controls;
+	qubits.insert(qubits.end(), openControls.begin(), openControls.end());
+	qubits.push_back(target);
+
+	U(controlled(controls.size(), openControls.size(), u), qubits);
+}
+
+template<class Type>
+void MatrixProductState<Type>::CNOT(int control, int target)
+{
+	MCU(vector<int>(1, control), target, gate.Pauli_X());
+}
+
+template<class Type>
+void MatrixProductState<Type>::CY(int control, int target)
+{
+	MCU(vector<int>(1, control), target, gate.Pauli_Y());
+}
+
+template<class Type>
+void MatrixProductState<Type>::CZ(int control, int target)
+{
+	MCU(vector<int>(1, control), target, gate.Pauli_Z());
+}
+
+template<class Type>
+void MatrixProductState<Type>::Toffoli(int control1, int control2, int target)
+{
+	vector<int> controls;
+	controls.push_back(control1);
+	controls.push_back(control2);
+
+	MCU(controls, target, gate.Pauli_X());
+}
+
+template<class Type>
+void MatrixProductState<Type>::Swap(int qubit1, int qubit2)
+{
+	// Relabels the two sites; the tensors stay where they are.
+	if(qubit1 < 0 || qubit1 >= numQubits || qubit2 < 0 || qubit2 >= numQubits)
+		barf("Swap", "qubit out of range");
+
+	std::swap(siteOf.at(qubit1), siteOf.at(qubit2));
+	qubitAt.at(siteOf.at(qubit1)) = qubit1;
+	qubitAt.at(siteOf.at(qubit2)) = qubit2;
+}
+
+/* Measurement */
+
+template<class Type>
+unsigned int MatrixProductState<Type>::Measure(int qubit)
+{
+	// With the centre on the qubit's site its outcome probabilities are
+	// local: the weights of the two physical slices.
+	if(qubit < 0 || qubit >= numQubits)
+		barf("Measure", "qubit out of range");
+
+	int site = siteOf.at(qubit);
+	moveCentre(site);
+
+	vector<Complex<Type> > &a = tensors.at(site);
+	int right = bonds.at(site + 1);
+	Type weights[2] = {0, 0};
+
+	for(int l=0; l<bonds.at(site); ++l)
+	{
+		for(int s=0; s<2; ++s)
+		{
+			for(int r=0; r<right; ++r)
+				weights[s] += a[((uint64_t)l * 2 + s) * right + r].normSq();
+		}
+	}
+
+	unsigned int result = (generator.uniform() * (weights[0] + weights[1]) < weights[0])? 0 : 1;
+
+	if(weights[result] <= 0)
+		result ^= 1;
+
+	Type factor = 1 / sqrt(weights[result]);
+
+	for(int l=0; l<bonds.at(site); ++l)
+	{
+		for(int s=0; s<2; ++s)
+		{
+			for(int r=0; r<right; ++r)
+			{
+				Complex<Type> &x = a[((uint64_t)l * 2 + s) * right + r];
+				x = (s == result)? x * factor : Complex<Type>(0, 0);
+			}
+		}
+	}
+
+	measurement.at(qubit) = result;
+
+	return result;
+}
+
+template<class Type>
+map<string, unsigned int> MatrixProductState<Type>::Sample(unsigned int shots)
+{
+	// Draws outcomes without collapsing. With the centre on the first site
+	// every other site is right-canonical, so the conditional probability of
+	// each next bit is the weight of the boundary vector times that slice.
+	map<string, unsigned int> counts;
+
+	moveCentre(0);
+
+	vector<int> bits(numQubits);
+	vector<Complex<Type> > boundary, next[2];
+
+	for(unsigned int shot=0; shot<shots; ++shot)
+	{
+		boundary.assign(1, Complex<Type>(1, 0));
+
+		for(int i=0; i<numQubits; ++i)
+		{
+			vector<Complex<Type> > &a = tensors.at(i);
+			int right = bonds.at(i + 1);
+			Type weights[2] = {0, 0};
+
+			for(int s=0; s<2; ++s)
+			{
+				next[s].assign(right, Complex<Type>(0, 0));
+
+				for(int l=0; l<bonds.at(i); ++l)
+				{
+					for(int r=0; r<right; ++r)
+						next[s][r] += boundary[l] * a[((uint64_t)l * 2 + s) * right + r];
+				}
+
+				for(int r=0; r<right; ++r)
+					weights[s] += next[s][r].normSq();
+			}
+
+			int bit = (generator.uniform() * (weights[0] + weights[1]) < weights[0])? 0 : 1;
+
+			if(weights[bit] <= 0)
+				bit ^= 1;
+
+			Type factor = 1 / sqrt(weights[bit]);
+
+			boundary.resize(right);
+
+			for(int r=0; r<right; ++r)
+				boundary[r] = next[bit][r] * factor;
+
+			bits.at(qubitAt.at(i)) = bit;
+		}
+
+		++counts[bitstring(bits)];
+	}
+
+	return counts;
+}
+
+template<class Type>
+string MatrixProductState<Type>::MeasureAll()
+{
+	// One sample, after which the state is that basis state.
+	string outcome = Sample(1).begin()->first;
+
+	for(int q=0; q<numQubits; ++q)
+	{
+		int bit = outcome.at(numQubits - 1 - q) - '0';
+		int site = siteOf.at(q);
+
+		tensors.at(site).assign(2, Complex<Type>(0, 0));
+		tensors.at(site).at(bit) = Complex<Type>(1, 0);
+		measurement.at(q) = bit;
+	}
+
+	bonds.assign(numQubits + 1, 1);
+
+	return outcome;
+}
+
+/* Truncation */
+
+template<class Type>
+void MatrixProductState<Type>::setMaxBond(int bond)
+{
+	// Largest bond dimension kept by any split.
+	if(bond < 1)
+		barf("setMaxBond", "bond dimension must be positive");
+
+	maxBond = bond;
+}
+
+template<class Type>
+void MatrixProductState<Type>::setCutoff(Type weight)
+{
+	// Relative weight of singular values that may be dropped at each split.
+	cutoff = weight;
+}
+
+template<class Type>
+Type MatrixProductState<Type>::truncationError()
+{
+	// Sum of the relative weights dropped so far; the squared distance to
+	// the untruncated state is at most about twice this.
+	return discarded;
+}
+
+template<class Type>
+Type MatrixProductState<Type>::fidelity()
+{
+	// Product of the weights kept at every split, an estimate of the
+	// overlap |⟨exact|state⟩|^2.
+	return fidelityEstimate;
+}
+
+template<class Type>
+int MatrixProductState<Type>::bondDimension()
+{
+	return *max_element(bonds.begin(), bonds.end());
+}
+
+template<class Type>
+vector<int> MatrixProductState<Type>::bondDimensions()
+{
+	// Dimensions of the numQubits - 1 inner bonds, left to right by site.
+	return vector<int>(bonds.begin() + 1, bonds.end() - 1);
+}
+
+/* Utilities */
+
+template<class Type>
+string MatrixProductState<Type>::bitstring(vector<int> &bits)
+{
+	string result;
+
+	for(int q=numQubits-1; q>=0; --q)
+		result.push_back('0' + bits.at(q));
+
+	return result;
+}
+
+template<class Type>
+Complex<Type> MatrixProductState<Type>::amplitude(string bits)
+{
+	// ⟨bits|ψ⟩ from the product of the selected slices, qubit n-1 first.
+	if(bits.size() != numQubits)
+		barf("amplitude", "one bit per qubit expected");
+
+	vector<Complex<Type> > boundary(1, Complex<Type>(1, 0)), next;
+
+	for(int i=0; i<numQubits; ++i)
+	{
+		vector<Complex<Type> > &a = tensors.at(i);
+		int right = bonds.at(i + 1);
+		int s = bits.at(numQubits - 1 - qubitAt.at(i)) - '0';
+
+		if(s != 0 && s != 1)
+			barf("amplitude", "bits must be 0 or 1");
+
+		next.assign(right, Complex<Type>(0, 0));
+
+		for(int l=0; l<bonds.at(i); ++l)
+		{
+			for(int r=0; r<right; ++r)
+				next[r] += boundary[l] * a[((uint64_t)l * 2 + s) * right + r];
+		}
+
+		boundary.swap(next);
+	}
+
+	return boundary.at(0);
+}
+
+template<class Type>
+Complex<Type> MatrixProductState<Type>::amplitude(uint64_t index)
+{
+	// Bit q of the index is qubit q, as for Qubits.
+	if(numQubits > 64)
+		barf("amplitude", "index form limited to 64 qubits");
+
+	vector<int> bits(numQubits);
+
+	for(int q=0; q<numQubits; ++q)
+		bits.at(q) = (index >> q) & 1;
+
+	return amplitude(bitstring(bits));
+}
+
+template<class Type>
+int MatrixProductState<Type>::getMeasurement(int qubit)
+{
+	return measurement.at(qubit);
+}
+
+template<class Type>
+vector<int> MatrixProductState<Type>::getMeasurements()
+{
+	return measurement;
+}
+
+template<class Type>
+unsigned int MatrixProductState<Type>::size()
+{
+	return numQubits;
+}
+
+template<class Type>
+uint64_t MatrixProductState<Type>::bytes()
+{
+	// Memory held by the tensors.
+	uint64_t total = 0;
+
+	for(int i=0; i<numQubits; ++i)
+		total += tensors.at(i).size() * sizeof(Complex<Type>);
+
+	return total;
+}
+
+template<class Type>
+void MatrixProductState<Type>::setRandomSeed(uint64_t seed)
+{
+	generator.seed(seed);
+}
+
+template<class Type>
+void MatrixProductState<Type>::print()
+{
+	printf("%u qubits, bond dimension %d, %llu bytes, truncation error %g\n", numQubits,
+		bondDimension(), (unsigned long long)bytes(), (double)discarded);
+
+	printf("Bonds:");
+
+	for(int i=1; i<numQubits; ++i)
+		printf(" %d", bonds.at(i));
+
+	printf("\n");
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef QMULATOR_PHASE_BUFFER_HPP
+#define QMULATOR_PHASE_BUFFER_HPP
+
+#include <vector>
+#include <stdint.h>
+#include "complex.hpp"
+
+/*
+	Collects consecutive diagonal gates so that they can be applied in a
+	single sweep. Diagonal gates commute, so their product is a table of
+	phases indexed by the bits of the qubits they act on. Entry t of the
+	table multiplies every amplitude whose bit qubits[j] equals bit j of t.
+*/
+
+template<class T>
+class PhaseBuffer
+{
+private:
+	vector<int> qubits;
+	vector<Complex<T> > table;
+	int maxWidth;
+	int numGates;
+
+	int position(int);
+
+public:
+	static const int DEFAULT_WIDTH = 10;
+
+	PhaseBuffer();
+
+	bool add(vector<int>, vector<Complex<T> >);
+	void clear();
+
+	bool isEmpty() { return numGates == 0; }
+	int gates() { return numGates; }
+	int width() { return qubits.size(); }
+	void setMaxWidth(int width) { maxWidth = width; }
+
+	int* qubitList() { return &qubits.at(0); }
+	Complex<T>* phases() { return &table.at(0); }
+};
+
+template<class T>
+PhaseBuffer<T>::PhaseBuffer()
+{
+	maxWidth = DEFAULT_WIDTH;
+	clear();
+}
+
+template<class T>
+int PhaseBuffer<T>::position(int qubit)
+{
+	for(int i=0; i<qubits.size(); ++i)
+	{
+		if(qubits.at(i) == qubit)
+			return i;
+	}
+
+	return -1;
+}
+
+template<class T>
+bool PhaseBuffer<T>::add(vector<int> gateQubits, vector<Complex<T> > diagonal)
+{
+	// Entry l of diagonal is the phase for the basis state whose bit j equals
+	// bit j of l on gateQubits. Returns false if the table would grow beyond
+	// maxWidth qubits, leaving the buffer unchanged.
+	int numNew = 0;
+
+	for(int j=0; j<gateQubits.size(); ++j)
+	{
+		if(position(gateQubits.at(j)) < 0)
+			++numNew;
+	}
+
+	if(qubits.size() + numNew > maxWidth)
+		return false;
+
+	for(int j=0; j<gateQubits.size(); ++j)
+	{
+		if(position(gateQubits.at(j)) >= 0)
+			continue;
+
+		// a new qubit leaves existing phases unchanged for both of its values
+		uint64_t size = table.size();
+
+		qubits.push_back(gateQubits.at(j));
+		table.resize(2 * size);
+
+		for(uint64_t t=0; t<size; ++t)
+			table.at(t + size) = table.at(t);
+	}
+
+	vector<int> positions;
+
+	for(int j=0; j<gateQubits.size(); ++j)
+		positions.push_back(position(gateQubits.at(j)));
+
+	for(uint64_t t=0; t<table.size(); ++t)
+	{
+		uint64_t local = 0;
+
+		for(int j=0; j<positions.size(); ++j)
+			local |= ((t >> positions.at(j)) & 1) << j;
+
+		table.at(t) *= diagonal.at(local);
+	}
+
+	++numGates;
+
+	return true;
+}
+
+template<class T>
+void PhaseBuffer<T>::clear()
+{
+	qubits.clear();
+	table.assign(1, Complex<T>(1, 0));
+	numGates = 0;
+}
+
+#endif
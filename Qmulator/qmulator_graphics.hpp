@@ -4,6 +4,7 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include "circuit.hpp"
 
 class QmulatorGraphics
 {
@@ -16,6 +17,7 @@ public:
 		SINGLE_QUBIT = 100,
 		TWO_QUBITS = 200,
 		THREE_QUBITS = 300,
+		MULTI_QUBIT = 350,
 		MEASURE = 400,
 	};
 
@@ -24,12 +26,7 @@ public:
 	~QmulatorGraphics();
 	void initialise(int);
 
-	void add(gateType);
-	void add(int, string, gateType);
-	void add(int, int, string, gateType);
-	void add(int, int, string, string, gateType);
-	void add(int, int, string, string, string, gateType);
-	void add(vector<int>, vector<string>, gateType);
+	void attach(vector<Operation> *);
 
 	void newLine(int);
 
@@ -38,6 +35,8 @@ public:
 	void save(string);
 
 private:
+	vector<Operation> *operations;
+
 	struct logger
 	{
 		vector<vector<int> > pos;
@@ -45,6 +44,9 @@ private:
 		vector<gateType> options;
 	} logger;
 
+	void add(vector<int>, vector<string>, gateType);
+	void add(Operation &);
+
 	vector<vector<string> > map;
 	bool *isClassical;
 
@@ -67,11 +69,14 @@ private:
 
 QmulatorGraphics::QmulatorGraphics()
 {
-
+	operations = NULL;
+	isClassical = NULL;
 }
 
 QmulatorGraphics::QmulatorGraphics(int qubits)
 {
+	operations = NULL;
+	isClassical = NULL;
 	initialise(qubits);
 }
 
@@ -95,65 +100,80 @@ void QmulatorGraphics::initialise(int qubits)
 	VERTICAL_LINE = "\u2502";
 }
 
-void QmulatorGraphics::add(gateType type)
-{
-	vector<int> vecPos;
-	vecPos.push_back(0);
-
-	vector<string> vecGate;
-	vecGate.push_back("NULL");
-
-	add(vecPos, vecGate, type);
-}
-
-void QmulatorGraphics::add(int pos, string gate, gateType type)
+void QmulatorGraphics::attach(vector<Operation> *ops)
 {
-	vector<int> vecPos;
-	vecPos.push_back(pos);
-
-	vector<string> vecGate;
-	vecGate.push_back(gate);
-
-	add(vecPos, vecGate, type);
-}
-
-void QmulatorGraphics::add(int pos1, int pos2, string gate, gateType type)
-{
-	vector<int> vecPos;
-	vecPos.push_back(pos1);
-	vecPos.push_back(pos2);
-
-	vector<string> vecGate;
-	vecGate.push_back(gate);
-
-	add(vecPos, vecGate, type);
+	// The diagram is drawn from the operations recorded by a circuit.
+	operations = ops;
 }
 
-void QmulatorGraphics::add(int pos1, int pos2, string gate1, string gate2, gateType type)
+void QmulatorGraphics::add(Operation &op)
 {
-	vector<int> vecPos;
-	vecPos.push_back(pos1);
-	vecPos.push_back(pos2);
-
-	vector<string> vecGate;
-	vecGate.push_back(gate1);
-	vecGate.push_back(gate2);
-
-	add(vecPos, vecGate, type);
-}
+	// Translates an operation into the positions and labels of the diagram.
+	vector<string> gates;
 
-void QmulatorGraphics::add(int pos1, int pos2, string gate1, string gate2, string gate3, gateType type)
-{
-	vector<int> vecPos;
-	vecPos.push_back(pos1);
-	vecPos.push_back(pos2);
-
-	vector<string> vecGate;
-	vecGate.push_back(gate1);
-	vecGate.push_back(gate2);
-	vecGate.push_back(gate3);
+	switch(op.type)
+	{
+		case Operation::H: gates.push_back("H"); break;
+		case Operation::X: gates.push_back("X"); break;
+		case Operation::Y: gates.push_back("Y"); break;
+		case Operation::Z: gates.push_back("Z"); break;
+		case Operation::T: gates.push_back("T"); break;
+		case Operation::S: gates.push_back("S"); break;
+		case Operation::U: gates.push_back("U"); break;
+		case Operation::PHASE: gates.push_back("P"); break;
+
+		case Operation::CNOT: gates.push_back("*"); gates.push_back("@"); break;
+		case Operation::CY: gates.push_back("*"); gates.push_back("Y"); break;
+		case Operation::CZ: gates.push_back("*"); gates.push_back("Z"); break;
+		case Operation::SWAP: gates.push_back("x"); gates.push_back("x"); break;
+		case Operation::TOFFOLI: gates.push_back("*"); gates.push_back("*"); gates.push_back("@"); break;
+
+		case Operation::MCU:
+			for(int i=0; i<op.qubits.size() - 1; i++)
+				gates.push_back((i < op.numControls)? "*" : "o");
+			gates.push_back("U");
+			break;
+
+		case Operation::UNITARY:
+			gates.assign(op.qubits.size(), "U");
+			break;
+
+		case Operation::MEASURE:
+			add(op.qubits, vector<string>(1, "M"), MEASURE);
+			return;
+
+		case Operation::MEASURE_ALL:
+			for(int i=0; i<op.qubits.size(); i++)
+				add(vector<int>(1, op.qubits.at(i)), vector<string>(1, "M"), MEASURE);
+			return;
+
+		case Operation::RESET:
+			add(op.qubits, vector<string>(1, "R"), SINGLE_QUBIT);
+			return;
+
+		case Operation::DISCARD:
+			add(op.qubits, vector<string>(1, "D"), MEASURE);
+			return;
+
+		case Operation::MARGIN:
+			add(vector<int>(1, 0), vector<string>(1, "NULL"), MARGIN);
+			return;
+
+		case Operation::BARRIER:
+			add(vector<int>(1, 0), vector<string>(1, "NULL"), BARRIER);
+			return;
+
+		default:
+			return;
+	}
 
-	add(vecPos, vecGate, type);
+	switch(op.qubits.size())
+	{
+		case 1: add(op.qubits, gates, SINGLE_QUBIT); break;
+		case 2: add(op.qubits, gates, TWO_QUBITS); break;
+		case 3: add(op.qubits, gates, (op.type == Operation::TOFFOLI)? THREE_QUBITS : MULTI_QUBIT); break;
+		default: add(op.qubits, gates, MULTI_QUBIT); break;
+	}
 }
 
 void QmulatorGraphics::add(vector<int> pos, vector<string> gates, gateType type)
@@ -198,6 +218,24 @@ void QmulatorGraphics::newLine(int n)
 
 void QmulatorGraphics::draw()
 {
+	// collect the operations to draw
+	logger.pos.clear();
+	logger.gate.clear();
+	logger.options.clear();
+	map.clear();
+
+	for(int i=0; i<numOfLines; i++)
+		isClassical[i] = false;
+
+	if(operations != NULL)
+	{
+		for(int i=0; i<operations->size(); i++)
+		{
+			if(operations->at(i).drawn)
+				add(operations->at(i));
+		}
+	}
+
 	// initialise map
 	for(int i=0; i<numOfLines; i++)
 	{
@@ -214,7 +252,7 @@ void QmulatorGraphics::draw()
 	int ptr = 2;
 
 	// draw circuit diagram
-	add(0, " ", NULL_TYPE);
+	add(vector<int>(1, 0), vector<string>(1, " "), NULL_TYPE);
 
 	for(int i=0; i<logger.gate.size() - 1; i++)
 	{
@@ -228,7 +266,7 @@ void QmulatorGraphics::draw()
 		switch(option.at(i))
 		{
 			case SINGLE_QUBIT:
-				if(currGates.at(0) == "H")
+				if(currGates.at(0) == "H" || currGates.at(0) == "R")
 					isClassical[currPos.at(0) / 2] = false;
 
 				map.at(currPos.at(0)).at(ptr) = currGates.at(0);
@@ -247,6 +285,13 @@ void QmulatorGraphics::draw()
 				map.at(currPos.at(2)).at(ptr) = currGates.at(2);
 				break;
 
+			case MULTI_QUBIT:
+				fill(ptr, min(currPos), max(currPos), VERTICAL_LINE);
+
+				for(int j=0; j<currPos.size(); j++)
+					map.at(currPos.at(j)).at(ptr) = currGates.at(j);
+				break;
+
 			case MEASURE:
 				isClassical[currPos.at(0) / 2] = true;
 				map.at(currPos.at(0)).at(ptr) = currGates.at(0);
@@ -35,6 +35,7 @@ public:
 	Matrix<T> Pauli_Z() { return *pauli_z; }
 
 	Matrix<T> PhaseShift(T);
+	Matrix<T> Rotation(T, T, T);
 
 	/* Multi-Qubit Gates */
 	Matrix<T> CNOT() { return *cnot; }
@@ -126,4 +127,18 @@ Matrix<T> QuantumGates<T>::PhaseShift(T radian)
 	return m;
 }
 
+template<class T>
+Matrix<T> QuantumGates<T>::Rotation(T theta, T phi, T lambda)
+{
+	// the general single-qubit rotation U3(θ, φ, λ)
+	Matrix<T> m(2, 2);
+
+	m.set(0, 0, cos(theta / 2), 0);
+	m.set(0, 1, -cos(lambda) * sin(theta / 2), -sin(lambda) * sin(theta / 2));
+	m.set(1, 0, cos(phi) * sin(theta / 2), sin(phi) * sin(theta / 2));
+	m.set(1, 1, cos(phi + lambda) * cos(theta / 2), sin(phi + lambda) * cos(theta / 2));
+
+	return m;
+}
+
 #endif
\ No newline at end of file
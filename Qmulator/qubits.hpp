@@ -2,11 +2,18 @@
 #define QMULATOR_QUBITS_HPP
 
 #include <stdio.h>
-#include <queue>
-#include <ctime>
+#include <map>
+#include <algorithm>
 #include "complex.hpp"
 #include "matrix.hpp"
 #include "quantum_gates.hpp"
+#include "state_vector.hpp"
+#include "random_source.hpp"
+#include "kernels.hpp"
+#include "phase_buffer.hpp"
+#include "circuit.hpp"
+#include "gate_fusion.hpp"
+#include "circuit_optimiser.hpp"
 #include "qmulator_graphics.hpp"
 
 template<class Type>
@@ -14,15 +21,92 @@ class Qubits
 {
 private:
 	unsigned int numQubits;
-	unsigned int numCoeffs;
+	uint64_t numCoeffs;
 
-	int measurement;
-	priority_queue<int, vector<int>, greater<int> > measured;
+	// qubits traced out of the vector sit at the bits from numActive up,
+	// their known values held in tracedBits
+	unsigned int numActive;
+	uint64_t tracedBits;
+	bool traceMeasured;
+
+	vector<int> measurement;
+	RandomSource<Type> generator;
 
 	QuantumGates<Type> gate;
+	GateKernels<Type> kernel;
+	PhaseBuffer<Type> pendingPhases;
+
+	Circuit<Type> circuit;
+	uint64_t numExecuted;
+	uint64_t numDrawn;
+	bool deferred;
+	GateFusion fusion;
+	CircuitOptimiser<Type> optimiser;
+	bool optimise;
+
+	vector<int> layout;
+	bool mapQubits;
+
+	GateKernels<Type> tileKernel;
+	int tileQubits;
+
+	// kernel arguments of a gate, worked out once and reused on every tile
+	struct PreparedGate
+	{
+		enum kind: int {SINGLE, CONTROLLED, PHASES, MATRIX, SWAP};
+
+		int kind;
+		uint64_t controlMask;
+		uint64_t controlValue;
+		vector<int> qubits;
+		vector<Complex<Type> > coeffs;
+	};
+
+	PreparedGate prepare(Operation &, Matrix<Type> *);
+	void applyPrepared(GateKernels<Type> &, Complex<Type> *, uint64_t, PreparedGate &);
+
+	Operation physical(Operation &);
+	uint64_t physicalIndex(uint64_t);
+	uint64_t logicalIndex(uint64_t);
+	void materialise();
+
+	void push(Operation);
+	void push(Operation, Matrix<Type>);
+	void execute(Operation &, Matrix<Type> *);
+	void applyOperation(GateKernels<Type> &, Complex<Type> *, uint64_t, Operation &, Matrix<Type> *);
+	void runOperations(Circuit<Type> &, uint64_t);
+	void runTiled(Circuit<Type> &, uint64_t);
+	void applyTiles(Circuit<Type> &, vector<uint64_t> &);
+	void bringLow(Circuit<Type> &, uint64_t);
+	void applyFused(Circuit<Type> &);
+	bool diagonalOf(Operation &, Matrix<Type> *, vector<Complex<Type> > &);
+
+	void applyPhases(vector<int>, vector<Complex<Type> >);
+	void applyMeasure(int);
+	void applyMeasureAll();
+	void applyReset(int);
+	void applyDiscard(int);
+	void flushPhases();
+
+	unsigned int collapse(int);
+	void traceOut(int, unsigned int, unsigned int);
+	void restore(int);
+	void activate(Operation &);
+
+	void initialise(int, unsigned int);
+	void barf(string, string);
 
 public:
-	Matrix<Type> *states;
+	enum memoryPolicy: unsigned int
+	{
+		STRICT_MEMORY = 0,
+		WARN_MEMORY = 1,
+		IGNORE_MEMORY = 2,
+	};
+
+	static const unsigned int MAX_QUBITS = 62;
+
+	StateVector<Type> *states;
 
 	/* Constructor and Deconstructor */
 	Qubits(int);
@@ -37,9 +121,17 @@ public:
 	void T(int);
 	void S(int);
 	void U(Matrix<Type>, int);
+	void U(Matrix<Type>, vector<int>);
 	unsigned int Measure(int);
+	uint64_t MeasureAll();
+	map<uint64_t, unsigned int> Sample(unsigned int);
+	Type random();
+
+	void Reset(int);
+	void Discard(int);
 
-	Matrix<Type> controlledU(int, int, Matrix<Type>);
+	void MCU(vector<int>, int, Matrix<Type>);
+	void MCU(vector<int>, vector<int>, int, Matrix<Type>);
 	void CNOT(int, int);
 	void CY(int, int);
 	void CZ(int, int);
@@ -51,11 +143,42 @@ public:
 	void margin();
 	void barrier();
 
+	/* Deferred Execution */
+	void setDeferred(bool);
+	bool isDeferred();
+	void run();
+	Circuit<Type>& getCircuit();
+	void setMaxFusedWidth(int);
+	void setOptimise(bool);
+	void setQubitMapping(bool);
+	void setTileQubits(int);
+	CircuitOptimiser<Type>& getOptimiser();
+	void optimiserReport();
+
 	/* Utilities */
+	void flush();
+	void setMaxFusedPhases(int);
+
 	unsigned int size();
-	unsigned int length();
+	uint64_t length();
+	Complex<Type> amplitude(uint64_t);
 
-	void setRandomSeed(int);
+	void setTraceMeasured(bool);
+	bool isActive(int);
+	unsigned int activeQubits();
+
+	static uint64_t bytesRequired(int);
+	static void memoryReport(int);
+
+	void setRandomSeed(uint64_t);
+
+	int getMeasurement(int);
+	vector<int> getMeasurements();
+	void setHugePages(bool);
+	void setNumThreads(int);
+	void setParallelThreshold(uint64_t);
+	void setSimdLevel(int);
+	int simdLevel();
 
 	void print();
 	void save(string);
@@ -70,18 +193,70 @@ public:
 template<class Type>
 Qubits<Type>::Qubits(int qubits)
 {
+	initialise(qubits, STRICT_MEMORY);
+}
+
+template<class Type>
+Qubits<Type>::Qubits(int qubits, unsigned int policy)
+{
+	initialise(qubits, policy);
+}
+
+template<class Type>
+void Qubits<Type>::initialise(int qubits, unsigned int policy)
+{
+	if(qubits < 1 || qubits > MAX_QUBITS)
+		barf("Qubits", "number of qubits must be between 1 and 62");
+
 	numQubits = qubits;
-	numCoeffs = 1 << numQubits;
+	numCoeffs = 1ULL << numQubits;
+
+	numActive = numQubits;
+	tracedBits = 0;
+	traceMeasured = false;
+
+	// check the state vector fits in memory before allocating it
+	uint64_t required = bytesRequired(numQubits);
+	uint64_t available = StateVector<Type>::availableMemory();
+
+	// zero means the size overflows, which no policy can allocate
+	if(required == 0)
+	{
+		memoryReport(numQubits);
+		barf("Qubits", "state vector too large to address");
+	}
+
+	if(policy != IGNORE_MEMORY && available != 0 && required > available)
+	{
+		memoryReport(numQubits);
+
+		if(policy == STRICT_MEMORY)
+			barf("Qubits", "state vector exceeds available memory");
+
+		printf("[warning] <Qubits> state vector exceeds available memory\n");
+	}
 
 	graphics.initialise(numQubits);
+	graphics.attach(&circuit.operations);
 
-	states = new Matrix<Type>(numCoeffs, 1);
-	states->set(0, 0, 1, 0);
+	states = new StateVector<Type>(numCoeffs);
+	states->set(0, 1, 0);
 
-	measurement = -1;
+	measurement.assign(numQubits, -1);
 	enableGraphics = true;
 
-	srand(time(NULL));
+	deferred = false;
+	optimise = true;
+	numExecuted = 0;
+
+	mapQubits = false;
+	tileQubits = 0;
+	tileKernel.setNumThreads(1);
+	layout.resize(numQubits);
+
+	for(int i=0; i<numQubits; ++i)
+		layout.at(i) = i;
+	numDrawn = 0;
 }
 
 template<class Type>
@@ -90,384 +265,1431 @@ Qubits<Type>::~Qubits()
 	delete states;
 }
 
-/* Single-Qubit Gates */
-
 template<class Type>
-void Qubits<Type>::H(int qubit)
+void Qubits<Type>::barf(string function, string message)
 {
-	if(enableGraphics)
-		graphics.add(qubit, "H", graphics.SINGLE_QUBIT);
+	cout << "[error] " << "<" << function << ">";
+	cout << " " << message << endl;
+	exit(1);
+}
+
+/* Circuit Recording */
 
-	Matrix<Type> m(1, 1);
-	m.setToI();
+template<class Type>
+void Qubits<Type>::push(Operation op)
+{
+	// Records the operation for the diagram or for a later run(), and
+	// executes it straight away unless execution is deferred.
+	if(enableGraphics || deferred)
+	{
+		op.drawn = enableGraphics;
+		numDrawn += op.drawn;
 
-	for(int i=numQubits - 1; i>=0; --i)
-		m = m.tensor((i == qubit)? gate.Hadamard() : gate.Identity());
+		circuit.add(op);
+	}
 
-	(*states) = m * (*states);
+	if(!deferred)
+	{
+		execute(op, NULL);
+		numExecuted = circuit.size();
+	}
 }
 
 template<class Type>
-void Qubits<Type>::X(int qubit)
+void Qubits<Type>::push(Operation op, Matrix<Type> u)
 {
-	if(enableGraphics)
-		graphics.add(qubit, "X", graphics.SINGLE_QUBIT);
-
-	Matrix<Type> m(1, 1);
-	m.setToI();
+	if(enableGraphics || deferred)
+	{
+		op.drawn = enableGraphics;
+		numDrawn += op.drawn;
 
-	for(int i=numQubits - 1; i>=0; --i)
-		m = m.tensor((i == qubit)? gate.Pauli_X() : gate.Identity());
+		circuit.add(op, u);
+	}
 
-	(*states) = m * (*states);
+	if(!deferred)
+	{
+		execute(op, &u);
+		numExecuted = circuit.size();
+	}
 }
 
 template<class Type>
-void Qubits<Type>::Y(int qubit)
+void Qubits<Type>::execute(Operation &op, Matrix<Type> *u)
 {
-	if(enableGraphics)
-		graphics.add(qubit, "Y", graphics.SINGLE_QUBIT);
+	// With qubit mapping on, a swap only exchanges the physical positions
+	// of two logical qubits.
+	if(op.type == Operation::SWAP && mapQubits)
+	{
+		swap(layout.at(op.qubits.at(0)), layout.at(op.qubits.at(1)));
+		return;
+	}
+
+	if(op.type == Operation::MEASURE)
+		applyMeasure(op.target());
+
+	if(op.type == Operation::MEASURE_ALL)
+		applyMeasureAll();
+
+	if(op.type == Operation::RESET)
+		applyReset(op.target());
+
+	if(op.type == Operation::DISCARD)
+		applyDiscard(op.target());
+
+	if(!op.isUnitary())
+		return;
 
-	Matrix<Type> m(1, 1);
-	m.setToI();
+	activate(op);
+	Operation mapped = physical(op);
 
-	for(int i=numQubits - 1; i>=0; --i)
-		m = m.tensor((i == qubit)? gate.Pauli_Y() : gate.Identity());
+	// diagonal gates are held back and fused into a single phase sweep
+	vector<Complex<Type> > diagonal;
 
-	(*states) = m * (*states);
+	if(diagonalOf(mapped, u, diagonal))
+	{
+		applyPhases(mapped.qubits, diagonal);
+		return;
+	}
+
+	flushPhases();
+	applyOperation(kernel, states->data(), numCoeffs, mapped, u);
 }
 
 template<class Type>
-void Qubits<Type>::Z(int qubit)
+void Qubits<Type>::applyOperation(GateKernels<Type> &kernels, Complex<Type> *amplitudes, uint64_t length, Operation &op, Matrix<Type> *u)
 {
-	if(enableGraphics)
-		graphics.add(qubit, "Z", graphics.SINGLE_QUBIT);
+	// Applies a unitary operation straight to the amplitudes given, using
+	// the kernels passed in.
+	uint64_t controlMask = 0, controlValue = 0;
+
+	for(int i=0; i<op.numControls + op.numOpenControls; ++i)
+	{
+		controlMask |= 1ULL << op.qubits.at(i);
+
+		if(i < op.numControls)
+			controlValue |= 1ULL << op.qubits.at(i);
+	}
+
+	vector<Complex<Type> > diagonal;
+
+	switch(op.type)
+	{
+		case Operation::H:
+			kernels.applySingle(amplitudes, length, op.target(), gate.Hadamard());
+			break;
+
+		case Operation::X:
+			kernels.applySingle(amplitudes, length, op.target(), gate.Pauli_X());
+			break;
+
+		case Operation::Y:
+			kernels.applySingle(amplitudes, length, op.target(), gate.Pauli_Y());
+			break;
+
+		case Operation::U:
+			kernels.applySingle(amplitudes, length, op.target(), *u);
+			break;
+
+		case Operation::CNOT:
+		case Operation::TOFFOLI:
+			kernels.applyControlled(amplitudes, length, controlMask, controlValue, op.target(), gate.Pauli_X());
+			break;
 
-	Matrix<Type> m(1, 1);
-	m.setToI();
+		case Operation::CY:
+			kernels.applyControlled(amplitudes, length, controlMask, controlValue, op.target(), gate.Pauli_Y());
+			break;
 
-	for(int i=numQubits - 1; i>=0; --i)
-		m = m.tensor((i == qubit)? gate.Pauli_Z() : gate.Identity());
+		case Operation::MCU:
+			kernels.applyControlled(amplitudes, length, controlMask, controlValue, op.target(), *u);
+			break;
 
-	(*states) = m * (*states);
+		case Operation::UNITARY:
+		{
+			uint64_t dim = u->rows();
+			vector<Complex<Type> > matrix(dim * dim);
+
+			for(uint64_t r=0; r<dim; ++r)
+			{
+				for(uint64_t c=0; c<dim; ++c)
+					matrix.at(r * dim + c) = u->get(r, c);
+			}
+
+			kernels.applyMatrix(amplitudes, length, &op.qubits.at(0), op.qubits.size(), &matrix.at(0));
+			break;
+		}
+
+		case Operation::SWAP:
+			kernels.applySwap(amplitudes, length, op.qubits.at(0), op.qubits.at(1));
+			break;
+
+		default:
+			if(diagonalOf(op, u, diagonal))
+				kernels.applyPhases(amplitudes, length, &op.qubits.at(0), op.qubits.size(), &diagonal.at(0));
+			break;
+	}
 }
 
 template<class Type>
-void Qubits<Type>::T(int qubit)
+bool Qubits<Type>::diagonalOf(Operation &op, Matrix<Type> *u, vector<Complex<Type> > &diagonal)
 {
-	if(enableGraphics)
-		graphics.add(qubit, "T", graphics.SINGLE_QUBIT);
+	// Fills in the phase table of a diagonal operation over op.qubits, in the
+	// order PhaseBuffer expects. Returns false if the operation mixes amplitudes.
+	Complex<Type> one(1, 0);
+
+	switch(op.type)
+	{
+		case Operation::Z:
+			diagonal.push_back(one);
+			diagonal.push_back(Complex<Type>(-1, 0));
+			return true;
+
+		case Operation::T:
+			diagonal.push_back(one);
+			diagonal.push_back(Complex<Type>(cos(M_PI / 4), sin(M_PI / 4)));
+			return true;
+
+		case Operation::S:
+			diagonal.push_back(one);
+			diagonal.push_back(Complex<Type>(0, 1));
+			return true;
+
+		case Operation::PHASE:
+			diagonal.push_back(one);
+			diagonal.push_back(Complex<Type>(cos(op.params.at(0)), sin(op.params.at(0))));
+			return true;
+
+		case Operation::U:
+			if(u->get(0, 1).normSq() != 0 || u->get(1, 0).normSq() != 0)
+				return false;
+
+			diagonal.push_back(u->get(0, 0));
+			diagonal.push_back(u->get(1, 1));
+			return true;
+
+		case Operation::CZ:
+			diagonal.assign(4, one);
+			diagonal.at(3).set(-1, 0);
+			return true;
+
+		case Operation::MCU:
+		{
+			// a diagonal u only adds phases on the basis states the controls select
+			int width = op.qubits.size();
+
+			if(u->get(0, 1).normSq() != 0 || u->get(1, 0).normSq() != 0 || width > PhaseBuffer<Type>::DEFAULT_WIDTH)
+				return false;
+
+			uint64_t selected = (1ULL << op.numControls) - 1;
+
+			diagonal.assign(1ULL << width, one);
+			diagonal.at(selected) = u->get(0, 0);
+			diagonal.at(selected | (1ULL << (width - 1))) = u->get(1, 1);
+			return true;
+		}
 
-	Matrix<Type> m(1, 1);
-	m.setToI();
+		case Operation::UNITARY:
+		{
+			uint64_t dim = u->rows();
+
+			if(op.qubits.size() > PhaseBuffer<Type>::DEFAULT_WIDTH)
+				return false;
+
+			for(uint64_t r=0; r<dim; ++r)
+			{
+				for(uint64_t c=0; c<dim; ++c)
+				{
+					if(r != c && u->get(r, c).normSq() != 0)
+						return false;
+				}
+			}
+
+			for(uint64_t t=0; t<dim; ++t)
+				diagonal.push_back(u->get(t, t));
+
+			return true;
+		}
+
+		default:
+			return false;
+	}
+}
 
-	for(int i=numQubits - 1; i>=0; --i)
-		m = m.tensor((i == qubit)? gate.PhaseShift(M_PI / 4) : gate.Identity());
+/* Single-Qubit Gates */
 
-	(*states) = m * (*states);
+template<class Type>
+void Qubits<Type>::H(int qubit)
+{
+	push(Operation(Operation::H, qubit));
 }
 
 template<class Type>
-void Qubits<Type>::S(int qubit)
+void Qubits<Type>::X(int qubit)
 {
-	if(enableGraphics)
-		graphics.add(qubit, "S", graphics.SINGLE_QUBIT);
+	push(Operation(Operation::X, qubit));
+}
+
+template<class Type>
+void Qubits<Type>::Y(int qubit)
+{
+	push(Operation(Operation::Y, qubit));
+}
 
-	Matrix<Type> m(1, 1);
-	m.setToI();
+template<class Type>
+void Qubits<Type>::Z(int qubit)
+{
+	push(Operation(Operation::Z, qubit));
+}
 
-	for(int i=numQubits - 1; i>=0; --i)
-		m = m.tensor((i == qubit)? gate.PhaseShift(M_PI / 2) : gate.Identity());
+template<class Type>
+void Qubits<Type>::T(int qubit)
+{
+	push(Operation(Operation::T, qubit));
+}
 
-	(*states) = m * (*states);
+template<class Type>
+void Qubits<Type>::S(int qubit)
+{
+	push(Operation(Operation::S, qubit));
 }
 
 template<class Type>
 void Qubits<Type>::U(Matrix<Type> u, int qubit)
 {
-	if(enableGraphics)
-		graphics.add(qubit, "U", graphics.SINGLE_QUBIT);
+	push(Operation(Operation::U, qubit), u);
+}
+
+template<class Type>
+void Qubits<Type>::U(Matrix<Type> u, vector<int> qubits)
+{
+	// Applies a 2^k x 2^k matrix to k distinct qubits, in any order. Bit j
+	// of a row or column index of u refers to qubits[j].
+	if(qubits.empty() || u.rows() != (1 << qubits.size()) || u.cols() != u.rows())
+		barf("U", "matrix must be 2^k x 2^k for k qubits");
+
+	for(int i=0; i<qubits.size(); ++i)
+	{
+		if(qubits.at(i) < 0 || qubits.at(i) >= numQubits)
+			barf("U", "qubit out of range");
 
-	Matrix<Type> m(1, 1);
-	m.setToI();
+		if(find(qubits.begin(), qubits.begin() + i, qubits.at(i)) != qubits.begin() + i)
+			barf("U", "qubits must be distinct");
+	}
 
-	for(int i=numQubits - 1; i>=0; --i)
-		m = m.tensor((i == qubit)? u : gate.Identity());
+	if(qubits.size() == 1)
+	{
+		U(u, qubits.at(0));
+		return;
+	}
 
-	(*states) = m * (*states);
+	push(Operation(Operation::UNITARY, qubits), u);
 }
 
 template<class Type>
 unsigned int Qubits<Type>::Measure(int qubit)
 {
-	if(enableGraphics)
-		graphics.add(qubit, "M", graphics.MEASURE);
+	// The outcome is needed now, so a deferred circuit is run up to here.
+	push(Operation(Operation::MEASURE, qubit));
 
-	// determine classical output
-	Type probOfZero = 0;
-	Type probability = (Type)(rand() % 10000) / 10000;
-	unsigned int result;
+	if(deferred)
+		run();
 
-	for(int i=0; i<numCoeffs; ++i)
+	return measurement.at(qubit);
+}
+
+template<class Type>
+void Qubits<Type>::applyMeasure(int logical)
+{
+	// A traced qubit already holds its outcome. The draw is still taken,
+	// so seeded runs agree with and without tracing.
+	if(!isActive(logical))
 	{
-		if(((i >> qubit) & 1) == 0)
-			probOfZero += states->get(i, 0).normSq();
+		random();
+		measurement.at(logical) = (tracedBits >> layout.at(logical)) & 1;
+		return;
 	}
 
-	result = (probability <= probOfZero)? 0 : 1;
+	unsigned int result = collapse(logical);
+	measurement.at(logical) = result;
 
-	// remove unused states
-	for(int i=0; i<numCoeffs; ++i)
-	{
-		if(((i >> qubit) & 1) != result)
-			states->set(i, 0, 0, 0);
-	}
+	if(traceMeasured && numActive > 1)
+		traceOut(logical, result, result);
+}
 
-	// normalise the coefficients
-	Complex<Type> factor;
+template<class Type>
+unsigned int Qubits<Type>::collapse(int logical)
+{
+	flushPhases();
 
-	if(result)
-		factor.setRe(sqrt(1 - probOfZero));
-	else
-		factor.setRe(sqrt(probOfZero));
+	// determine classical output from both marginals, so the outcome stays
+	// unbiased even if rounding has drifted the norm away from one
+	int qubit = layout.at(logical);
 
-	for(int i=0; i<numCoeffs; ++i)
-	{
-		Complex<Type> coeff(states->get(i, 0).getRe(), states->get(i, 0).getIm());
+	Type probOfZero, probOfOne;
+	kernel.probabilities(states->data(), numCoeffs, qubit, &probOfZero, &probOfOne);
 
-		coeff /= factor;
+	unsigned int result = (random() * (probOfZero + probOfOne) < probOfZero)? 0 : 1;
 
-		states->set(i, 0, coeff);
-	}
+	// never collapse onto an outcome that cannot occur
+	if(((result)? probOfOne : probOfZero) <= 0)
+		result ^= 1;
+
+	Type probability = (result)? probOfOne : probOfZero;
+
+	if(probability <= 0)
+		barf("Measure", "state has zero norm");
+
+	// remove unused states and normalise the rest in the same pass
+	kernel.collapse(states->data(), numCoeffs, qubit, result, 1 / sqrt(probability));
 
 	return result;
 }
 
-/* Contol Gates */
-
 template<class Type>
-Matrix<Type> Qubits<Type>::controlledU(int control, int target, Matrix<Type> u)
+uint64_t Qubits<Type>::MeasureAll()
 {
-	Matrix<Type> m1(1, 1), m2(1, 1), m00(2, 2), m11(2, 2);
+	// Measures every qubit with a single draw from the full distribution.
+	vector<int> qubits;
 
-	m1.setToI();
-	m2.setToI();
-	m00.set(0, 0, 1, 0);
-	m11.set(1, 1, 1, 0);
+	for(int i=0; i<numQubits; ++i)
+		qubits.push_back(i);
 
-	for(int i=numQubits - 1; i>=0; --i)
-		m1 = m1.tensor((i == control)? m00 : gate.Identity());
+	push(Operation(Operation::MEASURE_ALL, qubits));
 
-	for(int i=numQubits - 1; i>=0; --i)
-	{
-		if(i == control)
-			m2 = m2.tensor(m11);
-		else if(i == target)
-			m2 = m2.tensor(u);
-		else
-			m2 = m2.tensor(gate.Identity());
-	}
+	if(deferred)
+		run();
 
-	return m1 + m2;
+	uint64_t result = 0;
+
+	for(int i=0; i<numQubits; ++i)
+		result |= (uint64_t)measurement.at(i) << i;
+
+	return result;
 }
 
 template<class Type>
-void Qubits<Type>::CNOT(int control, int target)
+void Qubits<Type>::applyMeasureAll()
 {
-	if(enableGraphics)
-		graphics.add(control, target, "*", "@", graphics.TWO_QUBITS);
+	flushPhases();
+
+	uint64_t result = kernel.sampleIndex(states->data(), numCoeffs, random());
+	kernel.collapseTo(states->data(), numCoeffs, result);
 
-	(*states) = controlledU(control, target, gate.Pauli_X()) * (*states);
+	result |= tracedBits;
+
+	for(int i=0; i<numQubits; ++i)
+		measurement.at(i) = (result >> layout.at(i)) & 1;
 }
 
+/* Tracing Out Qubits */
+
 template<class Type>
-void Qubits<Type>::CY(int control, int target)
+void Qubits<Type>::Reset(int qubit)
 {
-	if(enableGraphics)
-		graphics.add(control, target, "*", "Y", graphics.TWO_QUBITS);
+	// Returns the qubit to |0⟩ by measuring it, without recording the
+	// outcome. With setTraceMeasured it then stays out of the vector until
+	// a gate uses it again.
+	if(qubit < 0 || qubit >= numQubits)
+		barf("Reset", "qubit out of range");
 
-	(*states) = controlledU(control, target, gate.Pauli_Y()) * (*states);
+	push(Operation(Operation::RESET, qubit));
 }
 
 template<class Type>
-void Qubits<Type>::CZ(int control, int target)
+void Qubits<Type>::Discard(int qubit)
 {
-	if(enableGraphics)
-		graphics.add(control, target, "*", "Z", graphics.TWO_QUBITS);
-
-	(*states) = controlledU(control, target, gate.Pauli_Z()) * (*states);
+	// Measures the qubit, without recording the outcome, and takes it out
+	// of the vector; the rest of the state is as if it were traced out. A
+	// later gate on the qubit brings it back in the state it was left in.
+	// The last qubit in the vector is only measured.
+	if(qubit < 0 || qubit >= numQubits)
+		barf("Discard", "qubit out of range");
+
+	push(Operation(Operation::DISCARD, qubit));
 }
 
 template<class Type>
-void Qubits<Type>::Toffoli(int control1, int control2, int target)
+void Qubits<Type>::applyReset(int logical)
 {
-	if(enableGraphics)
+	if(!isActive(logical))
 	{
-		vector<int> vecPos;
-		vecPos.push_back(control1);
-		vecPos.push_back(control2);
-		vecPos.push_back(target);
+		random();
+		tracedBits &= ~(1ULL << layout.at(logical));
+		return;
+	}
 
-		vector<string> vecGate;
-		vecGate.push_back("*");
-		vecGate.push_back("*");
-		vecGate.push_back("@");
-		vecGate.push_back("|");
+	unsigned int result = collapse(logical);
 
-		graphics.add(vecPos, vecGate, graphics.THREE_QUBITS);
+	if(traceMeasured && numActive > 1)
+	{
+		traceOut(logical, result, 0);
+		return;
 	}
 
-	Matrix<Type> m1(1, 1), m2(1, 1), m3(1, 1), m4(1, 1), m00(2, 2), m11(2, 2);
-
-	m1.setToI();
-	m2.setToI();
-	m3.setToI();
-	m4.setToI();
-	m00.set(0, 0, 1, 0);
-	m11.set(1, 1, 1, 0);
+	if(result)
+	{
+		Operation flip(Operation::X, logical);
+		execute(flip, NULL);
+	}
+}
 
-	for(int i=numQubits - 1; i>=0; i--)
+template<class Type>
+void Qubits<Type>::applyDiscard(int logical)
+{
+	if(!isActive(logical))
 	{
-		if(i == control1)
-		{
-			m1 = m1.tensor(m00);
-			m2 = m2.tensor(m00);
-			m3 = m3.tensor(m11);
-			m4 = m4.tensor(m11);
-		}
-		else if(i == control2)
-		{
-			m1 = m1.tensor(m00);
-			m2 = m2.tensor(m11);
-			m3 = m3.tensor(m00);
-			m4 = m4.tensor(m11);
-		}
-		else if(i == target)
-		{
-			m1 = m1.tensor(gate.Identity());
-			m2 = m2.tensor(gate.Identity());
-			m3 = m3.tensor(gate.Identity());
-			m4 = m4.tensor(gate.Pauli_X());
-		}
-		else
-		{
-			m1 = m1.tensor(gate.Identity());
-			m2 = m2.tensor(gate.Identity());
-			m3 = m3.tensor(gate.Identity());
-			m4 = m4.tensor(gate.Identity());
-		}
+		random();
+		return;
 	}
 
-	(*states) = (m1 + m2 + m3 + m4) * (*states);
-}
+	unsigned int result = collapse(logical);
 
-/* Other Multi-Qubit Gates */
+	if(numActive > 1)
+		traceOut(logical, result, result);
+}
 
 template<class Type>
-void Qubits<Type>::Swap(int qubit1, int qubit2)
+void Qubits<Type>::traceOut(int logical, unsigned int keep, unsigned int value)
 {
-	if(enableGraphics)
-		graphics.add(qubit1, qubit2, "x", "x", graphics.TWO_QUBITS);
+	// Drops the bit of a collapsed qubit, keeping the half of the vector
+	// where it is `keep`. The qubit moves to the bit just above the active
+	// ones, the bits above it shifting down, and is remembered as `value`.
+	flushPhases();
 
-	(*states) = controlledU(qubit1, qubit2, gate.Pauli_X()) *
-				controlledU(qubit2, qubit1, gate.Pauli_X()) *
-				controlledU(qubit1, qubit2, gate.Pauli_X()) *
-				(*states);
-}
+	int bit = layout.at(logical);
+	int top = numActive - 1;
+	uint64_t half = numCoeffs / 2;
+	uint64_t low = (1ULL << bit) - 1;
+	uint64_t offset = (uint64_t)keep << bit;
 
-/* Graphics */
+	StateVector<Type> *halved = new StateVector<Type>(half, states->usesHugePages());
+	Complex<Type> *from = states->data(), *to = halved->data();
+
+	#pragma omp parallel for if(kernel.isParallel(half)) num_threads(kernel.threads())
+	for(uint64_t i=0; i<half; ++i)
+		to[i] = from[(i & low) | ((i & ~low) << 1) | offset];
+
+	delete states;
+	states = halved;
+
+	for(int i=0; i<numQubits; ++i)
+	{
+		if(layout.at(i) > bit && layout.at(i) <= top)
+			--layout.at(i);
+	}
+
+	layout.at(logical) = top;
+	tracedBits |= (uint64_t)value << top;
+
+	numActive = top;
+	numCoeffs = half;
+}
 
 template<class Type>
-void Qubits<Type>::margin()
+void Qubits<Type>::restore(int logical)
 {
-	if(enableGraphics)
-		graphics.add(graphics.MARGIN);
+	// Brings a traced qubit back in its remembered state, as the bit just
+	// above the active ones: the vector doubles, its old contents going to
+	// the half where that bit holds the value.
+	int bit = numActive, from = layout.at(logical);
+	int other = find(layout.begin(), layout.end(), bit) - layout.begin();
+
+	// the traced qubit that held the bit takes over the old one
+	uint64_t value = (tracedBits >> from) & 1, displaced = (tracedBits >> bit) & 1;
+	tracedBits &= ~((1ULL << from) | (1ULL << bit));
+
+	if(from != bit)
+		tracedBits |= displaced << from;
+
+	swap(layout.at(logical), layout.at(other));
+
+	StateVector<Type> *doubled = new StateVector<Type>(numCoeffs * 2, states->usesHugePages());
+	memcpy((void *)(doubled->data() + value * numCoeffs), states->data(), numCoeffs * sizeof(Complex<Type>));
+
+	delete states;
+	states = doubled;
+
+	++numActive;
+	numCoeffs *= 2;
 }
 
 template<class Type>
-void Qubits<Type>::barrier()
+void Qubits<Type>::activate(Operation &op)
 {
-	if(enableGraphics)
-		graphics.add(0, 0, "NULL", graphics.BARRIER);
+	// A gate on traced qubits needs them back in the vector first.
+	for(int j=0; j<op.qubits.size(); ++j)
+	{
+		if(!isActive(op.qubits.at(j)))
+			restore(op.qubits.at(j));
+	}
 }
 
-/* Utilities */
-
 template<class Type>
-unsigned int Qubits<Type>::size()
+void Qubits<Type>::setTraceMeasured(bool enable)
 {
-	// Reutrns the number of qubits in the system.
-	return numQubits;
+	// While on, a measured qubit is taken out of the state vector, halving
+	// it, and its outcome kept as a classical bit; a later gate on the
+	// qubit brings it back. The last qubit in the vector stays.
+	run();
+	traceMeasured = enable;
 }
 
 template<class Type>
-unsigned int Qubits<Type>::length()
+bool Qubits<Type>::isActive(int qubit)
 {
-	// Returns the number of coefficients representing the states.
-	return numCoeffs;
+	// Whether the qubit is held in the state vector rather than traced out.
+	return layout.at(qubit) < numActive;
 }
 
 template<class Type>
-void Qubits<Type>::setRandomSeed(int seed)
+unsigned int Qubits<Type>::activeQubits()
 {
-	srand(seed);
+	// Number of qubits held in the state vector.
+	return numActive;
 }
 
 template<class Type>
-void Qubits<Type>::print()
+map<uint64_t, unsigned int> Qubits<Type>::Sample(unsigned int shots)
 {
-	for(int i=0; i<numCoeffs; ++i)
-	{
-		string decToBin;
+	// Draws basis states from the current distribution without collapsing
+	// it, returning how often each one was drawn. The cumulative
+	// distribution is built once, then each shot is a binary search.
+	run();
+	flushPhases();
 
-		for(int j=0; j<numQubits; ++j)
-			decToBin.insert(decToBin.begin(), (i >> j & 1) + '0');
+	map<uint64_t, unsigned int> counts;
+	vector<Type> cdf(numCoeffs);
 
-		printf("|%s⟩", decToBin.c_str());
+	kernel.cumulative(states->data(), numCoeffs, &cdf.at(0));
 
-		if(states->get(i, 0).getRe() || states->get(i, 0).getIm())
-			printf(" = %6.3f +%6.3fi", states->get(i, 0).getRe(), states->get(i, 0).getIm());
-		else
-			printf(" =  0             ");
+	Type total = cdf.back();
 
-		printf("  (%.3f)\n", states->get(i, 0).normSq());
-	}
+	for(unsigned int s=0; s<shots; ++s)
+	{
+		typename vector<Type>::iterator it = upper_bound(cdf.begin(), cdf.end(), random() * total);
 
-	priority_queue<int, vector<int>, greater<int> > temp = measured;
-	printf("\n");
+		// rounding left the draw at the total: fall back to the last basis
+		// state with nonzero probability, where the cdf first reaches it
+		if(it == cdf.end())
+			it = lower_bound(cdf.begin(), cdf.end(), total);
 
-	while(!temp.empty())
-	{
-		printf("Qubit%2d: %d\n", temp.top(), (measurement >> temp.top()) & 1);
-		temp.pop();
+		++counts[logicalIndex((it - cdf.begin()) | tracedBits)];
 	}
+
+	return counts;
 }
 
+/* Diagonal Gates */
+
 template<class Type>
-void Qubits<Type>::save(string location)
+void Qubits<Type>::applyPhases(vector<int> qubits, vector<Complex<Type> > diagonal)
 {
-	FILE *file;
-	file = fopen(location.c_str(), "wt");
+	// Diagonal gates are held back and fused until a non-diagonal gate or a
+	// read of the amplitudes calls flush().
+	if(pendingPhases.add(qubits, diagonal))
+		return;
 
-	for(int i=0; i<numCoeffs; ++i)
-	{
-		string decToBin;
+	flushPhases();
 
-		for(int j=0; j<numQubits; ++j)
-			decToBin.insert(decToBin.begin(), (i >> j & 1) + '0');
+	if(!pendingPhases.add(qubits, diagonal))
+		kernel.applyPhases(states->data(), numCoeffs, &qubits.at(0), qubits.size(), &diagonal.at(0));
+}
+
+template<class Type>
+void Qubits<Type>::flushPhases()
+{
+	if(pendingPhases.isEmpty())
+		return;
+
+	kernel.applyPhases(states->data(), numCoeffs, pendingPhases.qubitList(), pendingPhases.width(), pendingPhases.phases());
+	pendingPhases.clear();
+}
+
+/* Contol Gates */
+
+template<class Type>
+void Qubits<Type>::MCU(vector<int> controls, int target, Matrix<Type> u)
+{
+	MCU(controls, vector<int>(), target, u);
+}
+
+template<class Type>
+void Qubits<Type>::MCU(vector<int> controls, vector<int> openControls, int target, Matrix<Type> u)
+{
+	// Applies u to the target when every control reads 1 and every open
+	// control reads 0.
+	vector<int> qubits = controls;
+	qubits.insert(qubits.end(), openControls.begin(), openControls.end());
+	qubits.push_back(target);
+
+	if(u.rows() != 2 || u.cols() != 2)
+		barf("MCU", "matrix must be 2 x 2");
+
+	for(int i=0; i<qubits.size(); ++i)
+	{
+		if(qubits.at(i) < 0 || qubits.at(i) >= numQubits)
+			barf("MCU", "qubit out of range");
+
+		if(find(qubits.begin(), qubits.begin() + i, qubits.at(i)) != qubits.begin() + i)
+		{
+			if(i + 1 == qubits.size())
+				barf("MCU", "target cannot also be a control");
+
+			barf("MCU", "controls must be distinct");
+		}
+	}
+
+	Operation op(Operation::MCU, qubits);
+	op.numControls = controls.size();
+	op.numOpenControls = openControls.size();
+
+	push(op, u);
+}
+
+template<class Type>
+void Qubits<Type>::CNOT(int control, int target)
+{
+	push(Operation(Operation::CNOT, control, target));
+}
+
+template<class Type>
+void Qubits<Type>::CY(int control, int target)
+{
+	push(Operation(Operation::CY, control, target));
+}
+
+template<class Type>
+void Qubits<Type>::CZ(int control, int target)
+{
+	push(Operation(Operation::CZ, control, target));
+}
+
+template<class Type>
+void Qubits<Type>::Toffoli(int control1, int control2, int target)
+{
+	push(Operation(Operation::TOFFOLI, control1, control2, target));
+}
+
+/* Other Multi-Qubit Gates */
+
+template<class Type>
+void Qubits<Type>::Swap(int qubit1, int qubit2)
+{
+	push(Operation(Operation::SWAP, qubit1, qubit2));
+}
+
+/* Graphics */
+
+template<class Type>
+void Qubits<Type>::margin()
+{
+	if(enableGraphics)
+		push(Operation(Operation::MARGIN, vector<int>()));
+}
+
+template<class Type>
+void Qubits<Type>::barrier()
+{
+	if(enableGraphics)
+		push(Operation(Operation::BARRIER, vector<int>()));
+}
+
+/* Deferred Execution */
+
+template<class Type>
+void Qubits<Type>::setDeferred(bool enable)
+{
+	// While deferred, gates are only recorded; run() or any read of the
+	// state executes them. Turning it off runs whatever is pending.
+	if(!enable)
+		run();
+
+	deferred = enable;
+}
+
+template<class Type>
+bool Qubits<Type>::isDeferred()
+{
+	return deferred;
+}
+
+template<class Type>
+void Qubits<Type>::run()
+{
+	// Executes the operations recorded since the last run, after the
+	// peephole optimiser has had a pass over them.
+	if(numExecuted < circuit.size())
+	{
+		if(optimise)
+		{
+			Circuit<Type> optimised = optimiser.optimise(circuit, numExecuted);
+			runOperations(optimised, 0);
+		}
+		else
+			runOperations(circuit, numExecuted);
+	}
+
+	numExecuted = circuit.size();
+
+	// nothing left to draw, so executed operations need not be kept
+	if(numDrawn == 0)
+	{
+		circuit.clear();
+		numExecuted = 0;
+	}
+}
+
+template<class Type>
+void Qubits<Type>::runOperations(Circuit<Type> &ops, uint64_t begin)
+{
+	// Runs of unitary gates that fit in the maximum fused width are applied
+	// as one matrix.
+	if(tileQubits > 0 && tileQubits < numActive)
+	{
+		runTiled(ops, begin);
+		return;
+	}
+
+	for(uint64_t i=begin; i<ops.size(); ++i)
+	{
+		Operation &op = ops.at(i);
+		Matrix<Type> *u = (op.hasMatrix())? &ops.matrix(op) : NULL;
+
+		if(op.type == Operation::MARGIN)
+			continue;
+
+		if(op.isUnitary())
+			activate(op);
+
+		bool relabels = op.type == Operation::SWAP && mapQubits;
+
+		if(op.isUnitary() && fusion.getMaxWidth() > 0 && !relabels)
+		{
+			vector<Complex<Type> > diagonal;
+			bool isDiagonal = diagonalOf(op, u, diagonal);
+
+			if(fusion.add(i, op, isDiagonal))
+				continue;
+
+			applyFused(ops);
+
+			if(fusion.add(i, op, isDiagonal))
+				continue;
+		}
+
+		applyFused(ops);
+		execute(op, u);
+	}
+
+	applyFused(ops);
+}
+
+template<class Type>
+void Qubits<Type>::runTiled(Circuit<Type> &ops, uint64_t begin)
+{
+	// Consecutive gates on qubits held below bit tileQubits never mix
+	// amplitudes across tiles of 2^tileQubits, so they are applied one tile
+	// at a time while it is in cache. A gate on higher qubits first has them
+	// swapped down into the tile.
+	vector<uint64_t> segment;
+
+	for(uint64_t i=begin; i<ops.size(); ++i)
+	{
+		Operation &op = ops.at(i);
+
+		if(op.type == Operation::MARGIN)
+			continue;
+
+		bool relabels = op.type == Operation::SWAP && mapQubits;
+
+		if(op.isUnitary())
+			activate(op);
+
+		// measurements may have traced the vector down to a single tile
+		if(!op.isUnitary() || relabels || op.qubits.size() > tileQubits || tileQubits >= numActive)
+		{
+			applyTiles(ops, segment);
+			execute(op, (op.hasMatrix())? &ops.matrix(op) : NULL);
+			continue;
+		}
+
+		for(int j=0; j<op.qubits.size(); ++j)
+		{
+			if(layout.at(op.qubits.at(j)) >= tileQubits)
+			{
+				applyTiles(ops, segment);
+				bringLow(ops, i);
+				break;
+			}
+		}
+
+		segment.push_back(i);
+	}
+
+	applyTiles(ops, segment);
+}
+
+template<class Type>
+void Qubits<Type>::bringLow(Circuit<Type> &ops, uint64_t index)
+{
+	// Swaps each qubit of the operation at index that lies above the tile
+	// with the tile qubit whose next use is furthest away. Ties go to the
+	// highest position, as the lowest bits miss the vectorised kernels.
+	const uint64_t LOOKAHEAD = 64;
+	Operation &op = ops.at(index);
+
+	for(int j=0; j<op.qubits.size(); ++j)
+	{
+		int qubit = op.qubits.at(j);
+
+		if(layout.at(qubit) < tileQubits)
+			continue;
+
+		int best = -1;
+		uint64_t bestUse = 0;
+
+		for(int p=tileQubits-1; p>=0; --p)
+		{
+			int logical = find(layout.begin(), layout.end(), p) - layout.begin();
+
+			if(find(op.qubits.begin(), op.qubits.end(), logical) != op.qubits.end())
+				continue;
+
+			uint64_t nextUse = index + 1;
+
+			while(nextUse < ops.size() && nextUse <= index + LOOKAHEAD)
+			{
+				vector<int> &used = ops.at(nextUse).qubits;
+
+				if(find(used.begin(), used.end(), logical) != used.end())
+					break;
+
+				++nextUse;
+			}
+
+			if(best < 0 || nextUse > bestUse)
+			{
+				best = p;
+				bestUse = nextUse;
+			}
+		}
+
+		int displaced = find(layout.begin(), layout.end(), best) - layout.begin();
+
+		flushPhases();
+		kernel.applySwap(states->data(), numCoeffs, layout.at(qubit), best);
+		swap(layout.at(qubit), layout.at(displaced));
+	}
+}
+
+template<class Type>
+void Qubits<Type>::applyTiles(Circuit<Type> &ops, vector<uint64_t> &segment)
+{
+	if(segment.size() == 1)
+	{
+		Operation &op = ops.at(segment.at(0));
+		execute(op, (op.hasMatrix())? &ops.matrix(op) : NULL);
+	}
+
+	if(segment.size() <= 1)
+	{
+		segment.clear();
+		return;
+	}
+
+	vector<PreparedGate> gates;
+
+	for(uint64_t i=0; i<segment.size(); ++i)
+	{
+		Operation &op = ops.at(segment.at(i));
+		Operation mapped = physical(op);
+
+		gates.push_back(prepare(mapped, (op.hasMatrix())? &ops.matrix(op) : NULL));
+	}
+
+	uint64_t tileLength = 1ULL << tileQubits;
+	uint64_t numTiles = numCoeffs >> tileQubits;
+	Complex<Type> *amplitudes = states->data();
+
+	flushPhases();
+
+	#pragma omp parallel for if(kernel.isParallel(numCoeffs)) num_threads(kernel.threads())
+	for(uint64_t b=0; b<numTiles; ++b)
+	{
+		for(uint64_t g=0; g<gates.size(); ++g)
+			applyPrepared(tileKernel, amplitudes + b * tileLength, tileLength, gates.at(g));
+	}
+
+	segment.clear();
+}
+
+template<class Type>
+typename Qubits<Type>::PreparedGate Qubits<Type>::prepare(Operation &op, Matrix<Type> *u)
+{
+	PreparedGate prepared;
+	prepared.qubits = op.qubits;
+	prepared.controlMask = 0;
+	prepared.controlValue = 0;
+
+	if(diagonalOf(op, u, prepared.coeffs))
+	{
+		prepared.kind = PreparedGate::PHASES;
+		return prepared;
+	}
+
+	Matrix<Type> m = (u != NULL)? *u : (op.type == Operation::H)? gate.Hadamard() : (op.type == Operation::Y || op.type == Operation::CY)? gate.Pauli_Y() : gate.Pauli_X();
+
+	for(int r=0; r<m.rows(); ++r)
+	{
+		for(int c=0; c<m.cols(); ++c)
+			prepared.coeffs.push_back(m.get(r, c));
+	}
+
+	for(int i=0; i<op.numControls + op.numOpenControls; ++i)
+	{
+		prepared.controlMask |= 1ULL << op.qubits.at(i);
+
+		if(i < op.numControls)
+			prepared.controlValue |= 1ULL << op.qubits.at(i);
+	}
+
+	switch(op.type)
+	{
+		case Operation::SWAP: prepared.kind = PreparedGate::SWAP; break;
+		case Operation::UNITARY: prepared.kind = PreparedGate::MATRIX; break;
+		default: prepared.kind = (prepared.controlMask != 0)? PreparedGate::CONTROLLED : PreparedGate::SINGLE; break;
+	}
+
+	return prepared;
+}
+
+template<class Type>
+void Qubits<Type>::applyPrepared(GateKernels<Type> &kernels, Complex<Type> *amplitudes, uint64_t length, PreparedGate &prepared)
+{
+	vector<int> &qubits = prepared.qubits;
+	Complex<Type> *coeffs = &prepared.coeffs.at(0);
+
+	switch(prepared.kind)
+	{
+		case PreparedGate::SINGLE:
+			kernels.applySingle(amplitudes, length, qubits.back(), coeffs);
+			break;
+
+		case PreparedGate::CONTROLLED:
+			kernels.applyControlled(amplitudes, length, prepared.controlMask, prepared.controlValue, qubits.back(), coeffs);
+			break;
+
+		case PreparedGate::PHASES:
+			kernels.applyPhases(amplitudes, length, &qubits.at(0), qubits.size(), coeffs);
+			break;
+
+		case PreparedGate::MATRIX:
+			kernels.applyMatrix(amplitudes, length, &qubits.at(0), qubits.size(), coeffs);
+			break;
+
+		case PreparedGate::SWAP:
+			kernels.applySwap(amplitudes, length, qubits.at(0), qubits.at(1));
+			break;
+	}
+}
+
+template<class Type>
+void Qubits<Type>::applyFused(Circuit<Type> &ops)
+{
+	// Applies the gates collected by the fusion stage. Groups with a single
+	// gate, or only diagonal ones, gain nothing from a dense matrix.
+	if(fusion.isEmpty())
+		return;
+
+	vector<uint64_t> &members = fusion.operations();
+
+	if(!fusion.isWorthwhile())
+	{
+		for(int i=0; i<members.size(); ++i)
+		{
+			Operation &op = ops.at(members.at(i));
+			execute(op, (op.hasMatrix())? &ops.matrix(op) : NULL);
+		}
+
+		fusion.clear();
+		return;
+	}
+
+	// The columns of the product are built by applying each gate to the
+	// columns of the identity, held one after another as a state of 2k qubits.
+	int width = fusion.width();
+	uint64_t dim = 1ULL << width;
+
+	vector<Complex<Type> > columns(dim * dim), product(dim * dim);
+
+	for(uint64_t i=0; i<dim; ++i)
+		columns.at(i + (i << width)).set(1, 0);
+
+	for(int i=0; i<members.size(); ++i)
+	{
+		Operation &op = ops.at(members.at(i));
+		Operation mapped = fusion.local(op);
+
+		applyOperation(tileKernel, &columns.at(0), dim * dim, mapped, (op.hasMatrix())? &ops.matrix(op) : NULL);
+	}
+
+	for(uint64_t r=0; r<dim; ++r)
+	{
+		for(uint64_t c=0; c<dim; ++c)
+			product.at(r * dim + c) = columns.at(r + (c << width));
+	}
+
+	vector<int> targets;
+
+	for(int j=0; j<width; ++j)
+		targets.push_back(layout.at(fusion.qubitList()[j]));
+
+	flushPhases();
+	kernel.applyMatrix(states->data(), numCoeffs, &targets.at(0), width, &product.at(0));
+	fusion.clear();
+}
+
+template<class Type>
+Circuit<Type>& Qubits<Type>::getCircuit()
+{
+	// Operations recorded so far, including those already executed.
+	return circuit;
+}
+
+template<class Type>
+void Qubits<Type>::setMaxFusedWidth(int width)
+{
+	// Largest number of qubits a fused gate may act on when a deferred
+	// circuit is run; zero turns gate fusion off.
+	run();
+	fusion.setMaxWidth(width);
+}
+
+template<class Type>
+void Qubits<Type>::setOptimise(bool enable)
+{
+	// Whether deferred circuits go through the peephole optimiser; on by default.
+	run();
+	optimise = enable;
+}
+
+template<class Type>
+void Qubits<Type>::setQubitMapping(bool enable)
+{
+	// While on, Swap relabels which bit of the state vector holds each
+	// qubit instead of moving amplitudes. The amplitudes are put back in
+	// order when the state is printed, saved or flushed.
+	run();
+
+	if(!enable)
+		materialise();
+
+	mapQubits = enable;
+}
+
+template<class Type>
+void Qubits<Type>::setTileQubits(int qubits)
+{
+	// Deferred runs are applied in tiles of 2^qubits amplitudes, moving the
+	// qubits gates act on into the tile as needed; zero turns tiling off.
+	// A tile should fit in cache, e.g. 14 or 15 for double.
+	run();
+	tileQubits = (qubits > 0)? qubits : 0;
+}
+
+template<class Type>
+Operation Qubits<Type>::physical(Operation &op)
+{
+	// Copy of the operation acting on the bits that hold its qubits.
+	Operation mapped = op;
+
+	for(int j=0; j<mapped.qubits.size(); ++j)
+		mapped.qubits.at(j) = layout.at(op.qubits.at(j));
+
+	return mapped;
+}
+
+template<class Type>
+uint64_t Qubits<Type>::physicalIndex(uint64_t index)
+{
+	uint64_t result = 0;
+
+	for(int i=0; i<numQubits; ++i)
+		result |= ((index >> i) & 1) << layout.at(i);
+
+	return result;
+}
+
+template<class Type>
+uint64_t Qubits<Type>::logicalIndex(uint64_t index)
+{
+	uint64_t result = 0;
+
+	for(int i=0; i<numQubits; ++i)
+		result |= ((index >> layout.at(i)) & 1) << i;
+
+	return result;
+}
+
+template<class Type>
+void Qubits<Type>::materialise()
+{
+	// Moves qubit i back to bit i with one swap pass per misplaced qubit.
+	// With qubits traced out, the active ones take the low bits in order
+	// and the traced ones, which only need relabelling, the bits above.
+	flushPhases();
+
+	vector<int> target(numQubits);
+	int active = 0, traced = numActive;
+
+	for(int i=0; i<numQubits; ++i)
+		target.at(i) = (isActive(i))? active++ : traced++;
+
+	uint64_t values = 0;
+
+	for(int i=0; i<numQubits; ++i)
+	{
+		if(!isActive(i))
+			values |= ((tracedBits >> layout.at(i)) & 1) << target.at(i);
+	}
+
+	for(int i=0; i<numQubits; ++i)
+	{
+		if(!isActive(i) || layout.at(i) == target.at(i))
+			continue;
+
+		int other = find(layout.begin(), layout.end(), target.at(i)) - layout.begin();
+
+		kernel.applySwap(states->data(), numCoeffs, layout.at(i), target.at(i));
+		swap(layout.at(i), layout.at(other));
+	}
+
+	for(int i=0; i<numQubits; ++i)
+	{
+		if(!isActive(i))
+			layout.at(i) = target.at(i);
+	}
+
+	tracedBits = values;
+}
+
+template<class Type>
+CircuitOptimiser<Type>& Qubits<Type>::getOptimiser()
+{
+	return optimiser;
+}
+
+template<class Type>
+void Qubits<Type>::optimiserReport()
+{
+	printf("Optimiser removed %llu gates and %llu sweeps\n",
+		(unsigned long long)optimiser.gatesRemoved(), (unsigned long long)optimiser.sweepsRemoved());
+}
+
+/* Utilities */
+
+template<class Type>
+void Qubits<Type>::flush()
+{
+	// Runs any deferred operations, applies the pending diagonal gates and
+	// puts every qubit back at its own bit. Call before reading states directly.
+	run();
+	flushPhases();
+	materialise();
+}
+
+template<class Type>
+void Qubits<Type>::setMaxFusedPhases(int width)
+{
+	// Largest number of qubits a fused phase table may span.
+	flush();
+	pendingPhases.setMaxWidth(width);
+}
+
+template<class Type>
+unsigned int Qubits<Type>::size()
+{
+	// Reutrns the number of qubits in the system.
+	return numQubits;
+}
+
+template<class Type>
+uint64_t Qubits<Type>::length()
+{
+	// Returns the number of coefficients representing the states, which
+	// halves for every qubit traced out.
+	return numCoeffs;
+}
+
+template<class Type>
+Complex<Type> Qubits<Type>::amplitude(uint64_t index)
+{
+	// Returns the coefficient of the basis state |index⟩; zero where a
+	// traced qubit differs from its known value.
+	run();
+	flushPhases();
+
+	uint64_t physical = physicalIndex(index);
+
+	if((physical & ~(numCoeffs - 1)) != tracedBits)
+		return Complex<Type>(0, 0);
+
+	return (*states)[physical & (numCoeffs - 1)];
+}
+
+template<class Type>
+uint64_t Qubits<Type>::bytesRequired(int qubits)
+{
+	// Returns the size of the state vector in bytes, or zero on overflow.
+	if(qubits < 0 || qubits > MAX_QUBITS)
+		return 0;
+
+	return StateVector<Type>::bytesRequired(1ULL << qubits);
+}
+
+template<class Type>
+void Qubits<Type>::memoryReport(int qubits)
+{
+	printf("State vector of %d qubits:\n", qubits);
+	printf("  float       : %20llu bytes\n", (unsigned long long)Qubits<float>::bytesRequired(qubits));
+	printf("  double      : %20llu bytes\n", (unsigned long long)Qubits<double>::bytesRequired(qubits));
+	printf("  long double : %20llu bytes\n", (unsigned long long)Qubits<long double>::bytesRequired(qubits));
+	printf("  available   : %20llu bytes\n", (unsigned long long)StateVector<Type>::availableMemory());
+}
+
+template<class Type>
+void Qubits<Type>::setRandomSeed(uint64_t seed)
+{
+	generator.seed(seed);
+}
+
+template<class Type>
+Type Qubits<Type>::random()
+{
+	// Uniform in [0, 1) at the precision of Type.
+	return generator.uniform();
+}
+
+template<class Type>
+int Qubits<Type>::getMeasurement(int qubit)
+{
+	// Returns the last outcome recorded for the qubit, or -1 if it has not
+	// been measured.
+	return measurement.at(qubit);
+}
+
+template<class Type>
+vector<int> Qubits<Type>::getMeasurements()
+{
+	return measurement;
+}
+
+template<class Type>
+void Qubits<Type>::setHugePages(bool enable)
+{
+	// Moves the amplitudes into a buffer with or without huge-page backing.
+	if(states->usesHugePages() == enable)
+		return;
+
+	flush();
+
+	StateVector<Type> *newStates = new StateVector<Type>(numCoeffs, enable);
+	memcpy((void *)newStates->data(), states->data(), numCoeffs * sizeof(Complex<Type>));
+
+	delete states;
+	states = newStates;
+}
+
+template<class Type>
+void Qubits<Type>::setNumThreads(int threads)
+{
+	// Zero uses the OpenMP default; has no effect without OpenMP.
+	kernel.setNumThreads(threads);
+}
+
+template<class Type>
+void Qubits<Type>::setParallelThreshold(uint64_t length)
+{
+	// State vectors shorter than this are processed on a single thread.
+	kernel.setParallelThreshold(length);
+}
+
+template<class Type>
+void Qubits<Type>::setSimdLevel(int level)
+{
+	// One of SimdKernels::SCALAR, SSE2, AVX2 or AVX512, capped at what the CPU supports.
+	kernel.setSimdLevel(level);
+	tileKernel.setSimdLevel(level);
+}
+
+template<class Type>
+int Qubits<Type>::simdLevel()
+{
+	return kernel.simdLevel();
+}
+
+template<class Type>
+void Qubits<Type>::print()
+{
+	flush();
+
+	for(uint64_t i=0; i<numCoeffs; ++i)
+	{
+		string decToBin;
+		uint64_t index = logicalIndex(i | tracedBits);
+
+		for(int j=0; j<numQubits; ++j)
+			decToBin.insert(decToBin.begin(), (index >> j & 1) + '0');
+
+		Complex<Type> &coeff = (*states)[i];
+
+		printf("|%s⟩", decToBin.c_str());
+
+		if(coeff.getRe() || coeff.getIm())
+			printf(" = %6.3f +%6.3fi", coeff.getRe(), coeff.getIm());
+		else
+			printf(" =  0             ");
+
+		printf("  (%.3f)\n", coeff.normSq());
+	}
+
+	printf("\n");
+
+	for(int i=0; i<numQubits; ++i)
+	{
+		if(measurement.at(i) >= 0)
+			printf("Qubit%2d: %d\n", i, measurement.at(i));
+	}
+}
+
+template<class Type>
+void Qubits<Type>::save(string location)
+{
+	flush();
+
+	FILE *file;
+	file = fopen(location.c_str(), "wt");
+
+	for(uint64_t i=0; i<numCoeffs; ++i)
+	{
+		string decToBin;
+		uint64_t index = logicalIndex(i | tracedBits);
+
+		for(int j=0; j<numQubits; ++j)
+			decToBin.insert(decToBin.begin(), (index >> j & 1) + '0');
+
+		Complex<Type> &coeff = (*states)[i];
 
 		fprintf(file, "|%s⟩", decToBin.c_str());
-		fprintf(file, " = %6.3f +%6.3fi", states->get(i, 0).getRe(), states->get(i, 0).getIm());
-		fprintf(file, "  (%.3f)\n", states->get(i, 0).normSq());	
+		fprintf(file, " = %6.3f +%6.3fi", coeff.getRe(), coeff.getIm());
+		fprintf(file, "  (%.3f)\n", coeff.normSq());
 	}
 
-	priority_queue<int, vector<int>, greater<int> > temp = measured;
 	fprintf(file, "\n");
 
-	while(!temp.empty())
+	for(int i=0; i<numQubits; ++i)
 	{
-		fprintf(file, "Qubit%2d: %d\n", temp.top(), (measurement >> temp.top()) & 1);
-		temp.pop();
+		if(measurement.at(i) >= 0)
+			fprintf(file, "Qubit%2d: %d\n", i, measurement.at(i));
 	}
 
 	fclose(file);
@@ -0,0 +1,81 @@
+#ifndef QMULATOR_RANDOM_SOURCE_HPP
+#define QMULATOR_RANDOM_SOURCE_HPP
+
+#include <ctime>
+#include <random>
+#include <limits>
+#include <stdint.h>
+#include <math.h>
+
+using namespace std;
+
+/*
+	The random numbers every backend draws from: a 64-bit Mersenne Twister
+	seeded from the device and the clock unless a seed is given, and
+	uniforms in [0, 1) drawn at the precision of Type. Only as many bits
+	as Type can hold exactly are kept, so a float uniform never rounds up
+	to 1 and a draw compared against a total probability always falls
+	below it.
+*/
+
+template<class Type>
+class RandomSource
+{
+private:
+	mt19937_64 generator;
+
+public:
+	RandomSource();
+
+	void seed(uint64_t);
+	uint64_t next();
+	Type uniform();
+
+	static uint64_t deviceSeed();
+	static Type uniform(mt19937_64 &);
+};
+
+template<class Type>
+RandomSource<Type>::RandomSource()
+{
+	generator.seed(deviceSeed());
+}
+
+template<class Type>
+void RandomSource<Type>::seed(uint64_t value)
+{
+	generator.seed(value);
+}
+
+template<class Type>
+uint64_t RandomSource<Type>::next()
+{
+	return generator();
+}
+
+template<class Type>
+Type RandomSource<Type>::uniform()
+{
+	return uniform(generator);
+}
+
+template<class Type>
+uint64_t RandomSource<Type>::deviceSeed()
+{
+	random_device device;
+
+	return ((uint64_t)device() << 32) ^ device() ^ (uint64_t)time(NULL);
+}
+
+template<class Type>
+Type RandomSource<Type>::uniform(mt19937_64 &generator)
+{
+	// The top mantissa-width bits, scaled by 2^-bits: 24 for float and 53
+	// for double, whose draws are the same as before.
+	const int bits = (numeric_limits<Type>::digits < 64)? numeric_limits<Type>::digits : 64;
+	const Type scale = ldexp((Type)1, -bits);
+
+	return (Type)(generator() >> (64 - bits)) * scale;
+}
+
+#endif
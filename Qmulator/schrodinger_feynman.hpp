@@ -0,0 +1,729 @@
+#ifndef QMULATOR_SCHRODINGER_FEYNMAN_HPP
+#define QMULATOR_SCHRODINGER_FEYNMAN_HPP
+
+#include <stdio.h>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "complex.hpp"
+#include "matrix.hpp"
+#include "quantum_gates.hpp"
+#include "circuit.hpp"
+#include "qubits.hpp"
+#include "svd.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+	Schrödinger–Feynman hybrid simulation: the qubits are cut into a lower
+	and an upper half, each held as its own state vector. Gates on one
+	half act on it alone. A gate across the cut is written as a sum of
+	products Σ_k A_k ⊗ B_k, and choosing one term of every crossing gate
+	gives a path along which the two halves again evolve independently;
+	the amplitudes are the sum over all paths of the products of the two
+	halves' amplitudes. A circuit on n qubits with few gates across the cut
+	thus needs two 2^(n/2) vectors per path rather than one 2^n vector.
+
+	Controlled gates take two terms, I ⊗ I + P ⊗ (U - I) with P projecting
+	onto the control values, however many controls sit on either side.
+	Other gates are split by the singular value decomposition of their
+	operator-Schmidt matrix, four terms for a swap. The number of paths is
+	the product of the terms and is known before anything is run.
+
+	Gates before the first crossing gate on each half are shared by every
+	path and run once. Paths are spread across OpenMP threads, each with
+	its own pair of registers, and when there are fewer paths than threads
+	the registers use the threads instead.
+*/
+
+template<class Type>
+class SchrodingerFeynman
+{
+private:
+	enum side: int
+	{
+		LOWER = 0,
+		UPPER = 1,
+	};
+
+	unsigned int numQubits;
+	unsigned int cut;
+
+	// the operations of each half on its own qubits; condition[s][i] is
+	// (-1, 0) for a gate of that half, and (c, t) for the factor applied
+	// only on paths taking term t of crossing gate c
+	Circuit<Type> halves[2];
+	vector<pair<int, int> > condition[2];
+	vector<int> numTerms;
+
+	int numThreads;
+
+	QuantumGates<Type> gate;
+
+	void initialise(int, int);
+	void add(Operation, Matrix<Type> *);
+	void addLocal(int, Operation, Matrix<Type> *);
+	void addFactor(int, vector<int> &, Matrix<Type>, int, int);
+	void splitControlled(Operation &, Matrix<Type> &);
+	void splitSchmidt(Operation &, Matrix<Type>);
+
+	Matrix<Type> fullMatrix(Operation &, Matrix<Type> *);
+	void applyGate(Qubits<Type> &, Circuit<Type> &, Operation &);
+	uint64_t prefixLength(int);
+
+	int threads();
+	int threadIndex();
+
+	void barf(string, string);
+
+public:
+	/* Constructor */
+	SchrodingerFeynman(int);
+	SchrodingerFeynman(int, int);
+
+	/* Quantum Logic Gates */
+	void H(int);
+	void X(int);
+	void Y(int);
+	void Z(int);
+	void T(int);
+	void S(int);
+	void U(Matrix<Type>, int);
+	void U(Matrix<Type>, vector<int>);
+
+	void MCU(vector<int>, int, Matrix<Type>);
+	void MCU(vector<int>, vector<int>, int, Matrix<Type>);
+	void CNOT(int, int);
+	void CY(int, int);
+	void CZ(int, int);
+	void Toffoli(int, int, int);
+
+	void Swap(int, int);
+
+	/* Simulation */
+	double numPaths();
+	int crossingGates();
+	uint64_t bytesPerPath();
+	void printPlan();
+
+	Complex<Type> amplitude(uint64_t);
+	vector<Complex<Type> > amplitudes(vector<uint64_t>);
+
+	/* Utilities */
+	unsigned int size();
+	unsigned int cutPosition();
+	void setNumThreads(int);
+};
+
+/* Constructor */
+
+template<class Type>
+SchrodingerFeynman<Type>::SchrodingerFeynman(int qubits)
+{
+	initialise(qubits, qubits / 2);
+}
+
+template<class Type>
+SchrodingerFeynman<Type>::SchrodingerFeynman(int qubits, int lower)
+{
+	initialise(qubits, lower);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::initialise(int qubits, int lower)
+{
+	// Qubits 0 .. lower-1 form the lower half and the rest the upper half.
+	if(qubits < 2 || qubits > 64)
+		barf("SchrodingerFeynman", "number of qubits must be between 2 and 64");
+
+	if(lower < 1 || lower >= qubits)
+		barf("SchrodingerFeynman", "both halves need at least one qubit");
+
+	if(lower > Qubits<Type>::MAX_QUBITS || qubits - lower > Qubits<Type>::MAX_QUBITS)
+		barf("SchrodingerFeynman", "half exceeds the largest state vector");
+
+	numQubits = qubits;
+	cut = lower;
+	numThreads = 0;
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::barf(string function, string message)
+{
+	cout << "[error] " << "<" << function << ">";
+	cout << " " << message << endl;
+	exit(1);
+}
+
+template<class Type>
+int SchrodingerFeynman<Type>::threads()
+{
+#ifdef _OPENMP
+	return (numThreads > 0)? numThreads : omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+template<class Type>
+int SchrodingerFeynman<Type>::threadIndex()
+{
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
+/* Quantum Logic Gates */
+
+template<class Type>
+void SchrodingerFeynman<Type>::H(int qubit)
+{
+	add(Operation(Operation::H, qubit), NULL);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::X(int qubit)
+{
+	add(Operation(Operation::X, qubit), NULL);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::Y(int qubit)
+{
+	add(Operation(Operation::Y, qubit), NULL);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::Z(int qubit)
+{
+	add(Operation(Operation::Z, qubit), NULL);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::T(int qubit)
+{
+	add(Operation(Operation::T, qubit), NULL);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::S(int qubit)
+{
+	add(Operation(Operation::S, qubit), NULL);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::U(Matrix<Type> u, int qubit)
+{
+	add(Operation(Operation::U, qubit), &u);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::U(Matrix<Type> u, vector<int> qubits)
+{
+	// Bit j of the matrix index is qubits[j], as for Qubits.
+	if(u.rows() != (1 << qubits.size()) || u.cols() != u.rows())
+		barf("U", "matrix does not match the number of qubits");
+
+	add(Operation(Operation::UNITARY, qubits), &u);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::MCU(vector<int> controls, int target, Matrix<Type> u)
+{
+	MCU(controls, vector<int>(), target, u);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::MCU(vector<int> controls, vector<int> openControls, int target, Matrix<Type> u)
+{
+	vector<int> qubits = controls;
+	qubits.insert(qubits.end(), openControls.begin(), openControls.end());
+	qubits.push_back(target);
+
+	Operation op(Operation::MCU, qubits);
+	op.numControls = controls.size();
+	op.numOpenControls = openControls.size();
+
+	add(op, &u);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::CNOT(int control, int target)
+{
+	add(Operation(Operation::CNOT, control, target), NULL);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::CY(int control, int target)
+{
+	add(Operation(Operation::CY, control, target), NULL);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::CZ(int control, int target)
+{
+	add(Operation(Operation::CZ, control, target), NULL);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::Toffoli(int control1, int control2, int target)
+{
+	add(Operation(Operation::TOFFOLI, control1, control2, target), NULL);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::Swap(int qubit1, int qubit2)
+{
+	add(Operation(Operation::SWAP, qubit1, qubit2), NULL);
+}
+
+/* Circuit Splitting */
+
+template<class Type>
+void SchrodingerFeynman<Type>::add(Operation op, Matrix<Type> *u)
+{
+	// Sends a gate to the half holding all its qubits, or splits it.
+	int lower = 0;
+
+	for(int j=0; j<op.qubits.size(); ++j)
+	{
+		if(op.qubits.at(j) < 0 || op.qubits.at(j) >= numQubits)
+			barf("SchrodingerFeynman", "qubit out of range");
+
+		for(int k=0; k<j; ++k)
+		{
+			if(op.qubits.at(k) == op.qubits.at(j))
+				barf("SchrodingerFeynman", "qubits must be distinct");
+		}
+
+		lower += (op.qubits.at(j) < cut);
+	}
+
+	if(lower == op.qubits.size())
+		addLocal(LOWER, op, u);
+	else if(lower == 0)
+		addLocal(UPPER, op, u);
+	else if(op.type == Operation::SWAP || op.type == Operation::UNITARY)
+		splitSchmidt(op, fullMatrix(op, u));
+	else
+		splitControlled(op, *u);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::addLocal(int s, Operation op, Matrix<Type> *u)
+{
+	for(int j=0; j<op.qubits.size(); ++j)
+		op.qubits.at(j) -= (s == UPPER)? cut : 0;
+
+	if(u == NULL)
+		halves[s].add(op);
+	else
+		halves[s].add(op, *u);
+
+	condition[s].push_back(make_pair(-1, 0));
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::addFactor(int s, vector<int> &qubits, Matrix<Type> u, int crossing, int term)
+{
+	// The factor of term `term` of a crossing gate on half s.
+	vector<int> local = qubits;
+
+	for(int j=0; j<local.size(); ++j)
+		local.at(j) -= (s == UPPER)? cut : 0;
+
+	halves[s].add(Operation(Operation::UNITARY, local), u);
+	condition[s].push_back(make_pair(crossing, term));
+}
+
+template<class Type>
+Matrix<Type> SchrodingerFeynman<Type>::fullMatrix(Operation &op, Matrix<Type> *u)
+{
+	// The matrix of a swap or general gate, bit j of its index op.qubits[j].
+	if(op.type == Operation::UNITARY)
+		return *u;
+
+	Matrix<Type> swap(4, 4);
+	swap.set(0, 0, 1, 0);
+	swap.set(1, 2, 1, 0);
+	swap.set(2, 1, 1, 0);
+	swap.set(3, 3, 1, 0);
+
+	return swap;
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::splitControlled(Operation &op, Matrix<Type> &u)
+{
+	// I ⊗ I + P_a ⊗ P_b (U - I): the first term does nothing on either half
+	// and the second projects each half onto its control values, applying
+	// U - I to the target on its half.
+	int closed = op.numControls, open = op.numOpenControls;
+	Matrix<Type> target = gate.Pauli_X();
+
+	switch(op.type)
+	{
+		case Operation::CNOT: closed = 1; open = 0; break;
+		case Operation::CY: closed = 1; open = 0; target = gate.Pauli_Y(); break;
+		case Operation::CZ: closed = 1; open = 0; target = gate.Pauli_Z(); break;
+		case Operation::TOFFOLI: closed = 2; open = 0; break;
+		case Operation::MCU: target = u; break;
+	}
+
+	int crossing = numTerms.size();
+	numTerms.push_back(2);
+
+	int t = op.target();
+	int targetSide = (t < cut)? LOWER : UPPER;
+
+	for(int s=LOWER; s<=UPPER; ++s)
+	{
+		vector<int> qubits, values;
+
+		for(int j=0; j<closed+open; ++j)
+		{
+			int q = op.qubits.at(j);
+
+			if((q < cut) == (s == LOWER))
+			{
+				qubits.push_back(q);
+				values.push_back(j < closed);
+			}
+		}
+
+		bool hasTarget = (s == targetSide);
+
+		if(hasTarget)
+			qubits.push_back(t);
+
+		uint64_t dim = 1ULL << qubits.size();
+		uint64_t top = (hasTarget)? dim / 2 : 0;
+		Matrix<Type> factor(dim, dim);
+
+		for(uint64_t row=0; row<dim; ++row)
+		{
+			for(uint64_t col=0; col<dim; ++col)
+			{
+				// both row and column must meet the controls, and agree
+				// on them; the target bit picks the entry of U - I
+				bool selected = true;
+
+				for(int j=0; j<values.size(); ++j)
+				{
+					selected &= ((row >> j) & 1) == values.at(j);
+					selected &= ((col >> j) & 1) == values.at(j);
+				}
+
+				if(!selected || (row & ~top) != (col & ~top))
+					continue;
+
+				if(!hasTarget)
+				{
+					factor.set(row, col, 1, 0);
+					continue;
+				}
+
+				int r = (row & top)? 1 : 0, c = (col & top)? 1 : 0;
+				Complex<Type> entry = target.get(r, c) - Complex<Type>((r == c)? 1 : 0, 0);
+				factor.set(row, col, entry.getRe(), entry.getIm());
+			}
+		}
+
+		addFactor(s, qubits, factor, crossing, 1);
+	}
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::splitSchmidt(Operation &op, Matrix<Type> u)
+{
+	// Reshapes the gate into R[(r_a, c_a), (r_b, c_b)] = U[r][c] with a
+	// and b the bits of the lower and upper qubits; R = Σ s_k u_k v_k†
+	// gives the terms (s_k u_k) ⊗ conj(v_k), negligible ones dropped.
+	vector<int> position[2], qubits[2];
+
+	for(int j=0; j<op.qubits.size(); ++j)
+	{
+		int s = (op.qubits.at(j) < cut)? LOWER : UPPER;
+		position[s].push_back(j);
+		qubits[s].push_back(op.qubits.at(j));
+	}
+
+	uint64_t dim[2] = {1ULL << qubits[LOWER].size(), 1ULL << qubits[UPPER].size()};
+	uint64_t rows = dim[LOWER] * dim[LOWER], cols = dim[UPPER] * dim[UPPER];
+
+	vector<Complex<Type> > reshaped(rows * cols);
+
+	for(uint64_t r=0; r<u.rows(); ++r)
+	{
+		for(uint64_t c=0; c<u.cols(); ++c)
+		{
+			uint64_t part[2][2] = {{0, 0}, {0, 0}};
+
+			for(int s=LOWER; s<=UPPER; ++s)
+			{
+				for(int j=0; j<position[s].size(); ++j)
+				{
+					part[s][0] |= ((r >> position[s].at(j)) & 1) << j;
+					part[s][1] |= ((c >> position[s].at(j)) & 1) << j;
+				}
+			}
+
+			uint64_t i = part[LOWER][0] + part[LOWER][1] * dim[LOWER];
+			uint64_t k = part[UPPER][0] + part[UPPER][1] * dim[UPPER];
+			reshaped[i * cols + k] = u.get(r, c);
+		}
+	}
+
+	vector<Complex<Type> > left, right;
+	vector<Type> singular;
+	SVD<Type>::compute(rows, cols, reshaped.data(), left, singular, right);
+
+	int rank = singular.size();
+	int kept = 0;
+
+	while(kept < rank && singular.at(kept) > singular.at(0) * numeric_limits<Type>::epsilon() * rank * 16)
+		++kept;
+
+	int crossing = numTerms.size();
+	numTerms.push_back(kept);
+
+	for(int k=0; k<kept; ++k)
+	{
+		Matrix<Type> a(dim[LOWER], dim[LOWER]), b(dim[UPPER], dim[UPPER]);
+
+		for(uint64_t i=0; i<rows; ++i)
+			a.set(i % dim[LOWER], i / dim[LOWER], left[i * rank + k] * Complex<Type>(singular.at(k), 0));
+
+		for(uint64_t i=0; i<cols; ++i)
+		{
+			Complex<Type> entry = right[i * rank + k];
+			b.set(i % dim[UPPER], i / dim[UPPER], entry.getRe(), -entry.getIm());
+		}
+
+		addFactor(LOWER, qubits[LOWER], a, crossing, k);
+		addFactor(UPPER, qubits[UPPER], b, crossing, k);
+	}
+}
+
+/* Simulation */
+
+template<class Type>
+double SchrodingerFeynman<Type>::numPaths()
+{
+	// Product of the terms of the crossing gates; as a double since it
+	// grows exponentially with them.
+	double paths = 1;
+
+	for(int c=0; c<numTerms.size(); ++c)
+		paths *= numTerms.at(c);
+
+	return paths;
+}
+
+template<class Type>
+int SchrodingerFeynman<Type>::crossingGates()
+{
+	return numTerms.size();
+}
+
+template<class Type>
+uint64_t SchrodingerFeynman<Type>::bytesPerPath()
+{
+	// The two half registers each thread holds.
+	return Qubits<Type>::bytesRequired(cut) + Qubits<Type>::bytesRequired(numQubits - cut);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::printPlan()
+{
+	printf("Cut %u | %u qubits, %d crossing gates, %.6g paths\n", cut, numQubits - cut, crossingGates(), numPaths());
+	printf("%zu + %zu operations per path, %.3g MB of registers per thread\n",
+		halves[LOWER].size(), halves[UPPER].size(), bytesPerPath() / 1048576.0);
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::applyGate(Qubits<Type> &state, Circuit<Type> &ops, Operation &op)
+{
+	Matrix<Type> *u = (op.hasMatrix())? &ops.matrix(op) : NULL;
+	vector<int> &q = op.qubits;
+
+	switch(op.type)
+	{
+		case Operation::H: state.H(q.at(0)); break;
+		case Operation::X: state.X(q.at(0)); break;
+		case Operation::Y: state.Y(q.at(0)); break;
+		case Operation::Z: state.Z(q.at(0)); break;
+		case Operation::T: state.T(q.at(0)); break;
+		case Operation::S: state.S(q.at(0)); break;
+		case Operation::U: state.U(*u, q.at(0)); break;
+		case Operation::UNITARY: state.U(*u, q); break;
+		case Operation::CNOT: state.CNOT(q.at(0), q.at(1)); break;
+		case Operation::CY: state.CY(q.at(0), q.at(1)); break;
+		case Operation::CZ: state.CZ(q.at(0), q.at(1)); break;
+		case Operation::TOFFOLI: state.Toffoli(q.at(0), q.at(1), q.at(2)); break;
+		case Operation::SWAP: state.Swap(q.at(0), q.at(1)); break;
+
+		case Operation::MCU:
+		{
+			vector<int> controls(q.begin(), q.begin() + op.numControls);
+			vector<int> openControls(q.begin() + op.numControls, q.end() - 1);
+			state.MCU(controls, openControls, op.target(), *u);
+			break;
+		}
+	}
+}
+
+template<class Type>
+uint64_t SchrodingerFeynman<Type>::prefixLength(int s)
+{
+	// Operations of half s before its first factor, common to all paths.
+	uint64_t length = 0;
+
+	while(length < condition[s].size() && condition[s].at(length).first < 0)
+		++length;
+
+	return length;
+}
+
+template<class Type>
+vector<Complex<Type> > SchrodingerFeynman<Type>::amplitudes(vector<uint64_t> indices)
+{
+	// ⟨x|C|0⟩ for each basis index x, bit q being qubit q. Every path runs
+	// both halves and adds the products of their amplitudes.
+	double total = numPaths();
+
+	if(total > (double)(1ULL << 62))
+		barf("amplitudes", "too many paths");
+
+	uint64_t paths = total;
+	uint64_t lowMask = (1ULL << cut) - 1;
+
+	for(int i=0; i<indices.size(); ++i)
+	{
+		if(numQubits < 64 && (indices.at(i) >> numQubits) != 0)
+			barf("amplitudes", "index out of range");
+	}
+
+	bool outer = paths > 1 && paths >= threads();
+
+	// the gates every path shares, run once
+	vector<Qubits<Type> *> prefix(2);
+	uint64_t shared[2];
+
+	for(int s=LOWER; s<=UPPER; ++s)
+	{
+		prefix.at(s) = new Qubits<Type>((s == LOWER)? cut : numQubits - cut);
+		prefix.at(s)->enableGraphics = false;
+		prefix.at(s)->setNumThreads(threads());
+
+		shared[s] = prefixLength(s);
+
+		for(uint64_t i=0; i<shared[s]; ++i)
+			applyGate(*prefix.at(s), halves[s], halves[s].at(i));
+
+		prefix.at(s)->flush();
+	}
+
+	vector<vector<Complex<Type> > > partial(threads(), vector<Complex<Type> >(indices.size(), Complex<Type>(0, 0)));
+
+	#pragma omp parallel num_threads(threads()) if(outer)
+	{
+		Qubits<Type> lower(cut), upper(numQubits - cut);
+		Qubits<Type> *state[2] = {&lower, &upper};
+		vector<int> choice(numTerms.size());
+		vector<Complex<Type> > &sum = partial.at(threadIndex());
+
+		for(int s=LOWER; s<=UPPER; ++s)
+		{
+			state[s]->enableGraphics = false;
+			state[s]->setNumThreads((outer)? 1 : threads());
+		}
+
+		#pragma omp for schedule(static)
+		for(uint64_t path=0; path<paths; ++path)
+		{
+			// mixed-radix digits of the path pick the term of each gate
+			uint64_t rest = path;
+
+			for(int c=0; c<numTerms.size(); ++c)
+			{
+				choice.at(c) = rest % numTerms.at(c);
+				rest /= numTerms.at(c);
+			}
+
+			for(int s=LOWER; s<=UPPER; ++s)
+			{
+				Qubits<Type> &half = *state[s];
+
+				half.flush();
+				memcpy((void *)half.states->data(), prefix.at(s)->states->data(), half.length() * sizeof(Complex<Type>));
+
+				for(uint64_t i=shared[s]; i<halves[s].size(); ++i)
+				{
+					pair<int, int> &when = condition[s].at(i);
+
+					if(when.first < 0 || choice.at(when.first) == when.second)
+						applyGate(half, halves[s], halves[s].at(i));
+				}
+
+				half.flush();
+			}
+
+			for(int i=0; i<indices.size(); ++i)
+			{
+				uint64_t x = indices.at(i);
+				sum.at(i) += (*lower.states)[x & lowMask] * (*upper.states)[x >> cut];
+			}
+		}
+	}
+
+	for(int s=LOWER; s<=UPPER; ++s)
+		delete prefix.at(s);
+
+	vector<Complex<Type> > result(indices.size(), Complex<Type>(0, 0));
+
+	for(int t=0; t<partial.size(); ++t)
+	{
+		for(int i=0; i<indices.size(); ++i)
+			result.at(i) += partial.at(t).at(i);
+	}
+
+	return result;
+}
+
+template<class Type>
+Complex<Type> SchrodingerFeynman<Type>::amplitude(uint64_t index)
+{
+	return amplitudes(vector<uint64_t>(1, index)).at(0);
+}
+
+/* Utilities */
+
+template<class Type>
+unsigned int SchrodingerFeynman<Type>::size()
+{
+	return numQubits;
+}
+
+template<class Type>
+unsigned int SchrodingerFeynman<Type>::cutPosition()
+{
+	// Number of qubits in the lower half.
+	return cut;
+}
+
+template<class Type>
+void SchrodingerFeynman<Type>::setNumThreads(int threads)
+{
+	// Threads for the paths; zero uses the OpenMP default.
+	numThreads = (threads > 0)? threads : 0;
+}
+
+#endif
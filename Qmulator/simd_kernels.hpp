@@ -0,0 +1,370 @@
+#ifndef QMULATOR_SIMD_KERNELS_HPP
+#define QMULATOR_SIMD_KERNELS_HPP
+
+#include <stdint.h>
+#include "complex.hpp"
+
+/*
+	Vectorised gate kernels for Complex<float> and Complex<double> on x86.
+	Amplitudes are read in their interleaved (re, im) layout; a complex
+	product costs one permute and one fused multiply-add-subtract per
+	vector. The instruction set is picked at runtime, so one binary runs on
+	any x86-64 CPU and uses AVX2 or AVX-512 where present.
+
+	Each kernel walks the pair counter k over [kBegin, kEnd) in steps of the
+	vector width W (complex numbers per register), which requires W to
+	divide kBegin and every fixed bit of the index to be at position
+	log2(W) or above. GateKernels checks this and falls back to the scalar
+	loop otherwise.
+*/
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define QMULATOR_SIMD
+#include <immintrin.h>
+#endif
+
+class SimdKernels
+{
+public:
+	enum level: int
+	{
+		SCALAR = 0,
+		SSE2 = 1,
+		AVX2 = 2,
+		AVX512 = 3,
+	};
+
+	static level detect();
+	static const char* name(int);
+	static int width(int, int);
+
+	/* Kernels (return false if the level or type is not supported) */
+	static bool applySingle(int, Complex<double> *, uint64_t, uint64_t, int, Complex<double> *);
+	static bool applySingle(int, Complex<float> *, uint64_t, uint64_t, int, Complex<float> *);
+
+	static bool applyControlled(int, Complex<double> *, uint64_t, uint64_t, int *, int, uint64_t, uint64_t, Complex<double> *);
+	static bool applyControlled(int, Complex<float> *, uint64_t, uint64_t, int *, int, uint64_t, uint64_t, Complex<float> *);
+
+	static bool applyDiagonal(int, Complex<double> *, uint64_t, uint64_t, int, Complex<double> *);
+	static bool applyDiagonal(int, Complex<float> *, uint64_t, uint64_t, int, Complex<float> *);
+
+	template<class T>
+	static bool applySingle(int, Complex<T> *, uint64_t, uint64_t, int, Complex<T> *) { return false; }
+
+	template<class T>
+	static bool applyControlled(int, Complex<T> *, uint64_t, uint64_t, int *, int, uint64_t, uint64_t, Complex<T> *) { return false; }
+
+	template<class T>
+	static bool applyDiagonal(int, Complex<T> *, uint64_t, uint64_t, int, Complex<T> *) { return false; }
+};
+
+inline SimdKernels::level SimdKernels::detect()
+{
+#ifdef QMULATOR_SIMD
+	__builtin_cpu_init();
+
+	if(__builtin_cpu_supports("avx512f"))
+		return AVX512;
+
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return AVX2;
+
+	if(__builtin_cpu_supports("sse2"))
+		return SSE2;
+#endif
+
+	return SCALAR;
+}
+
+inline const char* SimdKernels::name(int simd)
+{
+	switch(simd)
+	{
+		case SSE2: return "SSE2";
+		case AVX2: return "AVX2";
+		case AVX512: return "AVX-512";
+		default: return "scalar";
+	}
+}
+
+inline int SimdKernels::width(int simd, int scalarSize)
+{
+	// Returns the number of complex numbers held by one register.
+	int bytes;
+
+	switch(simd)
+	{
+		case SSE2: bytes = 16; break;
+		case AVX2: bytes = 32; break;
+		case AVX512: bytes = 64; break;
+		default: return 0;
+	}
+
+	if(scalarSize != sizeof(float) && scalarSize != sizeof(double))
+		return 0;
+
+	return bytes / (2 * scalarSize);
+}
+
+#ifdef QMULATOR_SIMD
+
+#define QMULATOR_TARGET_SSE2 __attribute__((target("sse2"), always_inline))
+#define QMULATOR_TARGET_AVX2 __attribute__((target("avx2,fma"), always_inline))
+#define QMULATOR_TARGET_AVX512 __attribute__((target("avx512f"), always_inline))
+
+/*
+	Register operations. cmul(a, re, im) multiplies every complex number in
+	a by the coefficient whose broadcast parts come from coeffRe and coeffIm.
+*/
+
+struct Sse2Double
+{
+	typedef double scalar;
+	typedef __m128d vec;
+	static const int WIDTH = 1;
+
+	static inline QMULATOR_TARGET_SSE2 vec load(const double *p) { return _mm_loadu_pd(p); }
+	static inline QMULATOR_TARGET_SSE2 void store(double *p, vec v) { _mm_storeu_pd(p, v); }
+	static inline QMULATOR_TARGET_SSE2 vec add(vec a, vec b) { return _mm_add_pd(a, b); }
+	static inline QMULATOR_TARGET_SSE2 vec coeffRe(double re, double) { return _mm_set1_pd(re); }
+	static inline QMULATOR_TARGET_SSE2 vec coeffIm(double, double im) { return _mm_setr_pd(-im, im); }
+
+	static inline QMULATOR_TARGET_SSE2 vec cmul(vec a, vec re, vec im)
+	{
+		return _mm_add_pd(_mm_mul_pd(a, re), _mm_mul_pd(_mm_shuffle_pd(a, a, 1), im));
+	}
+};
+
+struct Sse2Float
+{
+	typedef float scalar;
+	typedef __m128 vec;
+	static const int WIDTH = 2;
+
+	static inline QMULATOR_TARGET_SSE2 vec load(const float *p) { return _mm_loadu_ps(p); }
+	static inline QMULATOR_TARGET_SSE2 void store(float *p, vec v) { _mm_storeu_ps(p, v); }
+	static inline QMULATOR_TARGET_SSE2 vec add(vec a, vec b) { return _mm_add_ps(a, b); }
+	static inline QMULATOR_TARGET_SSE2 vec coeffRe(float re, float) { return _mm_set1_ps(re); }
+	static inline QMULATOR_TARGET_SSE2 vec coeffIm(float, float im) { return _mm_setr_ps(-im, im, -im, im); }
+
+	static inline QMULATOR_TARGET_SSE2 vec cmul(vec a, vec re, vec im)
+	{
+		vec swapped = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1));
+
+		return _mm_add_ps(_mm_mul_ps(a, re), _mm_mul_ps(swapped, im));
+	}
+};
+
+struct Avx2Double
+{
+	typedef double scalar;
+	typedef __m256d vec;
+	static const int WIDTH = 2;
+
+	static inline QMULATOR_TARGET_AVX2 vec load(const double *p) { return _mm256_loadu_pd(p); }
+	static inline QMULATOR_TARGET_AVX2 void store(double *p, vec v) { _mm256_storeu_pd(p, v); }
+	static inline QMULATOR_TARGET_AVX2 vec add(vec a, vec b) { return _mm256_add_pd(a, b); }
+	static inline QMULATOR_TARGET_AVX2 vec coeffRe(double re, double) { return _mm256_set1_pd(re); }
+	static inline QMULATOR_TARGET_AVX2 vec coeffIm(double, double im) { return _mm256_set1_pd(im); }
+
+	static inline QMULATOR_TARGET_AVX2 vec cmul(vec a, vec re, vec im)
+	{
+		return _mm256_fmaddsub_pd(a, re, _mm256_mul_pd(_mm256_permute_pd(a, 0x5), im));
+	}
+};
+
+struct Avx2Float
+{
+	typedef float scalar;
+	typedef __m256 vec;
+	static const int WIDTH = 4;
+
+	static inline QMULATOR_TARGET_AVX2 vec load(const float *p) { return _mm256_loadu_ps(p); }
+	static inline QMULATOR_TARGET_AVX2 void store(float *p, vec v) { _mm256_storeu_ps(p, v); }
+	static inline QMULATOR_TARGET_AVX2 vec add(vec a, vec b) { return _mm256_add_ps(a, b); }
+	static inline QMULATOR_TARGET_AVX2 vec coeffRe(float re, float) { return _mm256_set1_ps(re); }
+	static inline QMULATOR_TARGET_AVX2 vec coeffIm(float, float im) { return _mm256_set1_ps(im); }
+
+	static inline QMULATOR_TARGET_AVX2 vec cmul(vec a, vec re, vec im)
+	{
+		return _mm256_fmaddsub_ps(a, re, _mm256_mul_ps(_mm256_permute_ps(a, 0xB1), im));
+	}
+};
+
+struct Avx512Double
+{
+	typedef double scalar;
+	typedef __m512d vec;
+	static const int WIDTH = 4;
+
+	static inline QMULATOR_TARGET_AVX512 vec load(const double *p) { return _mm512_loadu_pd(p); }
+	static inline QMULATOR_TARGET_AVX512 void store(double *p, vec v) { _mm512_storeu_pd(p, v); }
+	static inline QMULATOR_TARGET_AVX512 vec add(vec a, vec b) { return _mm512_add_pd(a, b); }
+	static inline QMULATOR_TARGET_AVX512 vec coeffRe(double re, double) { return _mm512_set1_pd(re); }
+	static inline QMULATOR_TARGET_AVX512 vec coeffIm(double, double im) { return _mm512_set1_pd(im); }
+
+	static inline QMULATOR_TARGET_AVX512 vec cmul(vec a, vec re, vec im)
+	{
+		return _mm512_fmaddsub_pd(a, re, _mm512_mul_pd(_mm512_shuffle_pd(a, a, 0x55), im));
+	}
+};
+
+struct Avx512Float
+{
+	typedef float scalar;
+	typedef __m512 vec;
+	static const int WIDTH = 8;
+
+	static inline QMULATOR_TARGET_AVX512 vec load(const float *p) { return _mm512_loadu_ps(p); }
+	static inline QMULATOR_TARGET_AVX512 void store(float *p, vec v) { _mm512_storeu_ps(p, v); }
+	static inline QMULATOR_TARGET_AVX512 vec add(vec a, vec b) { return _mm512_add_ps(a, b); }
+	static inline QMULATOR_TARGET_AVX512 vec coeffRe(float re, float) { return _mm512_set1_ps(re); }
+	static inline QMULATOR_TARGET_AVX512 vec coeffIm(float, float im) { return _mm512_set1_ps(im); }
+
+	static inline QMULATOR_TARGET_AVX512 vec cmul(vec a, vec re, vec im)
+	{
+		return _mm512_fmaddsub_ps(a, re, _mm512_mul_ps(_mm512_shuffle_ps(a, a, 0xB1), im));
+	}
+};
+
+/*
+	Kernel bodies, stamped out once per instruction set so that each copy is
+	compiled for its own target and the register operations inline.
+*/
+
+#define QMULATOR_SIMD_BODIES(NAME, TARGET) \
+struct NAME \
+{ \
+	template<class V> \
+	static TARGET void single(typename V::scalar *amps, uint64_t kBegin, uint64_t kEnd, \
+		int qubit, Complex<typename V::scalar> *u) \
+	{ \
+		typename V::vec r00 = V::coeffRe(u[0].getRe(), u[0].getIm()), i00 = V::coeffIm(u[0].getRe(), u[0].getIm()); \
+		typename V::vec r01 = V::coeffRe(u[1].getRe(), u[1].getIm()), i01 = V::coeffIm(u[1].getRe(), u[1].getIm()); \
+		typename V::vec r10 = V::coeffRe(u[2].getRe(), u[2].getIm()), i10 = V::coeffIm(u[2].getRe(), u[2].getIm()); \
+		typename V::vec r11 = V::coeffRe(u[3].getRe(), u[3].getIm()), i11 = V::coeffIm(u[3].getRe(), u[3].getIm()); \
+		uint64_t stride = 1ULL << qubit; \
+		uint64_t lowMask = stride - 1; \
+		\
+		for(uint64_t k=kBegin; k<kEnd; k+=V::WIDTH) \
+		{ \
+			uint64_t i = ((k & ~lowMask) << 1) | (k & lowMask); \
+			typename V::vec a0 = V::load(amps + 2 * i); \
+			typename V::vec a1 = V::load(amps + 2 * (i + stride)); \
+			\
+			V::store(amps + 2 * i, V::add(V::cmul(a0, r00, i00), V::cmul(a1, r01, i01))); \
+			V::store(amps + 2 * (i + stride), V::add(V::cmul(a0, r10, i10), V::cmul(a1, r11, i11))); \
+		} \
+	} \
+	\
+	template<class V> \
+	static TARGET void controlled(typename V::scalar *amps, uint64_t kBegin, uint64_t kEnd, \
+		int *fixedBits, int numFixed, uint64_t setBits, uint64_t stride, Complex<typename V::scalar> *u) \
+	{ \
+		typename V::vec r00 = V::coeffRe(u[0].getRe(), u[0].getIm()), i00 = V::coeffIm(u[0].getRe(), u[0].getIm()); \
+		typename V::vec r01 = V::coeffRe(u[1].getRe(), u[1].getIm()), i01 = V::coeffIm(u[1].getRe(), u[1].getIm()); \
+		typename V::vec r10 = V::coeffRe(u[2].getRe(), u[2].getIm()), i10 = V::coeffIm(u[2].getRe(), u[2].getIm()); \
+		typename V::vec r11 = V::coeffRe(u[3].getRe(), u[3].getIm()), i11 = V::coeffIm(u[3].getRe(), u[3].getIm()); \
+		\
+		for(uint64_t k=kBegin; k<kEnd; k+=V::WIDTH) \
+		{ \
+			uint64_t i = k; \
+			\
+			for(int j=0; j<numFixed; ++j) \
+				i = ((i >> fixedBits[j]) << (fixedBits[j] + 1)) | (i & ((1ULL << fixedBits[j]) - 1)); \
+			\
+			i |= setBits; \
+			typename V::vec a0 = V::load(amps + 2 * i); \
+			typename V::vec a1 = V::load(amps + 2 * (i | stride)); \
+			\
+			V::store(amps + 2 * i, V::add(V::cmul(a0, r00, i00), V::cmul(a1, r01, i01))); \
+			V::store(amps + 2 * (i | stride), V::add(V::cmul(a0, r10, i10), V::cmul(a1, r11, i11))); \
+		} \
+	} \
+	\
+	template<class V> \
+	static TARGET void diagonal(typename V::scalar *amps, uint64_t kBegin, uint64_t kEnd, \
+		int qubit, Complex<typename V::scalar> *d) \
+	{ \
+		typename V::vec r0 = V::coeffRe(d[0].getRe(), d[0].getIm()), i0 = V::coeffIm(d[0].getRe(), d[0].getIm()); \
+		typename V::vec r1 = V::coeffRe(d[1].getRe(), d[1].getIm()), i1 = V::coeffIm(d[1].getRe(), d[1].getIm()); \
+		uint64_t stride = 1ULL << qubit; \
+		uint64_t lowMask = stride - 1; \
+		\
+		for(uint64_t k=kBegin; k<kEnd; k+=V::WIDTH) \
+		{ \
+			uint64_t i = ((k & ~lowMask) << 1) | (k & lowMask); \
+			\
+			V::store(amps + 2 * i, V::cmul(V::load(amps + 2 * i), r0, i0)); \
+			V::store(amps + 2 * (i + stride), V::cmul(V::load(amps + 2 * (i + stride)), r1, i1)); \
+		} \
+	} \
+};
+
+QMULATOR_SIMD_BODIES(Sse2Bodies, __attribute__((target("sse2"))))
+QMULATOR_SIMD_BODIES(Avx2Bodies, __attribute__((target("avx2,fma"))))
+QMULATOR_SIMD_BODIES(Avx512Bodies, __attribute__((target("avx512f"))))
+
+#undef QMULATOR_SIMD_BODIES
+
+#define QMULATOR_SIMD_DISPATCH(SUFFIX, CALL, ARGS) \
+	switch(simd) \
+	{ \
+		case SSE2: Sse2Bodies::CALL<Sse2##SUFFIX> ARGS; return true; \
+		case AVX2: Avx2Bodies::CALL<Avx2##SUFFIX> ARGS; return true; \
+		case AVX512: Avx512Bodies::CALL<Avx512##SUFFIX> ARGS; return true; \
+		default: return false; \
+	}
+
+inline bool SimdKernels::applySingle(int simd, Complex<double> *states, uint64_t kBegin, uint64_t kEnd,
+	int qubit, Complex<double> *u)
+{
+	QMULATOR_SIMD_DISPATCH(Double, single, ((double *)states, kBegin, kEnd, qubit, u))
+}
+
+inline bool SimdKernels::applySingle(int simd, Complex<float> *states, uint64_t kBegin, uint64_t kEnd,
+	int qubit, Complex<float> *u)
+{
+	QMULATOR_SIMD_DISPATCH(Float, single, ((float *)states, kBegin, kEnd, qubit, u))
+}
+
+inline bool SimdKernels::applyControlled(int simd, Complex<double> *states, uint64_t kBegin, uint64_t kEnd,
+	int *fixedBits, int numFixed, uint64_t setBits, uint64_t stride, Complex<double> *u)
+{
+	QMULATOR_SIMD_DISPATCH(Double, controlled,
+		((double *)states, kBegin, kEnd, fixedBits, numFixed, setBits, stride, u))
+}
+
+inline bool SimdKernels::applyControlled(int simd, Complex<float> *states, uint64_t kBegin, uint64_t kEnd,
+	int *fixedBits, int numFixed, uint64_t setBits, uint64_t stride, Complex<float> *u)
+{
+	QMULATOR_SIMD_DISPATCH(Float, controlled,
+		((float *)states, kBegin, kEnd, fixedBits, numFixed, setBits, stride, u))
+}
+
+inline bool SimdKernels::applyDiagonal(int simd, Complex<double> *states, uint64_t kBegin, uint64_t kEnd,
+	int qubit, Complex<double> *d)
+{
+	QMULATOR_SIMD_DISPATCH(Double, diagonal, ((double *)states, kBegin, kEnd, qubit, d))
+}
+
+inline bool SimdKernels::applyDiagonal(int simd, Complex<float> *states, uint64_t kBegin, uint64_t kEnd,
+	int qubit, Complex<float> *d)
+{
+	QMULATOR_SIMD_DISPATCH(Float, diagonal, ((float *)states, kBegin, kEnd, qubit, d))
+}
+
+#undef QMULATOR_SIMD_DISPATCH
+
+#else
+
+inline bool SimdKernels::applySingle(int, Complex<double> *, uint64_t, uint64_t, int, Complex<double> *) { return false; }
+inline bool SimdKernels::applySingle(int, Complex<float> *, uint64_t, uint64_t, int, Complex<float> *) { return false; }
+inline bool SimdKernels::applyControlled(int, Complex<double> *, uint64_t, uint64_t, int *, int, uint64_t, uint64_t, Complex<double> *) { return false; }
+inline bool SimdKernels::applyControlled(int, Complex<float> *, uint64_t, uint64_t, int *, int, uint64_t, uint64_t, Complex<float> *) { return false; }
+inline bool SimdKernels::applyDiagonal(int, Complex<double> *, uint64_t, uint64_t, int, Complex<double> *) { return false; }
+inline bool SimdKernels::applyDiagonal(int, Complex<float> *, uint64_t, uint64_t, int, Complex<float> *) { return false; }
+
+#endif
+
+#endif
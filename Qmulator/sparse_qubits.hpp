@@ -0,0 +1,740 @@
+#ifndef QMULATOR_SPARSE_QUBITS_HPP
+#define QMULATOR_SPARSE_QUBITS_HPP
+
+#include <stdio.h>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "complex.hpp"
+#include "matrix.hpp"
+#include "quantum_gates.hpp"
+#include "random_source.hpp"
+#include "amplitude_map.hpp"
+#include "qubits.hpp"
+
+/*
+	State vector holding only its nonzero amplitudes, in an AmplitudeMap
+	keyed by basis index. A gate costs time proportional to the number of
+	stored amplitudes rather than 2^n, so GHZ states and reversible
+	arithmetic on up to 63 qubits fit in kilobytes. Amplitudes smaller than
+	the tolerance are pruned after each gate.
+
+	Once the stored amplitudes exceed a fraction of 2^n (the fill threshold)
+	and the full vector fits in memory, the state moves into a dense Qubits
+	and later calls are forwarded to it. A measurement that leaves the dense
+	state sparse enough again moves it back.
+*/
+
+template<class Type>
+class SparseQubits
+{
+private:
+	unsigned int numQubits;
+
+	AmplitudeMap<Type> amplitudes;
+	AmplitudeMap<Type> next;
+	Type tolerance;
+	double fillThreshold;
+
+	vector<int> measurement;
+	RandomSource<Type> generator;
+
+	QuantumGates<Type> gate;
+	Qubits<Type> *dense;
+
+	void applyMatrix(vector<int>, uint64_t, uint64_t, Matrix<Type>);
+	void applyControlled(vector<int>, vector<int>, int, Matrix<Type>);
+	void prune();
+	void checkQubits(string, vector<int>);
+
+	void toDense();
+	void toSparse();
+
+	void initialise(int);
+	void barf(string, string);
+
+public:
+	static const unsigned int MAX_QUBITS = 63;
+	static constexpr double DEFAULT_FILL = 1.0 / 32;
+
+	/* Constructor and Deconstructor */
+	SparseQubits(int);
+	~SparseQubits();
+
+	/* Quantum Logic Gates */
+	void H(int);
+	void X(int);
+	void Y(int);
+	void Z(int);
+	void T(int);
+	void S(int);
+	void U(Matrix<Type>, int);
+	void U(Matrix<Type>, vector<int>);
+	unsigned int Measure(int);
+	uint64_t MeasureAll();
+
+	void MCU(vector<int>, int, Matrix<Type>);
+	void MCU(vector<int>, vector<int>, int, Matrix<Type>);
+	void CNOT(int, int);
+	void CY(int, int);
+	void CZ(int, int);
+	void Toffoli(int, int, int);
+
+	void Swap(int, int);
+
+	/* Representation */
+	bool isSparse();
+	Qubits<Type>* denseState();
+	void setFillThreshold(double);
+	void setTolerance(Type);
+
+	/* Utilities */
+	unsigned int size();
+	uint64_t nonzeros();
+	uint64_t bytes();
+	Complex<Type> amplitude(uint64_t);
+
+	void setRandomSeed(uint64_t);
+	int getMeasurement(int);
+	vector<int> getMeasurements();
+
+	void print();
+};
+
+/* Constructor and Deconstructor */
+
+template<class Type>
+SparseQubits<Type>::SparseQubits(int qubits)
+{
+	initialise(qubits);
+}
+
+template<class Type>
+void SparseQubits<Type>::initialise(int qubits)
+{
+	if(qubits < 1 || qubits > MAX_QUBITS)
+		barf("SparseQubits", "number of qubits must be between 1 and 63");
+
+	numQubits = qubits;
+	dense = NULL;
+
+	tolerance = 64 * numeric_limits<Type>::epsilon();
+	fillThreshold = DEFAULT_FILL;
+
+	amplitudes.add(0, Complex<Type>(1, 0));
+	measurement.assign(numQubits, -1);
+}
+
+template<class Type>
+SparseQubits<Type>::~SparseQubits()
+{
+	delete dense;
+}
+
+template<class Type>
+void SparseQubits<Type>::barf(string function, string message)
+{
+	cout << "[error] " << "<" << function << ">";
+	cout << " " << message << endl;
+	exit(1);
+}
+
+template<class Type>
+void SparseQubits<Type>::checkQubits(string function, vector<int> qubits)
+{
+	// Every qubit must exist and appear once, as the bit masks and the
+	// dense fallback both assume.
+	for(int j=0; j<qubits.size(); ++j)
+	{
+		if(qubits.at(j) < 0 || qubits.at(j) >= numQubits)
+			barf(function, "qubit out of range");
+
+		for(int i=0; i<j; ++i)
+		{
+			if(qubits.at(i) == qubits.at(j))
+				barf(function, "qubits must be distinct");
+		}
+	}
+}
+
+/* Sparse Kernels */
+
+template<class Type>
+void SparseQubits<Type>::applyMatrix(vector<int> qubits, uint64_t controlMask, uint64_t controlValue, Matrix<Type> u)
+{
+	// Applies a 2^k x 2^k matrix to the listed qubits of every stored
+	// amplitude whose control bits read controlValue. Each amplitude feeds
+	// the column its bits on the qubits select; zero matrix entries are
+	// skipped, so permutations never create new amplitudes.
+	uint64_t dim = 1ULL << qubits.size();
+	uint64_t qubitMask = 0;
+	vector<uint64_t> spread(dim, 0);
+	bool isDiagonal = true;
+
+	for(int j=0; j<qubits.size(); ++j)
+		qubitMask |= 1ULL << qubits.at(j);
+
+	for(uint64_t r=0; r<dim; ++r)
+	{
+		for(int j=0; j<qubits.size(); ++j)
+			spread.at(r) |= ((r >> j) & 1) << qubits.at(j);
+
+		for(uint64_t c=0; c<dim; ++c)
+		{
+			if(r != c && u.get(r, c).normSq() != 0)
+				isDiagonal = false;
+		}
+	}
+
+	// a diagonal matrix only rescales, in place
+	if(isDiagonal)
+	{
+		for(uint64_t s=0; s<amplitudes.capacity(); ++s)
+		{
+			if(!amplitudes.occupied(s) || (amplitudes.key(s) & controlMask) != controlValue)
+				continue;
+
+			uint64_t c = 0;
+
+			for(int j=0; j<qubits.size(); ++j)
+				c |= ((amplitudes.key(s) >> qubits.at(j)) & 1) << j;
+
+			amplitudes.value(s) *= u.get(c, c);
+		}
+
+		return;
+	}
+
+	next.reset(amplitudes.size());
+
+	for(uint64_t s=0; s<amplitudes.capacity(); ++s)
+	{
+		if(!amplitudes.occupied(s))
+			continue;
+
+		uint64_t key = amplitudes.key(s);
+		Complex<Type> a = amplitudes.value(s);
+
+		if((key & controlMask) != controlValue)
+		{
+			next.add(key, a);
+			continue;
+		}
+
+		uint64_t c = 0;
+
+		for(int j=0; j<qubits.size(); ++j)
+			c |= ((key >> qubits.at(j)) & 1) << j;
+
+		for(uint64_t r=0; r<dim; ++r)
+		{
+			Complex<Type> coeff = u.get(r, c);
+
+			if(coeff.normSq() != 0)
+				next.add((key & ~qubitMask) | spread.at(r), coeff * a);
+		}
+	}
+
+	prune();
+
+	if(amplitudes.size() > fillThreshold * (double)(1ULL << numQubits))
+		toDense();
+}
+
+template<class Type>
+void SparseQubits<Type>::prune()
+{
+	// Moves next into amplitudes, dropping those that cancelled to below
+	// the tolerance.
+	Type cutoff = tolerance * tolerance;
+	uint64_t kept = 0;
+
+	for(uint64_t s=0; s<next.capacity(); ++s)
+		kept += next.occupied(s) && next.value(s).normSq() >= cutoff;
+
+	if(kept == next.size())
+	{
+		amplitudes.swap(next);
+		return;
+	}
+
+	amplitudes.reset(kept);
+
+	for(uint64_t s=0; s<next.capacity(); ++s)
+	{
+		if(next.occupied(s) && next.value(s).normSq() >= cutoff)
+			amplitudes.add(next.key(s), next.value(s));
+	}
+}
+
+template<class Type>
+void SparseQubits<Type>::applyControlled(vector<int> controls, vector<int> openControls, int target, Matrix<Type> u)
+{
+	uint64_t controlMask = 0, controlValue = 0;
+
+	for(int i=0; i<controls.size(); ++i)
+	{
+		controlMask |= 1ULL << controls.at(i);
+		controlValue |= 1ULL << controls.at(i);
+	}
+
+	for(int i=0; i<openControls.size(); ++i)
+		controlMask |= 1ULL << openControls.at(i);
+
+	applyMatrix(vector<int>(1, target), controlMask, controlValue, u);
+}
+
+/* Representation */
+
+template<class Type>
+void SparseQubits<Type>::toDense()
+{
+	// Moves the state into a full state vector, if one fits in memory.
+	if(numQubits > Qubits<Type>::MAX_QUBITS)
+		return;
+
+	uint64_t required = Qubits<Type>::bytesRequired(numQubits);
+	uint64_t available = StateVector<Type>::availableMemory();
+
+	if(required == 0 || (available != 0 && required > available))
+		return;
+
+	dense = new Qubits<Type>(numQubits);
+	dense->enableGraphics = false;
+	dense->setRandomSeed(generator.next());
+	dense->states->set(0, 0, 0);
+
+	for(uint64_t s=0; s<amplitudes.capacity(); ++s)
+	{
+		if(amplitudes.occupied(s))
+			(*dense->states)[amplitudes.key(s)] = amplitudes.value(s);
+	}
+
+	amplitudes.reset(0);
+	next.reset(0);
+}
+
+template<class Type>
+void SparseQubits<Type>::toSparse()
+{
+	// Moves a dense state back into the map once it holds fewer than a
+	// quarter of the amplitudes that made it dense, so the two do not flip
+	// back and forth.
+	dense->flush();
+
+	uint64_t length = dense->length();
+	Complex<Type> *states = dense->states->data();
+	Type cutoff = tolerance * tolerance;
+	uint64_t count = 0;
+
+	for(uint64_t i=0; i<length; ++i)
+		count += states[i].normSq() >= cutoff;
+
+	if(count > fillThreshold / 4 * (double)length)
+		return;
+
+	amplitudes.reset(count);
+
+	for(uint64_t i=0; i<length; ++i)
+	{
+		if(states[i].normSq() >= cutoff)
+			amplitudes.add(i, states[i]);
+	}
+
+	delete dense;
+	dense = NULL;
+}
+
+template<class Type>
+bool SparseQubits<Type>::isSparse()
+{
+	return dense == NULL;
+}
+
+template<class Type>
+Qubits<Type>* SparseQubits<Type>::denseState()
+{
+	// The state vector holding the state while it is dense, otherwise NULL.
+	return dense;
+}
+
+template<class Type>
+void SparseQubits<Type>::setFillThreshold(double fraction)
+{
+	// Fraction of the 2^n amplitudes above which the state goes dense; one
+	// or more keeps it sparse.
+	fillThreshold = fraction;
+}
+
+template<class Type>
+void SparseQubits<Type>::setTolerance(Type magnitude)
+{
+	tolerance = magnitude;
+}
+
+/* Quantum Logic Gates */
+
+template<class Type>
+void SparseQubits<Type>::H(int qubit)
+{
+	checkQubits("H", vector<int>(1, qubit));
+
+	if(dense != NULL)
+		dense->H(qubit);
+	else
+		applyMatrix(vector<int>(1, qubit), 0, 0, gate.Hadamard());
+}
+
+template<class Type>
+void SparseQubits<Type>::X(int qubit)
+{
+	checkQubits("X", vector<int>(1, qubit));
+
+	if(dense != NULL)
+		dense->X(qubit);
+	else
+		applyMatrix(vector<int>(1, qubit), 0, 0, gate.Pauli_X());
+}
+
+template<class Type>
+void SparseQubits<Type>::Y(int qubit)
+{
+	checkQubits("Y", vector<int>(1, qubit));
+
+	if(dense != NULL)
+		dense->Y(qubit);
+	else
+		applyMatrix(vector<int>(1, qubit), 0, 0, gate.Pauli_Y());
+}
+
+template<class Type>
+void SparseQubits<Type>::Z(int qubit)
+{
+	checkQubits("Z", vector<int>(1, qubit));
+
+	if(dense != NULL)
+		dense->Z(qubit);
+	else
+		applyMatrix(vector<int>(1, qubit), 0, 0, gate.Pauli_Z());
+}
+
+template<class Type>
+void SparseQubits<Type>::T(int qubit)
+{
+	checkQubits("T", vector<int>(1, qubit));
+
+	if(dense != NULL)
+		dense->T(qubit);
+	else
+		applyMatrix(vector<int>(1, qubit), 0, 0, gate.PhaseShift(M_PI / 4));
+}
+
+template<class Type>
+void SparseQubits<Type>::S(int qubit)
+{
+	checkQubits("S", vector<int>(1, qubit));
+
+	if(dense != NULL)
+		dense->S(qubit);
+	else
+		applyMatrix(vector<int>(1, qubit), 0, 0, gate.PhaseShift(M_PI / 2));
+}
+
+template<class Type>
+void SparseQubits<Type>::U(Matrix<Type> u, int qubit)
+{
+	checkQubits("U", vector<int>(1, qubit));
+
+	if(dense != NULL)
+		dense->U(u, qubit);
+	else
+		applyMatrix(vector<int>(1, qubit), 0, 0, u);
+}
+
+template<class Type>
+void SparseQubits<Type>::U(Matrix<Type> u, vector<int> qubits)
+{
+	// Bit j of the row and column index of u is the j-th qubit listed.
+	checkQubits("U", qubits);
+
+	if(u.rows() != (1 << qubits.size()) || u.cols() != u.rows())
+		barf("U", "matrix must be 2^k x 2^k for k qubits");
+
+	if(dense != NULL)
+	{
+		dense->U(u, qubits);
+		return;
+	}
+
+	applyMatrix(qubits, 0, 0, u);
+}
+
+template<class Type>
+void SparseQubits<Type>::MCU(vector<int> controls, int target, Matrix<Type> u)
+{
+	MCU(controls, vector<int>(), target, u);
+}
+
+template<class Type>
+void SparseQubits<Type>::MCU(vector<int> controls, vector<int> openControls, int target, Matrix<Type> u)
+{
+	vector<int> qubits = controls;
+	qubits.insert(qubits.end(), openControls.begin(), openControls.end());
+	qubits.push_back(target);
+
+	checkQubits("MCU", qubits);
+
+	if(dense != NULL)
+		dense->MCU(controls, openControls, target, u);
+	else
+		applyControlled(controls, openControls, target, u);
+}
+
+template<class Type>
+void SparseQubits<Type>::CNOT(int control, int target)
+{
+	MCU(vector<int>(1, control), target, gate.Pauli_X());
+}
+
+template<class Type>
+void SparseQubits<Type>::CY(int control, int target)
+{
+	MCU(vector<int>(1, control), target, gate.Pauli_Y());
+}
+
+template<class Type>
+void SparseQubits<Type>::CZ(int control, int target)
+{
+	MCU(vector<int>(1, control), target, gate.Pauli_Z());
+}
+
+template<class Type>
+void SparseQubits<Type>::Toffoli(int control1, int control2, int target)
+{
+	vector<int> controls;
+	controls.push_back(control1);
+	controls.push_back(control2);
+
+	MCU(controls, target, gate.Pauli_X());
+}
+
+template<class Type>
+void SparseQubits<Type>::Swap(int qubit1, int qubit2)
+{
+	vector<int> qubits;
+	qubits.push_back(qubit1);
+	qubits.push_back(qubit2);
+
+	checkQubits("Swap", qubits);
+
+	if(dense != NULL)
+	{
+		dense->Swap(qubit1, qubit2);
+		return;
+	}
+
+	Matrix<Type> swap(4, 4);
+	swap.set(0, 0, 1, 0);
+	swap.set(1, 2, 1, 0);
+	swap.set(2, 1, 1, 0);
+	swap.set(3, 3, 1, 0);
+
+	applyMatrix(qubits, 0, 0, swap);
+}
+
+template<class Type>
+unsigned int SparseQubits<Type>::Measure(int qubit)
+{
+	checkQubits("Measure", vector<int>(1, qubit));
+
+	if(dense != NULL)
+	{
+		measurement.at(qubit) = dense->Measure(qubit);
+		toSparse();
+
+		return measurement.at(qubit);
+	}
+
+	// both marginals are summed so drift in the norm does not bias the outcome
+	Type probOfZero = 0, probOfOne = 0;
+
+	for(uint64_t s=0; s<amplitudes.capacity(); ++s)
+	{
+		if(!amplitudes.occupied(s))
+			continue;
+
+		if((amplitudes.key(s) >> qubit) & 1)
+			probOfOne += amplitudes.value(s).normSq();
+		else
+			probOfZero += amplitudes.value(s).normSq();
+	}
+
+	unsigned int result = (generator.uniform() * (probOfZero + probOfOne) < probOfZero)? 0 : 1;
+
+	if(((result)? probOfOne : probOfZero) <= 0)
+		result ^= 1;
+
+	Type scale = 1 / sqrt((result)? probOfOne : probOfZero);
+
+	next.reset(amplitudes.size());
+
+	for(uint64_t s=0; s<amplitudes.capacity(); ++s)
+	{
+		if(amplitudes.occupied(s) && ((amplitudes.key(s) >> qubit) & 1) == result)
+			next.add(amplitudes.key(s), amplitudes.value(s) * scale);
+	}
+
+	amplitudes.swap(next);
+	measurement.at(qubit) = result;
+
+	return result;
+}
+
+template<class Type>
+uint64_t SparseQubits<Type>::MeasureAll()
+{
+	// Measures every qubit with a single draw from the stored amplitudes.
+	uint64_t result = 0;
+
+	if(dense != NULL)
+	{
+		result = dense->MeasureAll();
+		toSparse();
+	}
+	else
+	{
+		Type total = 0;
+
+		for(uint64_t s=0; s<amplitudes.capacity(); ++s)
+		{
+			if(amplitudes.occupied(s))
+				total += amplitudes.value(s).normSq();
+		}
+
+		Type draw = generator.uniform() * total;
+
+		// if rounding runs the draw past the end, the last stored amplitude
+		// with nonzero probability is taken
+		for(uint64_t s=0; s<amplitudes.capacity(); ++s)
+		{
+			if(!amplitudes.occupied(s) || amplitudes.value(s).normSq() <= 0)
+				continue;
+
+			result = amplitudes.key(s);
+			draw -= amplitudes.value(s).normSq();
+
+			if(draw < 0)
+				break;
+		}
+
+		amplitudes.reset(1);
+		amplitudes.add(result, Complex<Type>(1, 0));
+	}
+
+	for(int i=0; i<numQubits; ++i)
+		measurement.at(i) = (result >> i) & 1;
+
+	return result;
+}
+
+/* Utilities */
+
+template<class Type>
+unsigned int SparseQubits<Type>::size()
+{
+	return numQubits;
+}
+
+template<class Type>
+uint64_t SparseQubits<Type>::nonzeros()
+{
+	// Number of stored amplitudes, or 2^n while the state is dense.
+	return (dense != NULL)? dense->length() : amplitudes.size();
+}
+
+template<class Type>
+uint64_t SparseQubits<Type>::bytes()
+{
+	// Memory held by the amplitudes in either representation.
+	if(dense != NULL)
+		return Qubits<Type>::bytesRequired(numQubits);
+
+	return amplitudes.bytes() + next.bytes();
+}
+
+template<class Type>
+Complex<Type> SparseQubits<Type>::amplitude(uint64_t index)
+{
+	// Returns the coefficient of the basis state |index⟩.
+	if(dense != NULL)
+		return dense->amplitude(index);
+
+	return amplitudes.get(index);
+}
+
+template<class Type>
+void SparseQubits<Type>::setRandomSeed(uint64_t seed)
+{
+	generator.seed(seed);
+
+	if(dense != NULL)
+		dense->setRandomSeed(seed);
+}
+
+template<class Type>
+int SparseQubits<Type>::getMeasurement(int qubit)
+{
+	// Returns the last outcome recorded for the qubit, or -1 if it has not
+	// been measured.
+	return measurement.at(qubit);
+}
+
+template<class Type>
+vector<int> SparseQubits<Type>::getMeasurements()
+{
+	return measurement;
+}
+
+template<class Type>
+void SparseQubits<Type>::print()
+{
+	// Prints the stored amplitudes in order of basis state.
+	if(dense != NULL)
+	{
+		dense->print();
+		return;
+	}
+
+	vector<uint64_t> keys;
+
+	for(uint64_t s=0; s<amplitudes.capacity(); ++s)
+	{
+		if(amplitudes.occupied(s))
+			keys.push_back(amplitudes.key(s));
+	}
+
+	sort(keys.begin(), keys.end());
+
+	for(uint64_t i=0; i<keys.size(); ++i)
+	{
+		string decToBin;
+
+		for(int j=0; j<numQubits; ++j)
+			decToBin.insert(decToBin.begin(), (keys.at(i) >> j & 1) + '0');
+
+		Complex<Type> coeff = amplitudes.get(keys.at(i));
+
+		printf("|%s⟩ = %6.3f +%6.3fi  (%.3f)\n", decToBin.c_str(), coeff.getRe(), coeff.getIm(), coeff.normSq());
+	}
+
+	printf("\n");
+
+	for(int i=0; i<numQubits; ++i)
+	{
+		if(measurement.at(i) >= 0)
+			printf("Qubit%2d: %d\n", i, measurement.at(i));
+	}
+}
+
+#endif
@@ -0,0 +1,875 @@
+#ifndef QMULATOR_STABILISER_HPP
+#define QMULATOR_STABILISER_HPP
+
+#include <stdio.h>
+#include <map>
+#include <vector>
+#include <stdint.h>
+#include "complex.hpp"
+#include "matrix.hpp"
+#include "random_source.hpp"
+#include "qubits.hpp"
+
+/*
+	Clifford circuits simulated on a stabiliser tableau (Aaronson-Gottesman,
+	CHP). Rows 0 to n-1 hold the destabilisers and rows n to 2n-1 the
+	stabilisers of the state, each a signed Pauli string stored as bit words
+	of X and Z parts; row 2n is scratch space. A gate updates one or two
+	bit columns of every row, O(n), and a measurement multiplies rows
+	together, O(n^2), so thousands of qubits fit in memory.
+
+	T, U, MCU and Toffoli are not Clifford. Depending on the policy they
+	are rejected, or the tableau is expanded into a state vector once and
+	every later call is forwarded to Qubits<Type>. The tableau does not
+	track the global phase, so amplitudes match a state vector simulation
+	only up to a common phase.
+*/
+
+template<class Type>
+class Stabiliser
+{
+private:
+	// signed Pauli strings; (x, z) = (1, 0) is X, (1, 1) is Y and (0, 1) is Z
+	struct PauliRows
+	{
+		int words;
+		vector<uint64_t> x;
+		vector<uint64_t> z;
+		vector<int> r;
+
+		void resize(int, int);
+		uint64_t* xRow(int row) { return &x[(uint64_t)row * words]; }
+		uint64_t* zRow(int row) { return &z[(uint64_t)row * words]; }
+		int xBit(int row, int q) { return (xRow(row)[q >> 6] >> (q & 63)) & 1; }
+		int zBit(int row, int q) { return (zRow(row)[q >> 6] >> (q & 63)) & 1; }
+
+		void rowsum(int, int);
+		void rowcopy(int, int);
+		void rowclear(int);
+		void rowswap(int, int);
+	};
+
+	unsigned int numQubits;
+	unsigned int policy;
+	PauliRows tableau;
+
+	vector<int> measurement;
+	RandomSource<Type> generator;
+
+	Qubits<Type> *fallback;
+
+	bool useFallback(string);
+	void canonical(PauliRows &, vector<uint64_t> &, int &);
+	void applyPauli(PauliRows &, int, vector<Complex<Type> > &, vector<Complex<Type> > &);
+
+	void checkQubits(string, vector<int>);
+
+	void initialise(int, unsigned int);
+	void barf(string, string);
+
+public:
+	enum cliffordPolicy: unsigned int
+	{
+		REJECT_NON_CLIFFORD = 0,
+		FALLBACK_NON_CLIFFORD = 1,
+	};
+
+	/* Constructor and Deconstructor */
+	Stabiliser(int);
+	Stabiliser(int, unsigned int);
+	~Stabiliser();
+
+	/* Clifford Gates */
+	void H(int);
+	void X(int);
+	void Y(int);
+	void Z(int);
+	void S(int);
+	void CNOT(int, int);
+	void CY(int, int);
+	void CZ(int, int);
+	void Swap(int, int);
+	unsigned int Measure(int);
+	uint64_t MeasureAll();
+	map<uint64_t, unsigned int> Sample(unsigned int);
+
+	/* Non-Clifford Gates */
+	void T(int);
+	void U(Matrix<Type>, int);
+	void MCU(vector<int>, int, Matrix<Type>);
+	void MCU(vector<int>, vector<int>, int, Matrix<Type>);
+	void Toffoli(int, int, int);
+
+	/* Utilities */
+	bool isClifford();
+	Qubits<Type>* stateVector();
+
+	unsigned int size();
+	Complex<Type> amplitude(uint64_t);
+
+	void setRandomSeed(uint64_t);
+	int getMeasurement(int);
+	vector<int> getMeasurements();
+
+	void print();
+};
+
+/* Pauli Rows */
+
+template<class Type>
+void Stabiliser<Type>::PauliRows::resize(int rows, int qubits)
+{
+	words = (qubits + 63) / 64;
+	x.assign((uint64_t)rows * words, 0);
+	z.assign((uint64_t)rows * words, 0);
+	r.assign(rows, 0);
+}
+
+template<class Type>
+void Stabiliser<Type>::PauliRows::rowsum(int h, int i)
+{
+	// Replaces row h with the product of rows i and h. Each qubit picks up
+	// a power of i, +1 for XY, YZ and ZX and -1 for the reverse orders; the
+	// powers are summed mod 4 in two bit planes, one lane per bit of a word.
+	uint64_t *xi = xRow(i), *zi = zRow(i);
+	uint64_t *xh = xRow(h), *zh = zRow(h);
+
+	uint64_t low = 0, high = 0;
+
+	for(int w=0; w<words; ++w)
+	{
+		uint64_t isY = xi[w] & zi[w], isX = xi[w] & ~zi[w], isZ = ~xi[w] & zi[w];
+		uint64_t toY = xh[w] & zh[w], toX = xh[w] & ~zh[w], toZ = ~xh[w] & zh[w];
+
+		uint64_t plus = (isY & toZ) | (isX & toY) | (isZ & toX);
+		uint64_t minus = (isY & toX) | (isX & toZ) | (isZ & toY);
+
+		high ^= (low & plus) | (~low & minus);
+		low ^= plus | minus;
+
+		xh[w] ^= xi[w];
+		zh[w] ^= zi[w];
+	}
+
+	int sum = 2 * r[h] + 2 * r[i] + __builtin_popcountll(low) + 2 * __builtin_popcountll(high);
+
+	r[h] = (sum % 4 == 2)? 1 : 0;
+}
+
+template<class Type>
+void Stabiliser<Type>::PauliRows::rowcopy(int h, int i)
+{
+	for(int w=0; w<words; ++w)
+	{
+		xRow(h)[w] = xRow(i)[w];
+		zRow(h)[w] = zRow(i)[w];
+	}
+
+	r.at(h) = r.at(i);
+}
+
+template<class Type>
+void Stabiliser<Type>::PauliRows::rowclear(int h)
+{
+	for(int w=0; w<words; ++w)
+	{
+		xRow(h)[w] = 0;
+		zRow(h)[w] = 0;
+	}
+
+	r.at(h) = 0;
+}
+
+template<class Type>
+void Stabiliser<Type>::PauliRows::rowswap(int h, int i)
+{
+	for(int w=0; w<words; ++w)
+	{
+		swap(xRow(h)[w], xRow(i)[w]);
+		swap(zRow(h)[w], zRow(i)[w]);
+	}
+
+	swap(r.at(h), r.at(i));
+}
+
+/* Constructor and Deconstructor */
+
+template<class Type>
+Stabiliser<Type>::Stabiliser(int qubits)
+{
+	initialise(qubits, FALLBACK_NON_CLIFFORD);
+}
+
+template<class Type>
+Stabiliser<Type>::Stabiliser(int qubits, unsigned int nonClifford)
+{
+	initialise(qubits, nonClifford);
+}
+
+template<class Type>
+void Stabiliser<Type>::initialise(int qubits, unsigned int nonClifford)
+{
+	if(qubits < 1)
+		barf("Stabiliser", "number of qubits must be positive");
+
+	numQubits = qubits;
+	policy = nonClifford;
+	fallback = NULL;
+
+	// |0...0⟩ is stabilised by Z on every qubit and destabilised by X
+	tableau.resize(2 * numQubits + 1, numQubits);
+
+	for(int i=0; i<numQubits; ++i)
+	{
+		tableau.xRow(i)[i >> 6] |= 1ULL << (i & 63);
+		tableau.zRow(numQubits + i)[i >> 6] |= 1ULL << (i & 63);
+	}
+
+	measurement.assign(numQubits, -1);
+}
+
+template<class Type>
+Stabiliser<Type>::~Stabiliser()
+{
+	delete fallback;
+}
+
+template<class Type>
+void Stabiliser<Type>::barf(string function, string message)
+{
+	cout << "[error] " << "<" << function << ">";
+	cout << " " << message << endl;
+	exit(1);
+}
+
+template<class Type>
+void Stabiliser<Type>::checkQubits(string function, vector<int> qubits)
+{
+	// Every qubit must exist and appear once, before any tableau column or
+	// the fallback is touched.
+	for(int j=0; j<qubits.size(); ++j)
+	{
+		if(qubits.at(j) < 0 || qubits.at(j) >= numQubits)
+			barf(function, "qubit out of range");
+
+		for(int i=0; i<j; ++i)
+		{
+			if(qubits.at(i) == qubits.at(j))
+				barf(function, "qubits must be distinct");
+		}
+	}
+}
+
+/* Clifford Gates */
+
+template<class Type>
+void Stabiliser<Type>::H(int qubit)
+{
+	checkQubits("H", vector<int>(1, qubit));
+
+	if(fallback != NULL)
+	{
+		fallback->H(qubit);
+		return;
+	}
+
+	int w = qubit >> 6;
+	uint64_t bit = 1ULL << (qubit & 63);
+
+	for(int i=0; i<2*numQubits; ++i)
+	{
+		uint64_t &x = tableau.xRow(i)[w], &z = tableau.zRow(i)[w];
+
+		tableau.r.at(i) ^= ((x & z & bit) != 0);
+
+		uint64_t swapped = (x ^ z) & bit;
+		x ^= swapped;
+		z ^= swapped;
+	}
+}
+
+template<class Type>
+void Stabiliser<Type>::S(int qubit)
+{
+	checkQubits("S", vector<int>(1, qubit));
+
+	if(fallback != NULL)
+	{
+		fallback->S(qubit);
+		return;
+	}
+
+	int w = qubit >> 6;
+	uint64_t bit = 1ULL << (qubit & 63);
+
+	for(int i=0; i<2*numQubits; ++i)
+	{
+		uint64_t &x = tableau.xRow(i)[w], &z = tableau.zRow(i)[w];
+
+		tableau.r.at(i) ^= ((x & z & bit) != 0);
+		z ^= x & bit;
+	}
+}
+
+template<class Type>
+void Stabiliser<Type>::X(int qubit)
+{
+	// Paulis only flip the signs of the rows they anticommute with.
+	checkQubits("X", vector<int>(1, qubit));
+
+	if(fallback != NULL)
+	{
+		fallback->X(qubit);
+		return;
+	}
+
+	for(int i=0; i<2*numQubits; ++i)
+		tableau.r.at(i) ^= tableau.zBit(i, qubit);
+}
+
+template<class Type>
+void Stabiliser<Type>::Y(int qubit)
+{
+	checkQubits("Y", vector<int>(1, qubit));
+
+	if(fallback != NULL)
+	{
+		fallback->Y(qubit);
+		return;
+	}
+
+	for(int i=0; i<2*numQubits; ++i)
+		tableau.r.at(i) ^= tableau.xBit(i, qubit) ^ tableau.zBit(i, qubit);
+}
+
+template<class Type>
+void Stabiliser<Type>::Z(int qubit)
+{
+	checkQubits("Z", vector<int>(1, qubit));
+
+	if(fallback != NULL)
+	{
+		fallback->Z(qubit);
+		return;
+	}
+
+	for(int i=0; i<2*numQubits; ++i)
+		tableau.r.at(i) ^= tableau.xBit(i, qubit);
+}
+
+template<class Type>
+void Stabiliser<Type>::CNOT(int control, int target)
+{
+	vector<int> qubits;
+	qubits.push_back(control);
+	qubits.push_back(target);
+
+	checkQubits("CNOT", qubits);
+
+	if(fallback != NULL)
+	{
+		fallback->CNOT(control, target);
+		return;
+	}
+
+	for(int i=0; i<2*numQubits; ++i)
+	{
+		int xc = tableau.xBit(i, control), zc = tableau.zBit(i, control);
+		int xt = tableau.xBit(i, target), zt = tableau.zBit(i, target);
+
+		tableau.r.at(i) ^= xc & zt & (xt ^ zc ^ 1);
+
+		tableau.xRow(i)[target >> 6] ^= (uint64_t)xc << (target & 63);
+		tableau.zRow(i)[control >> 6] ^= (uint64_t)zt << (control & 63);
+	}
+}
+
+template<class Type>
+void Stabiliser<Type>::CY(int control, int target)
+{
+	// S X S† = Y
+	vector<int> qubits;
+	qubits.push_back(control);
+	qubits.push_back(target);
+
+	checkQubits("CY", qubits);
+
+	if(fallback != NULL)
+	{
+		fallback->CY(control, target);
+		return;
+	}
+
+	Z(target);
+	S(target);
+	CNOT(control, target);
+	S(target);
+}
+
+template<class Type>
+void Stabiliser<Type>::CZ(int control, int target)
+{
+	vector<int> qubits;
+	qubits.push_back(control);
+	qubits.push_back(target);
+
+	checkQubits("CZ", qubits);
+
+	if(fallback != NULL)
+	{
+		fallback->CZ(control, target);
+		return;
+	}
+
+	H(target);
+	CNOT(control, target);
+	H(target);
+}
+
+template<class Type>
+void Stabiliser<Type>::Swap(int qubit1, int qubit2)
+{
+	// a qubit swapped with itself is left alone, as before
+	checkQubits("Swap", vector<int>(1, qubit1));
+	checkQubits("Swap", vector<int>(1, qubit2));
+
+	if(fallback != NULL)
+	{
+		fallback->Swap(qubit1, qubit2);
+		return;
+	}
+
+	if(qubit1 == qubit2)
+		return;
+
+	CNOT(qubit1, qubit2);
+	CNOT(qubit2, qubit1);
+	CNOT(qubit1, qubit2);
+}
+
+template<class Type>
+unsigned int Stabiliser<Type>::Measure(int qubit)
+{
+	checkQubits("Measure", vector<int>(1, qubit));
+
+	if(fallback != NULL)
+		return measurement.at(qubit) = fallback->Measure(qubit);
+
+	int n = numQubits;
+	int p = -1;
+
+	for(int i=n; i<2*n && p < 0; ++i)
+	{
+		if(tableau.xBit(i, qubit))
+			p = i;
+	}
+
+	if(p >= 0)
+	{
+		// a stabiliser anticommutes with Z, so the outcome is random: every
+		// other row that anticommutes is multiplied by it, and it becomes
+		// the destabiliser of the new stabiliser ±Z
+		for(int i=0; i<2*n; ++i)
+		{
+			if(i != p && tableau.xBit(i, qubit))
+				tableau.rowsum(i, p);
+		}
+
+		tableau.rowcopy(p - n, p);
+		tableau.rowclear(p);
+		tableau.zRow(p)[qubit >> 6] |= 1ULL << (qubit & 63);
+		tableau.r.at(p) = generator.next() >> 63;
+
+		return measurement.at(qubit) = tableau.r.at(p);
+	}
+
+	// ±Z is already a product of stabilisers; the destabilisers that
+	// anticommute with Z pick out which, and its sign is the outcome
+	tableau.rowclear(2 * n);
+
+	for(int i=0; i<n; ++i)
+	{
+		if(tableau.xBit(i, qubit))
+			tableau.rowsum(2 * n, i + n);
+	}
+
+	return measurement.at(qubit) = tableau.r.at(2 * n);
+}
+
+template<class Type>
+uint64_t Stabiliser<Type>::MeasureAll()
+{
+	// Measures every qubit in turn. The returned basis index holds the
+	// first 64 outcomes; the rest are read with getMeasurements().
+	uint64_t result = 0;
+
+	for(int i=0; i<numQubits; ++i)
+	{
+		unsigned int outcome = Measure(i);
+
+		if(i < 64)
+			result |= (uint64_t)outcome << i;
+	}
+
+	return result;
+}
+
+template<class Type>
+map<uint64_t, unsigned int> Stabiliser<Type>::Sample(unsigned int shots)
+{
+	// Draws basis states without collapsing. The state is an equal
+	// superposition over basis ⊕ span(X parts), so a shot is the basis
+	// state with a random subset of the reduced X parts added in.
+	if(fallback != NULL)
+		return fallback->Sample(shots);
+
+	if(numQubits > 64)
+		barf("Sample", "basis index only covers 64 qubits");
+
+	PauliRows rows;
+	vector<uint64_t> basis;
+	int numX;
+
+	canonical(rows, basis, numX);
+
+	map<uint64_t, unsigned int> counts;
+
+	for(unsigned int s=0; s<shots; ++s)
+	{
+		uint64_t choice = generator.next(), outcome = basis.at(0);
+
+		for(int g=0; g<numX; ++g)
+		{
+			if((choice >> g) & 1)
+				outcome ^= rows.xRow(g)[0];
+		}
+
+		++counts[outcome];
+	}
+
+	return counts;
+}
+
+/* Non-Clifford Gates */
+
+template<class Type>
+bool Stabiliser<Type>::useFallback(string function)
+{
+	// Expands the tableau into a state vector the first time a gate outside
+	// the Clifford group appears, or stops if the policy rejects it.
+	if(fallback != NULL)
+		return true;
+
+	if(policy == REJECT_NON_CLIFFORD)
+		barf(function, "not a Clifford gate");
+
+	if(numQubits > Qubits<Type>::MAX_QUBITS)
+		barf(function, "too many qubits to fall back to a state vector");
+
+	fallback = new Qubits<Type>(numQubits);
+	fallback->enableGraphics = false;
+	fallback->setRandomSeed(generator.next());
+
+	vector<uint64_t> basis;
+	int numX;
+
+	PauliRows generators;
+	canonical(generators, basis, numX);
+
+	// (I + g) / 2 for each stabiliser with an X part spreads |basis⟩ over
+	// the support of the state; the others already hold on |basis⟩
+	vector<Complex<Type> > amplitudes(1ULL << numQubits), image;
+	amplitudes.at(basis.at(0)) = Complex<Type>(1, 0);
+
+	for(int g=0; g<numX; ++g)
+	{
+		applyPauli(generators, g, amplitudes, image);
+
+		for(uint64_t i=0; i<amplitudes.size(); ++i)
+			amplitudes.at(i) += image.at(i);
+	}
+
+	Type norm = 1 / sqrt((Type)(1ULL << numX));
+
+	for(uint64_t i=0; i<amplitudes.size(); ++i)
+		fallback->states->set(i, amplitudes.at(i).getRe() * norm, amplitudes.at(i).getIm() * norm);
+
+	return true;
+}
+
+template<class Type>
+void Stabiliser<Type>::T(int qubit)
+{
+	checkQubits("T", vector<int>(1, qubit));
+
+	if(useFallback("T"))
+		fallback->T(qubit);
+}
+
+template<class Type>
+void Stabiliser<Type>::U(Matrix<Type> u, int qubit)
+{
+	checkQubits("U", vector<int>(1, qubit));
+
+	if(useFallback("U"))
+		fallback->U(u, qubit);
+}
+
+template<class Type>
+void Stabiliser<Type>::MCU(vector<int> controls, int target, Matrix<Type> u)
+{
+	MCU(controls, vector<int>(), target, u);
+}
+
+template<class Type>
+void Stabiliser<Type>::MCU(vector<int> controls, vector<int> openControls, int target, Matrix<Type> u)
+{
+	vector<int> qubits = controls;
+	qubits.insert(qubits.end(), openControls.begin(), openControls.end());
+	qubits.push_back(target);
+
+	checkQubits("MCU", qubits);
+
+	if(useFallback("MCU"))
+		fallback->MCU(controls, openControls, target, u);
+}
+
+template<class Type>
+void Stabiliser<Type>::Toffoli(int control1, int control2, int target)
+{
+	vector<int> qubits;
+	qubits.push_back(control1);
+	qubits.push_back(control2);
+
+	qubits.push_back(target);
+
+	checkQubits("Toffoli", qubits);
+
+	if(useFallback("Toffoli"))
+		fallback->Toffoli(control1, control2, target);
+}
+
+/* State Reconstruction */
+
+template<class Type>
+void Stabiliser<Type>::canonical(PauliRows &rows, vector<uint64_t> &basis, int &numX)
+{
+	// Copies the stabilisers into rows and row-reduces them so that the
+	// first numX have independent X parts and the rest are ±Z strings.
+	// basis is set to a basis state the ±Z strings leave at +1, which the
+	// others map around the support of the state. Row n is scratch space.
+	int n = numQubits;
+	rows.resize(n + 1, n);
+
+	for(int i=0; i<n; ++i)
+	{
+		for(int w=0; w<rows.words; ++w)
+		{
+			rows.xRow(i)[w] = tableau.xRow(n + i)[w];
+			rows.zRow(i)[w] = tableau.zRow(n + i)[w];
+		}
+
+		rows.r.at(i) = tableau.r.at(n + i);
+	}
+
+	int top = 0;
+
+	for(int q=0; q<n && top<n; ++q)
+	{
+		int pivot = top;
+
+		while(pivot < n && !rows.xBit(pivot, q))
+			++pivot;
+
+		if(pivot == n)
+			continue;
+
+		rows.rowswap(top, pivot);
+
+		for(int i=0; i<n; ++i)
+		{
+			if(i != top && rows.xBit(i, q))
+				rows.rowsum(i, top);
+		}
+
+		++top;
+	}
+
+	numX = top;
+
+	// the ±Z strings are parity checks on the basis state: reduce them the
+	// same way on their Z parts and solve with the free bits left at zero
+	vector<int> pivots;
+
+	for(int q=0; q<n && top<n; ++q)
+	{
+		int pivot = top;
+
+		while(pivot < n && !rows.zBit(pivot, q))
+			++pivot;
+
+		if(pivot == n)
+			continue;
+
+		rows.rowswap(top, pivot);
+
+		for(int i=numX; i<n; ++i)
+		{
+			if(i != top && rows.zBit(i, q))
+				rows.rowsum(i, top);
+		}
+
+		pivots.push_back(q);
+		++top;
+	}
+
+	basis.assign(rows.words, 0);
+
+	for(int j=0; j<pivots.size(); ++j)
+	{
+		int q = pivots.at(j);
+
+		if(rows.r.at(numX + j))
+			basis.at(q >> 6) |= 1ULL << (q & 63);
+	}
+}
+
+template<class Type>
+void Stabiliser<Type>::applyPauli(PauliRows &rows, int row, vector<Complex<Type> > &amplitudes, vector<Complex<Type> > &image)
+{
+	// image = g amplitudes, for the n <= 64 qubit row g. Y is i X Z, so g|b⟩
+	// is ±i^(number of Y) (-1)^(b·z) |b ^ x⟩.
+	uint64_t x = rows.xRow(row)[0], z = rows.zRow(row)[0];
+	int power = 2 * rows.r.at(row) + __builtin_popcountll(x & z);
+
+	Complex<Type> phases[4] = {Complex<Type>(1, 0), Complex<Type>(0, 1), Complex<Type>(-1, 0), Complex<Type>(0, -1)};
+
+	image.assign(amplitudes.size(), Complex<Type>(0, 0));
+
+	for(uint64_t b=0; b<amplitudes.size(); ++b)
+	{
+		if(amplitudes.at(b).normSq() == 0)
+			continue;
+
+		int sign = __builtin_popcountll(b & z) & 1;
+		image.at(b ^ x) = phases[(power + 2 * sign) % 4] * amplitudes.at(b);
+	}
+}
+
+/* Utilities */
+
+template<class Type>
+bool Stabiliser<Type>::isClifford()
+{
+	// True while the state is still held as a tableau.
+	return fallback == NULL;
+}
+
+template<class Type>
+Qubits<Type>* Stabiliser<Type>::stateVector()
+{
+	// The state vector simulation taken over after a non-Clifford gate, or
+	// NULL while the circuit has been Clifford.
+	return fallback;
+}
+
+template<class Type>
+unsigned int Stabiliser<Type>::size()
+{
+	return numQubits;
+}
+
+template<class Type>
+Complex<Type> Stabiliser<Type>::amplitude(uint64_t index)
+{
+	// Returns the coefficient of |index⟩ up to the global phase. The state is
+	// an equal superposition over basis ⊕ span(X parts), so index is reached
+	// by exactly one product of the reduced stabilisers, whose phase on
+	// |basis⟩ is the answer.
+	if(fallback != NULL)
+		return fallback->amplitude(index);
+
+	if(numQubits > 64)
+		barf("amplitude", "basis index only covers 64 qubits");
+
+	PauliRows rows;
+	vector<uint64_t> basis;
+	int numX;
+
+	canonical(rows, basis, numX);
+
+	int product = numQubits;
+	rows.rowclear(product);
+
+	uint64_t remaining = index ^ basis.at(0);
+
+	for(int g=0; g<numX; ++g)
+	{
+		uint64_t x = rows.xRow(g)[0];
+		int q = __builtin_ctzll(x);
+
+		if((remaining >> q) & 1)
+		{
+			rows.rowsum(product, g);
+			remaining ^= x;
+		}
+	}
+
+	if(remaining != 0)
+		return Complex<Type>(0, 0);
+
+	// the product is a Hermitian Pauli, ±X^x Z^z with i per Y, acting on |basis⟩
+	uint64_t x = rows.xRow(product)[0], z = rows.zRow(product)[0];
+	int power = 2 * rows.r.at(product) + __builtin_popcountll(x & z) + 2 * (__builtin_popcountll(basis.at(0) & z) & 1);
+
+	Type magnitude = 1 / sqrt((Type)(1ULL << numX));
+	Complex<Type> phases[4] = {Complex<Type>(1, 0), Complex<Type>(0, 1), Complex<Type>(-1, 0), Complex<Type>(0, -1)};
+
+	return phases[power % 4] * magnitude;
+}
+
+template<class Type>
+void Stabiliser<Type>::setRandomSeed(uint64_t seed)
+{
+	generator.seed(seed);
+}
+
+template<class Type>
+int Stabiliser<Type>::getMeasurement(int qubit)
+{
+	// Returns the last outcome recorded for the qubit, or -1 if it has not
+	// been measured.
+	return measurement.at(qubit);
+}
+
+template<class Type>
+vector<int> Stabiliser<Type>::getMeasurements()
+{
+	return measurement;
+}
+
+template<class Type>
+void Stabiliser<Type>::print()
+{
+	// Prints the stabilisers, one signed Pauli string per line with qubit 0
+	// on the left.
+	if(fallback != NULL)
+	{
+		fallback->print();
+		return;
+	}
+
+	const char paulis[4] = {'I', 'Z', 'X', 'Y'};
+
+	for(int i=numQubits; i<2*numQubits; ++i)
+	{
+		string row = (tableau.r.at(i))? "-" : "+";
+
+		for(int q=0; q<numQubits; ++q)
+			row += paulis[2 * tableau.xBit(i, q) + tableau.zBit(i, q)];
+
+		cout << row << endl;
+	}
+}
+
+#endif
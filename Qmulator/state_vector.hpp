@@ -0,0 +1,247 @@
+#ifndef QMULATOR_STATE_VECTOR_HPP
+#define QMULATOR_STATE_VECTOR_HPP
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include "complex.hpp"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#ifdef __unix__
+#include <unistd.h>
+#endif
+
+/*
+	Amplitudes of a quantum state held in a single contiguous buffer aligned
+	to a cache line, so kernels can walk it through a raw pointer. Large
+	buffers can optionally be backed by huge pages.
+*/
+
+template<class T>
+class StateVector
+{
+private:
+	Complex<T> *amplitudes;
+	uint64_t length;
+	size_t bytes;
+	bool isMapped;
+
+	void allocate(uint64_t, bool);
+	void release();
+
+	void barf(string function, string message)
+	{
+		cout << "[error] " << "<" << function << ">";
+		cout << " " << message << endl;
+		exit(1);
+	}
+
+public:
+	static const size_t ALIGNMENT = 64;
+	static const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+	/* Constructor and Deconstructor */
+	StateVector(uint64_t);
+	StateVector(uint64_t, bool);
+	StateVector(const StateVector &);
+	~StateVector();
+
+	/* Setters and Getters */
+	void set(uint64_t, T, T);
+	void set(uint64_t, Complex<T>);
+	void setToZero();
+	Complex<T> get(uint64_t);
+
+	Complex<T>& operator [] (uint64_t i) { return amplitudes[i]; }
+	StateVector<T>& operator = (const StateVector &);
+
+	/* Utilities */
+	Complex<T>* data() { return amplitudes; }
+	uint64_t size() { return length; }
+	size_t memory() { return bytes; }
+	bool usesHugePages() { return isMapped; }
+
+	static uint64_t bytesRequired(uint64_t);
+	static uint64_t availableMemory();
+};
+
+/* Constructor and Deconstructor */
+
+template<class T>
+StateVector<T>::StateVector(uint64_t size)
+{
+	allocate(size, false);
+}
+
+template<class T>
+StateVector<T>::StateVector(uint64_t size, bool hugePages)
+{
+	allocate(size, hugePages);
+}
+
+template<class T>
+StateVector<T>::StateVector(const StateVector &other)
+{
+	allocate(other.length, other.isMapped);
+	memcpy(amplitudes, other.amplitudes, other.length * sizeof(Complex<T>));
+}
+
+template<class T>
+StateVector<T>::~StateVector()
+{
+	release();
+}
+
+template<class T>
+void StateVector<T>::allocate(uint64_t size, bool hugePages)
+{
+	// the byte count, rounded up to a whole huge page, must fit in size_t
+	if(size > (SIZE_MAX - HUGE_PAGE_SIZE) / sizeof(Complex<T>))
+		barf("allocate", "state vector too large to address");
+
+	length = size;
+	bytes = length * sizeof(Complex<T>);
+	bytes = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	isMapped = false;
+	amplitudes = NULL;
+
+#ifdef __linux__
+	// Anonymous mappings come back zeroed and page aligned; transparent huge
+	// pages are requested for them and silently ignored where unsupported.
+	if(hugePages && bytes >= HUGE_PAGE_SIZE)
+	{
+		bytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+		void *ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if(ptr != MAP_FAILED)
+		{
+#ifdef MADV_HUGEPAGE
+			madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+			amplitudes = (Complex<T> *)ptr;
+			isMapped = true;
+			return;
+		}
+	}
+#endif
+
+	void *ptr = NULL;
+
+	if(posix_memalign(&ptr, ALIGNMENT, bytes) != 0)
+		barf("allocate", "unable to allocate the state vector");
+
+	amplitudes = (Complex<T> *)ptr;
+	setToZero();
+}
+
+template<class T>
+void StateVector<T>::release()
+{
+#ifdef __linux__
+	if(isMapped)
+	{
+		munmap(amplitudes, bytes);
+		return;
+	}
+#endif
+
+	free(amplitudes);
+}
+
+/* Memory Budget */
+
+template<class T>
+uint64_t StateVector<T>::bytesRequired(uint64_t size)
+{
+	// Returns zero if the buffer size cannot be represented.
+	if(size > (uint64_t)-1 / sizeof(Complex<T>))
+		return 0;
+
+	return size * sizeof(Complex<T>);
+}
+
+template<class T>
+uint64_t StateVector<T>::availableMemory()
+{
+	// Prefers MemAvailable, which counts reclaimable page cache, over the
+	// free page count. Returns zero if the amount cannot be determined.
+	FILE *file = fopen("/proc/meminfo", "r");
+
+	if(file != NULL)
+	{
+		char line[256];
+		unsigned long long kiloBytes;
+
+		while(fgets(line, sizeof(line), file) != NULL)
+		{
+			if(sscanf(line, "MemAvailable: %llu kB", &kiloBytes) == 1)
+			{
+				fclose(file);
+				return (uint64_t)kiloBytes * 1024;
+			}
+		}
+
+		fclose(file);
+	}
+
+#if defined(__unix__) && defined(_SC_AVPHYS_PAGES)
+	long pages = sysconf(_SC_AVPHYS_PAGES);
+	long pageSize = sysconf(_SC_PAGE_SIZE);
+
+	if(pages > 0 && pageSize > 0)
+		return (uint64_t)pages * pageSize;
+#endif
+
+	return 0;
+}
+
+/* Setters and Getters */
+
+template<class T>
+void StateVector<T>::set(uint64_t i, T re, T im)
+{
+	amplitudes[i].set(re, im);
+}
+
+template<class T>
+void StateVector<T>::set(uint64_t i, Complex<T> c)
+{
+	amplitudes[i] = c;
+}
+
+template<class T>
+void StateVector<T>::setToZero()
+{
+	memset((void *)amplitudes, 0, length * sizeof(Complex<T>));
+}
+
+template<class T>
+Complex<T> StateVector<T>::get(uint64_t i)
+{
+	return amplitudes[i];
+}
+
+template<class T>
+StateVector<T>& StateVector<T>::operator = (const StateVector &other)
+{
+	if(this == &other)
+		return *this;
+
+	if(length != other.length)
+	{
+		release();
+		allocate(other.length, other.isMapped);
+	}
+
+	memcpy((void *)amplitudes, other.amplitudes, other.length * sizeof(Complex<T>));
+
+	return *this;
+}
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef QMULATOR_SVD_HPP
+#define QMULATOR_SVD_HPP
+
+#include <math.h>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include "complex.hpp"
+
+/*
+	Singular value decomposition of small dense complex matrices, A = U S V†,
+	by one-sided Jacobi rotations: pairs of columns are rotated until they
+	are mutually orthogonal, their norms then being the singular values.
+	It is slower than bidiagonalisation but accurate for small singular
+	values, which decide where a state gets truncated.
+
+	Matrices are row-major. U is rows x k and V is cols x k for
+	k = min(rows, cols), both row-major, and the singular values come out
+	in decreasing order.
+*/
+
+template<class T>
+class SVD
+{
+private:
+	static void orthogonalise(int, int, vector<Complex<T> > &, vector<Complex<T> > &);
+
+public:
+	static void compute(int, int, const Complex<T> *, vector<Complex<T> > &, vector<T> &, vector<Complex<T> > &);
+};
+
+template<class T>
+void SVD<T>::orthogonalise(int m, int n, vector<Complex<T> > &w, vector<Complex<T> > &v)
+{
+	// Rotates the n columns of w (column-major, m rows) until orthogonal,
+	// applying the same rotations to v (column-major, n rows).
+	const T tolerance = numeric_limits<T>::epsilon() * m;
+	const int MAX_SWEEPS = 60;
+
+	for(int sweep=0; sweep<MAX_SWEEPS; ++sweep)
+	{
+		bool rotated = false;
+
+		for(int p=0; p<n-1; ++p)
+		{
+			for(int q=p+1; q<n; ++q)
+			{
+				Complex<T> *wp = &w[(uint64_t)p * m], *wq = &w[(uint64_t)q * m];
+				T alpha = 0, beta = 0, gammaRe = 0, gammaIm = 0;
+
+				for(int i=0; i<m; ++i)
+				{
+					T pr = wp[i].getRe(), pi = wp[i].getIm();
+					T qr = wq[i].getRe(), qi = wq[i].getIm();
+
+					alpha += pr * pr + pi * pi;
+					beta += qr * qr + qi * qi;
+					gammaRe += pr * qr + pi * qi;
+					gammaIm += pr * qi - pi * qr;
+				}
+
+				T gamma = sqrt(gammaRe * gammaRe + gammaIm * gammaIm);
+
+				if(gamma == 0 || gamma <= tolerance * sqrt(alpha * beta))
+					continue;
+
+				rotated = true;
+
+				// w_p' = c w_p - s e* w_q and w_q' = s e w_p + c w_q, with e the
+				// phase of w_p† w_q, zero the overlap of the pair
+				T zeta = (beta - alpha) / (2 * gamma);
+				T t = ((zeta >= 0)? 1 : -1) / (fabs(zeta) + sqrt(1 + zeta * zeta));
+				T c = 1 / sqrt(1 + t * t), s = c * t;
+				T er = gammaRe / gamma, ei = gammaIm / gamma;
+
+				for(int pass=0; pass<2; ++pass)
+				{
+					Complex<T> *a = (pass == 0)? wp : &v[(uint64_t)p * n];
+					Complex<T> *b = (pass == 0)? wq : &v[(uint64_t)q * n];
+					int len = (pass == 0)? m : n;
+
+					for(int i=0; i<len; ++i)
+					{
+						T ar = a[i].getRe(), ai = a[i].getIm();
+						T br = b[i].getRe(), bi = b[i].getIm();
+
+						a[i].set(c * ar - s * (er * br + ei * bi), c * ai - s * (er * bi - ei * br));
+						b[i].set(s * (er * ar - ei * ai) + c * br, s * (er * ai + ei * ar) + c * bi);
+					}
+				}
+			}
+		}
+
+		if(!rotated)
+			break;
+	}
+}
+
+template<class T>
+void SVD<T>::compute(int rows, int cols, const Complex<T> *a, vector<Complex<T> > &u, vector<T> &s, vector<Complex<T> > &v)
+{
+	// Rotating the shorter side keeps the pairs few, so a wide matrix is
+	// decomposed through its adjoint A† = V S U†.
+	bool adjoint = cols > rows;
+	int m = (adjoint)? cols : rows;
+	int n = (adjoint)? rows : cols;
+
+	vector<Complex<T> > w((uint64_t)m * n), basis((uint64_t)n * n, Complex<T>(0, 0));
+
+	for(int r=0; r<rows; ++r)
+	{
+		for(int c=0; c<cols; ++c)
+		{
+			Complex<T> entry = a[(uint64_t)r * cols + c];
+
+			if(adjoint)
+				w[(uint64_t)r * m + c] = Complex<T>(entry.getRe(), -entry.getIm());
+			else
+				w[(uint64_t)c * m + r] = entry;
+		}
+	}
+
+	for(int i=0; i<n; ++i)
+		basis[(uint64_t)i * n + i] = Complex<T>(1, 0);
+
+	orthogonalise(m, n, w, basis);
+
+	vector<T> norms(n);
+	vector<int> order(n);
+
+	for(int j=0; j<n; ++j)
+	{
+		T sum = 0;
+
+		for(int i=0; i<m; ++i)
+			sum += w[(uint64_t)j * m + i].normSq();
+
+		norms[j] = sqrt(sum);
+		order[j] = j;
+	}
+
+	sort(order.begin(), order.end(), [&](int x, int y) { return norms[x] > norms[y]; });
+
+	// left vectors are the normalised columns of w, right vectors those of
+	// the accumulated rotations; A† = U S V† means A = V S U†, so for the
+	// adjoint the two just trade places
+	vector<Complex<T> > &left = (adjoint)? v : u;
+	vector<Complex<T> > &right = (adjoint)? u : v;
+
+	left.assign((uint64_t)m * n, Complex<T>(0, 0));
+	right.assign((uint64_t)n * n, Complex<T>(0, 0));
+	s.assign(n, 0);
+
+	for(int k=0; k<n; ++k)
+	{
+		int j = order[k];
+		s[k] = norms[j];
+
+		T scale = (norms[j] > 0)? 1 / norms[j] : 0;
+
+		for(int i=0; i<m; ++i)
+			left[(uint64_t)i * n + k] = w[(uint64_t)j * m + i] * scale;
+
+		for(int i=0; i<n; ++i)
+			right[(uint64_t)i * n + k] = basis[(uint64_t)j * n + i];
+	}
+}
+
+#endif
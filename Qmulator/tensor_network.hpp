@@ -0,0 +1,981 @@
+#ifndef QMULATOR_TENSOR_NETWORK_HPP
+#define QMULATOR_TENSOR_NETWORK_HPP
+
+#include <stdio.h>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <math.h>
+#include "complex.hpp"
+#include "matrix.hpp"
+#include "quantum_gates.hpp"
+#include "circuit.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+	Tensor network backend for single amplitudes of circuits too wide for a
+	state vector. The recorded circuit becomes a network: |0⟩ vectors on
+	the inputs, one tensor per gate on the wires it touches and, per query,
+	a ⟨x_q| vector closing each output wire. Every index is a wire segment
+	of dimension 2, and a tensor of rank k holds 2^k entries with its j-th
+	index as bit j of the offset.
+
+	The contraction order is chosen once per circuit by a greedy heuristic
+	that repeatedly contracts the pair of neighbouring tensors whose result
+	is smallest relative to its inputs. Each pairwise contraction permutes
+	both tensors into matrices over their free and shared indices and
+	multiplies them, the rows split across OpenMP threads. When the
+	largest intermediate would exceed the configured size, indices are
+	sliced: each is fixed to 0 and to 1 in turn and the independent
+	contractions summed, trading repeated work for memory. Slices, and the
+	bitstrings of a batch, are spread across threads instead when there
+	are enough of them.
+*/
+
+template<class Type>
+class TensorNetwork
+{
+private:
+	struct Tensor
+	{
+		vector<int> indices;
+		vector<Complex<Type> > data;
+	};
+
+	// one pairwise contraction of the plan: slot a absorbs slot b
+	struct Step
+	{
+		int a;
+		int b;
+	};
+
+	unsigned int numQubits;
+	Circuit<Type> circuit;
+
+	// the network, rebuilt when the circuit changes; outputs[q] is the open
+	// index of qubit q, closed by a cap per query
+	vector<Tensor> tensors;
+	vector<int> outputs;
+	int numIndices;
+	bool built;
+
+	vector<Step> plan;
+	vector<int> sliced;
+	double cost;
+	int peak;
+
+	int maxIntermediate;
+	int numThreads;
+
+	QuantumGates<Type> gate;
+
+	void build();
+	void addGate(Matrix<Type>, vector<int> &, vector<int> &);
+	Matrix<Type> controlled(int, int, Matrix<Type> &);
+
+	void planOrder();
+	int simulate(vector<int> &, double &, int &);
+	void planSlices();
+
+	Complex<Type> contract(vector<Tensor> &, bool);
+	void contractPair(Tensor &, Tensor &, Tensor &, bool);
+	void permute(Tensor &, vector<int> &, vector<Complex<Type> > &);
+	vector<Tensor> restrict(vector<Tensor> &, uint64_t);
+	vector<Tensor> closed(string &);
+
+	int threads();
+
+	void barf(string, string);
+
+public:
+	static const int DEFAULT_MAX_INTERMEDIATE = 26;
+
+	/* Constructor */
+	TensorNetwork(int);
+
+	/* Quantum Logic Gates */
+	void H(int);
+	void X(int);
+	void Y(int);
+	void Z(int);
+	void T(int);
+	void S(int);
+	void U(Matrix<Type>, int);
+	void U(Matrix<Type>, vector<int>);
+
+	void MCU(vector<int>, int, Matrix<Type>);
+	void MCU(vector<int>, vector<int>, int, Matrix<Type>);
+	void CNOT(int, int);
+	void CY(int, int);
+	void CZ(int, int);
+	void Toffoli(int, int, int);
+
+	void Swap(int, int);
+
+	void load(Circuit<Type> &);
+
+	/* Contraction */
+	Complex<Type> amplitude(string);
+	Complex<Type> amplitude(uint64_t);
+	vector<Complex<Type> > amplitudes(vector<string>);
+
+	void setMaxIntermediate(int);
+	void setNumThreads(int);
+
+	/* Utilities */
+	double contractionCost();
+	int peakRank();
+	int numSlices();
+	unsigned int size();
+	void printPlan();
+};
+
+template<class Type>
+const int TensorNetwork<Type>::DEFAULT_MAX_INTERMEDIATE;
+
+/* Constructor */
+
+template<class Type>
+TensorNetwork<Type>::TensorNetwork(int qubits)
+{
+	if(qubits < 1)
+		barf("TensorNetwork", "at least one qubit required");
+
+	numQubits = qubits;
+	built = false;
+	maxIntermediate = DEFAULT_MAX_INTERMEDIATE;
+	numThreads = 0;
+	cost = 0;
+	peak = 0;
+}
+
+template<class Type>
+void TensorNetwork<Type>::barf(string function, string message)
+{
+	cout << "[error] " << "<" << function << ">";
+	cout << " " << message << endl;
+	exit(1);
+}
+
+template<class Type>
+int TensorNetwork<Type>::threads()
+{
+#ifdef _OPENMP
+	return (numThreads > 0)? numThreads : omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+/* Quantum Logic Gates */
+
+template<class Type>
+void TensorNetwork<Type>::H(int qubit)
+{
+	circuit.add(Operation(Operation::H, qubit));
+	built = false;
+}
+
+template<class Type>
+void TensorNetwork<Type>::X(int qubit)
+{
+	circuit.add(Operation(Operation::X, qubit));
+	built = false;
+}
+
+template<class Type>
+void TensorNetwork<Type>::Y(int qubit)
+{
+	circuit.add(Operation(Operation::Y, qubit));
+	built = false;
+}
+
+template<class Type>
+void TensorNetwork<Type>::Z(int qubit)
+{
+	circuit.add(Operation(Operation::Z, qubit));
+	built = false;
+}
+
+template<class Type>
+void TensorNetwork<Type>::T(int qubit)
+{
+	circuit.add(Operation(Operation::T, qubit));
+	built = false;
+}
+
+template<class Type>
+void TensorNetwork<Type>::S(int qubit)
+{
+	circuit.add(Operation(Operation::S, qubit));
+	built = false;
+}
+
+template<class Type>
+void TensorNetwork<Type>::U(Matrix<Type> u, int qubit)
+{
+	circuit.add(Operation(Operation::U, qubit), u);
+	built = false;
+}
+
+template<class Type>
+void TensorNetwork<Type>::U(Matrix<Type> u, vector<int> qubits)
+{
+	// Bit j of the matrix index is qubits[j], as for Qubits.
+	circuit.add(Operation(Operation::UNITARY, qubits), u);
+	built = false;
+}
+
+template<class Type>
+void TensorNetwork<Type>::MCU(vector<int> controls, int target, Matrix<Type> u)
+{
+	MCU(controls, vector<int>(), target, u);
+}
+
+template<class Type>
+void TensorNetwork<Type>::MCU(vector<int> controls, vector<int> openControls, int target, Matrix<Type> u)
+{
+	vector<int> qubits = controls;
+	qubits.insert(qubits.end(), openControls.begin(), openControls.end());
+	qubits.push_back(target);
+
+	Operation op(Operation::MCU, qubits);
+	op.numControls = controls.size();
+	op.numOpenControls = openControls.size();
+
+	circuit.add(op, u);
+	built = false;
+}
+
+template<class Type>
+void TensorNetwork<Type>::CNOT(int control, int target)
+{
+	circuit.add(Operation(Operation::CNOT, control, target));
+	built = false;
+}
+
+template<class Type>
+void TensorNetwork<Type>::CY(int control, int target)
+{
+	circuit.add(Operation(Operation::CY, control, target));
+	built = false;
+}
+
+template<class Type>
+void TensorNetwork<Type>::CZ(int control, int target)
+{
+	circuit.add(Operation(Operation::CZ, control, target));
+	built = false;
+}
+
+template<class Type>
+void TensorNetwork<Type>::Toffoli(int control1, int control2, int target)
+{
+	circuit.add(Operation(Operation::TOFFOLI, control1, control2, target));
+	built = false;
+}
+
+template<class Type>
+void TensorNetwork<Type>::Swap(int qubit1, int qubit2)
+{
+	circuit.add(Operation(Operation::SWAP, qubit1, qubit2));
+	built = false;
+}
+
+template<class Type>
+void TensorNetwork<Type>::load(Circuit<Type> &other)
+{
+	// Appends the unitary operations of another circuit; margins and
+	// barriers are dropped, measurements are not supported.
+	for(uint64_t i=0; i<other.size(); ++i)
+	{
+		Operation &op = other.at(i);
+
+		if(op.type == Operation::MARGIN || op.type == Operation::BARRIER)
+			continue;
+
+		if(!op.isUnitary())
+			barf("load", "measurements cannot be part of a tensor network");
+
+		if(op.hasMatrix())
+			circuit.add(op, other.matrix(op));
+		else
+			circuit.add(op);
+	}
+
+	built = false;
+}
+
+/* Network Construction */
+
+template<class Type>
+Matrix<Type> TensorNetwork<Type>::controlled(int numControls, int numOpenControls, Matrix<Type> &u)
+{
+	// Full matrix of u on the last bit, applied when the first numControls
+	// bits are 1 and the next numOpenControls bits are 0.
+	int k = numControls + numOpenControls + 1;
+	uint64_t dim = 1ULL << k;
+	uint64_t half = dim / 2;
+	uint64_t value = (1ULL << numControls) - 1;
+
+	Matrix<Type> full(dim, dim);
+
+	for(uint64_t i=0; i<dim; ++i)
+		full.set(i, i, 1, 0);
+
+	for(int r=0; r<2; ++r)
+	{
+		for(int c=0; c<2; ++c)
+		{
+			Complex<Type> entry = u.get(r, c);
+			full.set(value | r * half, value | c * half, entry.getRe(), entry.getIm());
+		}
+	}
+
+	return full;
+}
+
+template<class Type>
+void TensorNetwork<Type>::addGate(Matrix<Type> u, vector<int> &qubits, vector<int> &wires)
+{
+	// A gate on k qubits is a tensor of rank 2k: its outputs are new wire
+	// segments (bits 0 .. k-1) and its inputs the current ones (bits k ..
+	// 2k-1), so entry u[row][col] sits at offset row + col * 2^k.
+	int k = qubits.size();
+	uint64_t dim = 1ULL << k;
+
+	Tensor tensor;
+
+	for(int j=0; j<k; ++j)
+	{
+		if(qubits.at(j) < 0 || qubits.at(j) >= numQubits)
+			barf("TensorNetwork", "qubit out of range");
+
+		tensor.indices.push_back(numIndices++);
+	}
+
+	for(int j=0; j<k; ++j)
+	{
+		tensor.indices.push_back(wires.at(qubits.at(j)));
+		wires.at(qubits.at(j)) = tensor.indices.at(j);
+	}
+
+	tensor.data.resize(dim * dim);
+
+	for(uint64_t row=0; row<dim; ++row)
+	{
+		for(uint64_t col=0; col<dim; ++col)
+			tensor.data[row + col * dim] = u.get(row, col);
+	}
+
+	tensors.push_back(tensor);
+}
+
+template<class Type>
+void TensorNetwork<Type>::build()
+{
+	// Turns the recorded circuit into tensors, then plans the contraction.
+	tensors.clear();
+	numIndices = 0;
+
+	vector<int> wires(numQubits);
+
+	for(int q=0; q<numQubits; ++q)
+	{
+		Tensor zero;
+		zero.indices.push_back(numIndices);
+		zero.data.push_back(Complex<Type>(1, 0));
+		zero.data.push_back(Complex<Type>(0, 0));
+
+		tensors.push_back(zero);
+		wires.at(q) = numIndices++;
+	}
+
+	for(uint64_t i=0; i<circuit.size(); ++i)
+	{
+		Operation &op = circuit.at(i);
+		vector<int> &q = op.qubits;
+
+		switch(op.type)
+		{
+			case Operation::H: addGate(gate.Hadamard(), q, wires); break;
+			case Operation::X: addGate(gate.Pauli_X(), q, wires); break;
+			case Operation::Y: addGate(gate.Pauli_Y(), q, wires); break;
+			case Operation::Z: addGate(gate.Pauli_Z(), q, wires); break;
+			case Operation::T: addGate(gate.PhaseShift(M_PI / 4), q, wires); break;
+			case Operation::S: addGate(gate.PhaseShift(M_PI / 2), q, wires); break;
+			case Operation::PHASE: addGate(gate.PhaseShift(op.params.at(0)), q, wires); break;
+			case Operation::U: addGate(circuit.matrix(op), q, wires); break;
+			case Operation::UNITARY: addGate(circuit.matrix(op), q, wires); break;
+
+			case Operation::CNOT:
+			{
+				Matrix<Type> x = gate.Pauli_X();
+				addGate(controlled(1, 0, x), q, wires);
+				break;
+			}
+
+			case Operation::CY:
+			{
+				Matrix<Type> y = gate.Pauli_Y();
+				addGate(controlled(1, 0, y), q, wires);
+				break;
+			}
+
+			case Operation::CZ:
+			{
+				Matrix<Type> z = gate.Pauli_Z();
+				addGate(controlled(1, 0, z), q, wires);
+				break;
+			}
+
+			case Operation::TOFFOLI:
+			{
+				Matrix<Type> x = gate.Pauli_X();
+				addGate(controlled(2, 0, x), q, wires);
+				break;
+			}
+
+			case Operation::MCU:
+				addGate(controlled(op.numControls, op.numOpenControls, circuit.matrix(op)), q, wires);
+				break;
+
+			// a swap only exchanges which wire belongs to which qubit
+			case Operation::SWAP:
+				std::swap(wires.at(q.at(0)), wires.at(q.at(1)));
+				break;
+		}
+	}
+
+	outputs = wires;
+
+	// caps for the outputs, filled in per query
+	for(int q=0; q<numQubits; ++q)
+	{
+		Tensor cap;
+		cap.indices.push_back(outputs.at(q));
+		cap.data.assign(2, Complex<Type>(0, 0));
+
+		tensors.push_back(cap);
+	}
+
+	planOrder();
+	planSlices();
+
+	built = true;
+}
+
+/* Contraction Planning */
+
+template<class Type>
+void TensorNetwork<Type>::planOrder()
+{
+	// Greedy order: every index joins exactly two tensors, so the candidate
+	// pairs are the indices. The pair whose result grows the least against
+	// its inputs goes first, ties going to the smaller result. Tensors
+	// stand for their index lists only; no data is touched.
+	vector<vector<int> > shapes;
+
+	for(int i=0; i<tensors.size(); ++i)
+		shapes.push_back(tensors.at(i).indices);
+
+	vector<pair<int, int> > owners(numIndices, make_pair(-1, -1));
+
+	for(int i=0; i<shapes.size(); ++i)
+	{
+		for(int j=0; j<shapes.at(i).size(); ++j)
+		{
+			pair<int, int> &o = owners.at(shapes.at(i).at(j));
+
+			if(o.first < 0)
+				o.first = i;
+			else
+				o.second = i;
+		}
+	}
+
+	plan.clear();
+
+	while(true)
+	{
+		int bestA = -1, bestB = -1;
+		double bestScore = 0, bestSize = 0;
+
+		for(int index=0; index<numIndices; ++index)
+		{
+			int a = owners.at(index).first, b = owners.at(index).second;
+
+			if(a < 0 || b < 0 || a == b)
+				continue;
+
+			int shared = 0;
+
+			for(int x=0; x<shapes.at(a).size(); ++x)
+				shared += count(shapes.at(b).begin(), shapes.at(b).end(), shapes.at(a).at(x));
+
+			int rank = shapes.at(a).size() + shapes.at(b).size() - 2 * shared;
+			double size = ldexp(1.0, rank);
+			double score = size - ldexp(1.0, shapes.at(a).size()) - ldexp(1.0, shapes.at(b).size());
+
+			if(bestA < 0 || score < bestScore || (score == bestScore && size < bestSize))
+			{
+				bestA = a;
+				bestB = b;
+				bestScore = score;
+				bestSize = size;
+			}
+		}
+
+		if(bestA < 0)
+			break;
+
+		Step step = {bestA, bestB};
+		plan.push_back(step);
+
+		// the result keeps the unshared indices of both and lives in slot a
+		vector<int> merged;
+
+		for(int x=0; x<shapes.at(bestA).size(); ++x)
+		{
+			int index = shapes.at(bestA).at(x);
+
+			if(find(shapes.at(bestB).begin(), shapes.at(bestB).end(), index) == shapes.at(bestB).end())
+				merged.push_back(index);
+			else
+				owners.at(index) = make_pair(-1, -1);
+		}
+
+		for(int x=0; x<shapes.at(bestB).size(); ++x)
+		{
+			int index = shapes.at(bestB).at(x);
+
+			if(owners.at(index).first < 0)
+				continue;
+
+			merged.push_back(index);
+			pair<int, int> &o = owners.at(index);
+
+			if(o.first == bestB)
+				o.first = bestA;
+			else
+				o.second = bestA;
+		}
+
+		shapes.at(bestA) = merged;
+		shapes.at(bestB).clear();
+	}
+}
+
+template<class Type>
+int TensorNetwork<Type>::simulate(vector<int> &removed, double &flops, int &atPeak)
+{
+	// Largest intermediate rank along the plan once the removed indices are
+	// fixed, how many intermediates reach it, and the multiply-adds of one
+	// contraction.
+	vector<vector<int> > shapes;
+
+	for(int i=0; i<tensors.size(); ++i)
+	{
+		vector<int> shape;
+
+		for(int j=0; j<tensors.at(i).indices.size(); ++j)
+		{
+			int index = tensors.at(i).indices.at(j);
+
+			if(find(removed.begin(), removed.end(), index) == removed.end())
+				shape.push_back(index);
+		}
+
+		shapes.push_back(shape);
+	}
+
+	int largest = 0;
+	flops = 0;
+	atPeak = 0;
+
+	for(int s=0; s<plan.size(); ++s)
+	{
+		vector<int> &a = shapes.at(plan.at(s).a), &b = shapes.at(plan.at(s).b);
+		vector<int> merged;
+		int shared = 0;
+
+		for(int x=0; x<a.size(); ++x)
+		{
+			if(find(b.begin(), b.end(), a.at(x)) == b.end())
+				merged.push_back(a.at(x));
+			else
+				++shared;
+		}
+
+		for(int x=0; x<b.size(); ++x)
+		{
+			if(find(a.begin(), a.end(), b.at(x)) == a.end())
+				merged.push_back(b.at(x));
+		}
+
+		flops += ldexp(1.0, merged.size() + shared);
+
+		if((int)merged.size() > largest)
+		{
+			largest = merged.size();
+			atPeak = 0;
+		}
+
+		atPeak += ((int)merged.size() == largest);
+
+		a = merged;
+		b.clear();
+	}
+
+	return largest;
+}
+
+template<class Type>
+void TensorNetwork<Type>::planSlices()
+{
+	// While the largest intermediate exceeds the limit, slices the index
+	// whose removal lowers the peak most. Often no single index does, as
+	// several intermediates share the peak, so fewer of them at the peak
+	// also counts, then the lower cost. The order stays as planned for the
+	// whole network.
+	int atPeak;
+	sliced.clear();
+	peak = simulate(sliced, cost, atPeak);
+
+	while(maxIntermediate > 0 && peak > maxIntermediate)
+	{
+		int best = -1, bestPeak = peak, bestAtPeak = atPeak;
+		double bestCost = 0;
+
+		for(int index=0; index<numIndices; ++index)
+		{
+			if(find(sliced.begin(), sliced.end(), index) != sliced.end())
+				continue;
+
+			vector<int> trial = sliced;
+			trial.push_back(index);
+
+			double flops;
+			int trialAtPeak;
+			int trialPeak = simulate(trial, flops, trialAtPeak);
+			flops *= ldexp(1.0, trial.size());
+
+			bool better = trialPeak < bestPeak || (trialPeak == bestPeak && trialAtPeak < bestAtPeak);
+			bool tied = best >= 0 && trialPeak == bestPeak && trialAtPeak == bestAtPeak && flops < bestCost;
+
+			if(better || tied)
+			{
+				best = index;
+				bestPeak = trialPeak;
+				bestAtPeak = trialAtPeak;
+				bestCost = flops;
+			}
+		}
+
+		if(best < 0)
+			break;
+
+		sliced.push_back(best);
+		peak = simulate(sliced, cost, atPeak);
+	}
+
+	cost *= ldexp(1.0, sliced.size());
+}
+
+/* Contraction */
+
+template<class Type>
+void TensorNetwork<Type>::permute(Tensor &tensor, vector<int> &order, vector<Complex<Type> > &result)
+{
+	// Copies the tensor so that bit p of the new offset is index order[p].
+	int rank = order.size();
+	vector<uint64_t> source(rank);
+
+	for(int p=0; p<rank; ++p)
+	{
+		int position = find(tensor.indices.begin(), tensor.indices.end(), order.at(p)) - tensor.indices.begin();
+		source.at(p) = 1ULL << position;
+	}
+
+	result.resize(1ULL << rank);
+
+	for(uint64_t offset=0; offset<result.size(); ++offset)
+	{
+		uint64_t from = 0;
+
+		for(int p=0; p<rank; ++p)
+			from |= ((offset >> p) & 1)? source[p] : 0;
+
+		result[offset] = tensor.data[from];
+	}
+}
+
+template<class Type>
+void TensorNetwork<Type>::contractPair(Tensor &a, Tensor &b, Tensor &result, bool parallel)
+{
+	// result[j + i * nb] = Σ_k A[k + i * K] B[j + k * nb] with i over the
+	// free indices of a, j over those of b and k over the shared ones,
+	// after permuting both operands into that layout.
+	vector<int> freeA, freeB, shared;
+
+	for(int x=0; x<a.indices.size(); ++x)
+	{
+		if(find(b.indices.begin(), b.indices.end(), a.indices.at(x)) == b.indices.end())
+			freeA.push_back(a.indices.at(x));
+		else
+			shared.push_back(a.indices.at(x));
+	}
+
+	for(int x=0; x<b.indices.size(); ++x)
+	{
+		if(find(a.indices.begin(), a.indices.end(), b.indices.at(x)) == a.indices.end())
+			freeB.push_back(b.indices.at(x));
+	}
+
+	vector<int> orderA = shared, orderB = freeB;
+	orderA.insert(orderA.end(), freeA.begin(), freeA.end());
+	orderB.insert(orderB.end(), shared.begin(), shared.end());
+
+	vector<Complex<Type> > matrixA, matrixB;
+	permute(a, orderA, matrixA);
+	permute(b, orderB, matrixB);
+
+	int64_t rows = 1LL << freeA.size();
+	uint64_t inner = 1ULL << shared.size();
+	uint64_t cols = 1ULL << freeB.size();
+
+	result.indices = freeB;
+	result.indices.insert(result.indices.end(), freeA.begin(), freeA.end());
+	result.data.assign(rows * cols, Complex<Type>(0, 0));
+
+	Complex<Type> *left = matrixA.data(), *right = matrixB.data(), *out = result.data.data();
+
+	#pragma omp parallel for if(parallel && rows > 1 && rows * inner * cols >= (1 << 16)) num_threads(threads())
+	for(int64_t i=0; i<rows; ++i)
+	{
+		Complex<Type> *row = out + i * cols;
+
+		for(uint64_t k=0; k<inner; ++k)
+		{
+			Complex<Type> x = left[i * inner + k];
+
+			if(x.getRe() == 0 && x.getIm() == 0)
+				continue;
+
+			Complex<Type> *from = right + k * cols;
+
+			for(uint64_t j=0; j<cols; ++j)
+				row[j] += x * from[j];
+		}
+	}
+}
+
+template<class Type>
+Complex<Type> TensorNetwork<Type>::contract(vector<Tensor> &network, bool parallel)
+{
+	// Runs the plan; what is left are scalars of disconnected parts.
+	Tensor result;
+
+	for(int s=0; s<plan.size(); ++s)
+	{
+		contractPair(network.at(plan.at(s).a), network.at(plan.at(s).b), result, parallel);
+		network.at(plan.at(s).a).indices.swap(result.indices);
+		network.at(plan.at(s).a).data.swap(result.data);
+
+		network.at(plan.at(s).b).indices.clear();
+		network.at(plan.at(s).b).data.clear();
+	}
+
+	Complex<Type> product(1, 0);
+
+	for(int i=0; i<network.size(); ++i)
+	{
+		if(!network.at(i).data.empty())
+			product = product * network.at(i).data.at(0);
+	}
+
+	return product;
+}
+
+template<class Type>
+vector<typename TensorNetwork<Type>::Tensor> TensorNetwork<Type>::closed(string &bits)
+{
+	// The network with each output capped by ⟨x_q|, qubit n-1 first.
+	if(bits.size() != numQubits)
+		barf("amplitude", "one bit per qubit expected");
+
+	vector<Tensor> network = tensors;
+
+	for(int q=0; q<numQubits; ++q)
+	{
+		int bit = bits.at(numQubits - 1 - q) - '0';
+
+		if(bit != 0 && bit != 1)
+			barf("amplitude", "bits must be 0 or 1");
+
+		Tensor &cap = network.at(network.size() - numQubits + q);
+		cap.data.at(bit) = Complex<Type>(1, 0);
+	}
+
+	return network;
+}
+
+template<class Type>
+vector<typename TensorNetwork<Type>::Tensor> TensorNetwork<Type>::restrict(vector<Tensor> &network, uint64_t slice)
+{
+	// Fixes sliced index s to bit s of slice in every tensor holding it.
+	vector<Tensor> result = network;
+
+	for(int i=0; i<result.size(); ++i)
+	{
+		for(int s=0; s<sliced.size(); ++s)
+		{
+			Tensor &tensor = result.at(i);
+			vector<int>::iterator at = find(tensor.indices.begin(), tensor.indices.end(), sliced.at(s));
+
+			if(at == tensor.indices.end())
+				continue;
+
+			int position = at - tensor.indices.begin();
+			uint64_t value = (slice >> s) & 1;
+			uint64_t low = (1ULL << position) - 1;
+
+			vector<Complex<Type> > data(tensor.data.size() / 2);
+
+			for(uint64_t offset=0; offset<data.size(); ++offset)
+				data[offset] = tensor.data[(offset & low) | ((offset & ~low) << 1) | (value << position)];
+
+			tensor.data.swap(data);
+			tensor.indices.erase(at);
+		}
+	}
+
+	return result;
+}
+
+template<class Type>
+vector<Complex<Type> > TensorNetwork<Type>::amplitudes(vector<string> bitstrings)
+{
+	// ⟨x|C|0⟩ for each bitstring. With enough bitstrings and slices to
+	// occupy every thread, whole contractions run side by side; otherwise
+	// each contraction spreads its multiplications across the threads.
+	if(!built)
+		build();
+
+	int64_t numSlices = 1LL << sliced.size();
+	int64_t jobs = bitstrings.size() * numSlices;
+	bool outer = jobs >= threads();
+
+	vector<vector<Tensor> > networks;
+
+	for(int i=0; i<bitstrings.size(); ++i)
+		networks.push_back(closed(bitstrings.at(i)));
+
+	vector<Complex<Type> > partial(jobs);
+
+	#pragma omp parallel for schedule(dynamic) if(outer && jobs > 1) num_threads(threads())
+	for(int64_t job=0; job<jobs; ++job)
+	{
+		vector<Tensor> network = restrict(networks.at(job / numSlices), job % numSlices);
+		partial.at(job) = contract(network, !outer);
+	}
+
+	vector<Complex<Type> > result(bitstrings.size(), Complex<Type>(0, 0));
+
+	for(int64_t job=0; job<jobs; ++job)
+		result.at(job / numSlices) += partial.at(job);
+
+	return result;
+}
+
+template<class Type>
+Complex<Type> TensorNetwork<Type>::amplitude(string bits)
+{
+	// ⟨bits|C|0⟩ with bits written qubit n-1 first.
+	return amplitudes(vector<string>(1, bits)).at(0);
+}
+
+template<class Type>
+Complex<Type> TensorNetwork<Type>::amplitude(uint64_t index)
+{
+	// Bit q of the index is qubit q, as for Qubits.
+	if(numQubits > 64)
+		barf("amplitude", "index form limited to 64 qubits");
+
+	string bits;
+
+	for(int q=numQubits-1; q>=0; --q)
+		bits.push_back('0' + ((index >> q) & 1));
+
+	return amplitude(bits);
+}
+
+template<class Type>
+void TensorNetwork<Type>::setMaxIntermediate(int rank)
+{
+	// Largest intermediate tensor allowed, as log2 of its entries; indices
+	// are sliced until the plan fits. Zero disables slicing.
+	maxIntermediate = rank;
+	built = false;
+}
+
+template<class Type>
+void TensorNetwork<Type>::setNumThreads(int threads)
+{
+	// Threads for contractions; zero uses the OpenMP default.
+	numThreads = (threads > 0)? threads : 0;
+}
+
+/* Utilities */
+
+template<class Type>
+double TensorNetwork<Type>::contractionCost()
+{
+	// Complex multiply-adds for one amplitude, over all slices.
+	if(!built)
+		build();
+
+	return cost;
+}
+
+template<class Type>
+int TensorNetwork<Type>::peakRank()
+{
+	// log2 of the entries of the largest intermediate tensor.
+	if(!built)
+		build();
+
+	return peak;
+}
+
+template<class Type>
+int TensorNetwork<Type>::numSlices()
+{
+	if(!built)
+		build();
+
+	return 1 << sliced.size();
+}
+
+template<class Type>
+unsigned int TensorNetwork<Type>::size()
+{
+	return numQubits;
+}
+
+template<class Type>
+void TensorNetwork<Type>::printPlan()
+{
+	if(!built)
+		build();
+
+	printf("%zu tensors, %zu contractions, %d sliced indices\n", tensors.size(), plan.size(), (int)sliced.size());
+	printf("Largest intermediate 2^%d entries (%.3g bytes), %.3g multiply-adds per amplitude\n",
+		peak, ldexp((double)sizeof(Complex<Type>), peak), cost);
+}
+
+#endif
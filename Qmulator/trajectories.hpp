@@ -0,0 +1,967 @@
+#ifndef QMULATOR_TRAJECTORIES_HPP
+#define QMULATOR_TRAJECTORIES_HPP
+
+#include <stdio.h>
+#include <random>
+#include <map>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include "complex.hpp"
+#include "random_source.hpp"
+#include "matrix.hpp"
+#include "quantum_gates.hpp"
+#include "circuit.hpp"
+#include "qubits.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+	Noisy circuits simulated by Monte Carlo trajectories: each trajectory
+	runs the pure state in Qubits and, at every channel, applies one Kraus
+	operator drawn with its Born probability. Gates and channels are
+	recorded first and run(shots) executes the trajectories across OpenMP
+	threads, each thread reusing its own register.
+
+	Channels whose operators are all multiples of unitaries (depolarising,
+	phase damping) are mixtures: the choice does not depend on the state,
+	so it is drawn up front. Each trajectory branches off at its first
+	non-identity choice, and trajectories are run in order of that step
+	from a shared noiseless state advanced once, instead of each repeating
+	the common prefix. Channels that depend on the state (amplitude
+	damping) and measurements end the shared prefix.
+
+	Every trajectory draws from its own generator, seeded from the run seed
+	and its index, so the results do not depend on the number of threads.
+*/
+
+template<class Type>
+class Trajectories
+{
+private:
+	// a gate of the circuit, or a channel with its Kraus operators; for a
+	// mixture the probabilities are those of the unitaries in kraus, and
+	// identity is the one that leaves the state alone (-1 if none)
+	struct Step
+	{
+		enum kind: int {GATE, MIXTURE, KRAUS};
+
+		int kind;
+		int identity;
+		uint64_t operation;
+		vector<int> qubits;
+		vector<Matrix<Type> > kraus;
+		vector<Type> probabilities;
+	};
+
+	unsigned int numQubits;
+
+	Circuit<Type> circuit;
+	vector<Step> steps;
+	vector<string> observables;
+	vector<Type> readoutFlip01;
+	vector<Type> readoutFlip10;
+
+	uint64_t seed;
+	int numThreads;
+
+	map<uint64_t, unsigned int> counts;
+	vector<double> means;
+	vector<double> halfWidths;
+	unsigned int numShots;
+	uint64_t numStepsRun;
+	uint64_t numStepsSaved;
+
+	QuantumGates<Type> gate;
+
+	void addGate(Operation);
+	void addGate(Operation, Matrix<Type>);
+	void addChannel(vector<Matrix<Type> >, vector<int>);
+
+	uint64_t sharedSteps();
+	uint64_t firstError(mt19937_64 &, uint64_t);
+	int draw(mt19937_64 &, vector<Type> &);
+	void runStep(Qubits<Type> &, Step &, mt19937_64 &);
+	void applyGate(Qubits<Type> &, Operation &);
+	void applyKraus(Qubits<Type> &, Step &, mt19937_64 &);
+	double expectation(Qubits<Type> &, string &);
+
+	static uint64_t mix(uint64_t);
+
+	void barf(string, string);
+
+public:
+	/* Constructor */
+	Trajectories(int);
+
+	/* Quantum Logic Gates */
+	void H(int);
+	void X(int);
+	void Y(int);
+	void Z(int);
+	void T(int);
+	void S(int);
+	void U(Matrix<Type>, int);
+	void U(Matrix<Type>, vector<int>);
+	void Measure(int);
+
+	void MCU(vector<int>, int, Matrix<Type>);
+	void MCU(vector<int>, vector<int>, int, Matrix<Type>);
+	void CNOT(int, int);
+	void CY(int, int);
+	void CZ(int, int);
+	void Toffoli(int, int, int);
+
+	void Swap(int, int);
+
+	/* Noise Channels */
+	void Kraus(vector<Matrix<Type> >, int);
+	void Kraus(vector<Matrix<Type> >, vector<int>);
+	void Depolarise(int, Type);
+	void AmplitudeDamping(int, Type);
+	void PhaseDamping(int, Type);
+	void setReadoutError(Type, Type);
+
+	/* Execution */
+	int addObservable(string);
+	void run(unsigned int);
+
+	/* Results */
+	map<uint64_t, unsigned int> getCounts();
+	double probability(uint64_t);
+	double probabilityError(uint64_t);
+	double expectation(int);
+	double expectationError(int);
+	uint64_t stepsSaved();
+	void report();
+
+	/* Utilities */
+	unsigned int size();
+	void clear();
+	void setRandomSeed(uint64_t);
+	void setNumThreads(int);
+};
+
+/* Constructor */
+
+template<class Type>
+Trajectories<Type>::Trajectories(int qubits)
+{
+	if(qubits < 1 || qubits > Qubits<Type>::MAX_QUBITS)
+		barf("Trajectories", "number of qubits must be between 1 and 62");
+
+	numQubits = qubits;
+	numThreads = 0;
+	numShots = 0;
+	numStepsRun = 0;
+	numStepsSaved = 0;
+
+	readoutFlip01.assign(numQubits, 0);
+	readoutFlip10.assign(numQubits, 0);
+
+	seed = RandomSource<Type>::deviceSeed();
+}
+
+template<class Type>
+void Trajectories<Type>::barf(string function, string message)
+{
+	cout << "[error] " << "<" << function << ">";
+	cout << " " << message << endl;
+	exit(1);
+}
+
+/* Circuit Recording */
+
+template<class Type>
+void Trajectories<Type>::addGate(Operation op)
+{
+	Step step;
+	step.kind = Step::GATE;
+	step.identity = -1;
+	step.operation = circuit.size();
+
+	circuit.add(op);
+	steps.push_back(step);
+}
+
+template<class Type>
+void Trajectories<Type>::addGate(Operation op, Matrix<Type> u)
+{
+	Step step;
+	step.kind = Step::GATE;
+	step.identity = -1;
+	step.operation = circuit.size();
+
+	circuit.add(op, u);
+	steps.push_back(step);
+}
+
+template<class Type>
+void Trajectories<Type>::addChannel(vector<Matrix<Type> > operators, vector<int> qubits)
+{
+	// A channel is a mixture when every K† K is a multiple p I of the
+	// identity; K / sqrt(p) is then applied with probability p. Either way
+	// Σ K† K must be the identity, as DensityMatrix::Kraus requires.
+	uint64_t dim = 1ULL << qubits.size();
+	Type tolerance = sqrt(numeric_limits<Type>::epsilon());
+
+	Step step;
+	step.kind = Step::MIXTURE;
+	step.identity = -1;
+	step.qubits = qubits;
+
+	vector<Complex<Type> > sum(dim * dim, Complex<Type>(0, 0));
+
+	for(int o=0; o<operators.size(); ++o)
+	{
+		Matrix<Type> &k = operators.at(o);
+
+		if(k.rows() != dim || k.cols() != dim)
+			barf("Kraus", "operators must be 2^k x 2^k for k qubits");
+
+		// (K† K)[r][c] for every r and c
+		vector<Complex<Type> > product(dim * dim, Complex<Type>(0, 0));
+
+		for(uint64_t r=0; r<dim; ++r)
+		for(uint64_t c=0; c<dim; ++c)
+		for(uint64_t i=0; i<dim; ++i)
+		{
+			Complex<Type> left = k.get(i, r);
+			product.at(r * dim + c) += Complex<Type>(left.getRe(), -left.getIm()) * k.get(i, c);
+		}
+
+		Type p = product.at(0).getRe();
+
+		for(uint64_t i=0; i<dim*dim; ++i)
+			sum.at(i) += product.at(i);
+
+		for(uint64_t r=0; r<dim; ++r)
+		{
+			for(uint64_t c=0; c<dim; ++c)
+			{
+				Complex<Type> expected((r == c)? p : 0, 0);
+
+				if((product.at(r * dim + c) - expected).normSq() > tolerance * tolerance)
+					step.kind = Step::KRAUS;
+			}
+		}
+
+		step.probabilities.push_back(p);
+	}
+
+	for(uint64_t r=0; r<dim; ++r)
+	{
+		for(uint64_t c=0; c<dim; ++c)
+		{
+			Complex<Type> expected((r == c)? 1 : 0, 0);
+
+			if((sum.at(r * dim + c) - expected).normSq() > tolerance * tolerance)
+				barf("Kraus", "operators are not trace preserving");
+		}
+	}
+
+	for(int o=0; o<operators.size(); ++o)
+	{
+		Type p = step.probabilities.at(o);
+		step.kraus.push_back((step.kind == Step::MIXTURE && p > 0)? operators.at(o) * Complex<Type>(1 / sqrt(p), 0) : operators.at(o));
+
+		if(step.kind != Step::MIXTURE || p <= 0 || step.identity >= 0)
+			continue;
+
+		bool identity = true;
+
+		for(uint64_t r=0; r<dim; ++r)
+		for(uint64_t c=0; c<dim; ++c)
+		{
+			if((step.kraus.back().get(r, c) - Complex<Type>((r == c)? 1 : 0, 0)).normSq() > tolerance * tolerance)
+				identity = false;
+		}
+
+		if(identity)
+			step.identity = o;
+	}
+
+	steps.push_back(step);
+}
+
+/* Quantum Logic Gates */
+
+template<class Type>
+void Trajectories<Type>::H(int qubit)
+{
+	addGate(Operation(Operation::H, qubit));
+}
+
+template<class Type>
+void Trajectories<Type>::X(int qubit)
+{
+	addGate(Operation(Operation::X, qubit));
+}
+
+template<class Type>
+void Trajectories<Type>::Y(int qubit)
+{
+	addGate(Operation(Operation::Y, qubit));
+}
+
+template<class Type>
+void Trajectories<Type>::Z(int qubit)
+{
+	addGate(Operation(Operation::Z, qubit));
+}
+
+template<class Type>
+void Trajectories<Type>::T(int qubit)
+{
+	addGate(Operation(Operation::T, qubit));
+}
+
+template<class Type>
+void Trajectories<Type>::S(int qubit)
+{
+	addGate(Operation(Operation::S, qubit));
+}
+
+template<class Type>
+void Trajectories<Type>::U(Matrix<Type> u, int qubit)
+{
+	addGate(Operation(Operation::U, qubit), u);
+}
+
+template<class Type>
+void Trajectories<Type>::U(Matrix<Type> u, vector<int> qubits)
+{
+	addGate(Operation(Operation::UNITARY, qubits), u);
+}
+
+template<class Type>
+void Trajectories<Type>::Measure(int qubit)
+{
+	// A mid-circuit measurement; every trajectory ends with all qubits
+	// measured regardless.
+	addGate(Operation(Operation::MEASURE, qubit));
+}
+
+template<class Type>
+void Trajectories<Type>::MCU(vector<int> controls, int target, Matrix<Type> u)
+{
+	MCU(controls, vector<int>(), target, u);
+}
+
+template<class Type>
+void Trajectories<Type>::MCU(vector<int> controls, vector<int> openControls, int target, Matrix<Type> u)
+{
+	vector<int> qubits = controls;
+	qubits.insert(qubits.end(), openControls.begin(), openControls.end());
+	qubits.push_back(target);
+
+	Operation op(Operation::MCU, qubits);
+	op.numControls = controls.size();
+	op.numOpenControls = openControls.size();
+
+	addGate(op, u);
+}
+
+template<class Type>
+void Trajectories<Type>::CNOT(int control, int target)
+{
+	addGate(Operation(Operation::CNOT, control, target));
+}
+
+template<class Type>
+void Trajectories<Type>::CY(int control, int target)
+{
+	addGate(Operation(Operation::CY, control, target));
+}
+
+template<class Type>
+void Trajectories<Type>::CZ(int control, int target)
+{
+	addGate(Operation(Operation::CZ, control, target));
+}
+
+template<class Type>
+void Trajectories<Type>::Toffoli(int control1, int control2, int target)
+{
+	addGate(Operation(Operation::TOFFOLI, control1, control2, target));
+}
+
+template<class Type>
+void Trajectories<Type>::Swap(int qubit1, int qubit2)
+{
+	addGate(Operation(Operation::SWAP, qubit1, qubit2));
+}
+
+/* Noise Channels */
+
+template<class Type>
+void Trajectories<Type>::Kraus(vector<Matrix<Type> > operators, int qubit)
+{
+	addChannel(operators, vector<int>(1, qubit));
+}
+
+template<class Type>
+void Trajectories<Type>::Kraus(vector<Matrix<Type> > operators, vector<int> qubits)
+{
+	// Operators are 2^k x 2^k on k qubits, bit j of their index being the
+	// j-th qubit listed.
+	addChannel(operators, qubits);
+}
+
+template<class Type>
+void Trajectories<Type>::Depolarise(int qubit, Type p)
+{
+	// With probability p, one of X, Y or Z chosen uniformly.
+	vector<Matrix<Type> > operators;
+
+	operators.push_back(gate.Identity() * Complex<Type>(sqrt(1 - p), 0));
+	operators.push_back(gate.Pauli_X() * Complex<Type>(sqrt(p / 3), 0));
+	operators.push_back(gate.Pauli_Y() * Complex<Type>(sqrt(p / 3), 0));
+	operators.push_back(gate.Pauli_Z() * Complex<Type>(sqrt(p / 3), 0));
+
+	addChannel(operators, vector<int>(1, qubit));
+}
+
+template<class Type>
+void Trajectories<Type>::AmplitudeDamping(int qubit, Type gamma)
+{
+	// |1⟩ decays to |0⟩ with probability gamma.
+	Matrix<Type> k0(2, 2), k1(2, 2);
+	k0.set(0, 0, 1, 0);
+	k0.set(1, 1, sqrt(1 - gamma), 0);
+	k1.set(0, 1, sqrt(gamma), 0);
+
+	vector<Matrix<Type> > operators;
+	operators.push_back(k0);
+	operators.push_back(k1);
+
+	addChannel(operators, vector<int>(1, qubit));
+}
+
+template<class Type>
+void Trajectories<Type>::PhaseDamping(int qubit, Type lambda)
+{
+	// The same channel as the Kraus pair diag(1, sqrt(1 - lambda)) and
+	// diag(0, sqrt(lambda)), written as a Z applied with probability
+	// (1 - sqrt(1 - lambda)) / 2 so that it is a mixture.
+	Type p = (1 - sqrt(1 - lambda)) / 2;
+
+	vector<Matrix<Type> > operators;
+	operators.push_back(gate.Identity() * Complex<Type>(sqrt(1 - p), 0));
+	operators.push_back(gate.Pauli_Z() * Complex<Type>(sqrt(p), 0));
+
+	addChannel(operators, vector<int>(1, qubit));
+}
+
+template<class Type>
+void Trajectories<Type>::setReadoutError(Type flip01, Type flip10)
+{
+	// Probabilities that a final 0 is reported as 1, and a 1 as 0.
+	readoutFlip01.assign(numQubits, flip01);
+	readoutFlip10.assign(numQubits, flip10);
+}
+
+/* Execution */
+
+template<class Type>
+int Trajectories<Type>::addObservable(string pauli)
+{
+	// Pauli string over I, X, Y and Z with qubit 0 first, whose expectation
+	// is averaged over the trajectories. Returns its index for expectation().
+	if(pauli.size() != numQubits)
+		barf("addObservable", "one Pauli per qubit expected");
+
+	for(int q=0; q<numQubits; ++q)
+	{
+		if(strchr("IXYZ", pauli.at(q)) == NULL)
+			barf("addObservable", "Paulis are I, X, Y or Z");
+	}
+
+	observables.push_back(pauli);
+
+	return observables.size() - 1;
+}
+
+template<class Type>
+uint64_t Trajectories<Type>::mix(uint64_t x)
+{
+	// splitmix64, to derive independent trajectory seeds from one seed
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+	return x ^ (x >> 31);
+}
+
+template<class Type>
+int Trajectories<Type>::draw(mt19937_64 &generator, vector<Type> &probabilities)
+{
+	Type r = RandomSource<Type>::uniform(generator);
+	int last = 0;
+
+	// if rounding runs the draw past the end, the last choice that can
+	// happen is taken
+	for(int i=0; i<probabilities.size(); ++i)
+	{
+		if(probabilities.at(i) <= 0)
+			continue;
+
+		last = i;
+		r -= probabilities.at(i);
+
+		if(r < 0)
+			return i;
+	}
+
+	return last;
+}
+
+template<class Type>
+uint64_t Trajectories<Type>::sharedSteps()
+{
+	// Steps up to the first that depends on the state; before it every
+	// random choice can be drawn without simulating.
+	for(uint64_t s=0; s<steps.size(); ++s)
+	{
+		if(steps.at(s).kind == Step::KRAUS)
+			return s;
+
+		if(steps.at(s).kind == Step::GATE && !circuit.at(steps.at(s).operation).isUnitary())
+			return s;
+	}
+
+	return steps.size();
+}
+
+template<class Type>
+uint64_t Trajectories<Type>::firstError(mt19937_64 &generator, uint64_t shared)
+{
+	// Draws the mixtures before the shared boundary until one picks an
+	// operator other than the identity.
+	for(uint64_t s=0; s<shared; ++s)
+	{
+		if(steps.at(s).kind == Step::MIXTURE && draw(generator, steps.at(s).probabilities) != steps.at(s).identity)
+			return s;
+	}
+
+	return shared;
+}
+
+template<class Type>
+void Trajectories<Type>::run(unsigned int shots)
+{
+	// Runs the recorded circuit shots times and collects the final outcomes
+	// and the observables. Trajectory t redraws its mixtures from its own
+	// seed, so planning and execution see the same choices.
+	uint64_t shared = sharedSteps();
+	vector<uint64_t> branch(shots);
+	vector<uint64_t> order(shots);
+
+	for(unsigned int t=0; t<shots; ++t)
+	{
+		mt19937_64 generator(mix(seed ^ mix(t)));
+		branch.at(t) = firstError(generator, shared);
+		order.at(t) = t;
+	}
+
+	stable_sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b) { return branch.at(a) < branch.at(b); });
+
+	vector<uint64_t> outcomes(shots);
+	vector<double> values(shots * observables.size());
+
+	Qubits<Type> prefix(numQubits);
+	prefix.enableGraphics = false;
+	prefix.setNumThreads(numThreads);
+
+	uint64_t advanced = 0;
+	uint64_t stepsRun = 0;
+	uint64_t first = 0;
+
+	while(first < shots)
+	{
+		// the trajectories branching at the same step share one prefix state
+		uint64_t s = branch.at(order.at(first));
+		uint64_t last = first;
+
+		while(last < shots && branch.at(order.at(last)) == s)
+			++last;
+
+		mt19937_64 unused;
+		uint64_t previous = advanced;
+
+		for(; advanced<s; ++advanced)
+		{
+			if(steps.at(advanced).kind == Step::GATE)
+				runStep(prefix, steps.at(advanced), unused);
+		}
+
+		// the shared prefix only moves on by the steps not yet run
+		stepsRun += advanced - previous;
+		prefix.flush();
+
+		#pragma omp parallel num_threads((numThreads > 0)? numThreads : omp_get_max_threads()) if(last - first > 1)
+		{
+			Qubits<Type> state(numQubits);
+			state.enableGraphics = false;
+			state.setNumThreads(1);
+
+			#pragma omp for schedule(dynamic) reduction(+:stepsRun)
+			for(uint64_t i=first; i<last; ++i)
+			{
+				uint64_t t = order.at(i);
+				uint64_t trajectorySeed = mix(seed ^ mix(t));
+				mt19937_64 generator(trajectorySeed);
+
+				// replay the identity draws up to the branch point
+				for(uint64_t p=0; p<s; ++p)
+				{
+					if(steps.at(p).kind == Step::MIXTURE)
+						draw(generator, steps.at(p).probabilities);
+				}
+
+				state.flush();
+				memcpy((void *)state.states->data(), prefix.states->data(), prefix.length() * sizeof(Complex<Type>));
+				state.setRandomSeed(mix(trajectorySeed));
+
+				for(uint64_t p=s; p<steps.size(); ++p)
+					runStep(state, steps.at(p), generator);
+
+				stepsRun += steps.size() - s;
+
+				for(int o=0; o<observables.size(); ++o)
+					values.at(t * observables.size() + o) = expectation(state, observables.at(o));
+
+				uint64_t outcome = state.MeasureAll();
+
+				for(int q=0; q<numQubits; ++q)
+				{
+					Type flip = ((outcome >> q) & 1)? readoutFlip10.at(q) : readoutFlip01.at(q);
+
+					if(flip > 0 && RandomSource<Type>::uniform(generator) < flip)
+						outcome ^= 1ULL << q;
+				}
+
+				outcomes.at(t) = outcome;
+			}
+		}
+
+		first = last;
+	}
+
+	// aggregate in trajectory order so the result does not depend on scheduling
+	counts.clear();
+
+	for(unsigned int t=0; t<shots; ++t)
+		++counts[outcomes.at(t)];
+
+	means.assign(observables.size(), 0);
+	halfWidths.assign(observables.size(), 0);
+
+	for(int o=0; o<observables.size(); ++o)
+	{
+		double sum = 0, sumSq = 0;
+
+		for(unsigned int t=0; t<shots; ++t)
+		{
+			double v = values.at(t * observables.size() + o);
+			sum += v;
+			sumSq += v * v;
+		}
+
+		double mean = sum / shots;
+		double variance = (shots > 1)? (sumSq - shots * mean * mean) / (shots - 1) : 0;
+
+		means.at(o) = mean;
+		halfWidths.at(o) = 1.96 * sqrt(max(variance, 0.0) / shots);
+	}
+
+	numShots = shots;
+	numStepsRun = stepsRun;
+	numStepsSaved = (uint64_t)shots * steps.size() - stepsRun;
+}
+
+template<class Type>
+void Trajectories<Type>::runStep(Qubits<Type> &state, Step &step, mt19937_64 &generator)
+{
+	switch(step.kind)
+	{
+		case Step::GATE:
+			applyGate(state, circuit.at(step.operation));
+			break;
+
+		case Step::MIXTURE:
+		{
+			int chosen = draw(generator, step.probabilities);
+
+			if(chosen != step.identity)
+			{
+				if(step.qubits.size() == 1)
+					state.U(step.kraus.at(chosen), step.qubits.at(0));
+				else
+					state.U(step.kraus.at(chosen), step.qubits);
+			}
+
+			break;
+		}
+
+		case Step::KRAUS:
+			applyKraus(state, step, generator);
+			break;
+	}
+}
+
+template<class Type>
+void Trajectories<Type>::applyGate(Qubits<Type> &state, Operation &op)
+{
+	Matrix<Type> *u = (op.hasMatrix())? &circuit.matrix(op) : NULL;
+	vector<int> &q = op.qubits;
+
+	switch(op.type)
+	{
+		case Operation::H: state.H(q.at(0)); break;
+		case Operation::X: state.X(q.at(0)); break;
+		case Operation::Y: state.Y(q.at(0)); break;
+		case Operation::Z: state.Z(q.at(0)); break;
+		case Operation::T: state.T(q.at(0)); break;
+		case Operation::S: state.S(q.at(0)); break;
+		case Operation::U: state.U(*u, q.at(0)); break;
+		case Operation::UNITARY: state.U(*u, q); break;
+		case Operation::CNOT: state.CNOT(q.at(0), q.at(1)); break;
+		case Operation::CY: state.CY(q.at(0), q.at(1)); break;
+		case Operation::CZ: state.CZ(q.at(0), q.at(1)); break;
+		case Operation::TOFFOLI: state.Toffoli(q.at(0), q.at(1), q.at(2)); break;
+		case Operation::SWAP: state.Swap(q.at(0), q.at(1)); break;
+		case Operation::MEASURE: state.Measure(q.at(0)); break;
+
+		case Operation::MCU:
+		{
+			vector<int> controls(q.begin(), q.begin() + op.numControls);
+			vector<int> openControls(q.begin() + op.numControls, q.end() - 1);
+			state.MCU(controls, openControls, op.target(), *u);
+			break;
+		}
+	}
+}
+
+template<class Type>
+void Trajectories<Type>::applyKraus(Qubits<Type> &state, Step &step, mt19937_64 &generator)
+{
+	// Picks K with probability Tr(K ρ K†), ρ being the reduced state of the
+	// channel's qubits, and applies K / sqrt(p) so the state stays normalised.
+	vector<int> &qubits = step.qubits;
+	int k = qubits.size();
+	uint64_t dim = 1ULL << k;
+
+	uint64_t mask = 0;
+
+	for(int j=0; j<k; ++j)
+		mask |= 1ULL << qubits.at(j);
+
+	state.flush();
+
+	Complex<Type> *amplitudes = state.states->data();
+	vector<Complex<Type> > reduced(dim * dim, Complex<Type>(0, 0));
+
+	for(uint64_t i=0; i<state.length(); ++i)
+	{
+		if(i & mask)
+			continue;
+
+		for(uint64_t a=0; a<dim; ++a)
+		{
+			uint64_t ia = i;
+
+			for(int j=0; j<k; ++j)
+				ia |= ((a >> j) & 1) << qubits.at(j);
+
+			for(uint64_t b=0; b<dim; ++b)
+			{
+				uint64_t ib = i;
+
+				for(int j=0; j<k; ++j)
+					ib |= ((b >> j) & 1) << qubits.at(j);
+
+				Complex<Type> right = amplitudes[ib];
+				reduced.at(a * dim + b) += amplitudes[ia] * Complex<Type>(right.getRe(), -right.getIm());
+			}
+		}
+	}
+
+	vector<Type> probabilities;
+
+	for(int o=0; o<step.kraus.size(); ++o)
+	{
+		// Tr(K ρ K†) = Σ K[r][a] ρ[a][b] conj(K[r][b])
+		Matrix<Type> &K = step.kraus.at(o);
+		Type p = 0;
+
+		for(uint64_t r=0; r<dim; ++r)
+		{
+			Complex<Type> sum(0, 0);
+
+			for(uint64_t a=0; a<dim; ++a)
+			for(uint64_t b=0; b<dim; ++b)
+			{
+				Complex<Type> right = K.get(r, b);
+				sum += K.get(r, a) * reduced.at(a * dim + b) * Complex<Type>(right.getRe(), -right.getIm());
+			}
+
+			p += sum.getRe();
+		}
+
+		probabilities.push_back(max(p, (Type)0));
+	}
+
+	int chosen = draw(generator, probabilities);
+	Matrix<Type> scaled = step.kraus.at(chosen) * Complex<Type>(1 / sqrt(probabilities.at(chosen)), 0);
+
+	if(k == 1)
+		state.U(scaled, qubits.at(0));
+	else
+		state.U(scaled, qubits);
+}
+
+template<class Type>
+double Trajectories<Type>::expectation(Qubits<Type> &state, string &pauli)
+{
+	// ⟨ψ|P|ψ⟩ for P = i^(number of Y) X^x Z^z: P|b⟩ picks up (-1)^(b·z) and
+	// lands on |b ^ x⟩.
+	uint64_t x = 0, z = 0;
+	int numY = 0;
+
+	for(int q=0; q<numQubits; ++q)
+	{
+		char p = pauli.at(q);
+
+		x |= (uint64_t)(p == 'X' || p == 'Y') << q;
+		z |= (uint64_t)(p == 'Z' || p == 'Y') << q;
+		numY += (p == 'Y');
+	}
+
+	state.flush();
+
+	Complex<Type> *amplitudes = state.states->data();
+	Complex<Type> sum(0, 0);
+
+	for(uint64_t b=0; b<state.length(); ++b)
+	{
+		Complex<Type> term = amplitudes[b];
+
+		if(__builtin_popcountll(b & z) & 1)
+			term = term * (Type)-1;
+
+		Complex<Type> bra = amplitudes[b ^ x];
+		sum += Complex<Type>(bra.getRe(), -bra.getIm()) * term;
+	}
+
+	Complex<Type> phases[4] = {Complex<Type>(1, 0), Complex<Type>(0, 1), Complex<Type>(-1, 0), Complex<Type>(0, -1)};
+
+	return (phases[numY % 4] * sum).getRe();
+}
+
+/* Results */
+
+template<class Type>
+map<uint64_t, unsigned int> Trajectories<Type>::getCounts()
+{
+	// Histogram of the final outcomes of the last run, readout errors included.
+	return counts;
+}
+
+template<class Type>
+double Trajectories<Type>::probability(uint64_t outcome)
+{
+	if(numShots == 0 || counts.find(outcome) == counts.end())
+		return 0;
+
+	return (double)counts[outcome] / numShots;
+}
+
+template<class Type>
+double Trajectories<Type>::probabilityError(uint64_t outcome)
+{
+	// Half width of the 95% normal-approximation interval of probability().
+	if(numShots == 0)
+		return 0;
+
+	double p = probability(outcome);
+
+	return 1.96 * sqrt(p * (1 - p) / numShots);
+}
+
+template<class Type>
+double Trajectories<Type>::expectation(int observable)
+{
+	return means.at(observable);
+}
+
+template<class Type>
+double Trajectories<Type>::expectationError(int observable)
+{
+	// Half width of the 95% interval of expectation(), from the sample
+	// variance over trajectories.
+	return halfWidths.at(observable);
+}
+
+template<class Type>
+uint64_t Trajectories<Type>::stepsSaved()
+{
+	// Steps of the last run not simulated thanks to the shared prefix.
+	return numStepsSaved;
+}
+
+template<class Type>
+void Trajectories<Type>::report()
+{
+	printf("%u trajectories, %llu steps run, %llu shared\n", numShots,
+		(unsigned long long)numStepsRun, (unsigned long long)numStepsSaved);
+
+	for(map<uint64_t, unsigned int>::iterator it=counts.begin(); it!=counts.end(); ++it)
+	{
+		string decToBin;
+
+		for(int j=0; j<numQubits; ++j)
+			decToBin.insert(decToBin.begin(), (it->first >> j & 1) + '0');
+
+		printf("|%s⟩  %.4f ± %.4f\n", decToBin.c_str(), probability(it->first), probabilityError(it->first));
+	}
+
+	for(int o=0; o<observables.size(); ++o)
+		printf("<%s>  %.4f ± %.4f\n", observables.at(o).c_str(), means.at(o), halfWidths.at(o));
+}
+
+/* Utilities */
+
+template<class Type>
+unsigned int Trajectories<Type>::size()
+{
+	return numQubits;
+}
+
+template<class Type>
+void Trajectories<Type>::clear()
+{
+	// Forgets the recorded circuit and observables.
+	circuit.clear();
+	steps.clear();
+	observables.clear();
+}
+
+template<class Type>
+void Trajectories<Type>::setRandomSeed(uint64_t newSeed)
+{
+	seed = newSeed;
+}
+
+template<class Type>
+void Trajectories<Type>::setNumThreads(int threads)
+{
+	// Threads running trajectories; zero uses the OpenMP default.
+	numThreads = (threads > 0)? threads : 0;
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*
+	Benchmarking the vectorised gate kernels against the scalar path. Each
+	gate is applied to every target qubit of a 22-qubit register and the
+	average time per gate is reported for each SIMD level the CPU supports.
+
+	g++ -O2 -std=c++11 main.cpp -o benchmark_simd
+*/
+
+#include <iostream>
+#include <chrono>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int NUM_QUBITS = 22;
+const int REPEATS = 3;
+
+template<class Type>
+double timeGate(Qubits<Type> &qubits, int gateIndex)
+{
+	Matrix<Type> u(2, 2);
+	u.set(0, 0, 0.6, 0);
+	u.set(0, 1, 0, 0.8);
+	u.set(1, 0, 0, 0.8);
+	u.set(1, 1, 0.6, 0);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	for(int r=0; r<REPEATS; r++)
+	{
+		for(int q=0; q<NUM_QUBITS; q++)
+		{
+			switch(gateIndex)
+			{
+				case 0: qubits.U(u, q); break;
+				case 1: qubits.CNOT((q + 1) % NUM_QUBITS, q); break;
+				case 2: qubits.T(q); break;
+			}
+		}
+	}
+
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+	return elapsed.count() / (REPEATS * NUM_QUBITS);
+}
+
+template<class Type>
+void benchmark(string typeName)
+{
+	string gateNames[3] = {"U", "CNOT", "T"};
+	int detected = SimdKernels::detect();
+
+	Qubits<Type> qubits(NUM_QUBITS);
+	qubits.enableGraphics = false;
+
+	for(int g=0; g<3; g++)
+	{
+		qubits.setSimdLevel(SimdKernels::SCALAR);
+		double scalarTime = timeGate(qubits, g);
+
+		printf("%-6s %-5s %-8s %8.3f ms\n", typeName.c_str(), gateNames[g].c_str(), "scalar", scalarTime);
+
+		for(int level=SimdKernels::SSE2; level<=detected; level++)
+		{
+			qubits.setSimdLevel(level);
+			double simdTime = timeGate(qubits, g);
+
+			printf("%-6s %-5s %-8s %8.3f ms  (x%.2f)\n", typeName.c_str(), gateNames[g].c_str(),
+				SimdKernels::name(level), simdTime, scalarTime / simdTime);
+		}
+	}
+}
+
+int main()
+{
+	printf("Detected: %s\n\n", SimdKernels::name(SimdKernels::detect()));
+
+	benchmark<double>("double");
+	benchmark<float>("float");
+
+	return 0;
+}
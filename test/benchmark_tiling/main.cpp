@@ -0,0 +1,66 @@
+/*
+	Benchmarking cache-blocked execution. A run of gates is applied to each
+	qubit of a 24-qubit register in deferred mode, first gate by gate and
+	then in tiles of 2^14 amplitudes, and the average time per gate is
+	reported against the qubit index.
+
+	g++ -O2 -std=c++11 main.cpp -o benchmark_tiling
+*/
+
+#include <iostream>
+#include <chrono>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int NUM_QUBITS = 24;
+const int TILE_QUBITS = 14;
+const int GATES_PER_QUBIT = 16;
+
+double timeQubit(Qubits<double> &qubits, int qubit)
+{
+	Matrix<double> u(2, 2);
+	u.set(0, 0, 0.6, 0);
+	u.set(0, 1, 0, 0.8);
+	u.set(1, 0, 0, 0.8);
+	u.set(1, 1, 0.6, 0);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	for(int g=0; g<GATES_PER_QUBIT; g++)
+	{
+		qubits.U(u, qubit);
+		qubits.CNOT(qubit, (qubit + 1) % NUM_QUBITS);
+	}
+
+	qubits.run();
+	qubits.flush();
+
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+	return elapsed.count() / (2 * GATES_PER_QUBIT);
+}
+
+int main()
+{
+	Qubits<double> qubits(NUM_QUBITS);
+	qubits.enableGraphics = false;
+	qubits.setDeferred(true);
+
+	// keep the gates from being fused or cancelled so only tiling differs
+	qubits.setMaxFusedWidth(0);
+	qubits.setOptimise(false);
+
+	printf("qubit  untiled (ms)  tiled (ms)\n");
+
+	for(int q=0; q<NUM_QUBITS; q++)
+	{
+		qubits.setTileQubits(0);
+		double untiled = timeQubit(qubits, q);
+
+		qubits.setTileQubits(TILE_QUBITS);
+		double tiled = timeQubit(qubits, q);
+
+		printf("%5d  %12.3f  %10.3f  (x%.2f)\n", q, untiled, tiled, untiled / tiled);
+	}
+
+	return 0;
+}
@@ -0,0 +1,201 @@
+/*
+	Testing the peephole optimiser. Random circuits are built from inverse
+	pairs with gates between them, mostly commuting with the pair (phases
+	on controls, gates on other qubits), phases to be merged, and barriers
+	and measurements that must not be crossed. Each circuit is run deferred
+	with the optimiser on and immediately, from the same seed, and both
+	must end in the same state with the same outcomes. A pair either side
+	of a barrier must be kept.
+
+	g++ -O2 -std=c++11 main.cpp -o circuit_optimiser
+*/
+
+#include <iostream>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int NUM_QUBITS = 8;
+const int NUM_CIRCUITS = 20;
+const int NUM_BLOCKS = 120;
+
+Matrix<double> inverse(Matrix<double> u)
+{
+	// conjugate transpose of a 2 x 2 matrix
+	Matrix<double> v(2, 2);
+
+	for(int r=0; r<2; r++)
+	{
+		for(int c=0; c<2; c++)
+		{
+			Complex<double> x = u.get(c, r);
+			v.set(r, c, x.getRe(), -x.getIm());
+		}
+	}
+
+	return v;
+}
+
+void between(Qubits<double> &qubits, mt19937 &generator, int a, int other)
+{
+	// Gates that commute with a pair controlled by a, or acting on
+	// neither a nor other.
+	switch(generator() % 5)
+	{
+		case 0: qubits.T(a); break;
+		case 1: qubits.CZ(a, other); break;
+		case 2: qubits.H(other); break;
+		case 3: qubits.S(a); qubits.Z(a); break;
+		default: break;
+	}
+}
+
+vector<unsigned int> randomCircuit(Qubits<double> &qubits, int seed)
+{
+	QuantumGates<double> gate;
+	mt19937 generator(seed);
+	uniform_real_distribution<double> angle(0, 2 * M_PI);
+	vector<unsigned int> outcomes;
+
+	for(int q=0; q<NUM_QUBITS; q++)
+		qubits.H(q);
+
+	for(int k=0; k<NUM_BLOCKS; k++)
+	{
+		int a = generator() % NUM_QUBITS;
+		int b = (a + 1 + generator() % (NUM_QUBITS - 1)) % NUM_QUBITS;
+		int other = (b + 1 + generator() % (NUM_QUBITS - 1)) % NUM_QUBITS;
+
+		if(other == a)
+			other = (other + 1) % NUM_QUBITS;
+		if(other == b)
+			other = (other + 1) % NUM_QUBITS;
+		if(other == a)
+			other = (other + 1) % NUM_QUBITS;
+
+		Matrix<double> u = gate.Rotation(angle(generator), angle(generator), angle(generator));
+		int separator = generator() % 8;
+
+		switch(generator() % 7)
+		{
+			case 0:
+				qubits.CNOT(a, b);
+				between(qubits, generator, a, other);
+				qubits.CNOT(a, b);
+				break;
+			case 1:
+				qubits.H(a);
+				qubits.CNOT(b, other);
+				qubits.H(a);
+				break;
+			case 2:
+				qubits.U(u, a);
+				between(qubits, generator, b, other);
+				qubits.U(inverse(u), a);
+				break;
+			case 3:
+			{
+				vector<int> controls(1, a), openControls(1, other);
+
+				qubits.MCU(controls, openControls, b, u);
+
+				if(separator == 0)
+					qubits.barrier();
+				else
+					between(qubits, generator, a, other);
+
+				qubits.MCU(controls, openControls, b, inverse(u));
+				break;
+			}
+			case 4:
+				qubits.T(a);
+				qubits.CZ(a, b);
+				qubits.S(a);
+				qubits.T(a);
+				break;
+			case 5:
+				qubits.Swap(a, b);
+
+				if(separator == 0)
+					outcomes.push_back(qubits.Measure(a));
+
+				qubits.Swap(b, a);
+				break;
+			default:
+				qubits.Toffoli(a, other, b);
+
+				if(separator == 0)
+					qubits.barrier();
+
+				qubits.Toffoli(other, a, b);
+				qubits.U(u, b);
+				break;
+		}
+	}
+
+	outcomes.push_back(qubits.Measure(0));
+
+	return outcomes;
+}
+
+double difference(Qubits<double> &a, Qubits<double> &b)
+{
+	double worst = 0;
+
+	for(uint64_t i=0; i<a.length(); i++)
+	{
+		Complex<double> d = a.amplitude(i) - b.amplitude(i);
+		worst = max(worst, sqrt(d.normSq()));
+	}
+
+	return worst;
+}
+
+int main()
+{
+	double worst = 0;
+	int mismatches = 0, measured = 0;
+	uint64_t removed = 0;
+
+	for(int c=0; c<NUM_CIRCUITS; c++)
+	{
+		// barriers are only recorded with graphics on
+		Qubits<double> immediate(NUM_QUBITS), optimised(NUM_QUBITS);
+		immediate.setRandomSeed(c);
+		optimised.setRandomSeed(c);
+
+		optimised.setDeferred(true);
+		optimised.setOptimise(true);
+
+		vector<unsigned int> a = randomCircuit(immediate, c);
+		vector<unsigned int> b = randomCircuit(optimised, c);
+
+		measured += a.size();
+
+		for(int m=0; m<a.size(); m++)
+			mismatches += (m >= b.size() || a.at(m) != b.at(m));
+
+		worst = max(worst, difference(immediate, optimised));
+		removed += optimised.getOptimiser().gatesRemoved();
+	}
+
+	printf("Optimised circuits: %llu gates removed, %d of %d outcomes differ, max difference %g\n",
+		(unsigned long long)removed, mismatches, measured, worst);
+
+	Qubits<double> kept(2), cancelled(2);
+	kept.setDeferred(true);
+	cancelled.setDeferred(true);
+
+	kept.H(0);
+	kept.barrier();
+	kept.H(0);
+	kept.run();
+
+	cancelled.H(0);
+	cancelled.T(1);
+	cancelled.H(0);
+	cancelled.run();
+
+	printf("Hadamard pair: %llu removed across a barrier, %llu across a gate on another qubit\n",
+		(unsigned long long)kept.getOptimiser().gatesRemoved(), (unsigned long long)cancelled.getOptimiser().gatesRemoved());
+
+	return 0;
+}
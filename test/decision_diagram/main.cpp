@@ -0,0 +1,109 @@
+/*
+	Testing the decision diagram backend. A 24-qubit register in uniform
+	superposition is copied into a second register and incremented by a
+	constant with multi-controlled X gates; the 48-qubit state has 2^24
+	terms yet takes about a hundred nodes, and every sample must satisfy
+	b = a + 5. The registers are interleaved: with b stacked above a, the
+	levels between them would need a node for every value of b. A small
+	random circuit is then compared against Qubits.
+
+	g++ -O2 -std=c++11 main.cpp -o decision_diagram
+*/
+
+#include <iostream>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int REGISTER = 24;
+const int ADDEND = 5;
+const int SMALL_QUBITS = 8;
+const int NUM_GATES = 300;
+
+int main()
+{
+	DecisionDiagram<double> dd(2 * REGISTER);
+	dd.setRandomSeed(3);
+
+	// bit i of a is qubit 2i and bit i of b is qubit 2i + 1
+	for(int i=0; i<REGISTER; i++)
+	{
+		dd.H(2 * i);
+		dd.CNOT(2 * i, 2 * i + 1);
+	}
+
+	// b += 1, ADDEND times: bit i flips when every bit below it is set
+	QuantumGates<double> gate;
+
+	for(int step=0; step<ADDEND; step++)
+	{
+		for(int i=REGISTER-1; i>=0; i--)
+		{
+			vector<int> controls;
+
+			for(int j=0; j<i; j++)
+				controls.push_back(2 * j + 1);
+
+			dd.MCU(controls, 2 * i + 1, gate.Pauli_X());
+		}
+	}
+
+	dd.printStatistics();
+
+	map<uint64_t, unsigned int> counts = dd.Sample(1000);
+	uint64_t mask = (1ULL << REGISTER) - 1;
+	int wrong = 0;
+
+	for(map<uint64_t, unsigned int>::iterator it=counts.begin(); it!=counts.end(); ++it)
+	{
+		uint64_t a = 0, b = 0;
+
+		for(int i=0; i<REGISTER; i++)
+		{
+			a |= (it->first >> (2 * i) & 1) << i;
+			b |= (it->first >> (2 * i + 1) & 1) << i;
+		}
+
+		wrong += (b != ((a + ADDEND) & mask)) * it->second;
+	}
+
+	printf("%zu distinct samples, %d with b != a + %d\n", counts.size(), wrong, ADDEND);
+
+	DecisionDiagram<double> small(SMALL_QUBITS);
+	Qubits<double> reference(SMALL_QUBITS);
+	reference.enableGraphics = false;
+
+	mt19937 generator(1234);
+
+	for(int g=0; g<NUM_GATES; g++)
+	{
+		int a = generator() % SMALL_QUBITS;
+		int b = (a + 1 + generator() % (SMALL_QUBITS - 1)) % SMALL_QUBITS;
+		int c = (b + 1 + generator() % (SMALL_QUBITS - 1)) % SMALL_QUBITS;
+
+		while(c == a || c == b)
+			c = (c + 1) % SMALL_QUBITS;
+
+		switch(generator() % 7)
+		{
+			case 0: small.H(a); reference.H(a); break;
+			case 1: small.T(a); reference.T(a); break;
+			case 2: small.CZ(a, b); reference.CZ(a, b); break;
+			case 3: small.Swap(a, b); reference.Swap(a, b); break;
+			case 4: small.Toffoli(a, b, c); reference.Toffoli(a, b, c); break;
+			case 5: small.CY(b, a); reference.CY(b, a); break;
+			default: small.CNOT(a, b); reference.CNOT(a, b); break;
+		}
+	}
+
+	double worst = 0;
+
+	for(uint64_t i=0; i<reference.length(); i++)
+	{
+		Complex<double> difference = small.amplitude(i) - reference.amplitude(i);
+		worst = max(worst, sqrt(difference.normSq()));
+	}
+
+	printf("Random circuit: max difference %g\n", worst);
+	small.printStatistics();
+
+	return 0;
+}
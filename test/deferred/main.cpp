@@ -0,0 +1,124 @@
+/*
+	Testing deferred execution. Random circuits over every gate of Qubits,
+	with measurements part way through and at the end, are run immediately
+	and deferred from the same seed. The deferred runs go once with the
+	optimiser and gate fusion off, so only the recording is exercised, and
+	once with both on. Outcomes must agree measurement for measurement and
+	the final states must match.
+
+	g++ -O2 -std=c++11 main.cpp -o deferred
+*/
+
+#include <iostream>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int NUM_QUBITS = 10;
+const int NUM_CIRCUITS = 20;
+const int NUM_GATES = 400;
+
+vector<unsigned int> randomCircuit(Qubits<double> &qubits, int seed)
+{
+	// Returns the outcomes of the measurements, in order.
+	QuantumGates<double> gate;
+	mt19937 generator(seed);
+	uniform_real_distribution<double> angle(0, 2 * M_PI);
+	vector<unsigned int> outcomes;
+
+	for(int g=0; g<NUM_GATES; g++)
+	{
+		int a = generator() % NUM_QUBITS;
+		int b = (a + 1 + generator() % (NUM_QUBITS - 1)) % NUM_QUBITS;
+		int c = (b + 1 + generator() % (NUM_QUBITS - 1)) % NUM_QUBITS;
+		double x = angle(generator), y = angle(generator), z = angle(generator);
+
+		switch(generator() % 16)
+		{
+			case 0: qubits.H(a); break;
+			case 1: qubits.X(a); break;
+			case 2: qubits.Y(a); break;
+			case 3: qubits.Z(a); break;
+			case 4: qubits.T(a); break;
+			case 5: qubits.S(a); break;
+			case 6: qubits.U(gate.Rotation(x, y, z), a); break;
+			case 7: qubits.CNOT(a, b); break;
+			case 8: qubits.CY(a, b); break;
+			case 9: qubits.CZ(a, b); break;
+			case 10:
+				if(c != a)
+					qubits.Toffoli(a, c, b);
+				break;
+			case 11:
+			{
+				vector<int> controls(1, a), openControls;
+
+				if(c != a)
+					openControls.push_back(c);
+
+				qubits.MCU(controls, openControls, b, gate.Rotation(x, y, z));
+				break;
+			}
+			case 12: qubits.Swap(a, b); break;
+			case 13:
+				if(generator() % 8 == 0)
+					outcomes.push_back(qubits.Measure(a));
+				break;
+			default: qubits.H(a); qubits.CNOT(a, b); break;
+		}
+	}
+
+	outcomes.push_back(qubits.Measure(0));
+	outcomes.push_back(qubits.Measure(NUM_QUBITS - 1));
+
+	return outcomes;
+}
+
+double difference(Qubits<double> &a, Qubits<double> &b)
+{
+	double worst = 0;
+
+	for(uint64_t i=0; i<a.length(); i++)
+	{
+		Complex<double> d = a.amplitude(i) - b.amplitude(i);
+		worst = max(worst, sqrt(d.normSq()));
+	}
+
+	return worst;
+}
+
+int main()
+{
+	const char *names[] = {"recording only", "optimised and fused"};
+
+	for(int mode=0; mode<2; mode++)
+	{
+		double worst = 0;
+		int mismatches = 0, measured = 0;
+
+		for(int c=0; c<NUM_CIRCUITS; c++)
+		{
+			Qubits<double> immediate(NUM_QUBITS), deferred(NUM_QUBITS);
+			immediate.enableGraphics = false;
+			deferred.enableGraphics = false;
+			immediate.setRandomSeed(c);
+			deferred.setRandomSeed(c);
+
+			deferred.setDeferred(true);
+			deferred.setOptimise(mode == 1);
+			deferred.setMaxFusedWidth((mode == 1)? 3 : 0);
+
+			vector<unsigned int> a = randomCircuit(immediate, c);
+			vector<unsigned int> b = randomCircuit(deferred, c);
+
+			measured += a.size();
+
+			for(int m=0; m<a.size(); m++)
+				mismatches += (m >= b.size() || a.at(m) != b.at(m));
+
+			worst = max(worst, difference(immediate, deferred));
+		}
+
+		printf("Deferred, %-19s: %d of %d outcomes differ, max difference %g\n", names[mode], mismatches, measured, worst);
+	}
+
+	return 0;
+}
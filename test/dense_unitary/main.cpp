@@ -0,0 +1,160 @@
+/*
+	Testing U(matrix, qubits) on k qubits. A random sequence of one- and
+	two-qubit gates on k qubits is turned into its 2^k x 2^k matrix, then
+	applied both gate by gate and as one matrix to a random 10-qubit state,
+	on qubits listed out of order. Both must give the same state, run
+	immediately and deferred. A matrix of the wrong size must be rejected,
+	checked by running this program again with "reject".
+
+	g++ -O2 -std=c++11 main.cpp -o dense_unitary
+*/
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int NUM_QUBITS = 10;
+const int NUM_GATES = 30;
+
+void compose(Qubits<double> &qubits, vector<int> targets, int seed)
+{
+	// The same gates for the same seed, with qubit j of the sequence
+	// placed on targets[j].
+	mt19937 generator(seed);
+	int k = targets.size();
+
+	for(int g=0; g<NUM_GATES; g++)
+	{
+		int a = generator() % k;
+		int b = (a + 1 + generator() % (k - 1)) % k;
+
+		switch(generator() % 6)
+		{
+			case 0: qubits.H(targets.at(a)); break;
+			case 1: qubits.T(targets.at(a)); break;
+			case 2: qubits.Y(targets.at(a)); break;
+			case 3: qubits.CNOT(targets.at(a), targets.at(b)); break;
+			case 4: qubits.CY(targets.at(b), targets.at(a)); break;
+			default: qubits.Swap(targets.at(a), targets.at(b)); break;
+		}
+	}
+}
+
+Matrix<double> matrixOf(int k, int seed)
+{
+	// Column j is the sequence applied to |j⟩.
+	Matrix<double> u(1 << k, 1 << k);
+	vector<int> targets;
+
+	for(int j=0; j<k; j++)
+		targets.push_back(j);
+
+	for(int column=0; column<(1 << k); column++)
+	{
+		Qubits<double> basis(k);
+		basis.enableGraphics = false;
+
+		for(int j=0; j<k; j++)
+		{
+			if((column >> j) & 1)
+				basis.X(j);
+		}
+
+		compose(basis, targets, seed);
+
+		for(int row=0; row<(1 << k); row++)
+		{
+			Complex<double> x = basis.amplitude(row);
+			u.set(row, column, x.getRe(), x.getIm());
+		}
+	}
+
+	return u;
+}
+
+void randomState(Qubits<double> &qubits)
+{
+	mt19937 generator(99);
+
+	for(int q=0; q<NUM_QUBITS; q++)
+		qubits.H(q);
+
+	for(int g=0; g<60; g++)
+	{
+		int a = generator() % NUM_QUBITS;
+		int b = (a + 1 + generator() % (NUM_QUBITS - 1)) % NUM_QUBITS;
+
+		if(generator() % 2)
+			qubits.T(a);
+		else
+			qubits.CNOT(a, b);
+	}
+}
+
+double difference(Qubits<double> &a, Qubits<double> &b)
+{
+	double worst = 0;
+
+	for(uint64_t i=0; i<a.length(); i++)
+	{
+		Complex<double> d = a.amplitude(i) - b.amplitude(i);
+		worst = max(worst, sqrt(d.normSq()));
+	}
+
+	return worst;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc > 1 && strcmp(argv[1], "reject") == 0)
+	{
+		// a 4 x 4 matrix on three qubits
+		Qubits<double> qubits(3);
+		vector<int> targets;
+		targets.push_back(2);
+		targets.push_back(0);
+		targets.push_back(1);
+
+		qubits.U(Matrix<double>(4, 4), targets);
+
+		return 0;
+	}
+
+	// out of order, with gaps, and reversed
+	const int layouts[4][5] = {{3, 1}, {8, 2, 5}, {9, 0, 4, 6}, {7, 6, 3, 2, 0}};
+
+	for(int k=2; k<=5; k++)
+	{
+		vector<int> targets(layouts[k - 2], layouts[k - 2] + k);
+		Matrix<double> u = matrixOf(k, k);
+
+		for(int deferred=0; deferred<2; deferred++)
+		{
+			Qubits<double> gates(NUM_QUBITS), dense(NUM_QUBITS);
+			gates.enableGraphics = false;
+			dense.enableGraphics = false;
+			dense.setDeferred(deferred);
+
+			randomState(gates);
+			randomState(dense);
+
+			compose(gates, targets, k);
+			dense.U(u, targets);
+
+			printf("%d qubits on {", k);
+
+			for(int j=0; j<k; j++)
+				printf((j)? ", %d" : "%d", targets.at(j));
+
+			printf("}%s: max difference %g\n", (deferred)? ", deferred" : "", difference(gates, dense));
+		}
+	}
+
+	string command = string(argv[0]) + " reject > /dev/null";
+	int status = system(command.c_str());
+
+	printf("Wrongly sized matrix %s\n", (status != 0)? "rejected" : "accepted (wrong)");
+
+	return 0;
+}
@@ -0,0 +1,78 @@
+/*
+	Testing the density matrix backend. A noiseless circuit must match the
+	outer product of the Qubits state, and each noise channel is checked
+	against its closed form on a Bell pair.
+
+	g++ -O2 -std=c++11 main.cpp -o density_matrix
+*/
+
+#include <iostream>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int NUM_QUBITS = 4;
+
+template<class Simulator>
+void circuit(Simulator &qubits)
+{
+	Matrix<double> u(2, 2);
+	u.set(0, 0, 0.6, 0);
+	u.set(0, 1, 0, 0.8);
+	u.set(1, 0, 0, 0.8);
+	u.set(1, 1, 0.6, 0);
+
+	qubits.H(0);
+	qubits.CNOT(0, 1);
+	qubits.T(1);
+	qubits.U(u, 2);
+	qubits.Toffoli(0, 2, 3);
+	qubits.CY(3, 1);
+	qubits.Swap(0, 2);
+	qubits.S(3);
+}
+
+int main()
+{
+	DensityMatrix<double> rho(NUM_QUBITS);
+	Qubits<double> reference(NUM_QUBITS);
+	reference.enableGraphics = false;
+
+	circuit(rho);
+	circuit(reference);
+
+	double worst = 0;
+
+	for(uint64_t r=0; r<reference.length(); r++)
+	{
+		for(uint64_t c=0; c<reference.length(); c++)
+		{
+			Complex<double> a = reference.amplitude(r), b = reference.amplitude(c);
+			Complex<double> difference = rho.element(r, c) - a * Complex<double>(b.getRe(), -b.getIm());
+			worst = max(worst, sqrt(difference.normSq()));
+		}
+	}
+
+	printf("Noiseless circuit: max difference %g, purity %.6f\n", worst, rho.purity());
+
+	// Bell pair (|00⟩ + |11⟩) / sqrt(2), then one channel on qubit 0
+	DensityMatrix<double> depolarised(2), damped(2), dephased(2);
+	DensityMatrix<double> *pairs[3] = {&depolarised, &damped, &dephased};
+
+	for(int i=0; i<3; i++)
+	{
+		pairs[i]->H(0);
+		pairs[i]->CNOT(0, 1);
+	}
+
+	depolarised.Depolarise(0, 0.3);
+	damped.AmplitudeDamping(0, 0.3);
+	dephased.PhaseDamping(0, 0.36);
+
+	printf("Depolarise 0.3       : P(|01⟩) = %.4f (expected 0.1000), ⟨00|ρ|11⟩ = %.4f (expected 0.3000)\n",
+		depolarised.probability(1), depolarised.element(0, 3).getRe());
+	printf("Amplitude damping 0.3: P(|10⟩) = %.4f (expected 0.1500), ⟨00|ρ|11⟩ = %.4f (expected 0.4183)\n",
+		damped.probability(2), damped.element(0, 3).getRe());
+	printf("Phase damping 0.36   : P(|11⟩) = %.4f (expected 0.5000), ⟨00|ρ|11⟩ = %.4f (expected 0.4000)\n",
+		dephased.probability(3), dephased.element(0, 3).getRe());
+
+	return 0;
+}
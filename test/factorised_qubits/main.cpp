@@ -0,0 +1,103 @@
+/*
+	Testing the factorised state. A random 10-qubit circuit is compared
+	against Qubits. The CNOT chain of the entanglement test is then run on
+	20 qubits: the registers merge one by one into a single 2^20 vector,
+	and measuring the first qubit splits the GHZ state back into 20
+	single-qubit registers. Finally 60 qubits form 30 Bell pairs, which
+	never need more than four amplitudes each.
+
+	g++ -O2 -std=c++11 main.cpp -o factorised_qubits
+*/
+
+#include <iostream>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int SMALL_QUBITS = 10;
+const int NUM_GATES = 200;
+const int CHAIN_QUBITS = 20;
+const int PAIR_QUBITS = 60;
+
+int main()
+{
+	FactorisedQubits<double> small(SMALL_QUBITS);
+	Qubits<double> reference(SMALL_QUBITS);
+	reference.enableGraphics = false;
+
+	mt19937 generator(1234);
+	QuantumGates<double> gate;
+
+	for(int g=0; g<NUM_GATES; g++)
+	{
+		int a = generator() % SMALL_QUBITS;
+		int b = (a + 1 + generator() % (SMALL_QUBITS - 1)) % SMALL_QUBITS;
+		int c = (b + 1 + generator() % (SMALL_QUBITS - 1)) % SMALL_QUBITS;
+
+		while(c == a || c == b)
+			c = (c + 1) % SMALL_QUBITS;
+
+		vector<int> controls(1, a);
+
+		switch(generator() % 8)
+		{
+			case 0: small.H(a); reference.H(a); break;
+			case 1: small.T(a); reference.T(a); break;
+			case 2: small.CZ(a, b); reference.CZ(a, b); break;
+			case 3: small.Swap(a, b); reference.Swap(a, b); break;
+			case 4: small.Toffoli(a, b, c); reference.Toffoli(a, b, c); break;
+			case 5: small.MCU(controls, b, gate.Hadamard()); reference.MCU(controls, b, gate.Hadamard()); break;
+			case 6: small.Y(a); reference.Y(a); break;
+			default: small.CNOT(a, b); reference.CNOT(a, b); break;
+		}
+	}
+
+	double worst = 0;
+
+	for(uint64_t i=0; i<reference.length(); i++)
+	{
+		Complex<double> difference = small.amplitude(i) - reference.amplitude(i);
+		worst = max(worst, sqrt(difference.normSq()));
+	}
+
+	printf("Random circuit: max difference %g\n\n", worst);
+
+	FactorisedQubits<double> chain(CHAIN_QUBITS);
+	chain.setRandomSeed(7);
+	chain.H(0);
+
+	for(int q=1; q<CHAIN_QUBITS; q++)
+		chain.CNOT(q - 1, q);
+
+	chain.print();
+
+	unsigned int first = chain.Measure(0);
+	int disagree = 0;
+
+	for(int q=1; q<CHAIN_QUBITS; q++)
+		disagree += chain.Measure(q) != first;
+
+	printf("After measuring: %d registers, largest %d, %llu bytes (peak %llu), %d disagreeing qubits\n\n",
+		chain.numRegisters(), chain.largestRegister(), (unsigned long long)chain.bytes(),
+		(unsigned long long)chain.peakBytes(), disagree);
+
+	FactorisedQubits<double> pairs(PAIR_QUBITS);
+	pairs.setRandomSeed(11);
+
+	for(int q=0; q<PAIR_QUBITS; q+=2)
+	{
+		pairs.H(q);
+		pairs.CNOT(q, q + 1);
+	}
+
+	printf("Bell pairs: %d registers, largest %d, %llu bytes\n",
+		pairs.numRegisters(), pairs.largestRegister(), (unsigned long long)pairs.bytes());
+
+	uint64_t outcome = pairs.MeasureAll();
+	int broken = 0;
+
+	for(int q=0; q<PAIR_QUBITS; q+=2)
+		broken += ((outcome >> q) & 1) != ((outcome >> (q + 1)) & 1);
+
+	printf("Measured %016llx, %d pairs disagreeing, %d registers\n", (unsigned long long)outcome, broken, pairs.numRegisters());
+
+	return 0;
+}
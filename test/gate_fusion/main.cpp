@@ -0,0 +1,115 @@
+/*
+	Testing gate fusion. Random deferred circuits mixing single-qubit
+	gates, controlled gates, Toffoli, swaps and MCU with closed and open
+	controls are run with fusion off and with fused gates of 2 to 5 qubits,
+	the optimiser off so that only fusion changes. Every width must give
+	the state fusion off gives.
+
+	g++ -O2 -std=c++11 main.cpp -o gate_fusion
+*/
+
+#include <iostream>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int NUM_QUBITS = 10;
+const int NUM_CIRCUITS = 20;
+const int NUM_GATES = 400;
+
+void randomCircuit(Qubits<double> &qubits, int seed)
+{
+	// Gates stay on a window of nearby qubits for a while, so runs of them
+	// fit in a fused block.
+	QuantumGates<double> gate;
+	mt19937 generator(seed);
+	uniform_real_distribution<double> angle(0, 2 * M_PI);
+	int base = 0;
+
+	for(int g=0; g<NUM_GATES; g++)
+	{
+		if(g % 25 == 0)
+			base = generator() % NUM_QUBITS;
+
+		int a = (base + generator() % 4) % NUM_QUBITS;
+		int b = (a + 1 + generator() % 3) % NUM_QUBITS;
+		int c = (b + 1 + generator() % 3) % NUM_QUBITS;
+		double x = angle(generator), y = angle(generator), z = angle(generator);
+
+		switch(generator() % 12)
+		{
+			case 0: qubits.H(a); break;
+			case 1: qubits.T(a); break;
+			case 2: qubits.Y(a); break;
+			case 3: qubits.U(gate.Rotation(x, y, z), a); break;
+			case 4: qubits.CNOT(a, b); break;
+			case 5: qubits.CY(b, a); break;
+			case 6: qubits.CZ(a, b); break;
+			case 7:
+				if(c != a)
+					qubits.Toffoli(a, c, b);
+				break;
+			case 8: qubits.Swap(a, b); break;
+			case 9:
+			{
+				// open controls only
+				vector<int> openControls(1, a);
+				qubits.MCU(vector<int>(), openControls, b, gate.Rotation(x, y, z));
+				break;
+			}
+			default:
+			{
+				vector<int> controls(1, a), openControls;
+
+				if(c != a)
+					openControls.push_back(c);
+
+				qubits.MCU(controls, openControls, b, gate.Rotation(x, y, z));
+				break;
+			}
+		}
+	}
+}
+
+double difference(Qubits<double> &a, Qubits<double> &b)
+{
+	double worst = 0;
+
+	for(uint64_t i=0; i<a.length(); i++)
+	{
+		Complex<double> d = a.amplitude(i) - b.amplitude(i);
+		worst = max(worst, sqrt(d.normSq()));
+	}
+
+	return worst;
+}
+
+int main()
+{
+	for(int width=2; width<=5; width++)
+	{
+		double worst = 0;
+
+		for(int c=0; c<NUM_CIRCUITS; c++)
+		{
+			Qubits<double> unfused(NUM_QUBITS), fused(NUM_QUBITS);
+			unfused.enableGraphics = false;
+			fused.enableGraphics = false;
+
+			unfused.setDeferred(true);
+			fused.setDeferred(true);
+			unfused.setOptimise(false);
+			fused.setOptimise(false);
+
+			unfused.setMaxFusedWidth(0);
+			fused.setMaxFusedWidth(width);
+
+			randomCircuit(unfused, c);
+			randomCircuit(fused, c);
+
+			worst = max(worst, difference(unfused, fused));
+		}
+
+		printf("Fused gates up to %d qubits: max difference %g over %d circuits\n", width, worst, NUM_CIRCUITS);
+	}
+
+	return 0;
+}
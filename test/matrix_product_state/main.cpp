@@ -0,0 +1,105 @@
+/*
+	Testing the matrix product state backend. A 100-qubit GHZ state needs
+	bond dimension 2 and samples only all zeros or all ones. A brickwork
+	circuit on 16 qubits is then run exactly and with a small maximum bond
+	dimension, and both are compared to Qubits: the exact run must match,
+	and the truncated run's fidelity estimate should track its overlap.
+
+	g++ -O2 -std=c++11 main.cpp -o matrix_product_state
+*/
+
+#include <iostream>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int GHZ_QUBITS = 100;
+const int NUM_QUBITS = 16;
+const int NUM_LAYERS = 8;
+
+template<class Simulator>
+void brickwork(Simulator &qubits)
+{
+	mt19937 generator(99);
+	uniform_real_distribution<double> angle(0, 2 * M_PI);
+
+	for(int layer=0; layer<NUM_LAYERS; layer++)
+	{
+		for(int q=0; q<NUM_QUBITS; q++)
+		{
+			double theta = angle(generator), phi = angle(generator);
+			Matrix<double> u(2, 2);
+			u.set(0, 0, cos(theta / 2), 0);
+			u.set(0, 1, -sin(theta / 2) * cos(phi), -sin(theta / 2) * sin(phi));
+			u.set(1, 0, sin(theta / 2) * cos(phi), -sin(theta / 2) * sin(phi));
+			u.set(1, 1, cos(theta / 2), 0);
+			qubits.U(u, q);
+		}
+
+		for(int q=layer%2; q<NUM_QUBITS-1; q+=2)
+			qubits.CNOT(q, q + 1);
+
+		qubits.T(layer);
+	}
+
+	// one long-range gate, routed through swaps
+	qubits.CZ(0, NUM_QUBITS - 1);
+}
+
+template<class Simulator>
+double overlap(Simulator &mps, Qubits<double> &reference)
+{
+	Complex<double> sum(0, 0);
+
+	for(uint64_t i=0; i<reference.length(); i++)
+	{
+		Complex<double> a = reference.amplitude(i);
+		sum += Complex<double>(a.getRe(), -a.getIm()) * mps.amplitude(i);
+	}
+
+	return sum.normSq();
+}
+
+int main()
+{
+	MatrixProductState<double> ghz(GHZ_QUBITS);
+	ghz.setRandomSeed(1);
+	ghz.H(0);
+
+	for(int q=0; q<GHZ_QUBITS-1; q++)
+		ghz.CNOT(q, q + 1);
+
+	map<string, unsigned int> counts = ghz.Sample(1000);
+
+	printf("GHZ over %d qubits: bond dimension %d, %llu bytes, %zu distinct outcomes, amplitude %.6f\n",
+		GHZ_QUBITS, ghz.bondDimension(), (unsigned long long)ghz.bytes(), counts.size(),
+		ghz.amplitude(string(GHZ_QUBITS, '1')).getRe());
+
+	Qubits<double> reference(NUM_QUBITS);
+	reference.enableGraphics = false;
+	brickwork(reference);
+
+	MatrixProductState<double> exact(NUM_QUBITS);
+	exact.setMaxBond(256);
+	brickwork(exact);
+
+	double worst = 0;
+
+	for(uint64_t i=0; i<reference.length(); i++)
+	{
+		Complex<double> difference = exact.amplitude(i) - reference.amplitude(i);
+		worst = max(worst, sqrt(difference.normSq()));
+	}
+
+	printf("Exact brickwork: bond dimension %d, max difference %g\n", exact.bondDimension(), worst);
+
+	for(int bond=4; bond<=16; bond*=2)
+	{
+		MatrixProductState<double> truncated(NUM_QUBITS);
+		truncated.setMaxBond(bond);
+		brickwork(truncated);
+
+		printf("Max bond %2d: truncation error %.4f, estimated fidelity %.4f, actual %.4f\n", bond,
+			truncated.truncationError(), truncated.fidelity(), overlap(truncated, reference));
+	}
+
+	return 0;
+}
@@ -0,0 +1,156 @@
+/*
+	Testing measurement. A qubit rotated so that it reads 1 with a known
+	probability is measured many times from a fixed seed, and the
+	frequency must match; two registers with the same seed must agree
+	outcome for outcome. A float qubit in |0⟩ is then measured millions of
+	times, past the draws that used to round up to 1, and must always
+	read 0 with its amplitude intact.
+
+	MeasureAll and Sample are checked against the probabilities of a
+	small random state, and a float state whose upper amplitudes are all
+	zero is sampled to make sure no shot lands on them.
+
+	g++ -O2 -std=c++11 main.cpp -o measurement
+*/
+
+#include <iostream>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int NUM_SHOTS = 100000;
+const int FLOAT_SHOTS = 2000000;
+const double PROB_OF_ONE = 0.3;
+const int SAMPLE_QUBITS = 4;
+const int SAMPLE_SHOTS = 1000000;
+const int TRAILING_QUBITS = 3;
+
+Matrix<double> rotation(double probOfOne)
+{
+	// Ry taking |0⟩ to sqrt(1 - p)|0⟩ + sqrt(p)|1⟩
+	double c = sqrt(1 - probOfOne), s = sqrt(probOfOne);
+	Matrix<double> u(2, 2);
+
+	u.set(0, 0, c, 0);
+	u.set(0, 1, -s, 0);
+	u.set(1, 0, s, 0);
+	u.set(1, 1, c, 0);
+
+	return u;
+}
+
+int main()
+{
+	Qubits<double> first(1), second(1);
+	first.enableGraphics = false;
+	second.enableGraphics = false;
+	first.setRandomSeed(42);
+	second.setRandomSeed(42);
+
+	int ones = 0, mismatches = 0;
+
+	for(int s=0; s<NUM_SHOTS; s++)
+	{
+		first.U(rotation(PROB_OF_ONE), 0);
+		second.U(rotation(PROB_OF_ONE), 0);
+
+		unsigned int a = first.Measure(0), b = second.Measure(0);
+		ones += a;
+		mismatches += (a != b);
+
+		// back to |0⟩ for the next shot
+		if(a)
+			first.X(0);
+		if(b)
+			second.X(0);
+	}
+
+	double frequency = (double)ones / NUM_SHOTS;
+	double sigma = sqrt(PROB_OF_ONE * (1 - PROB_OF_ONE) / NUM_SHOTS);
+
+	printf("Measure: %d shots, frequency of 1 %.4f (expected %.4f, %.1f sigma), %d mismatches between seeded runs\n",
+		NUM_SHOTS, frequency, PROB_OF_ONE, fabs(frequency - PROB_OF_ONE) / sigma, mismatches);
+
+	Qubits<float> zero(2);
+	zero.enableGraphics = false;
+	zero.setRandomSeed(1);
+
+	int wrong = 0;
+
+	for(int s=0; s<FLOAT_SHOTS; s++)
+		wrong += zero.Measure(0);
+
+	Complex<float> amplitude = zero.amplitude(0);
+
+	printf("Float |0⟩: %d shots, %d read 1, amplitude %g%s\n", FLOAT_SHOTS, wrong,
+		amplitude.getRe(), (amplitude.getRe() == 1)? "" : " (wrong)");
+
+	// a random state, and the largest deviation of each estimate from it
+	// in standard deviations
+	Qubits<double> state(SAMPLE_QUBITS);
+	state.enableGraphics = false;
+	state.setRandomSeed(7);
+
+	mt19937 generator(1234);
+
+	for(int g=0; g<40; g++)
+	{
+		int a = generator() % SAMPLE_QUBITS;
+		int b = (a + 1 + generator() % (SAMPLE_QUBITS - 1)) % SAMPLE_QUBITS;
+
+		switch(generator() % 3)
+		{
+			case 0: state.H(a); break;
+			case 1: state.T(a); break;
+			default: state.CNOT(a, b); break;
+		}
+	}
+
+	map<uint64_t, unsigned int> counts = state.Sample(SAMPLE_SHOTS);
+	vector<unsigned int> collapsed(state.length(), 0);
+
+	Qubits<double> copy(SAMPLE_QUBITS);
+	copy.enableGraphics = false;
+	copy.setRandomSeed(9);
+
+	for(int s=0; s<NUM_SHOTS; s++)
+	{
+		for(uint64_t i=0; i<state.length(); i++)
+			copy.states->data()[i] = state.amplitude(i);
+
+		collapsed.at(copy.MeasureAll())++;
+	}
+
+	double worstSample = 0, worstMeasure = 0;
+
+	for(uint64_t i=0; i<state.length(); i++)
+	{
+		double p = state.amplitude(i).normSq();
+
+		if(p <= 0)
+			continue;
+
+		worstSample = max(worstSample, fabs((double)counts[i] / SAMPLE_SHOTS - p) / sqrt(p * (1 - p) / SAMPLE_SHOTS));
+		worstMeasure = max(worstMeasure, fabs((double)collapsed.at(i) / NUM_SHOTS - p) / sqrt(p * (1 - p) / NUM_SHOTS));
+	}
+
+	printf("Sample: %d shots, worst deviation %.1f sigma\n", SAMPLE_SHOTS, worstSample);
+	printf("MeasureAll: %d shots, worst deviation %.1f sigma\n", NUM_SHOTS, worstMeasure);
+
+	// only the lowest two basis states carry any probability
+	Qubits<float> trailing(TRAILING_QUBITS);
+	trailing.enableGraphics = false;
+	trailing.setRandomSeed(3);
+	trailing.H(0);
+
+	map<uint64_t, unsigned int> shots = trailing.Sample(SAMPLE_SHOTS);
+	unsigned int outside = 0;
+
+	for(map<uint64_t, unsigned int>::iterator it=shots.begin(); it!=shots.end(); ++it)
+	{
+		if(it->first > 1)
+			outside += it->second;
+	}
+
+	printf("Float trailing zeros: %d shots, %u on zero-probability states\n", SAMPLE_SHOTS, outside);
+
+	return 0;
+}
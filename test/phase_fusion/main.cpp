@@ -0,0 +1,112 @@
+/*
+	Testing fused diagonal gates. Random circuits made mostly of Z, S, T,
+	CZ, diagonal U and diagonal MCU with open controls, broken up by the odd
+	Hadamard, are run with phase fusion off and with phase tables of
+	several widths. Reading amplitudes and measuring part way through must
+	flush the pending phases, so every run must end in the same state.
+
+	g++ -O2 -std=c++11 main.cpp -o phase_fusion
+*/
+
+#include <iostream>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int NUM_QUBITS = 10;
+const int NUM_CIRCUITS = 20;
+const int NUM_GATES = 300;
+
+Matrix<double> diagonal(double a, double b)
+{
+	Matrix<double> u(2, 2);
+
+	u.set(0, 0, cos(a), sin(a));
+	u.set(1, 1, cos(b), sin(b));
+
+	return u;
+}
+
+void randomCircuit(Qubits<double> &qubits, int seed)
+{
+	mt19937 generator(seed);
+	uniform_real_distribution<double> angle(0, 2 * M_PI);
+
+	for(int g=0; g<NUM_GATES; g++)
+	{
+		int a = generator() % NUM_QUBITS;
+		int b = (a + 1 + generator() % (NUM_QUBITS - 1)) % NUM_QUBITS;
+		int c = (b + 1 + generator() % (NUM_QUBITS - 1)) % NUM_QUBITS;
+		double x = angle(generator), y = angle(generator);
+
+		switch(generator() % 10)
+		{
+			case 0: qubits.H(a); break;
+			case 1: qubits.Z(a); break;
+			case 2: qubits.S(a); break;
+			case 3: qubits.T(a); break;
+			case 4: qubits.CZ(a, b); break;
+			case 5: qubits.U(diagonal(x, y), a); break;
+			case 6:
+			{
+				vector<int> controls(1, a), openControls;
+
+				if(c != a)
+					openControls.push_back(c);
+
+				qubits.MCU(controls, openControls, b, diagonal(x, y));
+				break;
+			}
+			case 7:
+				// a read in the middle of a run of phases
+				qubits.amplitude(generator() % qubits.length());
+				break;
+			default: qubits.T(a); qubits.CZ(b, a); break;
+		}
+
+		if(g == NUM_GATES / 2)
+			qubits.Measure(a);
+	}
+}
+
+double difference(Qubits<double> &a, Qubits<double> &b)
+{
+	double worst = 0;
+
+	for(uint64_t i=0; i<a.length(); i++)
+	{
+		Complex<double> d = a.amplitude(i) - b.amplitude(i);
+		worst = max(worst, sqrt(d.normSq()));
+	}
+
+	return worst;
+}
+
+int main()
+{
+	const int widths[] = {1, 2, 4, 10};
+
+	for(int w=0; w<4; w++)
+	{
+		double worst = 0;
+
+		for(int c=0; c<NUM_CIRCUITS; c++)
+		{
+			Qubits<double> unfused(NUM_QUBITS), fused(NUM_QUBITS);
+			unfused.enableGraphics = false;
+			fused.enableGraphics = false;
+			unfused.setRandomSeed(c);
+			fused.setRandomSeed(c);
+
+			unfused.setMaxFusedPhases(0);
+			fused.setMaxFusedPhases(widths[w]);
+
+			randomCircuit(unfused, c);
+			randomCircuit(fused, c);
+
+			worst = max(worst, difference(unfused, fused));
+		}
+
+		printf("Phase tables up to %2d qubits: max difference %g over %d circuits\n", widths[w], worst, NUM_CIRCUITS);
+	}
+
+	return 0;
+}
@@ -0,0 +1,157 @@
+/*
+	Testing qubit mapping. Swap-heavy random circuits with a measurement
+	part way through are run with Swap moving amplitudes and with Swap only
+	relabelling qubits, immediately and deferred. Amplitudes read while the
+	qubits are still relabelled must agree. The text of print() and save(),
+	which put the qubits back in order first, must be identical; for that
+	the circuits start with a Hadamard on every qubit and then only permute
+	amplitudes and flip their phases by ±1 and ±i, so both runs hold
+	exactly the same values and no printed digit can round differently.
+	Only the sign of a zero may differ, so -0.000 is read as 0.000.
+
+	g++ -O2 -std=c++11 main.cpp -o qubit_mapping
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int NUM_QUBITS = 6;
+const int NUM_CIRCUITS = 10;
+const int NUM_GATES = 200;
+
+void swapHeavy(Qubits<double> &qubits, int seed, bool exact)
+{
+	mt19937 generator(seed);
+
+	if(exact)
+	{
+		for(int q=0; q<NUM_QUBITS; q++)
+			qubits.H(q);
+	}
+
+	for(int g=0; g<NUM_GATES; g++)
+	{
+		int a = generator() % NUM_QUBITS;
+		int b = (a + 1 + generator() % (NUM_QUBITS - 1)) % NUM_QUBITS;
+		int c = (b + 1 + generator() % (NUM_QUBITS - 1)) % NUM_QUBITS;
+
+		switch(generator() % 8)
+		{
+			case 0:
+				if(exact)
+					qubits.S(a);
+				else
+					qubits.H(a);
+				break;
+			case 1:
+				if(exact)
+					qubits.Z(a);
+				else
+					qubits.T(a);
+				break;
+			case 2: qubits.CNOT(a, b); break;
+			case 3:
+				if(c != a)
+					qubits.Toffoli(a, c, b);
+				break;
+			default: qubits.Swap(a, b); break;
+		}
+
+		if(g == NUM_GATES / 2)
+			qubits.Measure(a);
+	}
+}
+
+string readFile(string path)
+{
+	ifstream file(path.c_str());
+	stringstream text;
+	text << file.rdbuf();
+
+	string result = text.str();
+	size_t zero;
+
+	while((zero = result.find("-0.000 ")) != string::npos || (zero = result.find("-0.000i")) != string::npos)
+		result.at(zero) = ' ';
+
+	return result;
+}
+
+string printed(Qubits<double> &qubits, string path)
+{
+	// print() writes to stdout, so stdout is pointed at a file for it.
+	fflush(stdout);
+	int saved = dup(fileno(stdout));
+	FILE *file = fopen(path.c_str(), "w");
+
+	dup2(fileno(file), fileno(stdout));
+	qubits.print();
+	fflush(stdout);
+
+	dup2(saved, fileno(stdout));
+	close(saved);
+	fclose(file);
+
+	string text = readFile(path);
+	remove(path.c_str());
+
+	return text;
+}
+
+string saved(Qubits<double> &qubits, string path)
+{
+	qubits.save(path);
+
+	string text = readFile(path);
+	remove(path.c_str());
+
+	return text;
+}
+
+int main()
+{
+	for(int deferred=0; deferred<2; deferred++)
+	{
+		double worst = 0;
+		int printDiffers = 0, saveDiffers = 0;
+
+		for(int c=0; c<2*NUM_CIRCUITS; c++)
+		{
+			bool exact = (c >= NUM_CIRCUITS);
+
+			Qubits<double> moved(NUM_QUBITS), mapped(NUM_QUBITS);
+			moved.enableGraphics = false;
+			mapped.enableGraphics = false;
+			moved.setRandomSeed(c);
+			mapped.setRandomSeed(c);
+
+			mapped.setQubitMapping(true);
+			moved.setDeferred(deferred);
+			mapped.setDeferred(deferred);
+
+			swapHeavy(moved, c, exact);
+			swapHeavy(mapped, c, exact);
+
+			// amplitude() reads through the relabelling without undoing it
+			for(uint64_t i=0; i<moved.length(); i++)
+			{
+				Complex<double> d = moved.amplitude(i) - mapped.amplitude(i);
+				worst = max(worst, sqrt(d.normSq()));
+			}
+
+			if(!exact)
+				continue;
+
+			printDiffers += printed(moved, "print_moved.txt") != printed(mapped, "print_mapped.txt");
+			saveDiffers += saved(moved, "save_moved.txt") != saved(mapped, "save_mapped.txt");
+		}
+
+		printf("Qubit mapping%s: max difference %g over %d circuits, print differs in %d and save in %d of %d\n",
+			(deferred)? ", deferred" : "", worst, 2 * NUM_CIRCUITS, printDiffers, saveDiffers, NUM_CIRCUITS);
+	}
+
+	return 0;
+}
@@ -0,0 +1,134 @@
+/*
+	Testing the Schrödinger–Feynman hybrid. A 20-qubit circuit of random
+	gates within each half, with a handful of gates across the cut
+	(controlled gates, a swap and a general two-qubit gate), is compared
+	against Qubits on a sample of amplitudes. A 40-qubit GHZ state is then
+	built through a single crossing CNOT: two paths over 2^20 vectors.
+
+	g++ -O2 -std=c++11 -fopenmp main.cpp -o schrodinger_feynman
+*/
+
+#include <iostream>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int NUM_QUBITS = 20;
+const int HALF = NUM_QUBITS / 2;
+const int NUM_LAYERS = 6;
+const int NUM_CHECKS = 200;
+const int WIDE_QUBITS = 40;
+
+template<class Simulator>
+void localLayer(Simulator &simulator, mt19937 &generator)
+{
+	QuantumGates<double> gate;
+
+	for(int q=0; q<NUM_QUBITS; q++)
+	{
+		int side = (q < HALF)? 0 : HALF;
+		int other = side + (q - side + 1 + generator() % (HALF - 1)) % HALF;
+
+		switch(generator() % 5)
+		{
+			case 0: simulator.H(q); break;
+			case 1: simulator.T(q); break;
+			case 2: simulator.U(gate.PhaseShift(0.1 * q), q); break;
+			case 3: simulator.CNOT(q, other); break;
+			default: simulator.CZ(q, other); break;
+		}
+	}
+}
+
+template<class Simulator>
+void crossingLayer(Simulator &simulator, int layer)
+{
+	QuantumGates<double> gate;
+
+	switch(layer)
+	{
+		case 0: simulator.CNOT(HALF - 1, HALF); break;
+		case 1: simulator.CZ(HALF + 3, 2); break;
+		case 2: simulator.Swap(4, HALF + 4); break;
+		case 3: simulator.Toffoli(1, HALF + 1, 5); break;
+
+		case 4:
+		{
+			vector<int> controls(1, 0), openControls(1, HALF + 2);
+			simulator.MCU(controls, openControls, HALF + 6, gate.Hadamard());
+			break;
+		}
+
+		default:
+		{
+			// H on one qubit then a CNOT: entangling, neither a product nor controlled
+			Matrix<double> cnot = gate.CNOT();
+			Matrix<double> u = cnot * gate.Identity().tensor(gate.Hadamard());
+
+			vector<int> qubits;
+			qubits.push_back(3);
+			qubits.push_back(HALF + 5);
+			simulator.U(u, qubits);
+			break;
+		}
+	}
+}
+
+int main()
+{
+	SchrodingerFeynman<double> hybrid(NUM_QUBITS);
+	Qubits<double> reference(NUM_QUBITS);
+	reference.enableGraphics = false;
+
+	mt19937 generator1(1234), generator2(1234);
+
+	for(int q=0; q<NUM_QUBITS; q++)
+	{
+		hybrid.H(q);
+		reference.H(q);
+	}
+
+	for(int layer=0; layer<NUM_LAYERS; layer++)
+	{
+		localLayer(hybrid, generator1);
+		localLayer(reference, generator2);
+		crossingLayer(hybrid, layer);
+		crossingLayer(reference, layer);
+	}
+
+	hybrid.printPlan();
+
+	mt19937 generator(42);
+	vector<uint64_t> indices;
+
+	for(int i=0; i<NUM_CHECKS; i++)
+		indices.push_back(generator() % reference.length());
+
+	vector<Complex<double> > amplitudes = hybrid.amplitudes(indices);
+	double worst = 0;
+
+	for(int i=0; i<NUM_CHECKS; i++)
+	{
+		Complex<double> difference = amplitudes.at(i) - reference.amplitude(indices.at(i));
+		worst = max(worst, sqrt(difference.normSq()));
+	}
+
+	printf("Random circuit: max difference %g (amplitudes of order %g)\n\n", worst, sqrt(1.0 / reference.length()));
+
+	SchrodingerFeynman<double> wide(WIDE_QUBITS);
+	wide.H(0);
+
+	for(int q=1; q<WIDE_QUBITS; q++)
+		wide.CNOT(q - 1, q);
+
+	wide.printPlan();
+
+	vector<uint64_t> ghz;
+	ghz.push_back(0);
+	ghz.push_back((1ULL << WIDE_QUBITS) - 1);
+	ghz.push_back(1ULL << 25);
+
+	vector<Complex<double> > result = wide.amplitudes(ghz);
+	printf("GHZ amplitudes: %g, %g, %g (expected %g, %g, 0)\n",
+		result.at(0).getRe(), result.at(1).getRe(), sqrt(result.at(2).normSq()), M_SQRT1_2, M_SQRT1_2);
+
+	return 0;
+}
@@ -0,0 +1,95 @@
+/*
+	Testing the vectorised gate kernels against the scalar path. The same
+	random circuit of H, T, U, CNOT and Toffoli gates is run at every SIMD
+	level the CPU supports, in double and float, and each final state must
+	match the scalar one to within rounding.
+
+	g++ -O2 -std=c++11 main.cpp -o simd_kernels
+*/
+
+#include <iostream>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int NUM_QUBITS = 12;
+const int NUM_GATES = 400;
+
+template<class Type>
+void randomCircuit(Qubits<Type> &qubits)
+{
+	mt19937 generator(7);
+	uniform_real_distribution<double> angle(0, 2 * M_PI);
+
+	for(int g=0; g<NUM_GATES; g++)
+	{
+		int a = generator() % NUM_QUBITS;
+		int b = (a + 1 + generator() % (NUM_QUBITS - 1)) % NUM_QUBITS;
+		int c = (a + 1 + generator() % (NUM_QUBITS - 1)) % NUM_QUBITS;
+		double x = angle(generator), y = angle(generator);
+
+		Matrix<Type> u(2, 2);
+		u.set(0, 0, cos(x), 0);
+		u.set(0, 1, -sin(x) * cos(y), -sin(x) * sin(y));
+		u.set(1, 0, sin(x) * cos(y), -sin(x) * sin(y));
+		u.set(1, 1, cos(x), 0);
+
+		switch(generator() % 5)
+		{
+			case 0: qubits.H(a); break;
+			case 1: qubits.T(a); break;
+			case 2: qubits.U(u, a); break;
+			case 3: qubits.CNOT(a, b); break;
+			case 4:
+				if(c != b)
+					qubits.Toffoli(b, c, a);
+				else
+					qubits.CNOT(b, a);
+				break;
+		}
+	}
+}
+
+template<class Type>
+bool compare(string typeName, Type tolerance)
+{
+	bool passed = true;
+
+	Qubits<Type> scalar(NUM_QUBITS);
+	scalar.enableGraphics = false;
+	scalar.setSimdLevel(SimdKernels::SCALAR);
+	randomCircuit(scalar);
+
+	for(int level=SimdKernels::SSE2; level<=SimdKernels::detect(); level++)
+	{
+		Qubits<Type> simd(NUM_QUBITS);
+		simd.enableGraphics = false;
+		simd.setSimdLevel(level);
+		randomCircuit(simd);
+
+		double difference = 0;
+
+		for(uint64_t i=0; i<scalar.length(); i++)
+		{
+			Complex<Type> d = simd.amplitude(i) - scalar.amplitude(i);
+			difference = max(difference, sqrt((double)d.normSq()));
+		}
+
+		printf("%-6s %-8s max difference %g\n", typeName.c_str(), SimdKernels::name(level), difference);
+
+		if(difference > tolerance)
+			passed = false;
+	}
+
+	return passed;
+}
+
+int main()
+{
+	printf("Detected: %s\n\n", SimdKernels::name(SimdKernels::detect()));
+
+	bool passed = compare<double>("double", 1e-12);
+	passed = compare<float>("float", 1e-4f) && passed;
+
+	printf("\n%s\n", (passed)? "All levels agree with the scalar kernels" : "A level disagrees with the scalar kernels");
+
+	return (passed)? 0 : 1;
+}
@@ -0,0 +1,73 @@
+/*
+	Testing the sparse backend. A 60-qubit GHZ state followed by a chain of
+	Toffoli and X gates must keep two amplitudes in a few hundred bytes. A
+	small random circuit is then run on both the sparse backend and Qubits,
+	crossing into the dense representation part way through.
+
+	g++ -O2 -std=c++11 main.cpp -o sparse
+*/
+
+#include <iostream>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int GHZ_QUBITS = 60;
+const int SMALL_QUBITS = 8;
+const int NUM_GATES = 200;
+
+int main()
+{
+	SparseQubits<double> ghz(GHZ_QUBITS);
+
+	ghz.H(0);
+
+	for(int q=0; q<GHZ_QUBITS-1; q++)
+		ghz.CNOT(q, q + 1);
+
+	for(int q=0; q<GHZ_QUBITS-2; q++)
+	{
+		ghz.Toffoli(q, q + 1, q + 2);
+		ghz.X(q);
+	}
+
+	printf("GHZ over %d qubits: %llu amplitudes in %llu bytes\n", GHZ_QUBITS,
+		(unsigned long long)ghz.nonzeros(), (unsigned long long)ghz.bytes());
+
+	SparseQubits<double> sparse(SMALL_QUBITS);
+	Qubits<double> reference(SMALL_QUBITS);
+	reference.enableGraphics = false;
+
+	mt19937 generator(1234);
+	uint64_t sparseGates = 0;
+
+	for(int g=0; g<NUM_GATES; g++)
+	{
+		int a = generator() % SMALL_QUBITS;
+		int b = (a + 1 + generator() % (SMALL_QUBITS - 1)) % SMALL_QUBITS;
+
+		// mostly permutations, so the state stays sparse for a while
+		switch(generator() % 8)
+		{
+			case 0: sparse.H(a); reference.H(a); break;
+			case 1: sparse.T(a); reference.T(a); break;
+			case 2: sparse.CZ(a, b); reference.CZ(a, b); break;
+			case 3: sparse.Swap(a, b); reference.Swap(a, b); break;
+			case 4: sparse.X(a); reference.X(a); break;
+			default: sparse.CNOT(a, b); reference.CNOT(a, b); break;
+		}
+
+		sparseGates += sparse.isSparse();
+	}
+
+	double worst = 0;
+
+	for(uint64_t i=0; i<reference.length(); i++)
+	{
+		Complex<double> difference = sparse.amplitude(i) - reference.amplitude(i);
+		worst = max(worst, sqrt(difference.normSq()));
+	}
+
+	printf("Random circuit: %llu of %d gates sparse, max difference %g\n",
+		(unsigned long long)sparseGates, NUM_GATES, worst);
+
+	return 0;
+}
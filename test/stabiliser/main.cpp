@@ -0,0 +1,128 @@
+/*
+	Testing the stabiliser backend. A GHZ chain over 2000 qubits must
+	measure all zeros or all ones. A small Clifford circuit is then run on
+	both the tableau and a state vector, and after a T gate the tableau hands
+	over to a state vector; both must match the reference up to global phase.
+	Shots sampled from the tableau must follow the reference probabilities,
+	and an MCU with an open control must hand over like the other
+	non-Clifford gates.
+
+	g++ -O2 -std=c++11 main.cpp -o stabiliser
+*/
+
+#include <iostream>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int GHZ_QUBITS = 2000;
+const int SMALL_QUBITS = 4;
+const int NUM_SHOTS = 100000;
+
+template<class Simulator>
+void clifford(Simulator &qubits)
+{
+	qubits.H(0);
+	qubits.CNOT(0, 1);
+	qubits.S(1);
+	qubits.H(2);
+	qubits.CY(2, 3);
+	qubits.CZ(1, 2);
+	qubits.Swap(0, 3);
+	qubits.Y(1);
+}
+
+double distance(Stabiliser<double> &stabiliser, Qubits<double> &reference)
+{
+	// Largest difference between the amplitudes once the global phase of the
+	// first nonzero reference amplitude is divided out.
+	uint64_t first = 0;
+
+	while(reference.amplitude(first).normSq() < 1e-12)
+		++first;
+
+	Complex<double> a = stabiliser.amplitude(first), b = reference.amplitude(first);
+	Complex<double> phase = a * Complex<double>(b.getRe(), -b.getIm());
+	phase = phase * (1 / sqrt(phase.normSq()));
+
+	double worst = 0;
+
+	for(uint64_t i=0; i<reference.length(); i++)
+	{
+		Complex<double> difference = stabiliser.amplitude(i) - phase * reference.amplitude(i);
+		worst = max(worst, sqrt(difference.normSq()));
+	}
+
+	return worst;
+}
+
+int main()
+{
+	Stabiliser<double> ghz(GHZ_QUBITS);
+
+	ghz.H(0);
+
+	for(int q=0; q<GHZ_QUBITS-1; q++)
+		ghz.CNOT(q, q + 1);
+
+	ghz.MeasureAll();
+
+	int ones = 0;
+
+	for(int q=0; q<GHZ_QUBITS; q++)
+		ones += ghz.getMeasurement(q);
+
+	printf("GHZ over %d qubits measured %d ones\n", GHZ_QUBITS, ones);
+
+	Stabiliser<double> stabiliser(SMALL_QUBITS);
+	Qubits<double> reference(SMALL_QUBITS);
+	reference.enableGraphics = false;
+
+	clifford(stabiliser);
+	clifford(reference);
+
+	printf("Clifford circuit: max difference %g\n", distance(stabiliser, reference));
+
+	map<uint64_t, unsigned int> counts = stabiliser.Sample(NUM_SHOTS);
+	double worst = 0;
+	int outside = 0;
+
+	for(map<uint64_t, unsigned int>::iterator it=counts.begin(); it!=counts.end(); ++it)
+	{
+		if(reference.amplitude(it->first).normSq() < 1e-12)
+			outside += it->second;
+	}
+
+	for(uint64_t i=0; i<reference.length(); i++)
+	{
+		double p = reference.amplitude(i).normSq();
+
+		if(p > 1e-12)
+			worst = max(worst, fabs((double)counts[i] / NUM_SHOTS - p) / sqrt(p * (1 - p) / NUM_SHOTS));
+	}
+
+	printf("Sample: %d shots, %d on zero-probability states, worst deviation %.1f sigma\n", NUM_SHOTS, outside, worst);
+
+	stabiliser.T(2);
+	reference.T(2);
+	stabiliser.H(2);
+	reference.H(2);
+
+	printf("After T (%s): max difference %g\n", (stabiliser.isClifford())? "tableau" : "state vector",
+		distance(stabiliser, reference));
+
+	Stabiliser<double> controlled(SMALL_QUBITS, Stabiliser<double>::FALLBACK_NON_CLIFFORD);
+	Qubits<double> openReference(SMALL_QUBITS);
+	openReference.enableGraphics = false;
+
+	QuantumGates<double> gates;
+	vector<int> controls(1, 0), openControls(1, 1);
+
+	clifford(controlled);
+	clifford(openReference);
+	controlled.MCU(controls, openControls, 3, gates.Hadamard());
+	openReference.MCU(controls, openControls, 3, gates.Hadamard());
+
+	printf("Open-control MCU (%s): max difference %g\n", (controlled.isClifford())? "tableau" : "state vector",
+		distance(controlled, openReference));
+
+	return 0;
+}
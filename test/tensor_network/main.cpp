@@ -0,0 +1,110 @@
+/*
+	Testing the tensor network backend. A random 12-qubit circuit is
+	compared against Qubits on every amplitude, then again with the largest
+	intermediate capped so that indices get sliced. A random subset of the
+	amplitudes is checked, each being a full contraction. Finally single
+	amplitudes of a 56-qubit shallow circuit are computed, far beyond a
+	state vector: a GHZ preparation whose two nonzero amplitudes are
+	known.
+
+	g++ -O2 -std=c++11 -fopenmp main.cpp -o tensor_network
+*/
+
+#include <iostream>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int NUM_QUBITS = 12;
+const int NUM_GATES = 120;
+const int NUM_CHECKS = 100;
+const int SLICED_RANK = 9;
+const int WIDE_QUBITS = 56;
+
+template<class Network>
+void randomCircuit(Network &network, Qubits<double> &reference)
+{
+	mt19937 generator(1234);
+	QuantumGates<double> gate;
+
+	for(int g=0; g<NUM_GATES; g++)
+	{
+		int a = generator() % NUM_QUBITS;
+		int b = (a + 1 + generator() % (NUM_QUBITS - 1)) % NUM_QUBITS;
+		int c = (b + 1 + generator() % (NUM_QUBITS - 1)) % NUM_QUBITS;
+
+		while(c == a || c == b)
+			c = (c + 1) % NUM_QUBITS;
+
+		switch(generator() % 7)
+		{
+			case 0: network.H(a); reference.H(a); break;
+			case 1: network.T(a); reference.T(a); break;
+			case 2: network.CZ(a, b); reference.CZ(a, b); break;
+			case 3: network.Swap(a, b); reference.Swap(a, b); break;
+			case 4: network.Toffoli(a, b, c); reference.Toffoli(a, b, c); break;
+			case 5: network.U(gate.PhaseShift(0.3 * a), b); reference.U(gate.PhaseShift(0.3 * a), b); break;
+			default: network.CNOT(a, b); reference.CNOT(a, b); break;
+		}
+	}
+}
+
+double compare(TensorNetwork<double> &network, Qubits<double> &reference)
+{
+	mt19937 generator(42);
+	vector<uint64_t> indices;
+	vector<string> bitstrings;
+
+	for(int i=0; i<NUM_CHECKS; i++)
+	{
+		uint64_t index = generator() % reference.length();
+		string bits;
+
+		for(int q=NUM_QUBITS-1; q>=0; q--)
+			bits.push_back('0' + ((index >> q) & 1));
+
+		indices.push_back(index);
+		bitstrings.push_back(bits);
+	}
+
+	vector<Complex<double> > amplitudes = network.amplitudes(bitstrings);
+	double worst = 0;
+
+	for(int i=0; i<NUM_CHECKS; i++)
+	{
+		Complex<double> difference = amplitudes.at(i) - reference.amplitude(indices.at(i));
+		worst = max(worst, sqrt(difference.normSq()));
+	}
+
+	return worst;
+}
+
+int main()
+{
+	TensorNetwork<double> network(NUM_QUBITS);
+	Qubits<double> reference(NUM_QUBITS);
+	reference.enableGraphics = false;
+
+	randomCircuit(network, reference);
+
+	network.printPlan();
+	printf("Random circuit: max difference %g\n\n", compare(network, reference));
+
+	network.setMaxIntermediate(SLICED_RANK);
+	network.printPlan();
+	printf("Sliced into %d: max difference %g\n\n", network.numSlices(), compare(network, reference));
+
+	TensorNetwork<double> wide(WIDE_QUBITS);
+	wide.H(0);
+
+	for(int q=1; q<WIDE_QUBITS; q++)
+		wide.CNOT(q - 1, q);
+
+	wide.printPlan();
+
+	string zeros(WIDE_QUBITS, '0'), ones(WIDE_QUBITS, '1'), mixed = zeros;
+	mixed.at(7) = '1';
+
+	Complex<double> a = wide.amplitude(zeros), b = wide.amplitude(ones), c = wide.amplitude(mixed);
+	printf("GHZ amplitudes: %g, %g, %g (expected %g, %g, 0)\n", a.getRe(), b.getRe(), sqrt(c.normSq()), M_SQRT1_2, M_SQRT1_2);
+
+	return 0;
+}
@@ -0,0 +1,115 @@
+/*
+	Testing measured qubits traced out of the state vector. Two registers
+	with the same seed run a random 12-qubit circuit with mid-circuit
+	measurements and resets, one tracing measured qubits out. Gates after
+	a measurement bring the qubits back, so both must end with the same
+	outcomes and amplitudes, here also with a deferred, tiled run. A
+	measure-and-reuse loop then shows the vector halving per measurement.
+
+	g++ -O2 -std=c++11 main.cpp -o trace_out
+*/
+
+#include <iostream>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int NUM_QUBITS = 12;
+const int NUM_ROUNDS = 6;
+const int GATES_PER_ROUND = 40;
+const int REUSE_QUBITS = 20;
+
+void randomGates(Qubits<double> &qubits, mt19937 &generator)
+{
+	for(int g=0; g<GATES_PER_ROUND; g++)
+	{
+		int a = generator() % NUM_QUBITS;
+		int b = (a + 1 + generator() % (NUM_QUBITS - 1)) % NUM_QUBITS;
+
+		switch(generator() % 5)
+		{
+			case 0: qubits.H(a); break;
+			case 1: qubits.T(a); break;
+			case 2: qubits.CZ(a, b); break;
+			case 3: qubits.Swap(a, b); break;
+			default: qubits.CNOT(a, b); break;
+		}
+	}
+}
+
+double compare(Qubits<double> &traced, bool deferred)
+{
+	Qubits<double> reference(NUM_QUBITS);
+	reference.enableGraphics = false;
+	reference.setRandomSeed(99);
+
+	traced.enableGraphics = false;
+	traced.setRandomSeed(99);
+	traced.setTraceMeasured(true);
+
+	if(deferred)
+	{
+		traced.setDeferred(true);
+		traced.setTileQubits(4);
+	}
+
+	mt19937 generator1(5), generator2(5);
+	int mismatches = 0;
+	unsigned int smallest = NUM_QUBITS;
+
+	for(int round=0; round<NUM_ROUNDS; round++)
+	{
+		randomGates(reference, generator1);
+		randomGates(traced, generator2);
+
+		for(int q=round; q<round+4; q++)
+			mismatches += reference.Measure(q % NUM_QUBITS) != traced.Measure(q % NUM_QUBITS);
+
+		reference.Reset(round);
+		traced.Reset(round);
+
+		smallest = min(smallest, traced.activeQubits());
+	}
+
+	double worst = 0;
+
+	for(uint64_t i=0; i<reference.length(); i++)
+	{
+		Complex<double> difference = traced.amplitude(i) - reference.amplitude(i);
+		worst = max(worst, sqrt(difference.normSq()));
+	}
+
+	printf("%s: %d differing outcomes, max difference %g, down to %u active qubits\n",
+		(deferred)? "Deferred and tiled" : "Immediate", mismatches, worst, smallest);
+
+	return worst;
+}
+
+int main()
+{
+	Qubits<double> immediate(NUM_QUBITS), deferred(NUM_QUBITS);
+
+	compare(immediate, false);
+	compare(deferred, true);
+
+	// a data qubit is read out through an ancilla, which is then reused
+	Qubits<double> reuse(REUSE_QUBITS);
+	reuse.enableGraphics = false;
+	reuse.setTraceMeasured(true);
+
+	for(int q=0; q<REUSE_QUBITS; q++)
+		reuse.H(q);
+
+	for(int q=0; q<REUSE_QUBITS-1; q++)
+	{
+		reuse.CNOT(q, REUSE_QUBITS - 1);
+		unsigned int parity = reuse.Measure(REUSE_QUBITS - 1);
+		unsigned int data = reuse.Measure(q);
+
+		reuse.Reset(REUSE_QUBITS - 1);
+
+		if(q % 6 == 0)
+			printf("After %2d readouts: %2u active qubits, %8llu amplitudes (parity %u, data %u)\n",
+				q + 1, reuse.activeQubits(), (unsigned long long)reuse.length(), parity, data);
+	}
+
+	return 0;
+}
@@ -0,0 +1,70 @@
+/*
+	Testing the trajectory backend against the density matrix. A noisy GHZ
+	circuit is run as trajectories and exactly; the outcome probabilities
+	and ⟨Z0 Z1⟩ of the trajectories must lie within their confidence
+	intervals (a few misses among many outcomes are expected).
+
+	g++ -O2 -std=c++11 main.cpp -o trajectories
+*/
+
+#include <iostream>
+#include "../../Qmulator/Qmulator.hpp"
+
+const int NUM_QUBITS = 3;
+const int NUM_SHOTS = 20000;
+
+template<class Simulator>
+void circuit(Simulator &qubits)
+{
+	qubits.H(0);
+	qubits.Depolarise(0, 0.05);
+
+	for(int q=0; q<NUM_QUBITS-1; q++)
+	{
+		qubits.CNOT(q, q + 1);
+		qubits.Depolarise(q + 1, 0.05);
+		qubits.PhaseDamping(q, 0.1);
+	}
+
+	qubits.T(2);
+	qubits.AmplitudeDamping(1, 0.2);
+	qubits.H(2);
+}
+
+int main()
+{
+	Trajectories<double> trajectories(NUM_QUBITS);
+	DensityMatrix<double> rho(NUM_QUBITS);
+
+	circuit(trajectories);
+	circuit(rho);
+
+	int zz = trajectories.addObservable("ZZI");
+	trajectories.setRandomSeed(42);
+	trajectories.run(NUM_SHOTS);
+	trajectories.report();
+
+	int misses = 0;
+
+	for(uint64_t i=0; i<(1ULL << NUM_QUBITS); i++)
+	{
+		double exact = rho.probability(i);
+		double difference = fabs(trajectories.probability(i) - exact);
+		misses += (difference > trajectories.probabilityError(i) + 1e-12);
+
+		printf("|%llu⟩ exact %.4f, sampled %.4f ± %.4f\n", (unsigned long long)i, exact,
+			trajectories.probability(i), trajectories.probabilityError(i));
+	}
+
+	double exactZZ = 0;
+
+	for(uint64_t i=0; i<(1ULL << NUM_QUBITS); i++)
+		exactZZ += ((i ^ i >> 1) & 1)? -rho.probability(i) : rho.probability(i);
+
+	printf("<Z0 Z1> exact %.4f, sampled %.4f ± %.4f\n", exactZZ,
+		trajectories.expectation(zz), trajectories.expectationError(zz));
+	printf("%d of %d outcomes outside their interval, %llu steps shared\n", misses, 1 << NUM_QUBITS,
+		(unsigned long long)trajectories.stepsSaved());
+
+	return 0;
+}